@@ -7,7 +7,8 @@
 Primitive struct introspection.
 
 Provides conversion to tuple and field name access:
-GetFieldNames<TStruct>(), AsTuple(structValue), WriteFieldNames<TStruct>(stream), WriteStruct(stream, structValue), ReadStruct(stream, structValue)
+GetFieldNames<TStruct>(), AsTuple(structValue), WriteFieldNames<TStruct>(stream), WriteStruct(stream, structValue), ReadStruct(stream, structValue),
+ReadStructColumns(columnNames, columns, structValue, storage)
 
 Works for structs with a static DescribeStruct() method or a specialization of GeoToolbox::DescribeStruct<T>() like this:
 
@@ -43,8 +44,12 @@ constexpr auto GeoToolbox::DescribeStruct<X>()
 
 #include "GeoToolbox/StlExtensions.hpp"
 
+#include <algorithm>
 #include <array>
 #include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace GeoToolbox
 {
@@ -182,4 +187,36 @@ namespace GeoToolbox
 				}
 			});
 	}
+
+	// Reads each field from the column of the same name, for the rows written by another version of the struct, with fields added, removed or reordered.
+	// The fields without a column keep their values, the columns without a field are skipped
+	template <class TStruct>
+	void ReadStructColumns(std::vector<std::string> const& columnNames, std::vector<std::string> const& columns, TStruct& value, StringStorage& storage)
+	{
+		constexpr auto descriptor = DescribeStruct<TStruct>();
+		TupleForEach(descriptor, [&](auto const& fieldDesc)
+			{
+				auto const column = std::size_t(std::find(columnNames.begin(), columnNames.end(), fieldDesc.name) - columnNames.begin());
+				if (column >= columns.size())
+				{
+					return;
+				}
+
+				auto& field = value.*fieldDesc.fieldPointer;
+				using FieldType = std::decay_t<decltype(field)>;
+				if constexpr (std::is_same_v<FieldType, std::string_view>)
+				{
+					field = storage.GetOrAddString(columns[column]);
+				}
+				else if constexpr (std::is_same_v<FieldType, std::string>)
+				{
+					field = columns[column];
+				}
+				else
+				{
+					std::istringstream in{ columns[column] };
+					in >> field;
+				}
+			});
+	}
 }
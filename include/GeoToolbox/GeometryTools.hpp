@@ -12,15 +12,185 @@
 #	include <Eigen/Dense>
 #endif
 
+// SIMD instruction set used by the padded vectors and the batched geometry kernels, selected at compile time. Define DISABLE_SIMD to use the scalar implementation only
+#if !defined( DISABLE_SIMD )
+#	if defined( __AVX__ )
+#		define GEOTOOLBOX_SIMD_AVX
+#		include <immintrin.h>
+#	elif defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_IX86_FP ) && _M_IX86_FP >= 2
+#		define GEOTOOLBOX_SIMD_SSE2
+#		include <immintrin.h>
+#	elif defined( __ARM_NEON ) && defined( __aarch64__ )
+#		define GEOTOOLBOX_SIMD_NEON
+#		include <arm_neon.h>
+#	endif
+#endif
+
 #include <algorithm>
 #include <array>
 #include <cmath>
 #include <fstream>
+#include <limits>
 
 namespace GeoToolbox
 {
 	constexpr auto Pi = 3.141592653589793;
 
+	// SIMD registers
+
+	namespace Detail
+	{
+		// The SIMD arithmetic on NWidth scalars, used by the padded vectors and the batched kernels. Width = 0 means no SIMD instructions for this width,
+		// Width = 1 is the scalar fallback. Min(a, b) is a < b ? a : b and Max(a, b) is a > b ? a : b in each lane, returning b if a or b is NaN, like the SSE instructions
+		template <typename TScalar, int NWidth>
+		struct SimdRegister
+		{
+			static constexpr auto Width = 0;
+		};
+
+		template <typename TScalar>
+		struct SimdRegister<TScalar, 1>
+		{
+			static constexpr auto Width = 1;
+
+			using Register = TScalar;
+
+			static Register Broadcast(TScalar value) noexcept { return value; }
+			static Register Load(TScalar const* values) noexcept { return *values; }
+			static void Store(TScalar* values, Register a) noexcept { *values = a; }
+			static Register Add(Register a, Register b) noexcept { return a + b; }
+			static Register Subtract(Register a, Register b) noexcept { return a - b; }
+			static Register Multiply(Register a, Register b) noexcept { return a * b; }
+			static Register Divide(Register a, Register b) noexcept { return a / b; }
+			static Register Min(Register a, Register b) noexcept { return a < b ? a : b; }
+			static Register Max(Register a, Register b) noexcept { return a > b ? a : b; }
+		};
+
+#if defined( GEOTOOLBOX_SIMD_SSE2 ) || defined( GEOTOOLBOX_SIMD_AVX )
+		template <>
+		struct SimdRegister<double, 2>
+		{
+			static constexpr auto Width = 2;
+
+			using Register = __m128d;
+
+			static Register Broadcast(double value) noexcept { return _mm_set1_pd(value); }
+			static Register Load(double const* values) noexcept { return _mm_loadu_pd(values); }
+			static void Store(double* values, Register a) noexcept { _mm_storeu_pd(values, a); }
+			static Register Add(Register a, Register b) noexcept { return _mm_add_pd(a, b); }
+			static Register Subtract(Register a, Register b) noexcept { return _mm_sub_pd(a, b); }
+			static Register Multiply(Register a, Register b) noexcept { return _mm_mul_pd(a, b); }
+			static Register Divide(Register a, Register b) noexcept { return _mm_div_pd(a, b); }
+			static Register Min(Register a, Register b) noexcept { return _mm_min_pd(a, b); }
+			static Register Max(Register a, Register b) noexcept { return _mm_max_pd(a, b); }
+		};
+
+		template <>
+		struct SimdRegister<float, 4>
+		{
+			static constexpr auto Width = 4;
+
+			using Register = __m128;
+
+			static Register Broadcast(float value) noexcept { return _mm_set1_ps(value); }
+			static Register Load(float const* values) noexcept { return _mm_loadu_ps(values); }
+			static void Store(float* values, Register a) noexcept { _mm_storeu_ps(values, a); }
+			static Register Add(Register a, Register b) noexcept { return _mm_add_ps(a, b); }
+			static Register Subtract(Register a, Register b) noexcept { return _mm_sub_ps(a, b); }
+			static Register Multiply(Register a, Register b) noexcept { return _mm_mul_ps(a, b); }
+			static Register Divide(Register a, Register b) noexcept { return _mm_div_ps(a, b); }
+			static Register Min(Register a, Register b) noexcept { return _mm_min_ps(a, b); }
+			static Register Max(Register a, Register b) noexcept { return _mm_max_ps(a, b); }
+		};
+#endif
+
+#if defined( GEOTOOLBOX_SIMD_AVX )
+		template <>
+		struct SimdRegister<double, 4>
+		{
+			static constexpr auto Width = 4;
+
+			using Register = __m256d;
+
+			static Register Broadcast(double value) noexcept { return _mm256_set1_pd(value); }
+			static Register Load(double const* values) noexcept { return _mm256_loadu_pd(values); }
+			static void Store(double* values, Register a) noexcept { _mm256_storeu_pd(values, a); }
+			static Register Add(Register a, Register b) noexcept { return _mm256_add_pd(a, b); }
+			static Register Subtract(Register a, Register b) noexcept { return _mm256_sub_pd(a, b); }
+			static Register Multiply(Register a, Register b) noexcept { return _mm256_mul_pd(a, b); }
+			static Register Divide(Register a, Register b) noexcept { return _mm256_div_pd(a, b); }
+			static Register Min(Register a, Register b) noexcept { return _mm256_min_pd(a, b); }
+			static Register Max(Register a, Register b) noexcept { return _mm256_max_pd(a, b); }
+		};
+
+		template <>
+		struct SimdRegister<float, 8>
+		{
+			static constexpr auto Width = 8;
+
+			using Register = __m256;
+
+			static Register Broadcast(float value) noexcept { return _mm256_set1_ps(value); }
+			static Register Load(float const* values) noexcept { return _mm256_loadu_ps(values); }
+			static void Store(float* values, Register a) noexcept { _mm256_storeu_ps(values, a); }
+			static Register Add(Register a, Register b) noexcept { return _mm256_add_ps(a, b); }
+			static Register Subtract(Register a, Register b) noexcept { return _mm256_sub_ps(a, b); }
+			static Register Multiply(Register a, Register b) noexcept { return _mm256_mul_ps(a, b); }
+			static Register Divide(Register a, Register b) noexcept { return _mm256_div_ps(a, b); }
+			static Register Min(Register a, Register b) noexcept { return _mm256_min_ps(a, b); }
+			static Register Max(Register a, Register b) noexcept { return _mm256_max_ps(a, b); }
+		};
+#elif defined( GEOTOOLBOX_SIMD_NEON )
+		// vminq and vmaxq return NaN if either lane is NaN, the selects below keep the semantics of the SSE instructions
+		template <>
+		struct SimdRegister<double, 2>
+		{
+			static constexpr auto Width = 2;
+
+			using Register = float64x2_t;
+
+			static Register Broadcast(double value) noexcept { return vdupq_n_f64(value); }
+			static Register Load(double const* values) noexcept { return vld1q_f64(values); }
+			static void Store(double* values, Register a) noexcept { vst1q_f64(values, a); }
+			static Register Add(Register a, Register b) noexcept { return vaddq_f64(a, b); }
+			static Register Subtract(Register a, Register b) noexcept { return vsubq_f64(a, b); }
+			static Register Multiply(Register a, Register b) noexcept { return vmulq_f64(a, b); }
+			static Register Divide(Register a, Register b) noexcept { return vdivq_f64(a, b); }
+			static Register Min(Register a, Register b) noexcept { return vbslq_f64(vcltq_f64(a, b), a, b); }
+			static Register Max(Register a, Register b) noexcept { return vbslq_f64(vcgtq_f64(a, b), a, b); }
+		};
+
+		template <>
+		struct SimdRegister<float, 4>
+		{
+			static constexpr auto Width = 4;
+
+			using Register = float32x4_t;
+
+			static Register Broadcast(float value) noexcept { return vdupq_n_f32(value); }
+			static Register Load(float const* values) noexcept { return vld1q_f32(values); }
+			static void Store(float* values, Register a) noexcept { vst1q_f32(values, a); }
+			static Register Add(Register a, Register b) noexcept { return vaddq_f32(a, b); }
+			static Register Subtract(Register a, Register b) noexcept { return vsubq_f32(a, b); }
+			static Register Multiply(Register a, Register b) noexcept { return vmulq_f32(a, b); }
+			static Register Divide(Register a, Register b) noexcept { return vdivq_f32(a, b); }
+			static Register Min(Register a, Register b) noexcept { return vbslq_f32(vcltq_f32(a, b), a, b); }
+			static Register Max(Register a, Register b) noexcept { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+		};
+#endif
+
+		// The widest power of 2 width up to NMaxWidth with SIMD instructions, or 1
+		template <typename TScalar, int NMaxWidth>
+		constexpr int SimdWidthUpTo = SimdRegister<TScalar, NMaxWidth>::Width == NMaxWidth ? NMaxWidth : SimdWidthUpTo<TScalar, NMaxWidth / 2>;
+
+		template <typename TScalar>
+		constexpr int SimdWidthUpTo<TScalar, 1> = 1;
+
+		// The widest SIMD registers for the scalar type, of 32 bytes at most, or the scalar fallback
+		template <typename TScalar>
+		using SimdArithmetic = SimdRegister<TScalar, SimdWidthUpTo<TScalar, int(32 / sizeof(TScalar))>>;
+	}
+
 	// Vector interface
 
 	// In addition to the operations in VectorTraits, all of which have default implementations in VectorTraitsDefault, the following operators must be implemented:
@@ -52,7 +222,7 @@ namespace GeoToolbox
 	template <class T>
 	constexpr bool IsVector =
 		VectorTraits<T>::Dimensions > 0
-		&& sizeof( T ) == VectorTraits<T>::Dimensions * sizeof( typename VectorTraits<T>::ScalarType )
+		&& sizeof( T ) >= VectorTraits<T>::Dimensions * sizeof( typename VectorTraits<T>::ScalarType )
 		&& HasMember<T, HasSubscriptOperator>;
 
 	// Default traits implementation
@@ -189,6 +359,17 @@ namespace GeoToolbox
 			return ComponentApply(a, b, [](auto x, auto y) { return std::max(x, y); });
 		}
 
+		// The bounds of a box extended to a point, the box may be empty, with NaN coordinates, the point may not
+		static constexpr TVector ExtendMin(TVector const& min, TVector const& point)
+		{
+			return ComponentApply(min, point, [](auto x, auto y) { return !(x <= y) ? y : x; });
+		}
+
+		static constexpr TVector ExtendMax(TVector const& max, TVector const& point)
+		{
+			return ComponentApply(max, point, [](auto x, auto y) { return !(x >= y) ? y : x; });
+		}
+
 		static constexpr auto MinimumValue(TVector const& a)
 		{
 			auto const position = std::min_element(&a[0], &a[0] + VectorTraits<TVector>::Dimensions);
@@ -335,6 +516,249 @@ namespace GeoToolbox
 	}
 
 
+	// Vector implementation padded for SIMD: the scalars are padded to a power of 2 count and aligned to their size, e.g. 3 floats in 16 bytes, so that
+	// the component-wise operations of its VectorTraits load, compute and store whole SIMD registers. The padding takes part in these operations
+	// and its value is unspecified, the comparisons, the iteration and the reductions use only the first NDimensions scalars
+
+	namespace Detail
+	{
+		[[nodiscard]] constexpr size_t GetPaddedSize(size_t size) noexcept
+		{
+			size_t result = 1;
+			while (result < size)
+			{
+				result *= 2;
+			}
+
+			return result;
+		}
+	}
+
+	template <typename TScalar, size_t NDimensions>
+	struct alignas(Detail::GetPaddedSize(NDimensions) * sizeof(TScalar)) PaddedVector
+	{
+		static constexpr auto Lanes = Detail::GetPaddedSize(NDimensions);
+
+		using value_type = TScalar;
+
+		std::array<TScalar, Lanes> lanes;
+
+
+		[[nodiscard]] constexpr TScalar& operator[](size_t i) noexcept
+		{
+			return lanes[i];
+		}
+
+		[[nodiscard]] constexpr TScalar const& operator[](size_t i) const noexcept
+		{
+			return lanes[i];
+		}
+
+		[[nodiscard]] static constexpr size_t size() noexcept
+		{
+			return NDimensions;
+		}
+
+		[[nodiscard]] constexpr TScalar* begin() noexcept
+		{
+			return lanes.data();
+		}
+
+		[[nodiscard]] constexpr TScalar* end() noexcept
+		{
+			return lanes.data() + NDimensions;
+		}
+
+		[[nodiscard]] constexpr TScalar const* begin() const noexcept
+		{
+			return lanes.data();
+		}
+
+		[[nodiscard]] constexpr TScalar const* end() const noexcept
+		{
+			return lanes.data() + NDimensions;
+		}
+
+		[[nodiscard]] friend constexpr bool operator==(PaddedVector const& a, PaddedVector const& b) noexcept
+		{
+			for (size_t i = 0; i < NDimensions; ++i)
+			{
+				if (a.lanes[i] != b.lanes[i])
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		[[nodiscard]] friend constexpr bool operator!=(PaddedVector const& a, PaddedVector const& b) noexcept
+		{
+			return !(a == b);
+		}
+	};
+
+	template <typename TScalar, size_t NDimensions>
+	constexpr bool IsArrayVector<PaddedVector<TScalar, NDimensions>> = VectorTraits<PaddedVector<TScalar, NDimensions>>::Dimensions > 0;
+
+	template <typename TScalar, size_t NDimensions>
+	struct VectorTraits<PaddedVector<TScalar, NDimensions>> : VectorTraitsDefault<PaddedVector<TScalar, NDimensions>, TScalar, NDimensions>
+	{
+		static constexpr std::array NameArray = { 'p', 'a', 'd', 'd', 'e', 'd', char('0' + NDimensions), GetFloatTypeCode<TScalar>(), char(0) };
+		static constexpr std::string_view Name{ NameArray.data() };
+
+		// The SIMD intrinsics are not constexpr
+		static constexpr auto IsConstexpr = false;
+
+		using ScalarType = TScalar;
+
+		using ArrayType = std::array<TScalar, NDimensions>;
+
+		using VectorType = PaddedVector<TScalar, NDimensions>;
+
+		template <typename TScalar2, size_t NDimensions2>
+		using Reconfigure = PaddedVector<TScalar2, NDimensions2>;
+
+		// The widest registers that the lanes fill, the lanes take one or more of them
+		using Simd = Detail::SimdRegister<TScalar, Detail::SimdWidthUpTo<TScalar, int(VectorType::Lanes)>>;
+
+
+		static constexpr VectorType FromArray(ArrayType const& v)
+		{
+			VectorType result{};
+			for (size_t i = 0; i < NDimensions; ++i)
+			{
+				result[i] = v[i];
+			}
+
+			return result;
+		}
+
+		static constexpr ArrayType ToArray(VectorType const& v)
+		{
+			ArrayType result{};
+			for (size_t i = 0; i < NDimensions; ++i)
+			{
+				result[i] = v[i];
+			}
+
+			return result;
+		}
+
+		static VectorType OperatorAdd(VectorType const& a, VectorType const& b)
+		{
+			return Apply([](auto x, auto y) { return Simd::Add(x, y); }, a, b);
+		}
+
+		static VectorType OperatorSub(VectorType const& a, VectorType const& b)
+		{
+			return Apply([](auto x, auto y) { return Simd::Subtract(x, y); }, a, b);
+		}
+
+		static VectorType OperatorMultiply(VectorType const& a, VectorType const& b)
+		{
+			return Apply([](auto x, auto y) { return Simd::Multiply(x, y); }, a, b);
+		}
+
+		static VectorType OperatorDivide(VectorType const& a, VectorType const& b)
+		{
+			return Apply([](auto x, auto y) { return Simd::Divide(x, y); }, a, b);
+		}
+
+		static VectorType OperatorMultiplyByScalar(VectorType const& v, ScalarType s)
+		{
+			auto const scalar = Simd::Broadcast(s);
+			return Apply([scalar](auto x) { return Simd::Multiply(x, scalar); }, v);
+		}
+
+		static VectorType OperatorDivideByScalar(VectorType const& v, ScalarType s)
+		{
+			auto const scalar = Simd::Broadcast(s);
+			return Apply([scalar](auto x) { return Simd::Divide(x, scalar); }, v);
+		}
+
+		static VectorType Min(VectorType const& a, VectorType const& b)
+		{
+			return Apply([](auto x, auto y) { return Simd::Min(x, y); }, a, b);
+		}
+
+		static VectorType Max(VectorType const& a, VectorType const& b)
+		{
+			return Apply([](auto x, auto y) { return Simd::Max(x, y); }, a, b);
+		}
+
+		// Min(x, y) is y if x is NaN
+		static VectorType ExtendMin(VectorType const& min, VectorType const& point)
+		{
+			return Min(min, point);
+		}
+
+		static VectorType ExtendMax(VectorType const& max, VectorType const& point)
+		{
+			return Max(max, point);
+		}
+
+		static ScalarType DotProduct(VectorType const& a, VectorType const& b)
+		{
+			return SumComponents(OperatorMultiply(a, b));
+		}
+
+		static ScalarType LengthSquared(VectorType const& a)
+		{
+			return DotProduct(a, a);
+		}
+
+		static ScalarType GetDistanceSquared(VectorType const& a, VectorType const& b)
+		{
+			return SumComponents(Apply([](auto x, auto y)
+				{
+					auto const difference = Simd::Subtract(x, y);
+					return Simd::Multiply(difference, difference);
+				}, a, b));
+		}
+
+		// The same as GetDistanceSquared() of a point and a box
+		static ScalarType GetDistanceSquaredToBox(VectorType const& point, VectorType const& min, VectorType const& max)
+		{
+			auto const zero = Simd::Broadcast(0);
+			return SumComponents(Apply([zero](auto x, auto low, auto high)
+				{
+					auto const outside = Simd::Max(Simd::Max(Simd::Subtract(low, x), Simd::Subtract(x, high)), zero);
+					return Simd::Multiply(outside, outside);
+				}, point, min, max));
+		}
+
+	private:
+
+		template <class TOperation, class... TVectors>
+		static VectorType Apply(TOperation operation, TVectors const&... vectors)
+		{
+			VectorType result;
+			for (size_t i = 0; i < VectorType::Lanes; i += Simd::Width)
+			{
+				Simd::Store(result.lanes.data() + i, operation(Simd::Load(vectors.lanes.data() + i)...));
+			}
+
+			return result;
+		}
+
+		// Summed in the order of the axes, like the other distance functions
+		static ScalarType SumComponents(VectorType const& v)
+		{
+			ScalarType result = 0;
+			for (size_t i = 0; i < NDimensions; ++i)
+			{
+				result += v[i];
+			}
+
+			return result;
+		}
+	};
+
+	using PaddedVector3 = PaddedVector<double, 3>;
+	using PaddedVector3f = PaddedVector<float, 3>;
+
+
 	// Vector implementation using Eigen
 
 #if defined( ENABLE_EIGEN )
@@ -381,6 +805,7 @@ namespace GeoToolbox
 	};
 
 	using EVector2 = Eigen::Vector<double, 2>;
+	using EVector3 = Eigen::Vector<double, 3>;
 #endif
 
 	// Operations with generic implementations, based on VectorTraits
@@ -640,9 +1065,9 @@ namespace GeoToolbox
 			// *this may be NaN, point may not
 			DEBUG_ASSERT(AllOf(point, [](auto x) { return !std::isnan(x); }));
 
-			// Can't use std::min/max here, this must work for empty boxes that use nan coordinates, hence the weird comparisons
-			ends_[0] = ComponentApply(ends_[0], point, [](auto x, auto y) { return !(x <= y) ? y : x; });
-			ends_[1] = ComponentApply(ends_[1], point, [](auto x, auto y) { return !(x >= y) ? y : x; });
+			// Can't use std::min/max here, this must work for empty boxes that use nan coordinates, see VectorTraitsDefault::ExtendMin()
+			ends_[0] = VectorTraitsType::ExtendMin(ends_[0], point);
+			ends_[1] = VectorTraitsType::ExtendMax(ends_[1], point);
 			return *this;
 		}
 
@@ -691,9 +1116,7 @@ namespace GeoToolbox
 		{
 			// box may be empty, point may not be NaN
 			DEBUG_ASSERT(AllOf(point, [](auto x) { return !std::isnan(x); }));
-			return Box{
-				ComponentApply(box.ends_[0], point, [](auto x, auto y) { return !(x <= y) ? y : x; }),
-				ComponentApply(box.ends_[1], point, [](auto x, auto y) { return !(x >= y) ? y : x; }) };
+			return Box{ VectorTraitsType::ExtendMin(box.ends_[0], point), VectorTraitsType::ExtendMax(box.ends_[1], point) };
 		}
 
 		friend constexpr bool operator==(Box const& a, Box const& b)
@@ -774,84 +1197,88 @@ namespace GeoToolbox
 		}
 	}
 
-	template <class TVector>
-	[[nodiscard]] bool Overlap(Box<TVector> const& a, Box<TVector> const& b) noexcept
+	// The box primitives below are unrolled at compile time over the axes and have no per-axis branches: the comparisons of all axes are combined with & and
+	// the coordinates are clamped with min/max. Early exits pay off only when the outcome is predictable, which it is not for the candidates of a spatial query
+	namespace Detail
 	{
-		for (auto i = 0; i < int(VectorTraits<TVector>::Dimensions); ++i)
+		template <class TVector, std::size_t... Indices>
+		constexpr bool OverlapImpl(Box<TVector> const& a, Box<TVector> const& b, std::index_sequence<Indices...>) noexcept
 		{
-			if (a.Max()[i] < b.Min()[i] || a.Min()[i] > b.Max()[i])
-			{
-				return false;
-			}
+			using Traits = VectorTraits<TVector>;
+			return ((!(Traits::template Get<Indices>(a.Max()) < Traits::template Get<Indices>(b.Min())) & !(Traits::template Get<Indices>(a.Min()) > Traits::template Get<Indices>(b.Max()))) & ...);
+		}
+
+		template <class TVector, std::size_t... Indices>
+		constexpr bool ContainsImpl(Box<TVector> const& a, Box<TVector> const& b, std::index_sequence<Indices...>) noexcept
+		{
+			using Traits = VectorTraits<TVector>;
+			return ((!(Traits::template Get<Indices>(a.Min()) > Traits::template Get<Indices>(b.Min())) & !(Traits::template Get<Indices>(a.Max()) < Traits::template Get<Indices>(b.Max()))) & ...);
+		}
+
+		template <class TVector, std::size_t... Indices>
+		constexpr bool OverlapPointImpl(Box<TVector> const& box, TVector const& point, std::index_sequence<Indices...>) noexcept
+		{
+			using Traits = VectorTraits<TVector>;
+			return ((!(Traits::template Get<Indices>(point) < Traits::template Get<Indices>(box.Min())) & !(Traits::template Get<Indices>(point) > Traits::template Get<Indices>(box.Max()))) & ...);
 		}
 
-		return true;
+		template <class TVector, std::size_t... Indices>
+		constexpr TVector ClampImpl(TVector const& point, TVector const& min, TVector const& max, std::index_sequence<Indices...>)
+		{
+			using Traits = VectorTraits<TVector>;
+			return TVector{ std::min(std::max(Traits::template Get<Indices>(point), Traits::template Get<Indices>(min)), Traits::template Get<Indices>(max)) ... };
+		}
+
+		// The distance to the box along one axis is the larger of the distances past its two sides, or 0 if the coordinate is inside
+		template <class TScalar>
+		constexpr TScalar GetDistanceOutside(TScalar coordinate, TScalar min, TScalar max) noexcept
+		{
+			return std::max(std::max(min - coordinate, coordinate - max), TScalar{ 0 });
+		}
+
+		template <class TVector, std::size_t... Indices>
+		constexpr auto GetDistanceSquaredImpl(TVector const& point, Box<TVector> const& box, std::index_sequence<Indices...>) noexcept
+		{
+			using Traits = VectorTraits<TVector>;
+
+			// Summed in the order of the axes, like the other distance functions
+			return (typename Traits::ScalarType{ 0 } + ... + Square(GetDistanceOutside(Traits::template Get<Indices>(point), Traits::template Get<Indices>(box.Min()), Traits::template Get<Indices>(box.Max()))));
+		}
 	}
 
 	template <class TVector>
-	[[nodiscard]] bool Contains(Box<TVector> const& a, Box<TVector> const& b) noexcept
+	[[nodiscard]] bool Overlap(Box<TVector> const& a, Box<TVector> const& b) noexcept
 	{
-		for (auto i = 0; i < int(VectorTraits<TVector>::Dimensions); ++i)
-		{
-			if (a.Min()[i] > b.Min()[i] || a.Max()[i] < b.Max()[i])
-			{
-				return false;
-			}
-		}
+		return Detail::OverlapImpl(a, b, std::make_index_sequence<VectorTraits<TVector>::Dimensions>());
+	}
 
-		return true;
+	template <class TVector>
+	[[nodiscard]] bool Contains(Box<TVector> const& a, Box<TVector> const& b) noexcept
+	{
+		return Detail::ContainsImpl(a, b, std::make_index_sequence<VectorTraits<TVector>::Dimensions>());
 	}
 
 	template <class TVector>
 	[[nodiscard]] bool Overlap(Box<TVector> const& box, TVector const& point) noexcept
 	{
-		for (auto i = 0; i < int(VectorTraits<TVector>::Dimensions); ++i)
-		{
-			if (point[i] < box.Min()[i] || point[i] > box.Max()[i])
-			{
-				return false;
-			}
-		}
-
-		return true;
+		return Detail::OverlapPointImpl(box, point, std::make_index_sequence<VectorTraits<TVector>::Dimensions>());
 	}
 
 	template <class TVector>
 	[[nodiscard]] Box<TVector> Intersect(Box<TVector> const& a, Box<TVector> const& b) noexcept
 	{
-		auto min = a.Min();
-		auto max = a.Max();
-		for (auto i = 0; i < int(VectorTraits<TVector>::Dimensions); ++i)
+		if (!Overlap(a, b))
 		{
-			if (min[i] > b.Max()[i] || max[i] < b.Min()[i])
-			{
-				return {};
-			}
-
-			if (min[i] < b.Min()[i])
-			{
-				min[i] = b.Min()[i];
-			}
-
-			if (max[i] > b.Max()[i])
-			{
-				max[i] = b.Max()[i];
-			}
+			return {};
 		}
 
-		return { min, max };
+		return { Max(a.Min(), b.Min()), Min(a.Max(), b.Max()) };
 	}
 
 	template <class TVector>
 	[[nodiscard]] typename Box<TVector>::VectorType GetClosestPointOnBox(Box<TVector> const& box, typename Box<TVector>::VectorType targetPoint)
 	{
-		TVector closest{} /* [[indeterminate]] */;
-		for (auto i = 0; i < int(VectorTraits<TVector>::Dimensions); ++i)
-		{
-			closest[i] = std::clamp(targetPoint[i], box.Min()[i], box.Max()[i]);
-		}
-
-		return closest;
+		return Detail::ClampImpl(targetPoint, box.Min(), box.Max(), std::make_index_sequence<VectorTraits<TVector>::Dimensions>());
 	}
 
 	template <class TVector>
@@ -869,41 +1296,324 @@ namespace GeoToolbox
 	template <class TVector>
 	[[nodiscard]] auto GetDistanceSquared(TVector const& point, Box<TVector> const& box)
 	{
-		typename VectorTraits<TVector>::ScalarType result{ 0 };
-		for (auto i = 0; i < int(VectorTraits<TVector>::Dimensions); ++i)
-		{
-			if (point[i] < box.Min()[i])
+		return Detail::GetDistanceSquaredImpl(point, box, std::make_index_sequence<VectorTraits<TVector>::Dimensions>());
+	}
+
+	template <typename TScalar, size_t NDimensions>
+	[[nodiscard]] TScalar GetDistanceSquared(PaddedVector<TScalar, NDimensions> const& point, Box<PaddedVector<TScalar, NDimensions>> const& box)
+	{
+		return VectorTraits<PaddedVector<TScalar, NDimensions>>::GetDistanceSquaredToBox(point, box.Min(), box.Max());
+	}
+
+	template <class TVector>
+	[[nodiscard]] auto GetDistanceSquared(TVector const& point, Box<TVector> const& box, int axisIndex) -> typename VectorTraits<TVector>::ScalarType
+	{
+		return Square(Detail::GetDistanceOutside(point[axisIndex], box.Min()[axisIndex], box.Max()[axisIndex]));
+	}
+
+	template <class TVector>
+	[[nodiscard]] auto GetDistance(TVector const& a, Box<TVector> const& b)
+	{
+		return std::sqrt(GetDistanceSquared(a, b));
+	}
+
+	// The squared distance to the closest point of the segment, the projection of the point on the line of the segment clamped to its ends
+	template <class TVector>
+	[[nodiscard]] auto GetDistanceSquared(TVector const& point, Segment<TVector> const& segment)
+	{
+		using ScalarType = typename VectorTraits<TVector>::ScalarType;
+
+		auto const direction = segment.second - segment.first;
+
+		// A degenerate segment is its first end, the smallest normal divisor keeps the projection 0 for it without a branch
+		auto const position = DotProduct(point - segment.first, direction) / std::max(LengthSquared(direction), std::numeric_limits<ScalarType>::min());
+		return GetDistanceSquared(point, segment.first + direction * std::min(std::max(position, ScalarType(0)), ScalarType(1)));
+	}
+
+
+	// Batched overlap tests: one query box against many candidates, whose coordinates are stored in one array per axis (structure of arrays)
+
+	// The maximum count of candidates tested in a single call to GetOverlapMask(), i.e. the size of the returned bitmask
+	constexpr auto OverlapMaskBits = 64;
+
+	namespace Detail
+	{
+		template <typename TScalar, size_t NDimensions>
+		[[nodiscard]] std::uint64_t GetOverlapMaskScalar(
+			std::array<TScalar, NDimensions> const& queryMin,
+			std::array<TScalar, NDimensions> const& queryMax,
+			std::array<TScalar const*, NDimensions> const& mins,
+			std::array<TScalar const*, NDimensions> const& maxs,
+			int first,
+			int count) noexcept
+		{
+			std::uint64_t result = 0;
+			for (auto i = first; i < count; ++i)
 			{
-				result += Square(box.Min()[i] - point[i]);
+				// No early exit, all axes are tested, to avoid unpredictable branches
+				auto overlap = 1u;
+				for (size_t axis = 0; axis < NDimensions; ++axis)
+				{
+					overlap &= unsigned(mins[axis][i] <= queryMax[axis]) & unsigned(maxs[axis][i] >= queryMin[axis]);
+				}
+
+				result |= std::uint64_t(overlap) << i;
 			}
-			else if (point[i] > box.Max()[i])
+
+			return result;
+		}
+
+		// Interface to the SIMD instructions needed by GetOverlapMask(). Width = 0 means no SIMD implementation for this scalar type
+		template <typename TScalar>
+		struct SimdOverlap
+		{
+			static constexpr auto Width = 0;
+		};
+
+#if defined( GEOTOOLBOX_SIMD_AVX )
+		template <>
+		struct SimdOverlap<double>
+		{
+			static constexpr auto Width = 4;
+
+			using Register = __m256d;
+			using Mask = __m256d;
+
+			static Register Broadcast(double value) noexcept { return _mm256_set1_pd(value); }
+			static Register Load(double const* values) noexcept { return _mm256_loadu_pd(values); }
+			static Mask Overlap(Register min, Register max, Register queryMin, Register queryMax) noexcept { return _mm256_and_pd(_mm256_cmp_pd(min, queryMax, _CMP_LE_OQ), _mm256_cmp_pd(max, queryMin, _CMP_GE_OQ)); }
+			static Mask And(Mask a, Mask b) noexcept { return _mm256_and_pd(a, b); }
+			static std::uint64_t ToBits(Mask mask) noexcept { return std::uint64_t(_mm256_movemask_pd(mask)); }
+		};
+
+		template <>
+		struct SimdOverlap<float>
+		{
+			static constexpr auto Width = 8;
+
+			using Register = __m256;
+			using Mask = __m256;
+
+			static Register Broadcast(float value) noexcept { return _mm256_set1_ps(value); }
+			static Register Load(float const* values) noexcept { return _mm256_loadu_ps(values); }
+			static Mask Overlap(Register min, Register max, Register queryMin, Register queryMax) noexcept { return _mm256_and_ps(_mm256_cmp_ps(min, queryMax, _CMP_LE_OQ), _mm256_cmp_ps(max, queryMin, _CMP_GE_OQ)); }
+			static Mask And(Mask a, Mask b) noexcept { return _mm256_and_ps(a, b); }
+			static std::uint64_t ToBits(Mask mask) noexcept { return std::uint64_t(_mm256_movemask_ps(mask)); }
+		};
+#elif defined( GEOTOOLBOX_SIMD_SSE2 )
+		template <>
+		struct SimdOverlap<double>
+		{
+			static constexpr auto Width = 2;
+
+			using Register = __m128d;
+			using Mask = __m128d;
+
+			static Register Broadcast(double value) noexcept { return _mm_set1_pd(value); }
+			static Register Load(double const* values) noexcept { return _mm_loadu_pd(values); }
+			static Mask Overlap(Register min, Register max, Register queryMin, Register queryMax) noexcept { return _mm_and_pd(_mm_cmple_pd(min, queryMax), _mm_cmpge_pd(max, queryMin)); }
+			static Mask And(Mask a, Mask b) noexcept { return _mm_and_pd(a, b); }
+			static std::uint64_t ToBits(Mask mask) noexcept { return std::uint64_t(_mm_movemask_pd(mask)); }
+		};
+
+		template <>
+		struct SimdOverlap<float>
+		{
+			static constexpr auto Width = 4;
+
+			using Register = __m128;
+			using Mask = __m128;
+
+			static Register Broadcast(float value) noexcept { return _mm_set1_ps(value); }
+			static Register Load(float const* values) noexcept { return _mm_loadu_ps(values); }
+			static Mask Overlap(Register min, Register max, Register queryMin, Register queryMax) noexcept { return _mm_and_ps(_mm_cmple_ps(min, queryMax), _mm_cmpge_ps(max, queryMin)); }
+			static Mask And(Mask a, Mask b) noexcept { return _mm_and_ps(a, b); }
+			static std::uint64_t ToBits(Mask mask) noexcept { return std::uint64_t(_mm_movemask_ps(mask)); }
+		};
+#elif defined( GEOTOOLBOX_SIMD_NEON )
+		template <>
+		struct SimdOverlap<double>
+		{
+			static constexpr auto Width = 2;
+
+			using Register = float64x2_t;
+			using Mask = uint64x2_t;
+
+			static Register Broadcast(double value) noexcept { return vdupq_n_f64(value); }
+			static Register Load(double const* values) noexcept { return vld1q_f64(values); }
+			static Mask Overlap(Register min, Register max, Register queryMin, Register queryMax) noexcept { return vandq_u64(vcleq_f64(min, queryMax), vcgeq_f64(max, queryMin)); }
+			static Mask And(Mask a, Mask b) noexcept { return vandq_u64(a, b); }
+			static std::uint64_t ToBits(Mask mask) noexcept
 			{
-				result += Square(point[i] - box.Max()[i]);
+				static constexpr std::uint64_t Bits[] = { 1, 2 };
+				return vaddvq_u64(vandq_u64(mask, vld1q_u64(Bits)));
 			}
-		}
+		};
 
-		return result;
+		template <>
+		struct SimdOverlap<float>
+		{
+			static constexpr auto Width = 4;
+
+			using Register = float32x4_t;
+			using Mask = uint32x4_t;
+
+			static Register Broadcast(float value) noexcept { return vdupq_n_f32(value); }
+			static Register Load(float const* values) noexcept { return vld1q_f32(values); }
+			static Mask Overlap(Register min, Register max, Register queryMin, Register queryMax) noexcept { return vandq_u32(vcleq_f32(min, queryMax), vcgeq_f32(max, queryMin)); }
+			static Mask And(Mask a, Mask b) noexcept { return vandq_u32(a, b); }
+			static std::uint64_t ToBits(Mask mask) noexcept
+			{
+				static constexpr std::uint32_t Bits[] = { 1, 2, 4, 8 };
+				return vaddvq_u32(vandq_u32(mask, vld1q_u32(Bits)));
+			}
+		};
+#endif
 	}
 
-	template <class TVector>
-	[[nodiscard]] auto GetDistanceSquared(TVector const& point, Box<TVector> const& box, int axisIndex) -> typename VectorTraits<TVector>::ScalarType
+	// Tests the query box against count (up to OverlapMaskBits) candidate boxes, the i-th of which is [mins[axis][i], maxs[axis][i]] along each axis.
+	// Bit i of the result is set if candidate i overlaps the query. For point candidates pass the same arrays as mins and maxs.
+	// Uses the widest SIMD instructions available at compile time for the scalar type, and a branchless scalar loop for the remainder.
+	template <typename TScalar, size_t NDimensions>
+	[[nodiscard]] std::uint64_t GetOverlapMask(
+		std::array<TScalar, NDimensions> const& queryMin,
+		std::array<TScalar, NDimensions> const& queryMax,
+		std::array<TScalar const*, NDimensions> const& mins,
+		std::array<TScalar const*, NDimensions> const& maxs,
+		int count) noexcept
 	{
-		if (point[axisIndex] < box.Min()[axisIndex])
-		{
-			return Square(box.Min()[axisIndex] - point[axisIndex]);
-		}
-		else if (point[axisIndex] > box.Max()[axisIndex])
+		DEBUG_ASSERT(count >= 0 && count <= OverlapMaskBits);
+
+		using Simd = Detail::SimdOverlap<TScalar>;
+
+		std::uint64_t result = 0;
+		auto i = 0;
+		if constexpr (Simd::Width > 0)
 		{
-			return Square(point[axisIndex] - box.Max()[axisIndex]);
+			// Plain arrays, std::array drops the alignment attributes of the register types
+			typename Simd::Register queryMins[NDimensions];
+			typename Simd::Register queryMaxs[NDimensions];
+			for (size_t axis = 0; axis < NDimensions; ++axis)
+			{
+				queryMins[axis] = Simd::Broadcast(queryMin[axis]);
+				queryMaxs[axis] = Simd::Broadcast(queryMax[axis]);
+			}
+
+			for (; i + Simd::Width <= count; i += Simd::Width)
+			{
+				auto mask = Simd::Overlap(Simd::Load(mins[0] + i), Simd::Load(maxs[0] + i), queryMins[0], queryMaxs[0]);
+				for (size_t axis = 1; axis < NDimensions; ++axis)
+				{
+					mask = Simd::And(mask, Simd::Overlap(Simd::Load(mins[axis] + i), Simd::Load(maxs[axis] + i), queryMins[axis], queryMaxs[axis]));
+				}
+
+				result |= Simd::ToBits(mask) << i;
+			}
 		}
 
-		return 0;
+		return result | Detail::GetOverlapMaskScalar(queryMin, queryMax, mins, maxs, i, count);
 	}
 
 	template <class TVector>
-	[[nodiscard]] auto GetDistance(TVector const& a, Box<TVector> const& b)
+	[[nodiscard]] std::uint64_t GetOverlapMask(
+		Box<TVector> const& query,
+		std::array<typename VectorTraits<TVector>::ScalarType const*, VectorTraits<TVector>::Dimensions> const& mins,
+		std::array<typename VectorTraits<TVector>::ScalarType const*, VectorTraits<TVector>::Dimensions> const& maxs,
+		int count) noexcept
 	{
-		return std::sqrt(GetDistanceSquared(a, b));
+		return GetOverlapMask(VectorTraits<TVector>::ToArray(query.Min()), VectorTraits<TVector>::ToArray(query.Max()), mins, maxs, count);
+	}
+
+
+	// Batched point to segment distances: one query point against many segments, whose ends are stored in one array per axis (structure of arrays)
+
+	namespace Detail
+	{
+		template <typename TScalar, size_t NDimensions>
+		[[nodiscard]] TScalar GetSegmentDistanceSquaredScalar(
+			std::array<TScalar, NDimensions> const& point,
+			std::array<TScalar const*, NDimensions> const& starts,
+			std::array<TScalar const*, NDimensions> const& ends,
+			int i) noexcept
+		{
+			TScalar product = 0;
+			TScalar lengthSquared = 0;
+			for (size_t axis = 0; axis < NDimensions; ++axis)
+			{
+				auto const direction = ends[axis][i] - starts[axis][i];
+				product += (point[axis] - starts[axis][i]) * direction;
+				lengthSquared += direction * direction;
+			}
+
+			auto const position = std::min(std::max(product / std::max(lengthSquared, std::numeric_limits<TScalar>::min()), TScalar(0)), TScalar(1));
+			TScalar result = 0;
+			for (size_t axis = 0; axis < NDimensions; ++axis)
+			{
+				result += Square(point[axis] - (starts[axis][i] + (ends[axis][i] - starts[axis][i]) * position));
+			}
+
+			return result;
+		}
+	}
+
+	// Stores in distancesSquared[i] the squared distance from the point to the i-th of count segments, from starts[axis][i] to ends[axis][i] along each axis,
+	// the same as GetDistanceSquared() of a point and a segment. Uses the widest SIMD instructions available at compile time for the scalar type,
+	// and a scalar loop for the remainder
+	template <typename TScalar, size_t NDimensions>
+	void GetSegmentDistancesSquared(
+		std::array<TScalar, NDimensions> const& point,
+		std::array<TScalar const*, NDimensions> const& starts,
+		std::array<TScalar const*, NDimensions> const& ends,
+		int count,
+		TScalar* distancesSquared) noexcept
+	{
+		DEBUG_ASSERT(count >= 0);
+
+		using Simd = Detail::SimdArithmetic<TScalar>;
+
+		auto i = 0;
+		if constexpr (Simd::Width > 1)
+		{
+			// Plain arrays, std::array drops the alignment attributes of the register types
+			typename Simd::Register points[NDimensions];
+			for (size_t axis = 0; axis < NDimensions; ++axis)
+			{
+				points[axis] = Simd::Broadcast(point[axis]);
+			}
+
+			auto const zero = Simd::Broadcast(TScalar(0));
+			auto const one = Simd::Broadcast(TScalar(1));
+			auto const smallest = Simd::Broadcast(std::numeric_limits<TScalar>::min());
+			for (; i + Simd::Width <= count; i += Simd::Width)
+			{
+				typename Simd::Register segmentStarts[NDimensions];
+				typename Simd::Register directions[NDimensions];
+				auto product = zero;
+				auto lengthSquared = zero;
+				for (size_t axis = 0; axis < NDimensions; ++axis)
+				{
+					segmentStarts[axis] = Simd::Load(starts[axis] + i);
+					directions[axis] = Simd::Subtract(Simd::Load(ends[axis] + i), segmentStarts[axis]);
+					product = Simd::Add(product, Simd::Multiply(Simd::Subtract(points[axis], segmentStarts[axis]), directions[axis]));
+					lengthSquared = Simd::Add(lengthSquared, Simd::Multiply(directions[axis], directions[axis]));
+				}
+
+				auto const position = Simd::Min(Simd::Max(Simd::Divide(product, Simd::Max(lengthSquared, smallest)), zero), one);
+				auto result = zero;
+				for (size_t axis = 0; axis < NDimensions; ++axis)
+				{
+					auto const difference = Simd::Subtract(points[axis], Simd::Add(segmentStarts[axis], Simd::Multiply(directions[axis], position)));
+					result = Simd::Add(result, Simd::Multiply(difference, difference));
+				}
+
+				Simd::Store(distancesSquared + i, result);
+			}
+		}
+
+		for (; i < count; ++i)
+		{
+			distancesSquared[i] = Detail::GetSegmentDistanceSquaredScalar(point, starts, ends, i);
+		}
 	}
 
 
@@ -943,15 +1653,22 @@ namespace GeoToolbox
 	}
 
 
-	template <class TVector, class TIterator>
-	void MakeCircle(TIterator output, typename VectorTraits<TVector>::ScalarType radius, int vertexCount)
+	// Returns vertex index of MakeCircle(), so that parts of the circle can be made independently
+	template <class TVector>
+	[[nodiscard]] TVector GetCirclePoint(typename VectorTraits<TVector>::ScalarType radius, int index, int vertexCount)
 	{
 		using ScalarType = typename VectorTraits<TVector>::ScalarType;
 
+		auto const angle = index * 2 * Pi / vertexCount;
+		return radius * TVector{ ScalarType(std::cos(angle)), ScalarType(std::sin(angle)) };
+	}
+
+	template <class TVector, class TIterator>
+	void MakeCircle(TIterator output, typename VectorTraits<TVector>::ScalarType radius, int vertexCount)
+	{
 		for (auto i = 0; i < vertexCount; ++i)
 		{
-			auto const angle = i * 2 * Pi / vertexCount;
-			*output = radius * TVector{ ScalarType(std::cos(angle)), ScalarType(std::sin(angle)) };
+			*output = GetCirclePoint<TVector>(radius, i, vertexCount);
 			++output;
 		}
 	}
@@ -964,4 +1681,47 @@ namespace GeoToolbox
 		MakeCircle(std::back_inserter(result), radius, vertexCount);
 		return result;
 	}
+
+
+	// Geodetic coordinates
+
+	// The mean radius of the Earth in meters (IUGG), to scale the great-circle distances on the unit sphere
+	constexpr auto EarthMeanRadius = 6'371'008.8;
+
+	// A longitude and latitude in radians, with the cosine of the latitude for the haversine formula
+	struct GeodeticLocation
+	{
+		double longitude = 0;
+		double latitude = 0;
+		double cosLatitude = 1;
+
+		[[nodiscard]] static GeodeticLocation FromDegrees(double longitude, double latitude)
+		{
+			return { longitude * Pi / 180, latitude * Pi / 180, std::cos(latitude * Pi / 180) };
+		}
+	};
+
+	// The point of the unit sphere at the location, with the z axis through the north pole and the x axis through longitude 0. The chord between two of these points
+	// is 2 sin(d / 2) for the great-circle distance d between them, it grows with d and is never longer, so the nearest points by chord are the nearest by great-circle distance,
+	// without the wrap-around at the antimeridian and the converging meridians at the poles
+	template <class TVector3>
+	[[nodiscard]] TVector3 ToUnitSphere(GeodeticLocation const& location)
+	{
+		using ScalarType = typename VectorTraits<TVector3>::ScalarType;
+
+		TVector3 result{};
+		result[0] = ScalarType(location.cosLatitude * std::cos(location.longitude));
+		result[1] = ScalarType(location.cosLatitude * std::sin(location.longitude));
+		result[2] = ScalarType(std::sin(location.latitude));
+		return result;
+	}
+
+	// The great-circle distance in radians, on the unit sphere, by the haversine formula, which is accurate for the small distances too
+	[[nodiscard]] inline double GetGreatCircleDistance(GeodeticLocation const& a, GeodeticLocation const& b)
+	{
+		auto const sinHalfLatitude = std::sin((b.latitude - a.latitude) / 2);
+		auto const sinHalfLongitude = std::sin((b.longitude - a.longitude) / 2);
+		auto const haversine = sinHalfLatitude * sinHalfLatitude + a.cosLatitude * b.cosLatitude * sinHalfLongitude * sinHalfLongitude;
+		return 2 * std::asin(std::min(1.0, std::sqrt(haversine)));
+	}
 }
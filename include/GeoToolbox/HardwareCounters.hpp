@@ -0,0 +1,69 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace GeoToolbox
+{
+	// Counts hardware events of the thread that created the object: with perf_event_open() on Linux, and only the cycles (QueryThreadCycleTime()) on Windows,
+	// where the other counters need a kernel driver. Counters that cannot be opened (no PMU in a VM, too high perf_event_paranoid, etc.) always read as 0.
+	// When the PMU has fewer registers than counters, the kernel multiplexes them and the values are scaled by the time each one was actually counting
+	class HardwareCounters
+	{
+	public:
+
+		enum Counter
+		{
+			Cycles,
+			Instructions,
+			L1DataMisses,
+			LastLevelCacheMisses,
+			BranchMisses,
+			DataTlbMisses,
+			CounterCount
+		};
+
+		using Values = std::array<std::int64_t, CounterCount>;
+
+		static constexpr std::array<char const*, CounterCount> Names = { "Cycles", "Instructions", "L1D Misses", "LLC Misses", "Branch Misses", "DTLB Misses" };
+
+	private:
+
+		std::array<std::intptr_t, CounterCount> handles_{};
+
+	public:
+
+		HardwareCounters();
+
+		HardwareCounters(HardwareCounters const&) = delete;
+		HardwareCounters(HardwareCounters&&) = delete;
+		HardwareCounters& operator=(HardwareCounters const&) = delete;
+		HardwareCounters& operator=(HardwareCounters&&) = delete;
+
+		~HardwareCounters();
+
+		// True if at least one of the counters could be opened
+		[[nodiscard]] bool IsAvailable() const noexcept;
+
+		[[nodiscard]] bool IsAvailable(Counter counter) const noexcept;
+
+		// The counts since the counters were opened. Must be called on the thread that created the object
+		[[nodiscard]] Values Read() const noexcept;
+
+		[[nodiscard]] static Values Subtract(Values const& end, Values const& start) noexcept
+		{
+			Values result{};
+			for (auto i = 0; i < CounterCount; ++i)
+			{
+				result[i] = end[i] - start[i];
+			}
+
+			return result;
+		}
+	};
+}
@@ -47,6 +47,12 @@ namespace GeoToolbox
 			return data_;
 		}
 
+		// The rows from top to bottom, for the drawing that does not go through Draw()
+		[[nodiscard]] std::vector<Color>& GetData() noexcept
+		{
+			return data_;
+		}
+
 		// Save to PNG file, filename should have .png extension
 		void Encode(std::string const& filename) const;
 
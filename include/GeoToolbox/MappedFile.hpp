@@ -0,0 +1,90 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Span.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <type_traits>
+
+namespace GeoToolbox
+{
+	// A read-only memory mapping of a whole file. The pages are loaded by the OS on first access, so opening is cheap regardless of the file size.
+	// The mapped data is valid for the lifetime of the object
+	class MappedFile
+	{
+		std::byte const* data_ = nullptr;
+		std::size_t size_ = 0;
+#if defined( _WIN32 )
+		void* fileHandle_ = nullptr;
+		void* mappingHandle_ = nullptr;
+#endif
+
+	public:
+
+		MappedFile() = default;
+
+		// Check IsOpen() to see if opening and mapping the file succeeded
+		explicit MappedFile(std::filesystem::path const& filePath);
+
+		MappedFile(MappedFile const&) = delete;
+		MappedFile(MappedFile&&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile&&) = delete;
+
+		~MappedFile();
+
+		[[nodiscard]] bool IsOpen() const noexcept
+		{
+			return data_ != nullptr;
+		}
+
+		[[nodiscard]] std::size_t GetSize() const noexcept
+		{
+			return size_;
+		}
+
+		[[nodiscard]] Span<std::byte const> GetBytes() const noexcept
+		{
+			return { data_, std::ptrdiff_t(size_) };
+		}
+
+		// Returns a view of count objects of type T, starting byteOffset bytes into the file, or an empty view if these are outside of the file or misaligned.
+		// T must be trivially copyable, the file is expected to have been written with the same object layout
+		template <typename T>
+		[[nodiscard]] Span<T const> GetArray(std::size_t byteOffset, std::size_t count) const noexcept
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+
+			if (!IsOpen() || byteOffset > size_ || count > (size_ - byteOffset) / sizeof(T) || (std::uintptr_t(data_) + byteOffset) % alignof(T) != 0)
+			{
+				return {};
+			}
+
+			return { reinterpret_cast<T const*>(data_ + byteOffset), std::ptrdiff_t(count) };
+		}
+
+		// Asks the OS to drop the cached pages of the file, so that the next mapping reads them from the storage device, as after a reboot.
+		// Supported on Linux only (posix_fadvise()), returns false if the pages could not be dropped
+		static bool DropCachedPages(std::filesystem::path const& filePath) noexcept;
+	};
+
+	// The count of the page faults of the process so far, minor (the page was in memory, e.g. in the file cache) and major (the page was read from the storage device).
+	// Returns 0 if not available
+	[[nodiscard]] std::int64_t GetPageFaultCount() noexcept;
+
+	struct IoByteCounts
+	{
+		std::int64_t read = 0;
+		std::int64_t written = 0;
+	};
+
+	// The bytes read and written by the process so far through file reads and writes, including those served from the file cache.
+	// The accesses to memory-mapped files are not included, see GetPageFaultCount() for them. Returns zeros if not available
+	[[nodiscard]] IoByteCounts GetIoByteCounts() noexcept;
+}
@@ -0,0 +1,340 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "MappedFile.hpp"
+#include "Span.hpp"
+#include "SpatialTools.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace GeoToolbox
+{
+	// Reads the vertices and writes the vertices and faces of Wavefront OBJ files. The work is split in chunks processed in parallel,
+	// numbers are parsed and formatted with from_chars/to_chars, without streams or per-line allocations
+	class ObjFile
+	{
+		// Enough for any integer or shortest round-trip floating-point representation
+		static constexpr auto MaxNumberLength = 32;
+
+		static constexpr std::size_t ReadChunkBytes = 1024 * 1024;
+
+		static constexpr std::ptrdiff_t WriteChunkLines = 16 * 1024;
+
+	public:
+
+		using Quad = std::array<std::int64_t, 4>;
+
+		// Reads the vertices ("v" lines) of the file as features, the ids are the vertex indices. Other lines, and vertices with fewer coordinates than TVector, are skipped.
+		// The file is memory-mapped and split in newline-aligned chunks. The threads count the vertices of their chunks first, then parse them directly into their place in the result.
+		// Returns nullopt if the file cannot be mapped. A threadCount of 0 or less means one thread per hardware thread
+		template <class TVector>
+		[[nodiscard]] static std::optional<std::vector<Feature<TVector>>> ReadVertices(std::filesystem::path const& filePath, int threadCount = 0)
+		{
+			MappedFile const file{ filePath };
+			if (!file.IsOpen())
+			{
+				return std::nullopt;
+			}
+
+			auto const bytes = file.GetBytes();
+			auto const text = reinterpret_cast<char const*>(bytes.data());
+			auto const size = std::size_t(bytes.size());
+
+			// Chunk boundaries are moved forward to the start of the next line
+			std::vector<std::size_t> chunkStarts{ 0 };
+			for (auto start = ReadChunkBytes; start < size; start += ReadChunkBytes)
+			{
+				auto const lineEnd = static_cast<char const*>(std::memchr(text + start - 1, '\n', size - start + 1));
+				if (lineEnd == nullptr)
+				{
+					break;
+				}
+
+				start = std::size_t(lineEnd - text) + 1;
+				if (start < size)
+				{
+					chunkStarts.push_back(start);
+				}
+			}
+
+			chunkStarts.push_back(size);
+			auto const chunkCount = int(chunkStarts.size()) - 1;
+
+			ThreadPool pool{ chunkCount > 1 ? threadCount : 1 };
+
+			std::vector<std::ptrdiff_t> chunkOffsets(chunkCount + 1);
+			pool.ForEachIndex(chunkCount, 1, [&](int chunk, int)
+				{
+					ForEachVertexLine(text + chunkStarts[chunk], text + chunkStarts[chunk + 1], [&chunkOffsets, chunk](char const*, char const*) { ++chunkOffsets[chunk + 1]; });
+				});
+
+			for (auto chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				chunkOffsets[chunk + 1] += chunkOffsets[chunk];
+			}
+
+			std::vector<Feature<TVector>> result(chunkOffsets.back());
+			std::vector<char> valid(result.size());
+			pool.ForEachIndex(chunkCount, 1, [&](int chunk, int)
+				{
+					auto index = chunkOffsets[chunk];
+					ForEachVertexLine(text + chunkStarts[chunk], text + chunkStarts[chunk + 1], [&](char const* first, char const* last)
+						{
+							valid[index] = ParseVector(first, last, result[index].spatialKey);
+							++index;
+						});
+				});
+
+			// Drop the vertices that failed to parse and number the rest consecutively
+			FeatureId last = 0;
+			for (std::ptrdiff_t i = 0; i < Size(result); ++i)
+			{
+				if (valid[i])
+				{
+					result[last] = { last, result[i].spatialKey };
+					++last;
+				}
+			}
+
+			result.resize(last);
+			return result;
+		}
+
+		// Reads the vertices of a file in chunks, with file reads into a buffer of ReadChunkBytes, for the files that do not fit in memory.
+		// The features are the same as those of ReadVertices(), Read() fills a chunk with the next ones
+		template <class TVector>
+		class VertexStream
+		{
+			std::ifstream file_;
+			std::vector<char> buffer_;
+
+			// The part of the buffer that is not parsed yet
+			std::size_t begin_ = 0;
+			std::size_t end_ = 0;
+
+			bool fileEnd_ = false;
+			FeatureId nextId_ = 0;
+
+		public:
+
+			// Check IsOpen() to see if opening the file succeeded
+			explicit VertexStream(std::filesystem::path const& filePath)
+				: file_{ filePath, std::ios::binary }
+				, buffer_(ReadChunkBytes)
+			{
+			}
+
+			[[nodiscard]] bool IsOpen() const
+			{
+				return file_.is_open();
+			}
+
+			// Starts over from the first vertex
+			bool Rewind()
+			{
+				file_.clear();
+				file_.seekg(0);
+				begin_ = 0;
+				end_ = 0;
+				fileEnd_ = false;
+				nextId_ = 0;
+				return IsOpen() && bool(file_);
+			}
+
+			// Returns the count of the vertices stored in the chunk, less than its size only at the end of the file, or -1 if reading fails
+			int Read(Span<Feature<TVector>> chunk)
+			{
+				auto count = 0;
+				while (count < int(chunk.size()))
+				{
+					auto const text = buffer_.data();
+					auto lineEnd = static_cast<char const*>(std::memchr(text + begin_, '\n', end_ - begin_));
+					if (lineEnd == nullptr)
+					{
+						if (!fileEnd_)
+						{
+							if (!Fill())
+							{
+								return -1;
+							}
+
+							continue;
+						}
+
+						// The last line may have no newline
+						if (begin_ == end_)
+						{
+							break;
+						}
+
+						lineEnd = text + end_;
+					}
+
+					auto const line = text + begin_;
+					begin_ = std::min(std::size_t(lineEnd - text) + 1, end_);
+					TVector vertex{};
+					if (lineEnd - line >= 2 && line[0] == 'v' && (line[1] == ' ' || line[1] == '\t') && ParseVector(line + 2, lineEnd, vertex))
+					{
+						chunk[count++] = { nextId_++, vertex };
+					}
+				}
+
+				return count;
+			}
+
+		private:
+
+			// Moves the partial last line to the front of the buffer and reads the file after it, the buffer grows for a line longer than it
+			bool Fill()
+			{
+				std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+				end_ -= begin_;
+				begin_ = 0;
+				if (end_ == buffer_.size())
+				{
+					buffer_.resize(2 * buffer_.size());
+				}
+
+				file_.read(buffer_.data() + end_, std::streamsize(buffer_.size() - end_));
+				end_ += std::size_t(file_.gcount());
+				fileEnd_ = file_.eof();
+				return fileEnd_ || bool(file_);
+			}
+		};
+
+		// Writes the vertices, followed by the faces, each one referring to 4 of the vertices by their 0-based index (written 1-based, as OBJ expects)
+		template <class TVector>
+		static bool Write(std::filesystem::path const& filePath, Span<TVector const> vertices, Span<Quad const> quads, int threadCount = 0)
+		{
+			std::ofstream file{ filePath, std::ios::binary | std::ios::trunc };
+			if (!file)
+			{
+				return false;
+			}
+
+			ThreadPool pool{ Size(vertices) + Size(quads) > WriteChunkLines ? threadCount : 1 };
+
+			constexpr auto Dimensions = int(VectorTraits<TVector>::Dimensions);
+			WriteLines(file, pool, Size(vertices), 2 + Dimensions * (MaxNumberLength + 1), [&vertices](std::ptrdiff_t index, char* out)
+				{
+					*out++ = 'v';
+					for (auto axis = 0; axis < Dimensions; ++axis)
+					{
+						*out++ = ' ';
+						out = std::to_chars(out, out + MaxNumberLength, vertices[index][axis]).ptr;
+					}
+
+					*out++ = '\n';
+					return out;
+				});
+
+			file.put('\n');
+
+			WriteLines(file, pool, Size(quads), 2 + 4 * (MaxNumberLength + 1), [&quads](std::ptrdiff_t index, char* out)
+				{
+					*out++ = 'f';
+					for (auto const vertexIndex : quads[index])
+					{
+						*out++ = ' ';
+						out = std::to_chars(out, out + MaxNumberLength, vertexIndex + 1).ptr;
+					}
+
+					*out++ = '\n';
+					return out;
+				});
+
+			return bool(file);
+		}
+
+	private:
+
+		// Calls function(first, last) with the coordinates part of each vertex line in [begin, end)
+		template <class TFunction>
+		static void ForEachVertexLine(char const* begin, char const* end, TFunction function)
+		{
+			while (begin < end)
+			{
+				auto lineEnd = static_cast<char const*>(std::memchr(begin, '\n', std::size_t(end - begin)));
+				if (lineEnd == nullptr)
+				{
+					lineEnd = end;
+				}
+
+				if (lineEnd - begin >= 2 && begin[0] == 'v' && (begin[1] == ' ' || begin[1] == '\t'))
+				{
+					function(begin + 2, lineEnd);
+				}
+
+				begin = lineEnd + 1;
+			}
+		}
+
+		template <class TVector>
+		[[nodiscard]] static bool ParseVector(char const* first, char const* last, TVector& vector)
+		{
+			for (auto axis = 0; axis < int(VectorTraits<TVector>::Dimensions); ++axis)
+			{
+				while (first < last && (*first == ' ' || *first == '\t'))
+				{
+					++first;
+				}
+
+				auto const [end, error] = std::from_chars(first, last, vector[axis]);
+				if (error != std::errc{})
+				{
+					return false;
+				}
+
+				first = end;
+			}
+
+			return true;
+		}
+
+		// Formats the lines in rounds of a few chunks per thread, each chunk into its own buffer, and writes the buffers in order.
+		// format(index, out) writes line index starting at out, at most maxLineLength characters, and returns the end of the written line
+		template <class TFormat>
+		static void WriteLines(std::ofstream& file, ThreadPool& pool, std::ptrdiff_t lineCount, std::size_t maxLineLength, TFormat format)
+		{
+			std::vector<std::string> buffers(std::size_t(pool.GetThreadCount()) * 4);
+			auto const roundLines = WriteChunkLines * Size(buffers);
+			for (std::ptrdiff_t roundFirst = 0; roundFirst < lineCount; roundFirst += roundLines)
+			{
+				auto const chunkCount = int((std::min(roundLines, lineCount - roundFirst) + WriteChunkLines - 1) / WriteChunkLines);
+				pool.ForEachIndex(chunkCount, 1, [&](int chunk, int)
+					{
+						auto const first = roundFirst + chunk * WriteChunkLines;
+						auto const last = std::min(first + WriteChunkLines, lineCount);
+						auto& buffer = buffers[chunk];
+						buffer.resize(std::size_t(last - first) * maxLineLength);
+						auto out = buffer.data();
+						for (auto index = first; index < last; ++index)
+						{
+							out = format(index, out);
+						}
+
+						buffer.resize(std::size_t(out - buffer.data()));
+					});
+
+				for (auto chunk = 0; chunk < chunkCount; ++chunk)
+				{
+					file.write(buffers[chunk].data(), std::streamsize(buffers[chunk].size()));
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,1576 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "GeoToolbox/MappedFile.hpp"
+#include "GeoToolbox/Span.hpp"
+#include "GeoToolbox/SpatialTools.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace GeoToolbox
+{
+	template <typename TSpatialKey, typename TQuantized, int NNodeSize>
+	class QuantizedPackedRtree;
+
+	// A static R-tree, bulk-loaded by sorting the features along the Hilbert curve and packing each NNodeSize consecutive entries into a node.
+	// The tree is stored level by level, level 0 holds the features themselves. Each level keeps the coordinates of its entries in one array per axis,
+	// so the children of a node are tested against a query by scanning NNodeSize consecutive values per axis, with no pointers to follow.
+	// The children of node i on level L + 1 are the entries [i * NNodeSize, (i + 1) * NNodeSize) on level L, and they are tested with the batched kernel GetOverlapMask().
+	// As the nodes refer to their children by position only, the arrays can be written to a file as they are (Save()) and queried in place from its memory mapping (Open())
+	template <typename TSpatialKey, int NNodeSize = MaxElementsPerNode>
+	class PackedRtree
+	{
+	public:
+
+		using KeyTraits = SpatialKeyTraits<TSpatialKey>;
+		using ScalarType = typename KeyTraits::ScalarType;
+		using VectorType = typename KeyTraits::VectorType;
+		using BoxType = typename KeyTraits::BoxType;
+
+		static constexpr auto Dimensions = int(KeyTraits::Dimensions);
+
+		static constexpr auto NodeSize = NNodeSize;
+
+		static_assert(NodeSize >= 2 && NodeSize <= OverlapMaskBits);
+
+	private:
+
+		struct Level
+		{
+			// The storage of a built tree, empty in an opened one, whose entries stay in the mapped file
+			std::array<std::vector<ScalarType>, Dimensions> mins;
+
+			// Empty on level 0 if the spatial keys are points
+			std::array<std::vector<ScalarType>, Dimensions> maxs;
+
+			// The entries, in mins and maxs or in the mapped file. They point to the mins on level 0 if the spatial keys are points
+			std::array<ScalarType const*, Dimensions> minData{};
+			std::array<ScalarType const*, Dimensions> maxData{};
+
+			int size = 0;
+
+			Level() = default;
+
+			// A copy would point to the entries of the original
+			Level(Level const&) = delete;
+			Level(Level&&) noexcept = default;
+			Level& operator=(Level const&) = delete;
+			Level& operator=(Level&&) noexcept = default;
+
+			[[nodiscard]] int Size() const noexcept
+			{
+				return size;
+			}
+
+			[[nodiscard]] ScalarType const* GetMins(int axis) const noexcept
+			{
+				return minData[axis];
+			}
+
+			[[nodiscard]] ScalarType const* GetMaxs(int axis) const noexcept
+			{
+				return maxData[axis];
+			}
+
+			void Resize(int newSize, bool withMaxs)
+			{
+				size = newSize;
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					mins[axis].resize(newSize);
+					minData[axis] = mins[axis].data();
+					if (withMaxs)
+					{
+						maxs[axis].resize(newSize);
+					}
+
+					maxData[axis] = withMaxs ? maxs[axis].data() : minData[axis];
+				}
+			}
+		};
+
+		// The header of the files written by Save(), followed by a LevelRecord per level and then by the arrays of the ids and of the level entries.
+		// The records locate the arrays by their offset from the start of the file, so the file can be mapped at any address.
+		// Increment Version when the layout changes
+		struct ImageHeader
+		{
+			static constexpr std::array<char, 4> Signature{ 'G', 'T', 'P', 'R' };
+			static constexpr std::uint32_t Version = 1;
+
+			std::array<char, 4> signature{};
+			std::uint32_t version = 0;
+			std::uint8_t keyKind = 0;
+			std::uint8_t scalarSize = 0;
+			std::uint8_t dimensions = 0;
+			std::uint8_t idSize = 0;
+			std::uint32_t nodeSize = 0;
+			std::int64_t size = 0;
+			std::int64_t height = 0;
+			std::uint64_t idsOffset = 0;
+
+			[[nodiscard]] static ImageHeader Make() noexcept
+			{
+				ImageHeader header;
+				header.signature = Signature;
+				header.version = Version;
+				header.keyKind = std::uint8_t(KeyTraits::Kind);
+				header.scalarSize = std::uint8_t(sizeof(ScalarType));
+				header.dimensions = std::uint8_t(Dimensions);
+				header.idSize = std::uint8_t(sizeof(FeatureId));
+				header.nodeSize = std::uint32_t(NodeSize);
+				return header;
+			}
+
+			[[nodiscard]] bool Matches() const noexcept
+			{
+				auto const expected = Make();
+				return signature == expected.signature && version == expected.version && keyKind == expected.keyKind && scalarSize == expected.scalarSize
+					&& dimensions == expected.dimensions && idSize == expected.idSize && nodeSize == expected.nodeSize;
+			}
+		};
+
+		struct LevelRecord
+		{
+			std::int64_t size = 0;
+			std::array<std::uint64_t, Dimensions> minOffsets{};
+			std::array<std::uint64_t, Dimensions> maxOffsets{};
+		};
+
+		// The arrays in the files start at cache line boundaries, as they do in memory
+		static constexpr std::uint64_t ImageAlignment = 64;
+
+		std::vector<Level> levels_;
+
+		// The storage of a built tree, empty in an opened one
+		std::vector<FeatureId> idStorage_;
+
+		Span<FeatureId const> ids_;
+
+		// The file an opened tree is mapped from
+		std::shared_ptr<MappedFile const> image_;
+
+		template <typename, typename, int>
+		friend class QuantizedPackedRtree;
+
+	public:
+
+		PackedRtree() = default;
+
+		// threadCount threads sort the features and fill the leaves, 0 or less means one thread per hardware thread. The tree is the same for any count
+		explicit PackedRtree(Span<Feature<TSpatialKey> const> features, int threadCount = 1)
+		{
+			Build(Features<TSpatialKey>{ features }, threadCount);
+		}
+
+		// Builds the tree directly from columnar features, without converting them first
+		explicit PackedRtree(Features<TSpatialKey> const& features, int threadCount = 1)
+		{
+			Build(features, threadCount);
+		}
+
+		[[nodiscard]] int GetSize() const noexcept
+		{
+			return int(ids_.size());
+		}
+
+		[[nodiscard]] bool IsEmpty() const noexcept
+		{
+			return ids_.empty();
+		}
+
+		// The levels include the leaf entries (the features), so a tree with up to NodeSize features has 2 levels
+		[[nodiscard]] int GetHeight() const noexcept
+		{
+			return int(levels_.size());
+		}
+
+		[[nodiscard]] int GetNodeCount() const noexcept
+		{
+			auto result = 0;
+			for (auto i = 1; i < GetHeight(); ++i)
+			{
+				result += levels_[i].Size();
+			}
+
+			return result;
+		}
+
+		[[nodiscard]] FeatureId GetId(int entryIndex) const
+		{
+			return ids_[entryIndex];
+		}
+
+		[[nodiscard]] TSpatialKey GetKey(int entryIndex) const
+		{
+			auto const& leaves = levels_[0];
+			VectorType min{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				min[axis] = leaves.GetMins(axis)[entryIndex];
+			}
+
+			if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+			{
+				return min;
+			}
+			else
+			{
+				VectorType max{};
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					max[axis] = leaves.GetMaxs(axis)[entryIndex];
+				}
+
+				return { min, max };
+			}
+		}
+
+		[[nodiscard]] std::string GetStats() const
+		{
+			std::ostringstream stream;
+			stream << "Nodes: " << GetNodeCount() << " Height: " << GetHeight();
+			return stream.str();
+		}
+
+		// Writes the tree to a file that Open() can map, returns false if the file cannot be written
+		bool Save(std::filesystem::path const& filePath) const
+		{
+			auto header = ImageHeader::Make();
+			header.size = GetSize();
+			auto const records = MakeImageLayout(header);
+
+			// The arrays are written in the order of their offsets, see MakeImageLayout()
+			return WriteImage(filePath, header, records, [this, &header, &records](std::ofstream& file)
+				{
+					std::array<char, ImageAlignment> const padding{};
+					auto written = std::uint64_t(file.tellp());
+					auto const writeArray = [&](std::uint64_t offset, void const* data, std::uint64_t byteSize)
+						{
+							file.write(padding.data(), std::streamsize(offset - written));
+							file.write(static_cast<char const*>(data), std::streamsize(byteSize));
+							written = offset + byteSize;
+						};
+
+					writeArray(header.idsOffset, ids_.data(), ids_.size_bytes());
+					for (auto i = 0; i < GetHeight(); ++i)
+					{
+						auto const& level = levels_[i];
+						auto const byteSize = std::uint64_t(level.Size()) * sizeof(ScalarType);
+						for (auto axis = 0; axis < Dimensions; ++axis)
+						{
+							writeArray(records[i].minOffsets[axis], level.GetMins(axis), byteSize);
+							if (records[i].maxOffsets[axis] != records[i].minOffsets[axis])
+							{
+								writeArray(records[i].maxOffsets[axis], level.GetMaxs(axis), byteSize);
+							}
+						}
+					}
+				});
+		}
+
+		// Builds the tree from a source of features that do not have to fit in memory, and writes it to a file that Open() can map, as Save() does.
+		// The source has bool Rewind(), to start over from the first feature, and int Read(Span<Feature<TSpatialKey>> chunk), that fills the chunk with the next features
+		// and returns their count, 0 at the end and negative on error. It is read twice, for the bounds of the centers and then in runs of up to memoryBudget bytes,
+		// which are sorted along the Hilbert curve and written to temporary files next to filePath. The runs are merged into the leaves of the file,
+		// the nodes above them are built in memory, they take about 1/NodeSize of the memory of the features. The tree is the same as the one built in memory.
+		// Returns false if the source fails, changes between the passes or has more than INT_MAX features, or if a file cannot be written
+		template <class TSource>
+		static bool BuildFile(TSource& source, std::filesystem::path const& filePath, std::size_t memoryBudget)
+		{
+			// The features are read and the leaves are written in blocks of up to this many
+			static constexpr std::size_t BlockSize = 4096;
+
+			struct RunRecord
+			{
+				std::uint64_t curveIndex;
+
+				// In the source, the features with the same curve index keep their order, as in the sort of Build()
+				std::int64_t position;
+
+				Feature<TSpatialKey> feature;
+
+				bool operator<(RunRecord const& other) const noexcept
+				{
+					return curveIndex != other.curveIndex ? curveIndex < other.curveIndex : position < other.position;
+				}
+			};
+
+			static_assert(std::is_trivially_copyable_v<RunRecord>);
+
+			struct RunReader
+			{
+				// Not open for the single run that is merged from memory
+				std::ifstream file;
+				std::vector<RunRecord> buffer;
+				std::size_t next = 0;
+
+				// Reads the next records of the run file, returns false at its end
+				bool Fill(std::size_t capacity)
+				{
+					next = 0;
+					buffer.clear();
+					if (!file.is_open())
+					{
+						return false;
+					}
+
+					buffer.resize(capacity);
+					file.read(reinterpret_cast<char*>(buffer.data()), std::streamsize(capacity * sizeof(RunRecord)));
+					buffer.resize(std::size_t(file.gcount()) / sizeof(RunRecord));
+					return !buffer.empty();
+				}
+			};
+
+			// The run files are removed on any return
+			struct RunFiles
+			{
+				std::vector<std::filesystem::path> paths;
+
+				RunFiles() = default;
+				RunFiles(RunFiles const&) = delete;
+				RunFiles& operator=(RunFiles const&) = delete;
+
+				~RunFiles()
+				{
+					for (auto const& path : paths)
+					{
+						std::error_code error;
+						std::filesystem::remove(path, error);
+					}
+				}
+			};
+
+			// The count and the bounds of the centers, which GetHilbertOrder() quantizes the centers over
+			std::vector<Feature<TSpatialKey>> block(BlockSize);
+			Box<VectorType> bounds;
+			std::int64_t size = 0;
+			if (!source.Rewind())
+			{
+				return false;
+			}
+
+			for (;;)
+			{
+				auto const count = source.Read(block);
+				if (count < 0)
+				{
+					return false;
+				}
+
+				if (count == 0)
+				{
+					break;
+				}
+
+				for (auto i = 0; i < count; ++i)
+				{
+					bounds.Add(KeyTraits::GetCenter(block[i].spatialKey));
+				}
+
+				size += count;
+			}
+
+			if (size > std::numeric_limits<int>::max() || !source.Rewind())
+			{
+				return false;
+			}
+
+			// The sorted runs, a single one that fits in the budget stays in memory
+			auto const runCapacity = std::max(memoryBudget / sizeof(RunRecord), std::size_t(1));
+			std::vector<RunRecord> run;
+			run.reserve(std::size_t(std::min(std::int64_t(runCapacity), size)));
+			RunFiles runFiles;
+			std::vector<RunReader> runs;
+			std::int64_t position = 0;
+			for (;;)
+			{
+				auto const count = source.Read(Span<Feature<TSpatialKey>>{ block }.first(std::ptrdiff_t(std::min(BlockSize, runCapacity - run.size()))));
+				if (count < 0)
+				{
+					return false;
+				}
+
+				for (auto i = 0; i < count; ++i)
+				{
+					run.push_back({ GetHilbertIndex(KeyTraits::GetCenter(block[i].spatialKey), bounds), position++, block[i] });
+				}
+
+				if (count > 0 && run.size() < runCapacity)
+				{
+					continue;
+				}
+
+				std::sort(run.begin(), run.end());
+				if (count == 0 && runs.empty())
+				{
+					runs.emplace_back().buffer = std::move(run);
+					break;
+				}
+
+				if (!run.empty())
+				{
+					auto runPath = filePath;
+					runPath += ".run" + std::to_string(runs.size());
+					runFiles.paths.push_back(runPath);
+					std::ofstream runFile{ runPath, std::ios::binary | std::ios::trunc };
+					runFile.write(reinterpret_cast<char const*>(run.data()), std::streamsize(run.size() * sizeof(RunRecord)));
+					if (!runFile)
+					{
+						return false;
+					}
+
+					runs.emplace_back();
+					run.clear();
+				}
+
+				if (count == 0)
+				{
+					break;
+				}
+			}
+
+			if (position != size)
+			{
+				return false;
+			}
+
+			// The budget is shared by the read buffers of the run files
+			run = {};
+			auto const readCapacity = std::max(runCapacity / runs.size(), std::size_t(1));
+			for (auto i = 0; i < int(runFiles.paths.size()); ++i)
+			{
+				runs[i].file.open(runFiles.paths[i], std::ios::binary);
+				if (!runs[i].Fill(readCapacity))
+				{
+					return false;
+				}
+			}
+
+			auto header = ImageHeader::Make();
+			header.size = size;
+			auto const records = MakeImageLayout(header);
+
+			return WriteImage(filePath, header, records, [&](std::ofstream& file)
+				{
+					if (size == 0)
+					{
+						return;
+					}
+
+					auto const writeArray = [&file](std::uint64_t offset, void const* data, std::uint64_t byteSize)
+						{
+							file.seekp(std::streamoff(offset));
+							file.write(static_cast<char const*>(data), std::streamsize(byteSize));
+						};
+
+					// The entries of the nodes over the leaves are gathered while the leaves are written
+					PackedRtree nodes;
+					auto& parents = nodes.levels_.emplace_back();
+					parents.Resize(int(records[1].size), true);
+
+					std::vector<FeatureId> ids(BlockSize);
+					std::array<std::vector<ScalarType>, Dimensions> mins;
+					std::array<std::vector<ScalarType>, Dimensions> maxs;
+					for (auto axis = 0; axis < Dimensions; ++axis)
+					{
+						mins[axis].resize(BlockSize);
+						maxs[axis].resize(BlockSize);
+					}
+
+					std::int64_t blockFirst = 0;
+					auto const writeBlock = [&](std::size_t blockSize)
+						{
+							writeArray(header.idsOffset + std::uint64_t(blockFirst) * sizeof(FeatureId), ids.data(), blockSize * sizeof(FeatureId));
+							for (auto axis = 0; axis < Dimensions; ++axis)
+							{
+								writeArray(records[0].minOffsets[axis] + std::uint64_t(blockFirst) * sizeof(ScalarType), mins[axis].data(), blockSize * sizeof(ScalarType));
+								if constexpr (SpatialKeyIsBox<TSpatialKey>)
+								{
+									writeArray(records[0].maxOffsets[axis] + std::uint64_t(blockFirst) * sizeof(ScalarType), maxs[axis].data(), blockSize * sizeof(ScalarType));
+								}
+							}
+
+							blockFirst += std::int64_t(blockSize);
+						};
+
+					auto const isAfter = [&runs](int left, int right)
+						{
+							return runs[right].buffer[runs[right].next] < runs[left].buffer[runs[left].next];
+						};
+
+					std::priority_queue<int, std::vector<int>, decltype(isAfter)> queue{ isAfter };
+					for (auto i = 0; i < int(runs.size()); ++i)
+					{
+						if (!runs[i].buffer.empty())
+						{
+							queue.push(i);
+						}
+					}
+
+					position = 0;
+					std::size_t blockSize = 0;
+					while (!queue.empty())
+					{
+						auto const runIndex = queue.top();
+						queue.pop();
+						auto& reader = runs[runIndex];
+						auto const& feature = reader.buffer[reader.next].feature;
+						BoxType const box{ feature.spatialKey };
+						ids[blockSize] = feature.id;
+						auto const node = int(position / NodeSize);
+						for (auto axis = 0; axis < Dimensions; ++axis)
+						{
+							mins[axis][blockSize] = box.Min()[axis];
+							maxs[axis][blockSize] = box.Max()[axis];
+							auto& nodeMin = parents.mins[axis][node];
+							auto& nodeMax = parents.maxs[axis][node];
+							nodeMin = position % NodeSize == 0 ? box.Min()[axis] : std::min(nodeMin, box.Min()[axis]);
+							nodeMax = position % NodeSize == 0 ? box.Max()[axis] : std::max(nodeMax, box.Max()[axis]);
+						}
+
+						++position;
+						if (++blockSize == BlockSize)
+						{
+							writeBlock(blockSize);
+							blockSize = 0;
+						}
+
+						if (++reader.next < reader.buffer.size() || reader.Fill(readCapacity))
+						{
+							queue.push(runIndex);
+						}
+					}
+
+					writeBlock(blockSize);
+					if (position != size)
+					{
+						file.setstate(std::ios::failbit);
+						return;
+					}
+
+					while (nodes.levels_.back().Size() > 1)
+					{
+						nodes.AddNodeLevel();
+					}
+
+					for (auto i = 0; i < nodes.GetHeight(); ++i)
+					{
+						auto const& level = nodes.levels_[i];
+						auto const byteSize = std::uint64_t(level.Size()) * sizeof(ScalarType);
+						for (auto axis = 0; axis < Dimensions; ++axis)
+						{
+							writeArray(records[i + 1].minOffsets[axis], level.GetMins(axis), byteSize);
+							writeArray(records[i + 1].maxOffsets[axis], level.GetMaxs(axis), byteSize);
+						}
+					}
+				});
+		}
+
+		// Maps a file written by Save() and returns a tree that is queried in place, its pages are loaded by the OS on first access, so opening reads only the headers.
+		// Returns null if the file cannot be mapped, was written for another spatial key type or node size, or does not hold a complete tree
+		[[nodiscard]] static std::shared_ptr<PackedRtree> Open(std::filesystem::path const& filePath)
+		{
+			auto image = std::make_shared<MappedFile const>(filePath);
+			auto const headers = image->GetArray<ImageHeader>(0, 1);
+			if (headers.empty() || !headers[0].Matches() || headers[0].size > std::numeric_limits<int>::max() || headers[0].height > 64)
+			{
+				return {};
+			}
+
+			auto const& header = headers[0];
+			auto const records = image->GetArray<LevelRecord>(sizeof(ImageHeader), std::size_t(header.height));
+			if (std::int64_t(records.size()) != header.height)
+			{
+				return {};
+			}
+
+			auto result = std::make_shared<PackedRtree>();
+			result->ids_ = image->GetArray<FeatureId>(header.idsOffset, std::size_t(header.size));
+			if (std::int64_t(result->ids_.size()) != header.size)
+			{
+				return {};
+			}
+
+			for (auto i = 0; i < int(records.size()); ++i)
+			{
+				// Each level has one entry per node of the level below, up to the single root
+				auto const& record = records[i];
+				auto const expectedSize = i == 0 ? header.size : (records[i - 1].size + NodeSize - 1) / NodeSize;
+				if (record.size != expectedSize || (i == int(records.size()) - 1 && record.size != 1))
+				{
+					return {};
+				}
+
+				auto& level = result->levels_.emplace_back();
+				level.size = int(record.size);
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					auto const mins = image->GetArray<ScalarType>(record.minOffsets[axis], std::size_t(record.size));
+					auto const maxs = image->GetArray<ScalarType>(record.maxOffsets[axis], std::size_t(record.size));
+					if (std::int64_t(mins.size()) != record.size || std::int64_t(maxs.size()) != record.size)
+					{
+						return {};
+					}
+
+					level.minData[axis] = mins.data();
+					level.maxData[axis] = maxs.data();
+				}
+			}
+
+			result->image_ = std::move(image);
+			return result;
+		}
+
+		// Returns the count of the features that overlap the box
+		[[nodiscard]] int QueryBox(BoxType const& box) const
+		{
+			auto count = 0;
+			VisitLeaves(box, [&count](int, std::uint64_t mask) { count += PopCount(mask); });
+			return count;
+		}
+
+		// Stores in counts[i] the count of the features that overlap boxes[i].
+		// The boxes are ordered along the Hilbert curve and taken in groups of up to OverlapMaskBits neighbours, each group descends the tree together,
+		// so that a node shared by the queries of a group is loaded once for all of them
+		void QueryBoxBatch(Span<BoxType const> boxes, Span<int> counts) const
+		{
+			DEBUG_ASSERT(counts.size() == boxes.size());
+
+			std::fill(counts.begin(), counts.end(), 0);
+			if (IsEmpty() || boxes.empty())
+			{
+				return;
+			}
+
+			auto const centers = Transform(boxes, [](BoxType const& box) { return box.Center(); });
+			auto const order = GetHilbertOrder<VectorType>(centers, QueryBatchOrderBitsPerAxis<VectorType>);
+
+			std::array<BoxType const*, OverlapMaskBits> groupBoxes{};
+			std::array<int*, OverlapMaskBits> groupCounts{};
+			for (auto first = 0; first < int(order.size()); first += OverlapMaskBits)
+			{
+				auto const groupSize = std::min(OverlapMaskBits, int(order.size()) - first);
+				for (auto i = 0; i < groupSize; ++i)
+				{
+					groupBoxes[i] = &boxes[order[first + i]];
+					groupCounts[i] = &counts[order[first + i]];
+				}
+
+				auto const groupMask = groupSize == OverlapMaskBits ? ~std::uint64_t(0) : (std::uint64_t(1) << groupSize) - 1;
+				CountBatch(groupBoxes, groupCounts, GetHeight() - 1, 0, groupMask);
+			}
+		}
+
+		// Calls function(entryIndex) for each feature that overlaps the box
+		template <class TFunction>
+		void VisitBox(BoxType const& box, TFunction function) const
+		{
+			VisitLeaves(box, [&function](int first, std::uint64_t mask)
+				{
+					for (; mask != 0; mask &= mask - 1)
+					{
+						function(first + CountTrailingZeros(mask));
+					}
+				});
+		}
+
+		// Calls function(entryIndex) for each feature that overlaps the box until it returns false, returns false if it stopped the query
+		template <class TFunction>
+		bool VisitBoxWhile(BoxType const& box, TFunction function) const
+		{
+			return VisitLeaves(box, [&function](int first, std::uint64_t mask)
+				{
+					for (; mask != 0; mask &= mask - 1)
+					{
+						if (!function(first + CountTrailingZeros(mask)))
+						{
+							return false;
+						}
+					}
+
+					return true;
+				});
+		}
+
+		// Calls function(entryIndex, otherFirstEntryIndex, mask) for each feature of this tree and each leaf node of the other tree with features that overlap it,
+		// bit i of the mask marks entry otherFirstEntryIndex + i of the other tree. The trees are traversed together, descending into the pairs of overlapping nodes only
+		template <class TFunction>
+		void VisitJoin(PackedRtree const& other, TFunction function) const
+		{
+			if (!IsEmpty() && !other.IsEmpty())
+			{
+				JoinNodes(other, GetHeight() - 1, 0, other.GetHeight() - 1, 0, function);
+			}
+		}
+
+		// Calls function(entryIndex, distanceSquared) for the nearest features to the location, in order of increasing distance
+		template <class TFunction>
+		void VisitNearest(VectorType const& location, int nearestCount, TFunction function) const
+		{
+			VisitNearestRefined(location, nearestCount, [this, &location](int first, int count, ScalarType* distancesSquared)
+				{
+					for (auto i = 0; i < count; ++i)
+					{
+						distancesSquared[i] = GetDistanceSquared(location, levels_[0], first + i);
+					}
+				}, function);
+		}
+
+		// Like VisitNearest(), with the distances of the features given by getDistancesSquared(firstEntryIndex, count, distancesSquared), which stores those of the count entries
+		// from firstEntryIndex on, e.g. to the exact geometries that the keys bound. They must be no less than the distances to the keys. The entries of a leaf node are refined
+		// together when the node is reached, so that a batched kernel like GetSegmentDistancesSquared() can compute them
+		template <class TGetDistancesSquared, class TFunction>
+		void VisitNearestRefined(VectorType const& location, int nearestCount, TGetDistancesSquared getDistancesSquared, TFunction function) const
+		{
+			if (IsEmpty() || nearestCount <= 0)
+			{
+				return;
+			}
+
+			struct Candidate
+			{
+				ScalarType distanceSquared;
+				int level;
+				int index;
+
+				bool operator>(Candidate const& other) const noexcept
+				{
+					return distanceSquared > other.distanceSquared;
+				}
+			};
+
+			std::vector<Candidate> storage;
+			storage.reserve(size_t(NodeSize) * GetHeight() + nearestCount);
+			std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> queue{ std::greater<>{}, std::move(storage) };
+			queue.push({ 0, GetHeight() - 1, 0 });
+
+			while (!queue.empty())
+			{
+				auto const candidate = queue.top();
+				queue.pop();
+
+				if (candidate.level == 0)
+				{
+					function(candidate.index, candidate.distanceSquared);
+					if (--nearestCount == 0)
+					{
+						return;
+					}
+
+					continue;
+				}
+
+				AddQueryStats_VisitedNodesCount();
+				auto const childLevel = candidate.level - 1;
+				auto const& children = levels_[childLevel];
+				auto const first = candidate.index * NodeSize;
+				auto const last = std::min(first + NodeSize, children.Size());
+				if (childLevel == 0)
+				{
+					std::array<ScalarType, NodeSize> distancesSquared;
+					getDistancesSquared(first, last - first, distancesSquared.data());
+					for (auto i = first; i < last; ++i)
+					{
+						AddQueryStats_ObjectTestsCount();
+						AddQueryStats_ScalarComparisonsCount();
+						queue.push({ distancesSquared[i - first], childLevel, i });
+					}
+
+					continue;
+				}
+
+				for (auto i = first; i < last; ++i)
+				{
+					AddQueryStats_ScalarComparisonsCount();
+					queue.push({ GetDistanceSquared(location, children, i), childLevel, i });
+				}
+			}
+		}
+
+	private:
+
+		void Build(Features<TSpatialKey> const& features, int threadCount)
+		{
+			// The leaves are gathered in chunks, to balance the threads
+			static constexpr auto GatherChunkSize = 16 * 1024;
+
+			auto const size = features.GetSize();
+			if (size == 0)
+			{
+				return;
+			}
+
+			std::vector<VectorType> centers(size);
+			for (auto i = 0; i < size; ++i)
+			{
+				centers[i] = KeyTraits::GetCenter(features.GetKey(i));
+			}
+
+			auto const order = threadCount == 1 ? GetHilbertOrder<VectorType>(centers) : ParallelGetCurveOrder<VectorType>(centers, SpaceFillingCurve::Hilbert, threadCount);
+
+			idStorage_.resize(size);
+			ids_ = idStorage_;
+			auto& leaves = levels_.emplace_back();
+			leaves.Resize(size, SpatialKeyIsBox<TSpatialKey>);
+			auto const gatherChunk = [&](int chunk, int)
+				{
+					for (auto i = chunk * GatherChunkSize, last = std::min(size, (chunk + 1) * GatherChunkSize); i < last; ++i)
+					{
+						auto const source = order[i];
+						idStorage_[i] = features.ids[source];
+						for (auto axis = 0; axis < Dimensions; ++axis)
+						{
+							leaves.mins[axis][i] = features.mins[axis][source];
+							if constexpr (SpatialKeyIsBox<TSpatialKey>)
+							{
+								leaves.maxs[axis][i] = features.maxs[axis][source];
+							}
+						}
+					}
+				};
+
+			auto const chunkCount = (size + GatherChunkSize - 1) / GatherChunkSize;
+			if (threadCount == 1 || chunkCount == 1)
+			{
+				for (auto chunk = 0; chunk < chunkCount; ++chunk)
+				{
+					gatherChunk(chunk, 0);
+				}
+			}
+			else
+			{
+				ThreadPool{ threadCount }.ForEachIndex(chunkCount, 1, gatherChunk);
+			}
+
+			// The root is always a node, even if all features fit in it
+			do
+			{
+				AddNodeLevel();
+			} while (levels_.back().Size() > 1);
+		}
+
+		// Adds a level with a node for each NodeSize entries of the last level
+		void AddNodeLevel()
+		{
+			auto const childCount = levels_.back().Size();
+			auto const nodeCount = (childCount + NodeSize - 1) / NodeSize;
+			Level level;
+			level.Resize(nodeCount, true);
+			auto const& children = levels_.back();
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				auto const* childMins = children.GetMins(axis);
+				auto const* childMaxs = children.GetMaxs(axis);
+				for (auto node = 0; node < nodeCount; ++node)
+				{
+					auto const first = node * NodeSize;
+					auto const last = std::min(first + NodeSize, childCount);
+					level.mins[axis][node] = *std::min_element(childMins + first, childMins + last);
+					level.maxs[axis][node] = *std::max_element(childMaxs + first, childMaxs + last);
+				}
+			}
+
+			levels_.push_back(std::move(level));
+		}
+
+		// Sets the height of the header from its size and returns the records of the levels, which locate the arrays in the file: the ids first,
+		// then the entries level by level and axis by axis, the mins before the maxs. The leaves of point keys have no maxs, their records point to the mins
+		[[nodiscard]] static std::vector<LevelRecord> MakeImageLayout(ImageHeader& header)
+		{
+			std::vector<std::int64_t> levelSizes;
+			if (header.size > 0)
+			{
+				levelSizes.push_back(header.size);
+				do
+				{
+					levelSizes.push_back((levelSizes.back() + NodeSize - 1) / NodeSize);
+				} while (levelSizes.back() > 1);
+			}
+
+			header.height = std::int64_t(levelSizes.size());
+			std::vector<LevelRecord> records(levelSizes.size());
+			auto offset = std::uint64_t(sizeof(ImageHeader) + records.size() * sizeof(LevelRecord));
+			auto const addArray = [&offset](std::uint64_t byteSize)
+				{
+					offset = (offset + ImageAlignment - 1) / ImageAlignment * ImageAlignment;
+					auto const result = offset;
+					offset += byteSize;
+					return result;
+				};
+
+			header.idsOffset = addArray(std::uint64_t(header.size) * sizeof(FeatureId));
+			for (auto i = 0; i < int(records.size()); ++i)
+			{
+				auto const byteSize = std::uint64_t(levelSizes[i]) * sizeof(ScalarType);
+				records[i].size = levelSizes[i];
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					records[i].minOffsets[axis] = addArray(byteSize);
+					records[i].maxOffsets[axis] = i == 0 && SpatialKeyIsPoint<TSpatialKey> ? records[i].minOffsets[axis] : addArray(byteSize);
+				}
+			}
+
+			return records;
+		}
+
+		// Writes the header and the records, then writeArrays(file) writes the arrays at their offsets.
+		// The file is written under a temporary name and renamed at the end, so that an interrupted write does not leave a truncated file behind
+		template <class TWriteArrays>
+		static bool WriteImage(std::filesystem::path const& filePath, ImageHeader const& header, std::vector<LevelRecord> const& records, TWriteArrays writeArrays)
+		{
+			auto temporaryPath = filePath;
+			temporaryPath += ".tmp";
+			{
+				std::ofstream file{ temporaryPath, std::ios::binary | std::ios::trunc };
+				file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+				file.write(reinterpret_cast<char const*>(records.data()), std::streamsize(records.size() * sizeof(LevelRecord)));
+				writeArrays(file);
+				if (!file)
+				{
+					file.close();
+					std::error_code error;
+					std::filesystem::remove(temporaryPath, error);
+					return false;
+				}
+			}
+
+			std::error_code error;
+			std::filesystem::rename(temporaryPath, filePath, error);
+			return !error;
+		}
+
+		[[nodiscard]] static std::uint64_t GetOverlapMask(BoxType const& box, Level const& level, int first, int count) noexcept
+		{
+			std::array<ScalarType const*, Dimensions> mins{};
+			std::array<ScalarType const*, Dimensions> maxs{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				mins[axis] = level.GetMins(axis) + first;
+				maxs[axis] = level.GetMaxs(axis) + first;
+			}
+
+			return GeoToolbox::GetOverlapMask(box, mins, maxs, count);
+		}
+
+		[[nodiscard]] static BoxType GetEntryBox(Level const& level, int index) noexcept
+		{
+			VectorType min{};
+			VectorType max{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				min[axis] = level.GetMins(axis)[index];
+				max[axis] = level.GetMaxs(axis)[index];
+			}
+
+			return { min, max };
+		}
+
+		[[nodiscard]] static ScalarType GetDistanceSquared(VectorType const& point, Level const& level, int index) noexcept
+		{
+			ScalarType result{ 0 };
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				auto const min = level.GetMins(axis)[index];
+				auto const max = level.GetMaxs(axis)[index];
+				if (point[axis] < min)
+				{
+					result += Square(min - point[axis]);
+				}
+				else if (point[axis] > max)
+				{
+					result += Square(point[axis] - max);
+				}
+			}
+
+			return result;
+		}
+
+		// Bit q of queryMask marks the query boxes[q] of the group that overlap the node
+		void CountBatch(std::array<BoxType const*, OverlapMaskBits> const& boxes, std::array<int*, OverlapMaskBits> const& counts, int levelIndex, int nodeIndex, std::uint64_t queryMask) const
+		{
+			AddQueryStats_VisitedNodesCount();
+			auto const childLevel = levelIndex - 1;
+			auto const& children = levels_[childLevel];
+			auto const first = nodeIndex * NodeSize;
+			auto const count = std::min(NodeSize, children.Size() - first);
+
+			// Bit q of childQueries[c] marks the queries that overlap child c
+			std::array<std::uint64_t, NodeSize> childQueries{};
+			for (; queryMask != 0; queryMask &= queryMask - 1)
+			{
+				auto const query = CountTrailingZeros(queryMask);
+				if (childLevel == 0)
+				{
+					AddQueryStats_ObjectTestsCount(count);
+				}
+
+				AddQueryStats_BoxOverlapsCount(count);
+				auto mask = GetOverlapMask(*boxes[query], children, first, count);
+				if (childLevel == 0)
+				{
+					*counts[query] += PopCount(mask);
+					continue;
+				}
+
+				for (; mask != 0; mask &= mask - 1)
+				{
+					childQueries[CountTrailingZeros(mask)] |= std::uint64_t(1) << query;
+				}
+			}
+
+			if (childLevel > 0)
+			{
+				for (auto i = 0; i < count; ++i)
+				{
+					if (childQueries[i] != 0)
+					{
+						CountBatch(boxes, counts, childLevel, first + i, childQueries[i]);
+					}
+				}
+			}
+		}
+
+		// Calls function(firstEntryIndex, mask) for each leaf node with features that overlap the box, bit i of the mask marks entry firstEntryIndex + i.
+		// A function that returns bool stops the traversal when it returns false, then false is returned
+		template <class TFunction>
+		bool VisitLeaves(BoxType const& box, TFunction function) const
+		{
+			return IsEmpty() || VisitLeaves(box, GetHeight() - 1, 0, function);
+		}
+
+		template <class TFunction>
+		bool VisitLeaves(BoxType const& box, int levelIndex, int nodeIndex, TFunction& function) const
+		{
+			AddQueryStats_VisitedNodesCount();
+			auto const childLevel = levelIndex - 1;
+			auto const& children = levels_[childLevel];
+			auto const first = nodeIndex * NodeSize;
+			auto const count = std::min(NodeSize, children.Size() - first);
+			if (childLevel == 0)
+			{
+				AddQueryStats_ObjectTestsCount(count);
+			}
+
+			AddQueryStats_BoxOverlapsCount(count);
+			auto mask = GetOverlapMask(box, children, first, count);
+			if (childLevel == 0)
+			{
+				if (mask == 0)
+				{
+					return true;
+				}
+
+				if constexpr (std::is_same_v<std::invoke_result_t<TFunction&, int, std::uint64_t>, bool>)
+				{
+					return function(first, mask);
+				}
+				else
+				{
+					function(first, mask);
+					return true;
+				}
+			}
+
+			for (; mask != 0; mask &= mask - 1)
+			{
+				if (!VisitLeaves(box, childLevel, first + CountTrailingZeros(mask), function))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		// The node of the higher level is split first, so both sides reach the leaves together, nodes of the same level are split both
+		template <class TFunction>
+		void JoinNodes(PackedRtree const& other, int levelIndex, int nodeIndex, int otherLevelIndex, int otherNodeIndex, TFunction& function) const
+		{
+			AddQueryStats_VisitedNodesCount();
+			if (levelIndex > otherLevelIndex)
+			{
+				auto const& children = levels_[levelIndex - 1];
+				auto const first = nodeIndex * NodeSize;
+				auto const count = std::min(NodeSize, children.Size() - first);
+				AddQueryStats_BoxOverlapsCount(count);
+				for (auto mask = GetOverlapMask(GetEntryBox(other.levels_[otherLevelIndex], otherNodeIndex), children, first, count); mask != 0; mask &= mask - 1)
+				{
+					JoinNodes(other, levelIndex - 1, first + CountTrailingZeros(mask), otherLevelIndex, otherNodeIndex, function);
+				}
+
+				return;
+			}
+
+			if (otherLevelIndex > levelIndex)
+			{
+				auto const& otherChildren = other.levels_[otherLevelIndex - 1];
+				auto const otherFirst = otherNodeIndex * NodeSize;
+				auto const otherCount = std::min(NodeSize, otherChildren.Size() - otherFirst);
+				AddQueryStats_BoxOverlapsCount(otherCount);
+				for (auto mask = GetOverlapMask(GetEntryBox(levels_[levelIndex], nodeIndex), otherChildren, otherFirst, otherCount); mask != 0; mask &= mask - 1)
+				{
+					JoinNodes(other, levelIndex, nodeIndex, otherLevelIndex - 1, otherFirst + CountTrailingZeros(mask), function);
+				}
+
+				return;
+			}
+
+			auto const childLevel = levelIndex - 1;
+			auto const& children = levels_[childLevel];
+			auto const& otherChildren = other.levels_[childLevel];
+			auto const first = nodeIndex * NodeSize;
+			auto const count = std::min(NodeSize, children.Size() - first);
+			auto const otherFirst = otherNodeIndex * NodeSize;
+			auto const otherCount = std::min(NodeSize, otherChildren.Size() - otherFirst);
+
+			// Only the children overlapping the other node can overlap any of its children
+			AddQueryStats_BoxOverlapsCount(count);
+			for (auto mask = GetOverlapMask(GetEntryBox(other.levels_[levelIndex], otherNodeIndex), children, first, count); mask != 0; mask &= mask - 1)
+			{
+				auto const child = first + CountTrailingZeros(mask);
+				if (childLevel == 0)
+				{
+					AddQueryStats_ObjectTestsCount(otherCount);
+				}
+
+				AddQueryStats_BoxOverlapsCount(otherCount);
+				auto otherMask = GetOverlapMask(GetEntryBox(children, child), otherChildren, otherFirst, otherCount);
+				if (childLevel == 0)
+				{
+					if (otherMask != 0)
+					{
+						function(child, otherFirst, otherMask);
+					}
+
+					continue;
+				}
+
+				for (; otherMask != 0; otherMask &= otherMask - 1)
+				{
+					JoinNodes(other, childLevel, child, childLevel, otherFirst + CountTrailingZeros(otherMask), function);
+				}
+			}
+		}
+	};
+
+	// A memory-compact variant of PackedRtree, with the same layout of the leaves but the boxes of the internal nodes stored as TQuantized (8- or 16-bit) coordinates
+	// relative to the box of their parent, rounded outward so that each stored box contains the exact one. Only the root box and the leaves (the features) are exact.
+	// The boxes of the children of a node are decoded from the box of the node while descending, the rounding only adds false positives that are filtered by the exact leaves,
+	// so the query results are the same as those of PackedRtree, at the cost of more visited nodes and tested objects (see QueryStats)
+	template <typename TSpatialKey, typename TQuantized = std::uint16_t, int NNodeSize = MaxElementsPerNode>
+	class QuantizedPackedRtree
+	{
+	public:
+
+		using ExactTree = PackedRtree<TSpatialKey, NNodeSize>;
+		using ScalarType = typename ExactTree::ScalarType;
+		using VectorType = typename ExactTree::VectorType;
+		using BoxType = typename ExactTree::BoxType;
+
+		static constexpr auto Dimensions = ExactTree::Dimensions;
+
+		static constexpr auto NodeSize = NNodeSize;
+
+		static constexpr auto QuantizedBits = int(sizeof(TQuantized) * 8);
+
+		static_assert(std::is_integral_v<TQuantized> && std::is_unsigned_v<TQuantized> && QuantizedBits <= 16);
+
+	private:
+
+		static constexpr auto MaxQuantized = std::numeric_limits<TQuantized>::max();
+
+		using ExactLevel = typename ExactTree::Level;
+
+		// The entry i of a level is relative to the box of its parent, the entry i / NodeSize of the level above
+		struct QuantizedLevel
+		{
+			std::array<std::vector<TQuantized>, Dimensions> mins;
+			std::array<std::vector<TQuantized>, Dimensions> maxs;
+
+			// Without the padding of the last node
+			int size = 0;
+
+			[[nodiscard]] int Size() const noexcept
+			{
+				return size;
+			}
+		};
+
+		// The decoded boxes of the children of a node, one array per axis, as expected by GetOverlapMask()
+		struct DecodedNode
+		{
+			std::array<std::array<ScalarType, NodeSize>, Dimensions> mins;
+			std::array<std::array<ScalarType, NodeSize>, Dimensions> maxs;
+
+			[[nodiscard]] BoxType GetBox(int child) const noexcept
+			{
+				VectorType min{};
+				VectorType max{};
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					min[axis] = mins[axis][child];
+					max[axis] = maxs[axis][child];
+				}
+
+				return { min, max };
+			}
+		};
+
+		ExactLevel leaves_;
+
+		// Level i - 1 here is the level i of the exact tree, the root is not included, it is stored in rootBox_
+		std::vector<QuantizedLevel> levels_;
+
+		BoxType rootBox_;
+
+		std::vector<FeatureId> ids_;
+
+	public:
+
+		QuantizedPackedRtree() = default;
+
+		// threadCount threads build the exact tree, see PackedRtree
+		explicit QuantizedPackedRtree(Span<Feature<TSpatialKey> const> features, int threadCount = 1)
+			: QuantizedPackedRtree(ExactTree{ features, threadCount })
+		{
+		}
+
+		explicit QuantizedPackedRtree(Features<TSpatialKey> const& features, int threadCount = 1)
+			: QuantizedPackedRtree(ExactTree{ features, threadCount })
+		{
+		}
+
+		// Takes the leaves of the exact tree and quantizes its internal nodes, top-down, each one relative to the decoded box of its parent.
+		// The tree must have been built, not opened from a file
+		explicit QuantizedPackedRtree(ExactTree&& tree)
+			: ids_{ std::move(tree.idStorage_) }
+		{
+			ASSERT(tree.image_ == nullptr);
+			if (IsEmpty())
+			{
+				return;
+			}
+
+			leaves_ = std::move(tree.levels_[0]);
+			rootBox_ = ExactTree::GetEntryBox(tree.levels_.back(), 0);
+			levels_.resize(tree.levels_.size() - 2);
+
+			std::vector<BoxType> parentBoxes{ rootBox_ };
+			for (auto levelIndex = tree.GetHeight() - 2; levelIndex > 0; --levelIndex)
+			{
+				auto const& exact = tree.levels_[levelIndex];
+				auto& quantized = levels_[levelIndex - 1];
+				// Padded to whole nodes, so that the children of any node are decoded with a loop of fixed length
+				auto const paddedSize = size_t((exact.Size() + NodeSize - 1) / NodeSize * NodeSize);
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					quantized.mins[axis].resize(paddedSize);
+					quantized.maxs[axis].resize(paddedSize);
+				}
+
+				quantized.size = exact.Size();
+
+				std::vector<BoxType> boxes(exact.Size());
+				for (auto i = 0; i < exact.Size(); ++i)
+				{
+					auto const& parent = parentBoxes[i / NodeSize];
+					VectorType min{};
+					VectorType max{};
+					for (auto axis = 0; axis < Dimensions; ++axis)
+					{
+						auto const origin = parent.Min()[axis];
+						auto const high = parent.Max()[axis];
+						auto const step = GetStep(origin, high);
+						quantized.mins[axis][i] = QuantizeMin(exact.GetMins(axis)[i], origin, step);
+						quantized.maxs[axis][i] = QuantizeMax(exact.GetMaxs(axis)[i], high, step);
+						min[axis] = DecodeMin(quantized.mins[axis][i], origin, step);
+						max[axis] = DecodeMax(quantized.maxs[axis][i], high, step);
+					}
+
+					boxes[i] = { min, max };
+				}
+
+				parentBoxes = std::move(boxes);
+			}
+		}
+
+		[[nodiscard]] int GetSize() const noexcept
+		{
+			return int(ids_.size());
+		}
+
+		[[nodiscard]] bool IsEmpty() const noexcept
+		{
+			return ids_.empty();
+		}
+
+		// The levels include the leaf entries and the root, as in PackedRtree
+		[[nodiscard]] int GetHeight() const noexcept
+		{
+			return IsEmpty() ? 0 : int(levels_.size()) + 2;
+		}
+
+		[[nodiscard]] int GetNodeCount() const noexcept
+		{
+			auto result = IsEmpty() ? 0 : 1;
+			for (auto const& level : levels_)
+			{
+				result += level.Size();
+			}
+
+			return result;
+		}
+
+		[[nodiscard]] FeatureId GetId(int entryIndex) const
+		{
+			return ids_[entryIndex];
+		}
+
+		[[nodiscard]] TSpatialKey GetKey(int entryIndex) const
+		{
+			auto const box = ExactTree::GetEntryBox(leaves_, entryIndex);
+			if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+			{
+				return box.Min();
+			}
+			else
+			{
+				return box;
+			}
+		}
+
+		[[nodiscard]] std::string GetStats() const
+		{
+			std::ostringstream stream;
+			stream << "Nodes: " << GetNodeCount() << " Height: " << GetHeight() << " Bits: " << QuantizedBits;
+			return stream.str();
+		}
+
+		// Returns the count of the features that overlap the box
+		[[nodiscard]] int QueryBox(BoxType const& box) const
+		{
+			auto count = 0;
+			VisitLeaves(box, [&count](int, std::uint64_t mask) { count += PopCount(mask); });
+			return count;
+		}
+
+		// Calls function(entryIndex) for each feature that overlaps the box
+		template <class TFunction>
+		void VisitBox(BoxType const& box, TFunction function) const
+		{
+			VisitLeaves(box, [&function](int first, std::uint64_t mask)
+				{
+					for (; mask != 0; mask &= mask - 1)
+					{
+						function(first + CountTrailingZeros(mask));
+					}
+				});
+		}
+
+		// Calls function(entryIndex, distanceSquared) for the nearest features to the location, in order of increasing distance.
+		// The distances to the decoded node boxes are lower bounds of the exact ones, so the order of the features is the same as in PackedRtree
+		template <class TFunction>
+		void VisitNearest(VectorType const& location, int nearestCount, TFunction function) const
+		{
+			if (IsEmpty() || nearestCount <= 0)
+			{
+				return;
+			}
+
+			struct Candidate
+			{
+				ScalarType distanceSquared;
+				int level;
+				int index;
+				BoxType box;
+
+				bool operator>(Candidate const& other) const noexcept
+				{
+					return distanceSquared > other.distanceSquared;
+				}
+			};
+
+			std::vector<Candidate> storage;
+			storage.reserve(size_t(NodeSize) * GetHeight() + nearestCount);
+			std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> queue{ std::greater<>{}, std::move(storage) };
+			queue.push({ 0, GetHeight() - 1, 0, rootBox_ });
+
+			DecodedNode decoded;
+			while (!queue.empty())
+			{
+				auto const candidate = queue.top();
+				queue.pop();
+
+				if (candidate.level == 0)
+				{
+					function(candidate.index, candidate.distanceSquared);
+					if (--nearestCount == 0)
+					{
+						return;
+					}
+
+					continue;
+				}
+
+				AddQueryStats_VisitedNodesCount();
+				auto const childLevel = candidate.level - 1;
+				auto const first = candidate.index * NodeSize;
+				auto const count = std::min(NodeSize, GetLevelSize(childLevel) - first);
+				if (childLevel == 0)
+				{
+					AddQueryStats_ObjectTestsCount(count);
+					for (auto i = first; i < first + count; ++i)
+					{
+						AddQueryStats_ScalarComparisonsCount();
+						queue.push({ ExactTree::GetDistanceSquared(location, leaves_, i), 0, i, {} });
+					}
+
+					continue;
+				}
+
+				Decode(levels_[childLevel - 1], first, candidate.box, decoded);
+				for (auto i = 0; i < count; ++i)
+				{
+					AddQueryStats_ScalarComparisonsCount();
+					auto const box = decoded.GetBox(i);
+					queue.push({ GeoToolbox::GetDistanceSquared(location, box), childLevel, first + i, box });
+				}
+			}
+		}
+
+	private:
+
+		[[nodiscard]] int GetLevelSize(int levelIndex) const noexcept
+		{
+			return levelIndex == 0 ? leaves_.Size() : levels_[levelIndex - 1].Size();
+		}
+
+		[[nodiscard]] static ScalarType GetStep(ScalarType origin, ScalarType high) noexcept
+		{
+			return (high - origin) / ScalarType(MaxQuantized);
+		}
+
+		// The mins are measured from the low end of the parent and the maxs from the high end, so that 0 and MaxQuantized decode exactly to the ends
+		[[nodiscard]] static ScalarType DecodeMin(TQuantized value, ScalarType origin, ScalarType step) noexcept
+		{
+			return origin + ScalarType(value) * step;
+		}
+
+		[[nodiscard]] static ScalarType DecodeMax(TQuantized value, ScalarType high, ScalarType step) noexcept
+		{
+			return high - ScalarType(MaxQuantized - value) * step;
+		}
+
+		// The decoding is monotonic, so the estimate is corrected by stepping towards the side where the decoded value still contains the exact one
+		[[nodiscard]] static TQuantized QuantizeMin(ScalarType value, ScalarType origin, ScalarType step) noexcept
+		{
+			if (!(step > 0))
+			{
+				return 0;
+			}
+
+			auto result = TQuantized(std::clamp(std::floor((value - origin) / step), ScalarType(0), ScalarType(MaxQuantized)));
+			while (result > 0 && DecodeMin(result, origin, step) > value)
+			{
+				--result;
+			}
+
+			return result;
+		}
+
+		[[nodiscard]] static TQuantized QuantizeMax(ScalarType value, ScalarType high, ScalarType step) noexcept
+		{
+			if (!(step > 0))
+			{
+				return MaxQuantized;
+			}
+
+			auto result = TQuantized(MaxQuantized - std::clamp(std::floor((high - value) / step), ScalarType(0), ScalarType(MaxQuantized)));
+			while (result < MaxQuantized && DecodeMax(result, high, step) < value)
+			{
+				++result;
+			}
+
+			return result;
+		}
+
+		// Decodes all NodeSize entries starting at first, the ones past the end of the level are padding
+		static void Decode(QuantizedLevel const& level, int first, BoxType const& parent, DecodedNode& decoded) noexcept
+		{
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				auto const origin = parent.Min()[axis];
+				auto const high = parent.Max()[axis];
+				auto const step = GetStep(origin, high);
+				auto const* mins = level.mins[axis].data() + first;
+				auto const* maxs = level.maxs[axis].data() + first;
+				for (auto i = 0; i < NodeSize; ++i)
+				{
+					decoded.mins[axis][i] = DecodeMin(mins[i], origin, step);
+					decoded.maxs[axis][i] = DecodeMax(maxs[i], high, step);
+				}
+			}
+		}
+
+		// Calls function(firstEntryIndex, mask) for each leaf node with features that overlap the box, bit i of the mask marks entry firstEntryIndex + i
+		template <class TFunction>
+		void VisitLeaves(BoxType const& box, TFunction function) const
+		{
+			if (!IsEmpty())
+			{
+				VisitLeaves(box, GetHeight() - 1, 0, rootBox_, function);
+			}
+		}
+
+		template <class TFunction>
+		void VisitLeaves(BoxType const& box, int levelIndex, int nodeIndex, BoxType const& nodeBox, TFunction& function) const
+		{
+			AddQueryStats_VisitedNodesCount();
+			auto const childLevel = levelIndex - 1;
+			auto const first = nodeIndex * NodeSize;
+			auto const count = std::min(NodeSize, GetLevelSize(childLevel) - first);
+			AddQueryStats_BoxOverlapsCount(count);
+			if (childLevel == 0)
+			{
+				AddQueryStats_ObjectTestsCount(count);
+				if (auto const mask = ExactTree::GetOverlapMask(box, leaves_, first, count); mask != 0)
+				{
+					function(first, mask);
+				}
+
+				return;
+			}
+
+			DecodedNode decoded;
+			Decode(levels_[childLevel - 1], first, nodeBox, decoded);
+			std::array<ScalarType const*, Dimensions> mins{};
+			std::array<ScalarType const*, Dimensions> maxs{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				mins[axis] = decoded.mins[axis].data();
+				maxs[axis] = decoded.maxs[axis].data();
+			}
+
+			for (auto mask = GeoToolbox::GetOverlapMask(box, mins, maxs, count); mask != 0; mask &= mask - 1)
+			{
+				auto const child = CountTrailingZeros(mask);
+				VisitLeaves(box, childLevel, first + child, decoded.GetBox(child), function);
+			}
+		}
+	};
+}
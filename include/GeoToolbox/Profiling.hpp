@@ -6,12 +6,20 @@
 #pragma once
 
 #include "GeoToolbox/Asserts.hpp"
+#include "GeoToolbox/HardwareCounters.hpp"
 #include "GeoToolbox/StlExtensions.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <iomanip>
+#include <new>
 #include <sstream>
 #include <unordered_map>
+#include <vector>
 
 #define TRACK_ALLOCATED_MEMORY 01
 
@@ -20,7 +28,152 @@ void TrackedFree(void* block);
 
 namespace GeoToolbox
 {
-	inline std::atomic<size_t> TotalAllocatedSize;
+	// Counts the memory allocated through the tracked operator new and TrackedMalloc() (see test/MemoryTracker.cpp). Each thread has its own counters,
+	// so that the allocating threads do not contend on a shared one, and the readers sum the counters of all threads. Only the owning thread updates
+	// the counts, allocations freed by another thread are subtracted from its counters. The counters of a finished thread are kept in the sums,
+	// as its memory may still be in use, and are taken over by the next new thread
+	class AllocationCounters
+	{
+		struct ThreadCounters
+		{
+			std::atomic<std::int64_t> size{ 0 };
+			std::atomic<std::int64_t> peakSize{ 0 };
+			std::atomic<std::int64_t> count{ 0 };
+			std::atomic<bool> inUse{ true };
+			ThreadCounters* next = nullptr;
+		};
+
+		struct ThreadRegistration
+		{
+			ThreadCounters* counters = nullptr;
+
+			ThreadRegistration() = default;
+			ThreadRegistration(ThreadRegistration const&) = delete;
+			ThreadRegistration(ThreadRegistration&&) = delete;
+			ThreadRegistration& operator=(ThreadRegistration const&) = delete;
+			ThreadRegistration& operator=(ThreadRegistration&&) = delete;
+
+			~ThreadRegistration()
+			{
+				if (counters != nullptr)
+				{
+					counters->inUse.store(false, std::memory_order_release);
+				}
+			}
+		};
+
+		inline static std::atomic<ThreadCounters*> head_{ nullptr };
+
+		[[nodiscard]] static ThreadCounters* Register() noexcept
+		{
+			for (auto counters = head_.load(std::memory_order_acquire); counters != nullptr; counters = counters->next)
+			{
+				if (auto expected = false; counters->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+				{
+					return counters;
+				}
+			}
+
+			// Taken from malloc, so that the counters do not count themselves, and never freed
+			auto const counters = new (std::malloc(sizeof(ThreadCounters))) ThreadCounters{};
+			counters->next = head_.load(std::memory_order_relaxed);
+			while (!head_.compare_exchange_weak(counters->next, counters, std::memory_order_release, std::memory_order_relaxed))
+			{
+			}
+
+			return counters;
+		}
+
+		[[nodiscard]] static ThreadCounters& GetThreadCounters() noexcept
+		{
+			thread_local ThreadRegistration registration;
+			if (registration.counters == nullptr)
+			{
+				registration.counters = Register();
+			}
+
+			return *registration.counters;
+		}
+
+		template <class F>
+		static void ForEachThread(F function) noexcept
+		{
+			for (auto counters = head_.load(std::memory_order_acquire); counters != nullptr; counters = counters->next)
+			{
+				function(*counters);
+			}
+		}
+
+	public:
+
+		struct Values
+		{
+			// The allocated minus the freed bytes
+			std::int64_t size = 0;
+
+			// The count of allocations
+			std::int64_t count = 0;
+		};
+
+		// The counters are updated by read-modify-write operations: a thread may still allocate during its thread-local teardown after its counters
+		// have been released and taken by a new thread, then both update the same counters
+		static void Add(std::size_t size) noexcept
+		{
+			auto& counters = GetThreadCounters();
+			auto const newSize = counters.size.fetch_add(std::int64_t(size), std::memory_order_relaxed) + std::int64_t(size);
+			counters.count.fetch_add(1, std::memory_order_relaxed);
+			auto peakSize = counters.peakSize.load(std::memory_order_relaxed);
+			while (newSize > peakSize && !counters.peakSize.compare_exchange_weak(peakSize, newSize, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		static void Remove(std::size_t size) noexcept
+		{
+			auto& counters = GetThreadCounters();
+			counters.size.fetch_sub(std::int64_t(size), std::memory_order_relaxed);
+		}
+
+		[[nodiscard]] static Values Read() noexcept
+		{
+			Values result;
+			ForEachThread([&result](ThreadCounters const& counters)
+				{
+					result.size += counters.size.load(std::memory_order_relaxed);
+					result.count += counters.count.load(std::memory_order_relaxed);
+				});
+
+			return result;
+		}
+
+		// Returns Read() and starts a new measure of the peak, GetPeakSize() - Read().size is the growth of the memory since then
+		static Values ResetPeak() noexcept
+		{
+			Values result;
+			ForEachThread([&result](ThreadCounters& counters)
+				{
+					auto const size = counters.size.load(std::memory_order_relaxed);
+					counters.peakSize.store(size, std::memory_order_relaxed);
+					result.size += size;
+					result.count += counters.count.load(std::memory_order_relaxed);
+				});
+
+			return result;
+		}
+
+		// The sum of the peak sizes of the threads since ResetPeak(). It is the peak of the total size when a single thread allocates,
+		// an upper bound of it when the threads reach their peaks at different times
+		[[nodiscard]] static std::int64_t GetPeakSize() noexcept
+		{
+			std::int64_t result = 0;
+			ForEachThread([&result](ThreadCounters const& counters)
+				{
+					result += counters.peakSize.load(std::memory_order_relaxed);
+				});
+
+			return result;
+		}
+	};
 
 
 	template <typename T>
@@ -69,6 +222,12 @@ namespace GeoToolbox
 			return isRunning_ ? int64_t(duration_cast<microseconds>(steady_clock::now() - start_).count()) : 0;
 		}
 
+		[[nodiscard]] int64_t ElapsedNanoseconds() const noexcept
+		{
+			using namespace std::chrono;
+			return isRunning_ ? int64_t(duration_cast<nanoseconds>(steady_clock::now() - start_).count()) : 0;
+		}
+
 		[[nodiscard]] int ElapsedMilliseconds() const noexcept
 		{
 			using namespace std::chrono;
@@ -154,6 +313,119 @@ namespace GeoToolbox
 	};
 
 
+	// A histogram of durations (or any non-negative values) with log-linear buckets, like HdrHistogram: each power of two is split in 2^SubBucketBits buckets,
+	// so a reported percentile is within 2^-SubBucketBits (about 3%) of the exact value. All the storage is inline, adding a value does not allocate.
+	// Values above 2^MaxValueBits (about 18 minutes in nanoseconds) are counted in the last bucket
+	class LatencyHistogram
+	{
+	public:
+
+		static constexpr int SubBucketBits = 5;
+
+		static constexpr int MaxValueBits = 40;
+
+	private:
+
+		static constexpr auto SubBucketCount = std::int64_t(1) << SubBucketBits;
+
+		// Values below 2 * SubBucketCount have one bucket each, above that a bucket spans 2^shift values
+		static constexpr auto BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+		std::array<std::int64_t, BucketCount> counts_{};
+		std::int64_t count_ = 0;
+		std::int64_t maximum_ = 0;
+
+		[[nodiscard]] static int GetBucket(std::int64_t value) noexcept
+		{
+			if (value < 2 * SubBucketCount)
+			{
+				return int(std::max(value, std::int64_t(0)));
+			}
+
+			auto const shift = 63 - CountLeadingZeros(std::uint64_t(value)) - SubBucketBits;
+			return std::min(int((shift + 1) * SubBucketCount + (value >> shift) - SubBucketCount), int(BucketCount) - 1);
+		}
+
+		// The highest value that falls into the bucket
+		[[nodiscard]] static std::int64_t GetBucketLimit(int bucket) noexcept
+		{
+			if (bucket < 2 * SubBucketCount)
+			{
+				return bucket;
+			}
+
+			auto const shift = bucket / SubBucketCount - 1;
+			return ((bucket % SubBucketCount + SubBucketCount + 1) << shift) - 1;
+		}
+
+	public:
+
+		void Add(std::int64_t value) noexcept
+		{
+			++counts_[GetBucket(value)];
+			++count_;
+			maximum_ = std::max(maximum_, value);
+		}
+
+		void Merge(LatencyHistogram const& other) noexcept
+		{
+			for (auto i = 0; i < BucketCount; ++i)
+			{
+				counts_[i] += other.counts_[i];
+			}
+
+			count_ += other.count_;
+			maximum_ = std::max(maximum_, other.maximum_);
+		}
+
+		void Clear() noexcept
+		{
+			counts_.fill(0);
+			count_ = 0;
+			maximum_ = 0;
+		}
+
+		[[nodiscard]] bool IsEmpty() const noexcept
+		{
+			return count_ == 0;
+		}
+
+		[[nodiscard]] std::int64_t Count() const noexcept
+		{
+			return count_;
+		}
+
+		// The exact maximum, not rounded to a bucket
+		[[nodiscard]] std::int64_t Maximum() const noexcept
+		{
+			return maximum_;
+		}
+
+		// The value that percentile % of the values do not exceed (rounded up to the limit of its bucket), percentile is in [0, 100]
+		[[nodiscard]] std::int64_t GetPercentile(double percentile) const noexcept
+		{
+			if (count_ == 0)
+			{
+				return 0;
+			}
+
+			auto const rank = std::max(std::int64_t(1), std::int64_t(std::ceil(percentile / 100 * double(count_))));
+			std::int64_t accumulated = 0;
+			for (auto i = 0; i < BucketCount; ++i)
+			{
+				accumulated += counts_[i];
+				if (accumulated >= rank)
+				{
+					// The last bucket also holds all the values above its limit
+					return i < BucketCount - 1 ? std::min(GetBucketLimit(i), maximum_) : maximum_;
+				}
+			}
+
+			return maximum_;
+		}
+	};
+
+
 	class ProfileMemoryResource : public std::pmr::memory_resource
 	{
 		memory_resource* upstream_;
@@ -214,6 +486,68 @@ namespace GeoToolbox
 		}
 	};
 
+	// Forwards to TrackedMalloc() and TrackedFree(), so that the memory taken through this resource is seen by the memory tracking of the tests
+	// (the default pmr resource may use the aligned forms of operator new, which are not tracked)
+	class TrackedMemoryResource : public std::pmr::memory_resource
+	{
+	public:
+
+		[[nodiscard]] static TrackedMemoryResource* Get() noexcept
+		{
+			static TrackedMemoryResource instance;
+			return &instance;
+		}
+
+	private:
+
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			ASSERT(alignment <= alignof(std::max_align_t));
+			auto const result = TrackedMalloc(bytes);
+			if (result == nullptr)
+			{
+				throw std::bad_alloc{};
+			}
+
+			return result;
+		}
+
+		void do_deallocate(void* p, size_t /*bytes*/, size_t /*alignment*/) override
+		{
+			TrackedFree(p);
+		}
+
+		[[nodiscard]] bool do_is_equal(memory_resource const& other) const noexcept override
+		{
+			return this == &other;
+		}
+	};
+
+	// A monotonic arena: allocations are carved from chunks of growing size taken from the upstream resource, deallocations are ignored,
+	// and all the memory is released at once when the arena is destroyed. The arena is used through a ProfileMemoryResource, which counts the allocations made in it
+	class ArenaResource
+	{
+		std::pmr::monotonic_buffer_resource arena_;
+		ProfileMemoryResource profile_{ &arena_ };
+
+	public:
+
+		explicit ArenaResource(std::size_t initialSize = 64 * 1024, std::pmr::memory_resource* upstream = nullptr)
+			: arena_{ initialSize, upstream != nullptr ? upstream : TrackedMemoryResource::Get() }
+		{
+		}
+
+		[[nodiscard]] ProfileMemoryResource& GetResource() noexcept
+		{
+			return profile_;
+		}
+
+		[[nodiscard]] ProfileMemoryResource const& GetResource() const noexcept
+		{
+			return profile_;
+		}
+	};
+
 	struct TotalAllocatedStats
 	{
 		using StatsType = std::shared_ptr<std::atomic<std::int64_t>>;
@@ -433,6 +767,38 @@ namespace GeoToolbox
 		return PrintMicroSeconds(double(us));
 	}
 
+	// The median of the values, 0 if there are none
+	template <class TAllocator>
+	[[nodiscard]] double GetMedian(std::vector<double, TAllocator> values)
+	{
+		if (values.empty())
+		{
+			return 0;
+		}
+
+		auto const middle = values.begin() + std::ptrdiff_t(values.size() / 2);
+		std::nth_element(values.begin(), middle, values.end());
+		if (values.size() % 2 != 0)
+		{
+			return *middle;
+		}
+
+		return (*middle + *std::max_element(values.begin(), middle)) / 2;
+	}
+
+	// The median of the absolute deviations from the median (MAD), a measure of the spread of the values that, unlike the standard deviation, ignores a few outliers
+	template <class TAllocator>
+	[[nodiscard]] double GetMedianAbsoluteDeviation(std::vector<double, TAllocator> values)
+	{
+		auto const median = GetMedian(values);
+		for (auto& value : values)
+		{
+			value = std::abs(value - median);
+		}
+
+		return GetMedian(std::move(values));
+	}
+
 	//! Runs a set of named actions for several iterations until none of the actions improves its time and records the best time of each action
 	class Timings
 	{
@@ -444,8 +810,29 @@ namespace GeoToolbox
 			double bestTime = std::numeric_limits<double>::max();
 			int64_t iterationCount = 0;
 			int64_t memoryDelta = std::numeric_limits<int64_t>::max();
+
+			// The largest over the samples of the growth of the allocated memory above its size at the start of the action, and of the count of allocations per repeat
+			int64_t peakMemory = 0;
+			int64_t allocationCount = 0;
+
 			bool failed = false;
 			std::shared_ptr<void> extra;
+
+			// The hardware counters per repeat of the sample with the best time, if enabled by SetHardwareCounters()
+			HardwareCounters::Values hardwareCounters{};
+
+			// The time per repeat of each sample, except those of the warmup iterations
+			std::vector<double, MallocAllocator<double>> samples;
+
+			[[nodiscard]] double GetMedianTime() const
+			{
+				return GetMedian(samples);
+			}
+
+			[[nodiscard]] double GetMedianAbsoluteDeviation() const
+			{
+				return GeoToolbox::GetMedianAbsoluteDeviation(samples);
+			}
 		};
 
 		using ContainerType = std::unordered_map<char const*, ActionStats, std::hash<char const*>, std::equal_to<char const*>, MallocAllocator<std::pair<char const* const, ActionStats>>>;
@@ -458,6 +845,10 @@ namespace GeoToolbox
 
 		int const maximumIterationCount_;
 
+		int warmupIterations_ = 0;
+
+		int minimumIterationCount_ = 0;
+
 		ContainerType actions_;
 
 		Stopwatch timer_{ false };
@@ -474,6 +865,8 @@ namespace GeoToolbox
 
 		int notImprovedRuns_ = 0;
 
+		HardwareCounters const* hardwareCounters_ = nullptr;
+
 	public:
 
 		static constexpr int64_t MsPerSecond = 1'000;
@@ -496,19 +889,54 @@ namespace GeoToolbox
 		Timings& operator=(Timings const&) = delete;
 		Timings& operator=(Timings&&) = delete;
 
-		ActionStats& AddSample(char const* actionName, int64_t runTime, int repeats = 1, int64_t memoryDelta = 0)
+		// Record() reads the counters around each action, they should have been created on the thread that calls it. Pass nullptr to stop reading them
+		void SetHardwareCounters(HardwareCounters const* counters) noexcept
+		{
+			hardwareCounters_ = counters;
+		}
+
+		// The first iterations run the actions without recording them, to warm up the caches, the branch predictors and the clock frequency of the CPU
+		void SetWarmupIterations(int count) noexcept
+		{
+			warmupIterations_ = std::max(count, 0);
+		}
+
+		// Do not stop before this count of recorded iterations, to have enough samples for the median and the spread of the times
+		void SetMinimumIterationCount(int count) noexcept
+		{
+			minimumIterationCount_ = std::max(count, 0);
+		}
+
+		[[nodiscard]] bool IsWarmingUp() const noexcept
+		{
+			return warmupIterations_ > 0 && iterationCount_ <= warmupIterations_;
+		}
+
+		ActionStats& AddSample(char const* actionName, int64_t runTime, int repeats = 1, int64_t memoryDelta = 0, int64_t peakMemory = 0, int64_t allocationCount = 0, HardwareCounters::Values const& hardwareCounters = {})
 		{
 			auto& action = actions_[actionName];
+			if (IsWarmingUp())
+			{
+				return action;
+			}
+
 			action.iterationCount += repeats;
 			action.totalTime += runTime;
 			auto const avgTime = double(runTime) / repeats;
+			action.samples.push_back(avgTime);
 			if (avgTime < action.bestTime)
 			{
 				action.bestTime = avgTime;
 				anyImproved_ = true;
+				for (auto i = 0; i < HardwareCounters::CounterCount; ++i)
+				{
+					action.hardwareCounters[i] = hardwareCounters[i] / repeats;
+				}
 			}
 
 			action.memoryDelta = std::min(action.memoryDelta, memoryDelta);
+			action.peakMemory = std::max(action.peakMemory, peakMemory);
+			action.allocationCount = std::max(action.allocationCount, allocationCount / repeats);
 			return action;
 		}
 
@@ -563,7 +991,10 @@ namespace GeoToolbox
 		template <class F>
 		std::invoke_result_t<F> Record(char const* actionName, int repeats, SharedAllocatedSize const& allocatorStats, F action, ActionStats** statsPtr = nullptr, int64_t* elapsedUs = nullptr)
 		{
-			auto initialMemory = allocatorStats != nullptr ? allocatorStats->load() : int64_t(TotalAllocatedSize.load());
+			// The allocator of the index, if given, counts only the memory of the index, the peak and the count of allocations are always of all the tracked memory
+			auto const initialAllocatorMemory = allocatorStats != nullptr ? allocatorStats->load() : 0;
+			auto const initialAllocations = AllocationCounters::ResetPeak();
+			auto const initialCounters = hardwareCounters_ != nullptr ? hardwareCounters_->Read() : HardwareCounters::Values{};
 			Stopwatch actionTimer;
 
 			for (auto i = 0; i < repeats - 1; ++i)
@@ -582,12 +1013,16 @@ namespace GeoToolbox
 			}
 
 			auto const us = actionTimer.ElapsedMicroseconds();
+			auto const counters = hardwareCounters_ != nullptr ? HardwareCounters::Subtract(hardwareCounters_->Read(), initialCounters) : HardwareCounters::Values{};
 			if (elapsedUs != nullptr)
 			{
 				*elapsedUs = us;
 			}
 
-			auto& stats = AddSample(actionName, us, repeats, (allocatorStats != nullptr ? allocatorStats->load() : int64_t(TotalAllocatedSize.load())) - initialMemory);
+			auto const allocations = AllocationCounters::Read();
+			auto const memoryDelta = allocatorStats != nullptr ? allocatorStats->load() - initialAllocatorMemory : allocations.size - initialAllocations.size;
+			auto const peakMemory = AllocationCounters::GetPeakSize() - initialAllocations.size;
+			auto& stats = AddSample(actionName, us, repeats, memoryDelta, peakMemory, allocations.count - initialAllocations.count, counters);
 			if (statsPtr != nullptr)
 			{
 				*statsPtr = &stats;
@@ -610,6 +1045,13 @@ namespace GeoToolbox
 				return true;
 			}
 
+			if (IsWarmingUp())
+			{
+				++iterationCount_;
+				iterationStartTime_ = timer_.ElapsedMicroseconds();
+				return true;
+			}
+
 			auto const time = timer_.ElapsedMicroseconds() - iterationStartTime_;
 			if (time < bestIterationTime_)
 			{
@@ -627,7 +1069,9 @@ namespace GeoToolbox
 				++notImprovedRuns_;
 			}
 
-			if (iterationCount_ >= maximumIterationCount_ || timer_.ElapsedMicroseconds() > minimumRunningTimeUs_ && (stopWhenNotImprovedNTimes_ <= 0 || notImprovedRuns_ >= stopWhenNotImprovedNTimes_))
+			auto const recordedIterationCount = iterationCount_ - warmupIterations_;
+			if (recordedIterationCount >= maximumIterationCount_
+				|| recordedIterationCount >= minimumIterationCount_ && timer_.ElapsedMicroseconds() > minimumRunningTimeUs_ && (stopWhenNotImprovedNTimes_ <= 0 || notImprovedRuns_ >= stopWhenNotImprovedNTimes_))
 			{
 				totalRunningTime_ = timer_.ElapsedMicroseconds();
 				return false;
@@ -650,6 +1094,11 @@ namespace GeoToolbox
 					buffer << ", mem delta: " << action.second.memoryDelta;
 				}
 
+				if (action.second.peakMemory != 0)
+				{
+					buffer << ", mem peak: " << action.second.peakMemory << " in " << action.second.allocationCount << " allocations";
+				}
+
 				buffer << '\n';
 			}
 
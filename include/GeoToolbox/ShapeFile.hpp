@@ -9,6 +9,7 @@
 #include "SpatialTools.hpp"
 
 #include <filesystem>
+#include <optional>
 #include <vector>
 
 struct tagSHPObject;
@@ -98,6 +99,17 @@ namespace GeoToolbox
 			return ShapeType(shapeType_);
 		}
 
+		// The bounds of all objects from the file header, per axis X, Y, Z and M
+		[[nodiscard]] std::array<double, 4> const& GetMinBounds() const noexcept
+		{
+			return minBounds_;
+		}
+
+		[[nodiscard]] std::array<double, 4> const& GetMaxBounds() const noexcept
+		{
+			return maxBounds_;
+		}
+
 		template <typename TSpatialKey>
 		[[nodiscard]] bool Supports() const noexcept
 		{
@@ -129,6 +141,9 @@ namespace GeoToolbox
 
 		[[nodiscard]] static Interval<double> GetBounds(tagSHPObject const& object, int axis);
 
+		// False for the null shapes and the points and multi-points without vertices, which ReadBounds() skips too
+		[[nodiscard]] static bool HasKey(tagSHPObject const& object);
+
 		template <typename TSpatialKey>
 		[[nodiscard]] TSpatialKey GetKey(tagSHPObject const& object) const
 		{
@@ -149,6 +164,11 @@ namespace GeoToolbox
 			}
 		}
 
+		// Reads only the bounding box of each of the first limit records (for points and multi-points: the first vertex, as a degenerate box),
+		// directly from the .shp and .shx files, without decoding the vertices. Null shapes are skipped. Large files are split across threads.
+		// Returns nullopt if the files cannot be read this way, the caller should fall back to GetObject() then
+		[[nodiscard]] std::optional<std::vector<Box2>> ReadBounds(int limit = -1) const;
+
 		template <typename TSpatialKey>
 		[[nodiscard]] std::vector<TSpatialKey> GetKeys(int limit = -1) const
 		{
@@ -158,6 +178,24 @@ namespace GeoToolbox
 			}
 			else
 			{
+				using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
+				using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+				if (auto const bounds = ReadBounds(limit))
+				{
+					return Transform(*bounds, [](Box2 const& box) -> TSpatialKey
+						{
+							if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+							{
+								return { ScalarType(box.Min()[0]), ScalarType(box.Min()[1]) };
+							}
+							else
+							{
+								return { Convert<VectorType>(box.Min()), Convert<VectorType>(box.Max()) };
+							}
+						});
+				}
+
 				std::vector<TSpatialKey> result;
 				limit = limit < 0 ? objectCount_ : std::min(objectCount_, limit);
 				for (auto index = 0; index < limit; ++index)
@@ -175,6 +213,31 @@ namespace GeoToolbox
 			}
 		}
 
+		// Reads the keys of the records from index on into the span, until it is filled or the records end, and advances index past the read records.
+		// The records are read one by one through GetObject(), so that a file that does not fit in memory can be read in chunks. Returns the count of the stored keys,
+		// which are the same as those of GetKeys()
+		template <typename TSpatialKey>
+		[[nodiscard]] int ReadKeys(int& index, Span<TSpatialKey> keys) const
+		{
+			if constexpr (SpatialKeyTraits<TSpatialKey>::Dimensions >= 3)
+			{
+				return 0;
+			}
+			else
+			{
+				auto count = 0;
+				for (; count < int(keys.size()) && index < objectCount_; ++index)
+				{
+					if (auto const object = GetObject(index); object != nullptr && HasKey(*object))
+					{
+						keys[count++] = GetKey<TSpatialKey>(*object);
+					}
+				}
+
+				return count;
+			}
+		}
+
 		[[nodiscard]] std::vector<Segment2> GetSegments() const;
 	};
 }
@@ -7,8 +7,17 @@
 
 #include "GeoToolbox/GeometryTools.hpp"
 #include "GeoToolbox/Iterators.hpp"
+#include "GeoToolbox/Span.hpp"
 #include "GeoToolbox/StlExtensions.hpp"
+#include "GeoToolbox/ThreadPool.hpp"
 
+#if defined( __BMI2__ )
+#	include <immintrin.h>
+#endif
+
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <random>
 #include <sstream>
 
@@ -23,11 +32,12 @@ namespace GeoToolbox
 
 		Point,
 		Box,
+		Segment,
 	};
 
 	inline SpatialKeyKind SpatialKeyKindFromString(std::string_view name)
 	{
-		return name == "point" ? SpatialKeyKind::Point : name == "box" ? SpatialKeyKind::Box : SpatialKeyKind::Undefined;
+		return name == "point" ? SpatialKeyKind::Point : name == "box" ? SpatialKeyKind::Box : name == "segment" ? SpatialKeyKind::Segment : SpatialKeyKind::Undefined;
 	}
 
 	constexpr std::string_view ToString(SpatialKeyKind key)
@@ -36,6 +46,7 @@ namespace GeoToolbox
 		{
 		case SpatialKeyKind::Point: return "point";
 		case SpatialKeyKind::Box: return "box";
+		case SpatialKeyKind::Segment: return "segment";
 		default: throw std::out_of_range("SpatialKeyKind value cannot be converted to string");
 		}
 	}
@@ -104,12 +115,33 @@ namespace GeoToolbox
 		}
 	};
 
+	// The trees index a segment by its bounding box, GetBox(), and the nearest queries refine the distances to the boxes with the exact ones,
+	// see GetDistanceSquared() of a point and a segment and its batched variant GetSegmentDistancesSquared()
+	template <typename TVector>
+	struct SpatialKeyTraits<Segment<TVector>> : SpatialKeyTraitsDefaults<TVector, SpatialKeyKind::Segment>
+	{
+		using SpatialKeyArrayType = Segment<typename SpatialKeyTraitsDefaults<TVector, SpatialKeyKind::Point>::ArrayType>;
+
+		static TVector GetCenter(Segment<TVector> const& key)
+		{
+			return (key.first + key.second) / typename SpatialKeyTraitsDefaults<TVector, SpatialKeyKind::Segment>::ScalarType(2);
+		}
+
+		static Box<TVector> GetBox(Segment<TVector> const& key)
+		{
+			return Box<TVector>::Bound(key.first, key.second);
+		}
+	};
+
 	template <class TSpatialKey>
 	constexpr bool SpatialKeyIsPoint = SpatialKeyTraits<TSpatialKey>::Kind == SpatialKeyKind::Point;
 
 	template <class TSpatialKey>
 	constexpr bool SpatialKeyIsBox = SpatialKeyTraits<TSpatialKey>::Kind == SpatialKeyKind::Box;
 
+	template <class TSpatialKey>
+	constexpr bool SpatialKeyIsSegment = SpatialKeyTraits<TSpatialKey>::Kind == SpatialKeyKind::Segment;
+
 
 	using FeatureId = std::intptr_t;
 
@@ -126,19 +158,464 @@ namespace GeoToolbox
 	};
 
 
+	// Columnar (structure of arrays) storage of features: an id column and one coordinate column per axis for the low and the high bounds of the keys.
+	// Point keys have no high bound columns, GetMaxs() returns the low bounds for them, so that scans can treat all keys as boxes.
 	template <typename TSpatialKey>
 	struct Features
 	{
+		using KeyTraits = SpatialKeyTraits<TSpatialKey>;
+		using ScalarType = typename KeyTraits::ScalarType;
+		using VectorType = typename KeyTraits::VectorType;
+
+		static constexpr auto Dimensions = int(KeyTraits::Dimensions);
+
+
 		std::vector<FeatureId> ids;
-		std::vector<TSpatialKey> spatialKeys;
 
-		Feature<TSpatialKey> operator[](int index)
+		std::array<std::vector<ScalarType>, Dimensions> mins;
+
+		// Empty if the spatial keys are points
+		std::array<std::vector<ScalarType>, Dimensions> maxs;
+
+
+		Features() = default;
+
+		explicit Features(Span<Feature<TSpatialKey> const> features)
+		{
+			Assign(features);
+		}
+
+		void Assign(Span<Feature<TSpatialKey> const> features)
+		{
+			Resize(int(features.size()));
+			for (auto i = 0; i < GetSize(); ++i)
+			{
+				ids[i] = features[i].id;
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					mins[axis][i] = GetLowBound(features[i].spatialKey, axis);
+					if constexpr (SpatialKeyIsBox<TSpatialKey>)
+					{
+						maxs[axis][i] = GetHighBound(features[i].spatialKey, axis);
+					}
+				}
+			}
+		}
+
+		void Resize(int size)
+		{
+			ids.resize(size);
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				mins[axis].resize(size);
+				if constexpr (SpatialKeyIsBox<TSpatialKey>)
+				{
+					maxs[axis].resize(size);
+				}
+			}
+		}
+
+		void Clear() noexcept
+		{
+			ids.clear();
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				mins[axis].clear();
+				maxs[axis].clear();
+			}
+		}
+
+		[[nodiscard]] int GetSize() const noexcept
+		{
+			return int(ids.size());
+		}
+
+		[[nodiscard]] bool IsEmpty() const noexcept
+		{
+			return ids.empty();
+		}
+
+		[[nodiscard]] Span<FeatureId const> GetIds() const noexcept
+		{
+			return ids;
+		}
+
+		[[nodiscard]] Span<ScalarType const> GetMins(int axis) const noexcept
+		{
+			return mins[axis];
+		}
+
+		[[nodiscard]] Span<ScalarType const> GetMaxs(int axis) const noexcept
+		{
+			return SpatialKeyIsBox<TSpatialKey> ? Span<ScalarType const>{ maxs[axis] } : Span<ScalarType const>{ mins[axis] };
+		}
+
+		// Pointers to the coordinates of the entry at index first, one per axis, in the form expected by GetOverlapMask()
+		[[nodiscard]] std::array<ScalarType const*, Dimensions> GetMinPointers(int first = 0) const noexcept
+		{
+			std::array<ScalarType const*, Dimensions> result{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				result[axis] = GetMins(axis).data() + first;
+			}
+
+			return result;
+		}
+
+		[[nodiscard]] std::array<ScalarType const*, Dimensions> GetMaxPointers(int first = 0) const noexcept
 		{
-			return { ids[index], spatialKeys[index] };
+			std::array<ScalarType const*, Dimensions> result{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				result[axis] = GetMaxs(axis).data() + first;
+			}
+
+			return result;
+		}
+
+		[[nodiscard]] TSpatialKey GetKey(int index) const
+		{
+			VectorType min{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				min[axis] = mins[axis][index];
+			}
+
+			if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+			{
+				return min;
+			}
+			else
+			{
+				VectorType max{};
+				for (auto axis = 0; axis < Dimensions; ++axis)
+				{
+					max[axis] = maxs[axis][index];
+				}
+
+				return { min, max };
+			}
+		}
+
+		[[nodiscard]] Feature<TSpatialKey> operator[](int index) const
+		{
+			return { ids[index], GetKey(index) };
 		}
 	};
 
 
+	// Space-filling curves
+
+	// Returns the distance along the Hilbert curve of a point with integer coordinates, each of them using bitsPerAxis bits (NDimensions * bitsPerAxis must not exceed 64).
+	// Based on John Skilling, "Programming the Hilbert curve", AIP Conference Proceedings 707, 2004
+	template <size_t NDimensions>
+	[[nodiscard]] constexpr std::uint64_t GetHilbertIndex(std::array<std::uint32_t, NDimensions> x, int bitsPerAxis) noexcept
+	{
+		DEBUG_ASSERT(bitsPerAxis > 0 && bitsPerAxis <= 32 && NDimensions * bitsPerAxis <= 64);
+
+		auto const highestBit = std::uint32_t(1) << (bitsPerAxis - 1);
+
+		// Inverse undo excess work. The bits tested here are effectively random, so the branches of the original are replaced by masks:
+		// if bit q of x[i] is set, the low bits of x[0] are inverted, otherwise they are exchanged with those of x[i]
+		for (auto q = highestBit; q > 1; q >>= 1)
+		{
+			auto const p = q - 1;
+			for (size_t i = 0; i < NDimensions; ++i)
+			{
+				auto const invert = std::uint32_t(0) - ((x[i] & q) != 0 ? 1u : 0u);
+				auto const t = (x[0] ^ x[i]) & p & ~invert;
+				x[0] ^= (p & invert) | t;
+				x[i] ^= t;
+			}
+		}
+
+		// Gray encode
+		for (size_t i = 1; i < NDimensions; ++i)
+		{
+			x[i] ^= x[i - 1];
+		}
+
+		std::uint32_t t = 0;
+		for (auto q = highestBit; q > 1; q >>= 1)
+		{
+			t ^= (q - 1) & (std::uint32_t(0) - ((x[NDimensions - 1] & q) != 0 ? 1u : 0u));
+		}
+
+		for (size_t i = 0; i < NDimensions; ++i)
+		{
+			x[i] ^= t;
+		}
+
+		// The result is "transposed" - the bits of the index are interleaved over the coordinates
+		std::uint64_t index = 0;
+		for (auto bit = bitsPerAxis - 1; bit >= 0; --bit)
+		{
+			for (size_t i = 0; i < NDimensions; ++i)
+			{
+				index = (index << 1) | ((x[i] >> bit) & 1);
+			}
+		}
+
+		return index;
+	}
+
+	template <class TVector>
+	constexpr int MaxCurveBitsPerAxis = int(std::min(size_t(32), 64 / VectorTraits<TVector>::Dimensions));
+
+	// Moves bit b of the value to bit b * NDimensions, the bits that do not fit in 64 bits are dropped
+	template <size_t NDimensions>
+	[[nodiscard]] constexpr std::uint64_t SpreadBits(std::uint32_t value) noexcept
+	{
+		static_assert(NDimensions > 0);
+
+		std::uint64_t x = value;
+		if constexpr (NDimensions == 1)
+		{
+			return x;
+		}
+		else if constexpr (NDimensions == 2)
+		{
+			x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+			x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+			x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+			x = (x | (x << 2)) & 0x3333333333333333ull;
+			x = (x | (x << 1)) & 0x5555555555555555ull;
+			return x;
+		}
+		else if constexpr (NDimensions == 3)
+		{
+			x &= 0x1FFFFF;
+			x = (x | (x << 32)) & 0x001F00000000FFFFull;
+			x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+			x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+			x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+			x = (x | (x << 2)) & 0x1249249249249249ull;
+			return x;
+		}
+		else
+		{
+			std::uint64_t result = 0;
+			for (size_t bit = 0; bit < 32 && bit * NDimensions < 64; ++bit)
+			{
+				result |= ((x >> bit) & 1) << (bit * NDimensions);
+			}
+
+			return result;
+		}
+	}
+
+	// Returns the distance along the Morton (Z-order) curve of a point with integer coordinates: bit b of x[i] becomes bit b * NDimensions + i of the index,
+	// the bits that do not fit in 64 bits are dropped. Uses the BMI2 instruction PDEP where available
+	template <size_t NDimensions>
+	[[nodiscard]] inline std::uint64_t GetMortonIndex(std::array<std::uint32_t, NDimensions> const& x) noexcept
+	{
+		std::uint64_t index = 0;
+		for (size_t i = 0; i < NDimensions; ++i)
+		{
+#if defined( __BMI2__ )
+			index |= _pdep_u64(x[i], SpreadBits<NDimensions>(~std::uint32_t(0)) << i);
+#else
+			index |= SpreadBits<NDimensions>(x[i]) << i;
+#endif
+		}
+
+		return index;
+	}
+
+	// Returns the cell of the point in a grid of 2^bitsPerAxis cells per axis over the bounds
+	template <class TVector>
+	[[nodiscard]] std::array<std::uint32_t, VectorTraits<TVector>::Dimensions> GetGridCell(TVector const& point, Box<TVector> const& bounds, int bitsPerAxis) noexcept
+	{
+		constexpr auto Dimensions = VectorTraits<TVector>::Dimensions;
+		auto const maxCoordinate = double((std::uint64_t(1) << bitsPerAxis) - 1);
+
+		std::array<std::uint32_t, Dimensions> coordinates{};
+		for (auto i = 0; i < int(Dimensions); ++i)
+		{
+			auto const size = double(bounds.Max()[i]) - double(bounds.Min()[i]);
+			auto const t = size > 0 ? (double(point[i]) - double(bounds.Min()[i])) / size : 0.0;
+			coordinates[i] = std::uint32_t(std::clamp(t, 0.0, 1.0) * maxCoordinate);
+		}
+
+		return coordinates;
+	}
+
+	// Returns the Hilbert curve index of a point, whose coordinates are quantized over the given bounds, by default using as many bits per axis as fit in 64 bits
+	template <class TVector>
+	[[nodiscard]] std::uint64_t GetHilbertIndex(TVector const& point, Box<TVector> const& bounds, int bitsPerAxis = MaxCurveBitsPerAxis<TVector>) noexcept
+	{
+		return GetHilbertIndex(GetGridCell(point, bounds, bitsPerAxis), bitsPerAxis);
+	}
+
+	// Returns the Morton curve index of a point, whose coordinates are quantized over the given bounds, see GetHilbertIndex()
+	template <class TVector>
+	[[nodiscard]] std::uint64_t GetMortonIndex(TVector const& point, Box<TVector> const& bounds, int bitsPerAxis = MaxCurveBitsPerAxis<TVector>) noexcept
+	{
+		return GetMortonIndex(GetGridCell(point, bounds, bitsPerAxis));
+	}
+
+	enum class SpaceFillingCurve
+	{
+		Morton,
+		Hilbert,
+	};
+
+	// Returns the indices of the points, ordered by the position of the points along the curve over their bounds.
+	// Fewer bits per axis make a coarser but cheaper order, points that fall in the same cell keep their relative order
+	template <class TVector>
+	[[nodiscard]] std::vector<int> GetCurveOrder(Span<TVector const> points, SpaceFillingCurve curve, int bitsPerAxis = MaxCurveBitsPerAxis<TVector>)
+	{
+		Box<TVector> bounds;
+		for (auto const& point : points)
+		{
+			bounds.Add(point);
+		}
+
+		auto const getIndex = [&bounds, curve, bitsPerAxis](TVector const& point)
+			{
+				return curve == SpaceFillingCurve::Hilbert ? GetHilbertIndex(point, bounds, bitsPerAxis) : GetMortonIndex(point, bounds, bitsPerAxis);
+			};
+
+		auto const size = int(points.size());
+		auto const keyBits = int(VectorTraits<TVector>::Dimensions) * bitsPerAxis;
+
+		// Coarse keys are few enough to be counting-sorted, which is stable and linear
+		if (keyBits <= 16)
+		{
+			std::vector<std::uint32_t> keys(size);
+			std::vector<int> offsets((size_t(1) << keyBits) + 1);
+			for (auto i = 0; i < size; ++i)
+			{
+				keys[i] = std::uint32_t(getIndex(points[i]));
+				++offsets[keys[i] + 1];
+			}
+
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+			std::vector<int> order(size);
+			for (auto i = 0; i < size; ++i)
+			{
+				order[offsets[keys[i]]++] = i;
+			}
+
+			return order;
+		}
+
+		std::vector<std::pair<std::uint64_t, int>> keys(size);
+		for (auto i = 0; i < size; ++i)
+		{
+			keys[i] = { getIndex(points[i]), i };
+		}
+
+		std::sort(keys.begin(), keys.end());
+		return Transform(keys, [](auto const& key) { return key.second; });
+	}
+
+	template <class TVector>
+	[[nodiscard]] std::vector<int> GetHilbertOrder(Span<TVector const> points, int bitsPerAxis = MaxCurveBitsPerAxis<TVector>)
+	{
+		return GetCurveOrder(points, SpaceFillingCurve::Hilbert, bitsPerAxis);
+	}
+
+	// The same order as GetCurveOrder(), computed on threadCount threads, 0 or less means one thread per hardware thread.
+	// Each thread computes the curve indices of a contiguous chunk of the points and sorts them, then the sorted chunks are merged pairwise, also in parallel.
+	// The bulk loads of the indices use this as their presort stage, it pays off from about 10^5 points
+	template <class TVector>
+	[[nodiscard]] std::vector<int> ParallelGetCurveOrder(Span<TVector const> points, SpaceFillingCurve curve, int threadCount, int bitsPerAxis = MaxCurveBitsPerAxis<TVector>)
+	{
+		// Smaller inputs are not worth starting the threads for
+		static constexpr auto MinChunkSize = 16 * 1024;
+
+		auto const size = int(points.size());
+		ThreadPool pool{ std::min(threadCount > 0 ? threadCount : ThreadPool::GetHardwareThreadCount(), std::max(1, size / MinChunkSize)) };
+		auto const chunkCount = pool.GetThreadCount();
+		if (chunkCount == 1)
+		{
+			return GetCurveOrder(points, curve, bitsPerAxis);
+		}
+
+		auto const getChunkFirst = [size, chunkCount](int chunk) { return int(std::int64_t(size) * chunk / chunkCount); };
+
+		std::vector<Box<TVector>> chunkBounds(chunkCount);
+		pool.Run([&](int chunk)
+			{
+				for (auto i = getChunkFirst(chunk), last = getChunkFirst(chunk + 1); i < last; ++i)
+				{
+					chunkBounds[chunk].Add(points[i]);
+				}
+			});
+
+		Box<TVector> bounds;
+		for (auto const& chunkBox : chunkBounds)
+		{
+			bounds.Add(chunkBox);
+		}
+
+		// The pairs are unique, so sorting them gives the same order as the stable counting sort of GetCurveOrder()
+		std::vector<std::pair<std::uint64_t, int>> keys(size);
+		pool.Run([&](int chunk)
+			{
+				auto const first = getChunkFirst(chunk);
+				auto const last = getChunkFirst(chunk + 1);
+				for (auto i = first; i < last; ++i)
+				{
+					keys[i] = { curve == SpaceFillingCurve::Hilbert ? GetHilbertIndex(points[i], bounds, bitsPerAxis) : GetMortonIndex(points[i], bounds, bitsPerAxis), i };
+				}
+
+				std::sort(keys.begin() + first, keys.begin() + last);
+			});
+
+		for (auto width = 1; width < chunkCount; width *= 2)
+		{
+			pool.ForEachIndex((chunkCount + 2 * width - 1) / (2 * width), 1, [&](int merge, int)
+				{
+					auto const low = 2 * width * merge;
+					auto const middle = std::min(low + width, chunkCount);
+					auto const high = std::min(low + 2 * width, chunkCount);
+					if (middle < high)
+					{
+						std::inplace_merge(keys.begin() + getChunkFirst(low), keys.begin() + getChunkFirst(middle), keys.begin() + getChunkFirst(high));
+					}
+				});
+		}
+
+		std::vector<int> order(size);
+		pool.Run([&](int chunk)
+			{
+				for (auto i = getChunkFirst(chunk), last = getChunkFirst(chunk + 1); i < last; ++i)
+				{
+					order[i] = keys[i].second;
+				}
+			});
+
+		return order;
+	}
+
+	// Returns the indices of the features, ordered by the position of the centers of their keys along the curve
+	template <class TSpatialKey>
+	[[nodiscard]] std::vector<int> GetSpatialKeysOrder(Span<Feature<TSpatialKey> const> features, SpaceFillingCurve curve, int bitsPerAxis = MaxCurveBitsPerAxis<typename SpatialKeyTraits<TSpatialKey>::VectorType>)
+	{
+		using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+		auto const centers = Transform(features, [](Feature<TSpatialKey> const& feature) { return SpatialKeyTraits<TSpatialKey>::GetCenter(feature.spatialKey); });
+		return GetCurveOrder(Span<VectorType const>{ centers }, curve, bitsPerAxis);
+	}
+
+	// GetSpatialKeysOrder() on threadCount threads, see ParallelGetCurveOrder()
+	template <class TSpatialKey>
+	[[nodiscard]] std::vector<int> ParallelGetSpatialKeysOrder(Span<Feature<TSpatialKey> const> features, SpaceFillingCurve curve, int threadCount, int bitsPerAxis = MaxCurveBitsPerAxis<typename SpatialKeyTraits<TSpatialKey>::VectorType>)
+	{
+		using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+		auto const centers = Transform(features, [](Feature<TSpatialKey> const& feature) { return SpatialKeyTraits<TSpatialKey>::GetCenter(feature.spatialKey); });
+		return ParallelGetCurveOrder(Span<VectorType const>{ centers }, curve, threadCount, bitsPerAxis);
+	}
+
+	// Batched queries only need to bring nearby queries together, a Hilbert order over a grid of 4096 cells does that at a fraction of the cost of the full one
+	template <class TVector>
+	constexpr int QueryBatchOrderBitsPerAxis = int(12 / VectorTraits<TVector>::Dimensions);
+
+
 	template <class TVector, class TRandomGenerator>
 	[[nodiscard]] Box<TVector> MakeRandomBox(
 		TRandomGenerator& randomGenerator,
@@ -164,59 +641,170 @@ namespace GeoToolbox
 		return std::array{ ((void)Indices, randomGenerator())... };
 	}
 
-	template <class TSpatialKey, class TRandomGenerator>
-	[[nodiscard]] std::vector<Feature<TSpatialKey>> MakeRandomSpatialKeys(
-		TRandomGenerator& randomGenerator,
-		int datasetSize,
-		Box<typename SpatialKeyTraits<TSpatialKey>::VectorType> const& boundingBox,
-		Interval<typename SpatialKeyTraits<TSpatialKey>::ScalarType> heightMinMax,
-		typename SpatialKeyTraits<TSpatialKey>::ScalarType skewPower = 0,
-		typename SpatialKeyTraits<TSpatialKey>::ScalarType averageBoxAspect = 1,
-		int islandsCount = 1)
+	// A counter-based random number generator (SplitMix64). Each (seed, stream) pair starts its own sequence in constant time, independently of all other streams,
+	// so parallel generators can give each element its own stream and produce the same result for any thread count
+	class CounterRandomGenerator
+	{
+		std::uint64_t state_;
+
+		[[nodiscard]] static constexpr std::uint64_t Mix(std::uint64_t value) noexcept
+		{
+			value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+			value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+			return value ^ (value >> 31);
+		}
+
+	public:
+
+		using result_type = std::uint64_t;
+
+		constexpr CounterRandomGenerator(std::uint64_t seed, std::uint64_t stream) noexcept
+			: state_{ Mix(seed ^ Mix(stream + 0x9E3779B97F4A7C15ull)) }
+		{
+		}
+
+		[[nodiscard]] static constexpr result_type min() noexcept
+		{
+			return 0;
+		}
+
+		[[nodiscard]] static constexpr result_type max() noexcept
+		{
+			return ~result_type{ 0 };
+		}
+
+		constexpr result_type operator()() noexcept
+		{
+			state_ += 0x9E3779B97F4A7C15ull;
+			return Mix(state_);
+		}
+	};
+
+	// Calls function(randomGenerator, index) for each index in [0, count), in parallel chunks, with a CounterRandomGenerator on stream index of the seed.
+	// Each chunk works on its own copy of the function, so it can hold random distributions. A threadCount of 0 or less means one thread per hardware thread
+	template <class TFunction>
+	void ParallelForEachRandomIndex(std::uint64_t seed, int count, TFunction const& function, int threadCount = 0)
+	{
+		constexpr auto ChunkSize = 16 * 1024;
+
+		auto const chunkCount = (count + ChunkSize - 1) / ChunkSize;
+		ThreadPool pool{ chunkCount > 1 ? threadCount : 1 };
+		pool.ForEachIndex(chunkCount, 1, [&](int chunk, int)
+			{
+				auto chunkFunction = function;
+				auto const last = std::min(count, (chunk + 1) * ChunkSize);
+				for (auto index = chunk * ChunkSize; index < last; ++index)
+				{
+					CounterRandomGenerator randomGenerator{ seed, std::uint64_t(index) };
+					chunkFunction(randomGenerator, index);
+				}
+			});
+	}
+
+	// Makes the features of MakeRandomSpatialKeys() one by one, feature index is placed in island (index % islandsCount)
+	template <class TSpatialKey>
+	class RandomSpatialKeyMaker
 	{
 		using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
 		using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
 
-		ASSERT(datasetSize > 0);
-		ASSERT(averageBoxAspect >= 1);
+		Box<VectorType> boundingBox_;
+		ScalarType skewPower_;
+		int islandsCount_;
+		VectorType islandSizes_;
+		std::uniform_real_distribution<ScalarType> positionDistribution_{ ScalarType{ 0 }, ScalarType{ 1 } };
+		std::uniform_real_distribution<ScalarType> heightDistribution_;
+		std::uniform_real_distribution<ScalarType> aspectDistribution_;
 
-		std::uniform_real_distribution positionDistribution{ ScalarType{ 0 }, ScalarType{ 1 } };
-		std::uniform_real_distribution heightDistribution{ heightMinMax.min, heightMinMax.max };
-		std::uniform_real_distribution aspectDistribution{ ScalarType{ 1 }, 2 * averageBoxAspect - 1 };
-		auto islandsIndex = 0;
+	public:
 
-		std::vector<Feature<TSpatialKey>> data{ size_t(datasetSize) };
-		islandsCount = std::max(islandsCount, 1);
-		auto const islandSizes = boundingBox.Sizes() / ScalarType(islandsCount);
-		for (auto i = 0; i < datasetSize; ++i)
+		RandomSpatialKeyMaker(Box<VectorType> const& boundingBox, Interval<ScalarType> heightMinMax, ScalarType skewPower, ScalarType averageBoxAspect, int islandsCount)
+			: boundingBox_{ boundingBox }
+			, skewPower_{ skewPower }
+			, islandsCount_{ std::max(islandsCount, 1) }
+			, islandSizes_{ boundingBox.Sizes() / ScalarType(islandsCount_) }
+			, heightDistribution_{ heightMinMax.min, heightMinMax.max }
+			, aspectDistribution_{ ScalarType{ 1 }, 2 * averageBoxAspect - 1 }
+		{
+			ASSERT(averageBoxAspect >= 1);
+		}
+
+		template <class TRandomGenerator>
+		[[nodiscard]] Feature<TSpatialKey> operator()(TRandomGenerator& randomGenerator, int index)
 		{
-			auto randomArray = MakeRandomArray([&]() { return positionDistribution(randomGenerator); }, std::make_index_sequence<VectorTraits<VectorType>::Dimensions>());
+			auto randomArray = MakeRandomArray([&]() { return positionDistribution_(randomGenerator); }, std::make_index_sequence<VectorTraits<VectorType>::Dimensions>());
 			auto randomPoint = VectorTraits<VectorType>::FromArray(randomArray);
-			if (skewPower > 1)
+			if (skewPower_ > 1)
 			{
-				randomPoint[0] = ScalarType(pow(double(randomPoint[0]), double(skewPower)));
+				randomPoint[0] = ScalarType(pow(double(randomPoint[0]), double(skewPower_)));
 			}
 
-			auto center = boundingBox.Min() + ComponentMultiply(islandSizes, randomPoint);
-			if (islandsCount > 1)
+			auto center = boundingBox_.Min() + ComponentMultiply(islandSizes_, randomPoint);
+			if (islandsCount_ > 1)
 			{
-				center += ScalarType(islandsIndex) * islandSizes;
-				islandsIndex = (islandsIndex + 1) % islandsCount;
+				center += ScalarType(index % islandsCount_) * islandSizes_;
 			}
 
 			if constexpr (SpatialKeyIsPoint<TSpatialKey>)
 			{
-				data[i] = { i, center };
+				return { index, center };
 			}
 			else
 			{
-				data[i] = { i, MakeRandomBox<VectorType>(randomGenerator, center, boundingBox, heightDistribution, aspectDistribution) };
+				return { index, MakeRandomBox<VectorType>(randomGenerator, center, boundingBox_, heightDistribution_, aspectDistribution_) };
 			}
 		}
+	};
+
+	template <class TSpatialKey, class TRandomGenerator>
+	[[nodiscard]] std::vector<Feature<TSpatialKey>> MakeRandomSpatialKeys(
+		TRandomGenerator& randomGenerator,
+		int datasetSize,
+		Box<typename SpatialKeyTraits<TSpatialKey>::VectorType> const& boundingBox,
+		Interval<typename SpatialKeyTraits<TSpatialKey>::ScalarType> heightMinMax,
+		typename SpatialKeyTraits<TSpatialKey>::ScalarType skewPower = 0,
+		typename SpatialKeyTraits<TSpatialKey>::ScalarType averageBoxAspect = 1,
+		int islandsCount = 1)
+	{
+		ASSERT(datasetSize > 0);
+
+		RandomSpatialKeyMaker<TSpatialKey> maker{ boundingBox, heightMinMax, skewPower, averageBoxAspect, islandsCount };
+		std::vector<Feature<TSpatialKey>> data{ size_t(datasetSize) };
+		for (auto i = 0; i < datasetSize; ++i)
+		{
+			data[i] = maker(randomGenerator, i);
+		}
 
 		return data;
 	}
 
+	// The same as MakeRandomSpatialKeys(), but each feature is made from its own stream of CounterRandomGenerator, in parallel.
+	// The result depends only on the seed and the parameters, not on threadCount
+	template <class TSpatialKey>
+	[[nodiscard]] std::vector<Feature<TSpatialKey>> ParallelMakeRandomSpatialKeys(
+		std::uint64_t seed,
+		int datasetSize,
+		Box<typename SpatialKeyTraits<TSpatialKey>::VectorType> const& boundingBox,
+		Interval<typename SpatialKeyTraits<TSpatialKey>::ScalarType> heightMinMax,
+		typename SpatialKeyTraits<TSpatialKey>::ScalarType skewPower = 0,
+		typename SpatialKeyTraits<TSpatialKey>::ScalarType averageBoxAspect = 1,
+		int islandsCount = 1,
+		int threadCount = 0)
+	{
+		ASSERT(datasetSize > 0);
+
+		std::vector<Feature<TSpatialKey>> data{ size_t(datasetSize) };
+		ParallelForEachRandomIndex(
+			seed,
+			datasetSize,
+			[&data, maker = RandomSpatialKeyMaker<TSpatialKey>{ boundingBox, heightMinMax, skewPower, averageBoxAspect, islandsCount }](CounterRandomGenerator& randomGenerator, int index) mutable
+			{
+				data[index] = maker(randomGenerator, index);
+			},
+			threadCount);
+		return data;
+	}
+
 	// Generates query boxes in a grid over a provided box extent. The first and last row/column in the grid are outside the extent. Query sizes are cycled over a provided list.
 	template <class TVector>
 	class QueryIterator
@@ -340,9 +928,216 @@ namespace GeoToolbox
 	};
 
 
+	// Generates query boxes with the skew and temporal locality of real workloads, to complement the uniform grid of QueryIterator.
+	// The queries start at the centers of random features, their sizes cycle over the provided list like those of QueryIterator.
+	// The same seed gives the same queries
+	template <class TSpatialKey>
+	class QueryWorkloadMaker
+	{
+		using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
+		using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+		using BoxType = Box<VectorType>;
+
+		static constexpr auto Dimensions = int(VectorTraits<VectorType>::Dimensions);
+
+
+		Span<Feature<TSpatialKey> const> features_;
+		BoxType bounds_;
+		std::vector<ScalarType> sizes_;
+		std::mt19937_64 randomGenerator_;
+
+	public:
+
+		QueryWorkloadMaker(std::uint64_t seed, Span<Feature<TSpatialKey> const> features, BoxType const& bounds, std::vector<ScalarType> sizes)
+			: features_{ features }
+			, bounds_{ bounds }
+			, sizes_{ std::move(sizes) }
+			, randomGenerator_{ seed }
+		{
+			ASSERT(!features_.empty() && !sizes_.empty());
+		}
+
+		// Queries around hotspotCount hot spots at random features, the hot spot of rank r is picked with a probability proportional to 1 / (r + 1)^exponent
+		// and the query is scattered around it by about the largest query size
+		[[nodiscard]] std::vector<BoxType> MakeZipfHotspots(int queryCount, int hotspotCount = 64, double exponent = 1)
+		{
+			std::vector<VectorType> hotspots;
+			std::vector<double> weights;
+			for (auto rank = 0; rank < std::max(hotspotCount, 1); ++rank)
+			{
+				hotspots.push_back(GetRandomFeatureCenter());
+				weights.push_back(1 / std::pow(rank + 1.0, exponent));
+			}
+
+			std::discrete_distribution<int> hotspotDistribution{ weights.begin(), weights.end() };
+			std::normal_distribution<ScalarType> scatterDistribution{ 0, sizes_.back() };
+			std::vector<BoxType> result;
+			result.reserve(queryCount);
+			for (auto i = 0; i < queryCount; ++i)
+			{
+				auto center = hotspots[hotspotDistribution(randomGenerator_)];
+				for (auto dim = 0; dim < Dimensions; ++dim)
+				{
+					center[dim] += scatterDistribution(randomGenerator_);
+				}
+
+				result.push_back(MakeQuery(center, sizes_[i % sizes_.size()]));
+			}
+
+			return result;
+		}
+
+		// Trajectories of walkCount moving objects, like vehicles, each one a run of consecutive queries of the same size. Each step moves by half the query size
+		// in a direction that turns slightly from the previous one, and reflects at the bounds
+		[[nodiscard]] std::vector<BoxType> MakeRandomWalks(int queryCount, int walkCount = 16)
+		{
+			walkCount = std::clamp(walkCount, 1, std::max(queryCount, 1));
+			std::normal_distribution<ScalarType> turnDistribution{ 0, ScalarType(0.25) };
+			std::vector<BoxType> result;
+			result.reserve(queryCount);
+			for (auto walk = 0; walk < walkCount; ++walk)
+			{
+				auto const size = sizes_[walk % sizes_.size()];
+				auto location = GetRandomFeatureCenter();
+				auto direction = GetRandomDirection();
+				for (auto step = walk * queryCount / walkCount; step < (walk + 1) * queryCount / walkCount; ++step)
+				{
+					result.push_back(MakeQuery(location, size));
+					for (auto dim = 0; dim < Dimensions; ++dim)
+					{
+						direction[dim] += turnDistribution(randomGenerator_);
+					}
+
+					direction = Normalized(direction);
+					location = Reflect(location + direction * (size / 2), direction);
+				}
+			}
+
+			return result;
+		}
+
+		// Map viewing sessions of sessionCount users, each one a run of consecutive views that pan by a quarter of the view size, zoom in or zoom out twice,
+		// starting at a random query size and staying between the smallest one and 4 times the largest one
+		[[nodiscard]] std::vector<BoxType> MakePanZoomSessions(int queryCount, int sessionCount = 16)
+		{
+			sessionCount = std::clamp(sessionCount, 1, std::max(queryCount, 1));
+			auto const minSize = *std::min_element(sizes_.begin(), sizes_.end());
+			auto const maxSize = 4 * *std::max_element(sizes_.begin(), sizes_.end());
+			std::uniform_int_distribution<int> actionDistribution{ 0, 7 };
+			std::vector<BoxType> result;
+			result.reserve(queryCount);
+			for (auto session = 0; session < sessionCount; ++session)
+			{
+				auto size = sizes_[session % sizes_.size()];
+				auto location = GetRandomFeatureCenter();
+				for (auto view = session * queryCount / sessionCount; view < (session + 1) * queryCount / sessionCount; ++view)
+				{
+					result.push_back(MakeQuery(location, size));
+
+					// Mostly pans, a zoom in or out once in 4 views
+					auto const action = actionDistribution(randomGenerator_);
+					if (action == 0)
+					{
+						size = std::max(minSize, size / 2);
+					}
+					else if (action == 1)
+					{
+						size = std::min(maxSize, size * 2);
+					}
+					else
+					{
+						auto direction = GetRandomDirection();
+						location = Reflect(location + direction * (size / 4), direction);
+					}
+				}
+			}
+
+			return result;
+		}
+
+		// Queries centered on random features, so that their density follows the data and no query falls in the empty space
+		[[nodiscard]] std::vector<BoxType> MakeDataDistributed(int queryCount)
+		{
+			std::vector<BoxType> result;
+			result.reserve(queryCount);
+			for (auto i = 0; i < queryCount; ++i)
+			{
+				result.push_back(MakeQuery(GetRandomFeatureCenter(), sizes_[i % sizes_.size()]));
+			}
+
+			return result;
+		}
+
+	private:
+
+		[[nodiscard]] VectorType GetRandomFeatureCenter()
+		{
+			std::uniform_int_distribution<std::ptrdiff_t> featureDistribution{ 0, features_.size() - 1 };
+			return SpatialKeyTraits<TSpatialKey>::GetCenter(features_[featureDistribution(randomGenerator_)].spatialKey);
+		}
+
+		[[nodiscard]] VectorType GetRandomDirection()
+		{
+			std::normal_distribution<ScalarType> distribution{ 0, 1 };
+			VectorType result;
+			for (auto dim = 0; dim < Dimensions; ++dim)
+			{
+				result[dim] = distribution(randomGenerator_);
+			}
+
+			return Normalized(result);
+		}
+
+		[[nodiscard]] static VectorType Normalized(VectorType vector)
+		{
+			ScalarType lengthSquared = 0;
+			for (auto dim = 0; dim < Dimensions; ++dim)
+			{
+				lengthSquared += vector[dim] * vector[dim];
+			}
+
+			if (!(lengthSquared > 0))
+			{
+				vector = Flat<VectorType>(0);
+				vector[0] = 1;
+				return vector;
+			}
+
+			return vector / ScalarType(std::sqrt(lengthSquared));
+		}
+
+		// Mirrors the location back into the bounds and turns the direction away from the crossed sides
+		[[nodiscard]] VectorType Reflect(VectorType location, VectorType& direction) const
+		{
+			for (auto dim = 0; dim < Dimensions; ++dim)
+			{
+				if (location[dim] < bounds_.Min()[dim])
+				{
+					location[dim] = std::min(2 * bounds_.Min()[dim] - location[dim], bounds_.Max()[dim]);
+					direction[dim] = std::abs(direction[dim]);
+				}
+				else if (location[dim] > bounds_.Max()[dim])
+				{
+					location[dim] = std::max(2 * bounds_.Max()[dim] - location[dim], bounds_.Min()[dim]);
+					direction[dim] = -std::abs(direction[dim]);
+				}
+			}
+
+			return location;
+		}
+
+		[[nodiscard]] static BoxType MakeQuery(VectorType const& center, ScalarType size)
+		{
+			return BoxType::FromCenterAndSize(center, size);
+		}
+	};
+
+
 #define ENABLE_QUERYSTATS
 
-	extern struct QueryStats
+	// Counters of the work done by queries, to compare indices by more than their timings. The AddQueryStats_ hooks,
+	// patched also into some of the tested libraries, update a block of counters owned by the calling thread, see QueryStatsRegistry
+	struct QueryStats
 	{
 		using CounterType = int64_t;
 
@@ -394,7 +1189,7 @@ namespace GeoToolbox
 			stream << "Comp:" << ScalarComparisonsCount / count << " BoxComp:" << BoxOverlapsCount / count << " ObjTest:" << ObjectTestsCount / count << " Nodes:" << VisitedNodesCount / count;
 			return stream.str();
 		}
-	} TheQueryStats;
+	};
 
 	inline std::ostream& operator<<(std::ostream& stream, QueryStats const& stats)
 	{
@@ -441,24 +1236,154 @@ namespace GeoToolbox
 		QueryCount = 0;
 	}
 
+	// Owns one block of query counters per thread, each on its own cache lines, so that the hooks update them without locks or false sharing.
+	// A block outlives its thread and is reused by the next thread that starts counting, so the counts of finished threads are not lost.
+	// Collect() and Clear() lock only the registry, and must be called while no other thread is counting, e.g. after joining the query threads.
+	class QueryStatsRegistry
+	{
+		struct alignas(CacheLineSize) Block
+		{
+			QueryStats stats;
+			bool inUse = false;
+		};
+
+		std::mutex mutex_;
+		std::vector<std::unique_ptr<Block>> blocks_;
+
+		QueryStatsRegistry() = default;
+
+	public:
+
+		// Releases the block of the thread when the thread exits
+		class ThreadHandle
+		{
+			Block* block_;
+
+		public:
+
+			ThreadHandle()
+				: block_{ GetInstance().Acquire() }
+			{
+			}
+
+			ThreadHandle(ThreadHandle const&) = delete;
+			ThreadHandle& operator=(ThreadHandle const&) = delete;
+
+			~ThreadHandle()
+			{
+				GetInstance().Release(block_);
+			}
+
+			[[nodiscard]] QueryStats& GetStats() const noexcept
+			{
+				return block_->stats;
+			}
+		};
+
+		[[nodiscard]] static QueryStatsRegistry& GetInstance()
+		{
+			static QueryStatsRegistry instance;
+			return instance;
+		}
+
+		// Returns the sum of the counters of all threads since the last Clear(), over the queryCount queries that DebugPrint() averages them by
+		[[nodiscard]] QueryStats Collect(int queryCount)
+		{
+			std::lock_guard lock{ mutex_ };
+			QueryStats result;
+			result.QueryCount = queryCount;
+			for (auto const& block : blocks_)
+			{
+				result.ScalarComparisonsCount += block->stats.ScalarComparisonsCount;
+				result.BoxOverlapsCount += block->stats.BoxOverlapsCount;
+				result.ObjectTestsCount += block->stats.ObjectTestsCount;
+				result.VisitedNodesCount += block->stats.VisitedNodesCount;
+			}
+
+			return result;
+		}
+
+		void Clear()
+		{
+			std::lock_guard lock{ mutex_ };
+			for (auto const& block : blocks_)
+			{
+				block->stats.Clear();
+			}
+		}
+
+	private:
+
+		Block* Acquire()
+		{
+			std::lock_guard lock{ mutex_ };
+			for (auto const& block : blocks_)
+			{
+				if (!block->inUse)
+				{
+					block->inUse = true;
+					return block.get();
+				}
+			}
+
+			auto& block = blocks_.emplace_back(std::make_unique<Block>());
+			block->inUse = true;
+			return block.get();
+		}
+
+		void Release(Block* block)
+		{
+			std::lock_guard lock{ mutex_ };
+			block->inUse = false;
+		}
+	};
+
+	// The counters of the calling thread
+	inline QueryStats& GetThreadQueryStats()
+	{
+		thread_local QueryStatsRegistry::ThreadHandle const handle;
+		return handle.GetStats();
+	}
+
+	inline QueryStats CollectQueryStats(int queryCount = 0)
+	{
+		return QueryStatsRegistry::GetInstance().Collect(queryCount);
+	}
+
+	inline void ClearQueryStats()
+	{
+		QueryStatsRegistry::GetInstance().Clear();
+	}
+
 	inline void AddQueryStats_ScalarComparisonsCount()
 	{
-		++TheQueryStats.ScalarComparisonsCount;
+		++GetThreadQueryStats().ScalarComparisonsCount;
 	}
 
 	inline void AddQueryStats_BoxOverlapsCount()
 	{
-		++TheQueryStats.BoxOverlapsCount;
+		++GetThreadQueryStats().BoxOverlapsCount;
 	}
 
 	inline void AddQueryStats_ObjectTestsCount()
 	{
-		++TheQueryStats.ObjectTestsCount;
+		++GetThreadQueryStats().ObjectTestsCount;
+	}
+
+	// Used by batched tests
+	inline void AddQueryStats_BoxOverlapsCount(QueryStats::CounterType count)
+	{
+		GetThreadQueryStats().BoxOverlapsCount += count;
+	}
+
+	inline void AddQueryStats_ObjectTestsCount(QueryStats::CounterType count)
+	{
+		GetThreadQueryStats().ObjectTestsCount += count;
 	}
 
 	inline void AddQueryStats_VisitedNodesCount()
 	{
-		++TheQueryStats.VisitedNodesCount;
+		++GetThreadQueryStats().VisitedNodesCount;
 	}
 #else
 
@@ -471,6 +1396,15 @@ namespace GeoToolbox
 	{
 	}
 
+	inline QueryStats CollectQueryStats(int /*queryCount*/ = 0)
+	{
+		return {};
+	}
+
+	inline void ClearQueryStats()
+	{
+	}
+
 	inline void AddQueryStats_ScalarComparisonsCount()
 	{
 	}
@@ -483,6 +1417,14 @@ namespace GeoToolbox
 	{
 	}
 
+	inline void AddQueryStats_BoxOverlapsCount(QueryStats::CounterType)
+	{
+	}
+
+	inline void AddQueryStats_ObjectTestsCount(QueryStats::CounterType)
+	{
+	}
+
 	inline void AddQueryStats_VisitedNodesCount()
 	{
 	}
@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <charconv>
 #include <cstdint>
 #include <execution>
@@ -19,8 +20,17 @@
 #include <unordered_set>
 #include <vector>
 
+#if defined( _MSC_VER )
+#	include <intrin.h>
+#endif
+
 namespace GeoToolbox
 {
+	// Data written by different threads should be kept this far apart to avoid false sharing.
+	// std::hardware_destructive_interference_size is not available everywhere, and 64 holds for all current x64 and most ARM CPUs.
+	constexpr std::size_t CacheLineSize = 64;
+
+
 	// Traits
 
 	struct Identity
@@ -60,6 +70,36 @@ namespace GeoToolbox
 		return x * x;
 	}
 
+	// std::popcount and std::countr_zero are C++20
+	[[nodiscard]] inline int PopCount(std::uint64_t bits) noexcept
+	{
+		return int(std::bitset<64>(bits).count());
+	}
+
+	// The result is undefined if bits is 0
+	[[nodiscard]] inline int CountTrailingZeros(std::uint64_t bits) noexcept
+	{
+#if defined( _MSC_VER ) && !defined( __clang__ )
+		unsigned long index = 0;
+		_BitScanForward64(&index, bits);
+		return int(index);
+#else
+		return __builtin_ctzll(bits);
+#endif
+	}
+
+	// The result is undefined if bits is 0
+	[[nodiscard]] inline int CountLeadingZeros(std::uint64_t bits) noexcept
+	{
+#if defined( _MSC_VER ) && !defined( __clang__ )
+		unsigned long index = 0;
+		_BitScanReverse64(&index, bits);
+		return 63 - int(index);
+#else
+		return __builtin_clzll(bits);
+#endif
+	}
+
 	template <class TContainer, typename T>
 	[[nodiscard]] constexpr auto Find(TContainer& container, T const& value)
 	{
@@ -7,6 +7,15 @@
 
 #include "GeoToolbox/Image.hpp"
 #include "GeoToolbox/SpatialTools.hpp"
+#include "GeoToolbox/ThreadPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <vector>
 
 namespace GeoToolbox
 {
@@ -37,4 +46,220 @@ namespace GeoToolbox
 			}
 		}
 	}
+
+	enum class DrawMode
+	{
+		// The outline of each box, or the pixel of each point, in black
+		Outline,
+
+		// The count of the keys over each pixel, log-scaled to a heat palette from pale yellow for one key to dark red for the most
+		Density
+	};
+
+	// The heat palette of the Density mode, density is in [0, 1]
+	[[nodiscard]] inline Color GetDensityColor(double density) noexcept
+	{
+		static constexpr std::array<std::array<double, 3>, 3> Stops{ { { 255, 240, 160 }, { 240, 60, 20 }, { 60, 0, 40 } } };
+
+		auto const t = std::clamp(density, 0.0, 1.0) * double(Stops.size() - 1);
+		auto const stop = std::min(int(t), int(Stops.size()) - 2);
+		auto const fraction = t - stop;
+		Color result = 0;
+		for (auto channel = 0; channel < 3; ++channel)
+		{
+			auto const from = Stops[stop][channel];
+			auto const to = Stops[stop + 1][channel];
+			result |= Color(std::lround(from + (to - from) * fraction)) << (8 * channel);
+		}
+
+		return result;
+	}
+
+	// Draws all the keys, without the sampling of DrawSpatialKeys(), on threadCount threads (0 or less for one per hardware thread).
+	// The image is split into tiles of TileSize pixels. The threads first sort the keys by the tiles they draw into, then each thread draws whole tiles
+	// into a small layer of its own and copies it to the counts of the image, so that the memory does not grow with the count of threads.
+	// In the Density mode a key adds 1 to the corners of its pixel rectangle in a difference layer, that is summed up into the counts by rows and columns,
+	// so that a key costs the same for any size in each tile it covers. In the Outline mode a box costs its perimeter in pixels and is sorted only to the tiles of its edges
+	template <typename TSpatialKey>
+	void ParallelDrawSpatialKeys(Image& image, Span<Feature<TSpatialKey> const> features, Box2 const& boundingBox, DrawMode mode, int threadCount = 0)
+	{
+		static_assert(SpatialKeyTraits<TSpatialKey>::Dimensions == 2);
+
+		static constexpr auto TileSize = 64;
+
+		static constexpr auto KeysPerChunk = 16 * 1024;
+
+		static constexpr auto RowsPerChunk = 16;
+
+		// The pixel rectangle of a key, its edges may be outside of the image
+		struct PixelRectangle
+		{
+			int left;
+			int top;
+			int right;
+			int bottom;
+		};
+
+		auto const width = image.GetWidth();
+		auto const height = image.GetHeight();
+		auto const tilesX = (width + TileSize - 1) / TileSize;
+		auto const tilesY = (height + TileSize - 1) / TileSize;
+		auto const chunkCount = int((features.size() + KeysPerChunk - 1) / KeysPerChunk);
+		ThreadPool pool{ std::max(threadCount > 0 ? threadCount : ThreadPool::GetHardwareThreadCount(), 1) };
+
+		auto const scaleX = boundingBox.Max()[0] > boundingBox.Min()[0] ? double(width - 1) / (boundingBox.Max()[0] - boundingBox.Min()[0]) : 0.0;
+		auto const scaleY = boundingBox.Max()[1] > boundingBox.Min()[1] ? double(height - 1) / (boundingBox.Max()[1] - boundingBox.Min()[1]) : 0.0;
+		auto const toPixel = [&](auto const& point)
+			{
+				return std::array{
+					int(std::lround((double(point[0]) - boundingBox.Min()[0]) * scaleX)),
+					int(std::lround(double(height - 1) - (double(point[1]) - boundingBox.Min()[1]) * scaleY)) };
+			};
+
+		auto const getRectangle = [&](std::size_t keyIndex)
+			{
+				auto const& key = features[keyIndex].spatialKey;
+				std::array<int, 2> corner0;
+				std::array<int, 2> corner1;
+				if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+				{
+					corner0 = corner1 = toPixel(key);
+				}
+				else
+				{
+					corner0 = toPixel(key.Min());
+					corner1 = toPixel(key.Max());
+				}
+
+				return PixelRectangle{ std::min(corner0[0], corner1[0]), std::min(corner0[1], corner1[1]), std::max(corner0[0], corner1[0]), std::max(corner0[1], corner1[1]) };
+			};
+
+		// The indices of the keys drawn into each tile, sorted by each thread on its own
+		std::vector<std::vector<std::vector<int>>> tileKeys(std::size_t(pool.GetThreadCount()), std::vector<std::vector<int>>(std::size_t(tilesX) * std::size_t(tilesY)));
+		pool.ForEachIndex(chunkCount, 1, [&](int chunk, int threadIndex)
+			{
+				auto& keys = tileKeys[threadIndex];
+				auto const end = std::min(std::size_t(chunk + 1) * KeysPerChunk, std::size_t(features.size()));
+				for (auto i = std::size_t(chunk) * KeysPerChunk; i < end; ++i)
+				{
+					auto const rectangle = getRectangle(i);
+					if (rectangle.right < 0 || rectangle.left > width - 1 || rectangle.bottom < 0 || rectangle.top > height - 1)
+					{
+						continue;
+					}
+
+					auto const firstTileX = std::max(rectangle.left, 0) / TileSize;
+					auto const lastTileX = std::min(rectangle.right, width - 1) / TileSize;
+					auto const firstTileY = std::max(rectangle.top, 0) / TileSize;
+					auto const lastTileY = std::min(rectangle.bottom, height - 1) / TileSize;
+					for (auto tileY = firstTileY; tileY <= lastTileY; ++tileY)
+					{
+						for (auto tileX = firstTileX; tileX <= lastTileX; ++tileX)
+						{
+							// The tiles inside of an outline are not drawn into
+							if (mode == DrawMode::Outline && tileX * TileSize > rectangle.left && (tileX + 1) * TileSize - 1 < rectangle.right
+								&& tileY * TileSize > rectangle.top && (tileY + 1) * TileSize - 1 < rectangle.bottom)
+							{
+								continue;
+							}
+
+							keys[std::size_t(tileY) * tilesX + tileX].push_back(int(i));
+						}
+					}
+				}
+			});
+
+		// One more row and column of the difference layers take the ends of the rectangles at the right and bottom edges of the tile
+		static constexpr auto LayerSize = TileSize + 1;
+		std::vector<std::vector<std::int32_t>> layers(std::size_t(pool.GetThreadCount()), std::vector<std::int32_t>(std::size_t(LayerSize) * LayerSize));
+		std::vector<std::int32_t> counts(std::size_t(width) * std::size_t(height));
+		pool.ForEachIndex(tilesX * tilesY, 1, [&](int tile, int threadIndex)
+			{
+				auto& layer = layers[threadIndex];
+				std::fill(layer.begin(), layer.end(), 0);
+				auto const tileLeft = (tile % tilesX) * TileSize;
+				auto const tileTop = (tile / tilesX) * TileSize;
+				auto const tileWidth = std::min(TileSize, width - tileLeft);
+				auto const tileHeight = std::min(TileSize, height - tileTop);
+				for (auto const& keys : tileKeys)
+				{
+					for (auto const keyIndex : keys[tile])
+					{
+						// In the coordinates of the tile
+						auto const rectangle = getRectangle(std::size_t(keyIndex));
+						auto const left = rectangle.left - tileLeft;
+						auto const right = rectangle.right - tileLeft;
+						auto const top = rectangle.top - tileTop;
+						auto const bottom = rectangle.bottom - tileTop;
+						auto const clippedLeft = std::max(left, 0);
+						auto const clippedRight = std::min(right, tileWidth - 1);
+						auto const clippedTop = std::max(top, 0);
+						auto const clippedBottom = std::min(bottom, tileHeight - 1);
+						if (mode == DrawMode::Density)
+						{
+							++layer[std::size_t(clippedTop) * LayerSize + clippedLeft];
+							--layer[std::size_t(clippedTop) * LayerSize + clippedRight + 1];
+							--layer[std::size_t(clippedBottom + 1) * LayerSize + clippedLeft];
+							++layer[std::size_t(clippedBottom + 1) * LayerSize + clippedRight + 1];
+							continue;
+						}
+
+						// Only the edges inside the tile
+						for (auto const y : { top, bottom })
+						{
+							if (y >= 0 && y <= tileHeight - 1)
+							{
+								std::fill_n(layer.begin() + std::ptrdiff_t(std::size_t(y) * LayerSize + clippedLeft), clippedRight - clippedLeft + 1, 1);
+							}
+						}
+
+						for (auto const x : { left, right })
+						{
+							if (x >= 0 && x <= tileWidth - 1)
+							{
+								for (auto y = clippedTop; y <= clippedBottom; ++y)
+								{
+									layer[std::size_t(y) * LayerSize + x] = 1;
+								}
+							}
+						}
+					}
+				}
+
+				for (auto y = 0; y < tileHeight; ++y)
+				{
+					auto const rowBegin = layer.begin() + std::ptrdiff_t(std::size_t(y) * LayerSize);
+					if (mode == DrawMode::Density)
+					{
+						std::partial_sum(rowBegin, rowBegin + tileWidth, rowBegin);
+						if (y > 0)
+						{
+							std::transform(rowBegin, rowBegin + tileWidth, rowBegin - LayerSize, rowBegin, std::plus<>{});
+						}
+					}
+
+					std::copy_n(rowBegin, tileWidth, counts.begin() + std::ptrdiff_t(std::size_t(tileTop + y) * width + tileLeft));
+				}
+			});
+
+		auto const maxCount = mode == DrawMode::Density && !counts.empty() ? std::max(1, *std::max_element(counts.begin(), counts.end())) : 1;
+		auto const logMaxCount = std::log1p(double(maxCount));
+		auto& pixels = image.GetData();
+		pool.ForEachIndex(height, RowsPerChunk, [&](int row, int)
+			{
+				for (auto x = 0; x < width; ++x)
+				{
+					auto const count = counts[std::size_t(row) * width + x];
+					auto& pixel = pixels[std::size_t(row) * width + x];
+					if (count <= 0)
+					{
+						pixel = White;
+					}
+					else
+					{
+						pixel = mode == DrawMode::Density ? GetDensityColor(std::log1p(double(count)) / logMaxCount) : Black;
+					}
+				}
+			});
+	}
 }
@@ -0,0 +1,184 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "GeoToolbox/Asserts.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GeoToolbox
+{
+	// A fixed set of threads that run the same function in parallel and wait for each other to finish (fork-join).
+	// The calling thread takes part in each run as thread 0, so a pool of N threads starts N - 1 workers that sleep between runs.
+	class ThreadPool
+	{
+		std::vector<std::thread> workers_;
+
+		std::mutex mutex_;
+		std::condition_variable startCondition_;
+		std::condition_variable doneCondition_;
+
+		void (*invoke_)(void* function, int threadIndex) = nullptr;
+		void* function_ = nullptr;
+
+		std::uint64_t generation_ = 0;
+		int runningCount_ = 0;
+		bool stopping_ = false;
+		std::exception_ptr exception_;
+
+	public:
+
+		[[nodiscard]] static int GetHardwareThreadCount() noexcept
+		{
+			return std::max(1, int(std::thread::hardware_concurrency()));
+		}
+
+		// A threadCount of 0 or less means one thread per hardware thread
+		explicit ThreadPool(int threadCount = 0)
+		{
+			if (threadCount <= 0)
+			{
+				threadCount = GetHardwareThreadCount();
+			}
+
+			workers_.reserve(threadCount - 1);
+			for (auto i = 1; i < threadCount; ++i)
+			{
+				workers_.emplace_back([this, i] { WorkerLoop(i); });
+			}
+		}
+
+		ThreadPool(ThreadPool const&) = delete;
+		ThreadPool(ThreadPool&&) = delete;
+		ThreadPool& operator=(ThreadPool const&) = delete;
+		ThreadPool& operator=(ThreadPool&&) = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard lock{ mutex_ };
+				stopping_ = true;
+			}
+
+			startCondition_.notify_all();
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+		}
+
+		[[nodiscard]] int GetThreadCount() const noexcept
+		{
+			return int(workers_.size()) + 1;
+		}
+
+		// Calls function(threadIndex) once on each thread, in parallel, and returns when all calls have returned.
+		// If any of the calls throws, the first exception is rethrown here.
+		template <class TFunction>
+		void Run(TFunction&& function)
+		{
+			using FunctionType = std::remove_reference_t<TFunction>;
+
+			{
+				std::lock_guard lock{ mutex_ };
+				DEBUG_ASSERT(runningCount_ == 0);
+				invoke_ = [](void* f, int threadIndex) { (*static_cast<FunctionType*>(f))(threadIndex); };
+				function_ = const_cast<void*>(static_cast<void const*>(&function));
+				runningCount_ = int(workers_.size());
+				exception_ = nullptr;
+				++generation_;
+			}
+
+			startCondition_.notify_all();
+
+			Invoke(0);
+
+			std::unique_lock lock{ mutex_ };
+			doneCondition_.wait(lock, [this] { return runningCount_ == 0; });
+			if (exception_ != nullptr)
+			{
+				std::rethrow_exception(std::exchange(exception_, nullptr));
+			}
+		}
+
+		// Calls function(index, threadIndex) for each index in [0, count), the threads take chunks of chunkSize consecutive indices until all are taken
+		template <class TFunction>
+		void ForEachIndex(int count, int chunkSize, TFunction&& function)
+		{
+			DEBUG_ASSERT(chunkSize > 0);
+
+			std::atomic<int> nextIndex{ 0 };
+			Run([&](int threadIndex)
+				{
+					for (auto first = nextIndex.fetch_add(chunkSize, std::memory_order_relaxed); first < count; first = nextIndex.fetch_add(chunkSize, std::memory_order_relaxed))
+					{
+						auto const last = std::min(first + chunkSize, count);
+						for (auto index = first; index < last; ++index)
+						{
+							function(index, threadIndex);
+						}
+					}
+				});
+		}
+
+	private:
+
+		void Invoke(int threadIndex) noexcept
+		{
+			try
+			{
+				invoke_(function_, threadIndex);
+			}
+			catch (...)
+			{
+				std::lock_guard lock{ mutex_ };
+				if (exception_ == nullptr)
+				{
+					exception_ = std::current_exception();
+				}
+			}
+		}
+
+		void WorkerLoop(int threadIndex)
+		{
+			std::uint64_t lastGeneration = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock lock{ mutex_ };
+					startCondition_.wait(lock, [this, lastGeneration] { return stopping_ || generation_ != lastGeneration; });
+					if (stopping_)
+					{
+						return;
+					}
+
+					lastGeneration = generation_;
+				}
+
+				Invoke(threadIndex);
+
+				{
+					std::lock_guard lock{ mutex_ };
+					if (--runningCount_ > 0)
+					{
+						continue;
+					}
+				}
+
+				doneCondition_.notify_one();
+			}
+		}
+	};
+}
@@ -110,12 +110,3 @@ namespace GeoToolbox
 		return fallback;
 	}
 }
-
-
-// TODO: Move
-#include "GeoToolbox/SpatialTools.hpp"
-
-namespace GeoToolbox
-{
-	QueryStats TheQueryStats{};
-}
@@ -0,0 +1,170 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "GeoToolbox/HardwareCounters.hpp"
+
+#if defined( _WIN32 )
+#	define NOMINMAX
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#elif defined( __linux__ )
+#	include <linux/perf_event.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+namespace GeoToolbox
+{
+#if defined( _WIN32 )
+
+	// Only the cycles are counted, no handles are needed
+	HardwareCounters::HardwareCounters() = default;
+
+	HardwareCounters::~HardwareCounters() = default;
+
+	bool HardwareCounters::IsAvailable() const noexcept
+	{
+		return true;
+	}
+
+	bool HardwareCounters::IsAvailable(Counter counter) const noexcept
+	{
+		return counter == Cycles;
+	}
+
+	HardwareCounters::Values HardwareCounters::Read() const noexcept
+	{
+		Values result{};
+		ULONG64 cycles = 0;
+		if (QueryThreadCycleTime(GetCurrentThread(), &cycles))
+		{
+			result[Cycles] = std::int64_t(cycles);
+		}
+
+		return result;
+	}
+
+#elif defined( __linux__ )
+
+	namespace
+	{
+		constexpr std::uint64_t CacheMissConfig(std::uint64_t cache)
+		{
+			return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		}
+
+		struct EventConfig
+		{
+			std::uint32_t type;
+			std::uint64_t config;
+		};
+
+		constexpr std::array<EventConfig, HardwareCounters::CounterCount> Events =
+		{ {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HW_CACHE, CacheMissConfig(PERF_COUNT_HW_CACHE_L1D) },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_HW_CACHE, CacheMissConfig(PERF_COUNT_HW_CACHE_DTLB) },
+		} };
+
+		// The value, followed by the times enabled and running, for the scaling of multiplexed counters
+		struct ReadFormat
+		{
+			std::uint64_t value;
+			std::uint64_t timeEnabled;
+			std::uint64_t timeRunning;
+		};
+	}
+
+	HardwareCounters::HardwareCounters()
+	{
+		for (auto i = 0; i < CounterCount; ++i)
+		{
+			perf_event_attr attributes{};
+			attributes.size = sizeof(attributes);
+			attributes.type = Events[i].type;
+			attributes.config = Events[i].config;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			// The calling thread, on any CPU
+			handles_[i] = std::intptr_t(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+		}
+	}
+
+	HardwareCounters::~HardwareCounters()
+	{
+		for (auto const handle : handles_)
+		{
+			if (handle >= 0)
+			{
+				close(int(handle));
+			}
+		}
+	}
+
+	bool HardwareCounters::IsAvailable() const noexcept
+	{
+		for (auto i = 0; i < CounterCount; ++i)
+		{
+			if (IsAvailable(Counter(i)))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool HardwareCounters::IsAvailable(Counter counter) const noexcept
+	{
+		return handles_[counter] >= 0;
+	}
+
+	HardwareCounters::Values HardwareCounters::Read() const noexcept
+	{
+		Values result{};
+		for (auto i = 0; i < CounterCount; ++i)
+		{
+			ReadFormat data{};
+			if (handles_[i] < 0 || read(int(handles_[i]), &data, sizeof(data)) != sizeof(data) || data.timeRunning == 0)
+			{
+				continue;
+			}
+
+			result[i] = data.timeRunning < data.timeEnabled
+				? std::int64_t(double(data.value) * double(data.timeEnabled) / double(data.timeRunning))
+				: std::int64_t(data.value);
+		}
+
+		return result;
+	}
+
+#else
+
+	HardwareCounters::HardwareCounters() = default;
+
+	HardwareCounters::~HardwareCounters() = default;
+
+	bool HardwareCounters::IsAvailable() const noexcept
+	{
+		return false;
+	}
+
+	bool HardwareCounters::IsAvailable(Counter) const noexcept
+	{
+		return false;
+	}
+
+	HardwareCounters::Values HardwareCounters::Read() const noexcept
+	{
+		return {};
+	}
+
+#endif
+}
@@ -0,0 +1,177 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "GeoToolbox/MappedFile.hpp"
+
+#if defined( _WIN32 )
+#	define NOMINMAX
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#	include <Psapi.h>
+#else
+#	include <array>
+#	include <cstdio>
+#	include <cstring>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/resource.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace GeoToolbox
+{
+#if defined( _WIN32 )
+
+	MappedFile::MappedFile(std::filesystem::path const& filePath)
+	{
+		auto const file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		fileHandle_ = file;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			return;
+		}
+
+		mappingHandle_ = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle_ == nullptr)
+		{
+			return;
+		}
+
+		data_ = static_cast<std::byte const*>(MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0));
+		if (data_ != nullptr)
+		{
+			size_ = std::size_t(size.QuadPart);
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data_ != nullptr)
+		{
+			UnmapViewOfFile(data_);
+		}
+
+		if (mappingHandle_ != nullptr)
+		{
+			CloseHandle(mappingHandle_);
+		}
+
+		if (fileHandle_ != nullptr)
+		{
+			CloseHandle(fileHandle_);
+		}
+	}
+
+	bool MappedFile::DropCachedPages(std::filesystem::path const& /*filePath*/) noexcept
+	{
+		return false;
+	}
+
+	std::int64_t GetPageFaultCount() noexcept
+	{
+		// K32GetProcessMemoryInfo() is in kernel32, no need to link psapi
+		PROCESS_MEMORY_COUNTERS counters{};
+		return K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? std::int64_t(counters.PageFaultCount) : 0;
+	}
+
+	IoByteCounts GetIoByteCounts() noexcept
+	{
+		IO_COUNTERS counters{};
+		if (!GetProcessIoCounters(GetCurrentProcess(), &counters))
+		{
+			return {};
+		}
+
+		return { std::int64_t(counters.ReadTransferCount), std::int64_t(counters.WriteTransferCount) };
+	}
+
+#else
+
+	MappedFile::MappedFile(std::filesystem::path const& filePath)
+	{
+		auto const file = open(filePath.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return;
+		}
+
+		struct stat status{};
+		if (fstat(file, &status) == 0 && status.st_size > 0)
+		{
+			// The mapping keeps its own reference to the file, the descriptor is not needed after this
+			if (auto const data = mmap(nullptr, std::size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0); data != MAP_FAILED)
+			{
+				data_ = static_cast<std::byte const*>(data);
+				size_ = std::size_t(status.st_size);
+			}
+		}
+
+		close(file);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (data_ != nullptr)
+		{
+			munmap(const_cast<std::byte*>(data_), size_);
+		}
+	}
+
+	bool MappedFile::DropCachedPages(std::filesystem::path const& filePath) noexcept
+	{
+		auto const file = open(filePath.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		// Dirty pages are not dropped, write them first
+		auto const dropped = fdatasync(file) == 0 && posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(file);
+		return dropped;
+	}
+
+	std::int64_t GetPageFaultCount() noexcept
+	{
+		rusage usage{};
+		return getrusage(RUSAGE_SELF, &usage) == 0 ? std::int64_t(usage.ru_minflt) + std::int64_t(usage.ru_majflt) : 0;
+	}
+
+	IoByteCounts GetIoByteCounts() noexcept
+	{
+		// The characters passed through the read and write calls, the *_bytes lines count only those that reached the storage device
+		IoByteCounts result;
+		if (auto const file = std::fopen("/proc/self/io", "r"))
+		{
+			std::array<char, 32> name{};
+			long long value = 0;
+			while (std::fscanf(file, "%31[^:]: %lld\n", name.data(), &value) == 2)
+			{
+				if (std::strcmp(name.data(), "rchar") == 0)
+				{
+					result.read = value;
+				}
+				else if (std::strcmp(name.data(), "wchar") == 0)
+				{
+					result.written = value;
+				}
+			}
+
+			std::fclose(file);
+		}
+
+		return result;
+	}
+
+#endif
+}
@@ -4,14 +4,97 @@
 // (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 
 #include "GeoToolbox/ShapeFile.hpp"
+#include "GeoToolbox/MappedFile.hpp"
+#include "GeoToolbox/ThreadPool.hpp"
 
 #include <shapelib-1.5.0/shapefil.h>
 
+#include <cstring>
 #include <stdexcept>
 #include <string>
 
 namespace GeoToolbox
 {
+	namespace
+	{
+		// Both the main (.shp) and the index (.shx) file start with a 100-byte header, the index continues with an 8-byte entry per record:
+		// the offset of the record in the main file and the length of its content, both big-endian, in 16-bit words.
+		// Each record in the main file starts with an 8-byte header too, its content starts with the little-endian shape type
+		constexpr std::size_t FileHeaderSize = 100;
+		constexpr std::size_t IndexEntrySize = 8;
+		constexpr std::size_t RecordHeaderSize = 8;
+
+		// Below this record count the threads cost more than they save
+		constexpr auto MinParallelRecordCount = 64 * 1024;
+
+		[[nodiscard]] std::uint32_t ReadBigEndianUint32(std::byte const* data) noexcept
+		{
+			return std::uint32_t(data[0]) << 24 | std::uint32_t(data[1]) << 16 | std::uint32_t(data[2]) << 8 | std::uint32_t(data[3]);
+		}
+
+		// The shape data is little-endian, as are all platforms this library is built for
+		template <typename T>
+		[[nodiscard]] T ReadLittleEndian(std::byte const* data) noexcept
+		{
+			T value;
+			std::memcpy(&value, data, sizeof(T));
+			return value;
+		}
+
+		// Reads the bounding box of a record content of the given size, returns false for null shapes and truncated records
+		[[nodiscard]] bool ReadRecordBounds(std::byte const* content, std::size_t size, Box2& bounds) noexcept
+		{
+			if (size < sizeof(std::int32_t))
+			{
+				return false;
+			}
+
+			auto const readPoint = [](std::byte const* data)
+				{
+					return Vector2{ ReadLittleEndian<double>(data), ReadLittleEndian<double>(data + sizeof(double)) };
+				};
+
+			switch (ShapeType(ReadLittleEndian<std::int32_t>(content)))
+			{
+			case ShapeType::Null:
+				return false;
+
+			case ShapeType::Point:
+			case ShapeType::PointM:
+			case ShapeType::PointZ:
+				if (size < 4 + 2 * sizeof(double))
+				{
+					return false;
+				}
+
+				bounds = Box2{ readPoint(content + 4) };
+				return true;
+
+			case ShapeType::MultiPoint:
+			case ShapeType::MultiPointM:
+			case ShapeType::MultiPointZ:
+				// Shape type, bounding box, point count, points
+				if (size < 4 + 4 * sizeof(double) + 4 + 2 * sizeof(double) || ReadLittleEndian<std::int32_t>(content + 4 + 4 * sizeof(double)) <= 0)
+				{
+					return false;
+				}
+
+				bounds = Box2{ readPoint(content + 4 + 4 * sizeof(double) + 4) };
+				return true;
+
+			default:
+				// All other shapes store their bounding box after the shape type, as x min, y min, x max, y max
+				if (size < 4 + 4 * sizeof(double))
+				{
+					return false;
+				}
+
+				bounds = Box2{ readPoint(content + 4), readPoint(content + 4 + 2 * sizeof(double)) };
+				return true;
+			}
+		}
+	}
+
 	void ShapeFileDeleter::operator()(void* shapeFile) const
 	{
 		SHPClose(static_cast<SHPHandle>(shapeFile));
@@ -61,6 +144,75 @@ namespace GeoToolbox
 		}
 	}
 
+	[[nodiscard]] bool ShapeFile::HasKey(tagSHPObject const& object)
+	{
+		switch (ShapeType(object.nSHPType))
+		{
+		case ShapeType::Null:
+			return false;
+
+		case ShapeType::Point:
+		case ShapeType::PointM:
+		case ShapeType::PointZ:
+		case ShapeType::MultiPoint:
+		case ShapeType::MultiPointM:
+		case ShapeType::MultiPointZ:
+			return object.nVertices > 0;
+
+		default:
+			return true;
+		}
+	}
+
+	[[nodiscard]] std::optional<std::vector<Box2>> ShapeFile::ReadBounds(int limit) const
+	{
+		auto indexPath = filePath_;
+		indexPath.replace_extension(".shx");
+		MappedFile const mainFile{ filePath_ };
+		MappedFile const indexFile{ indexPath };
+		if (!mainFile.IsOpen() || !indexFile.IsOpen() || mainFile.GetSize() < FileHeaderSize || indexFile.GetSize() < FileHeaderSize)
+		{
+			return std::nullopt;
+		}
+
+		auto const recordCount = int((indexFile.GetSize() - FileHeaderSize) / IndexEntrySize);
+		auto const count = limit < 0 ? recordCount : std::min(recordCount, limit);
+
+		std::vector<Box2> bounds(count);
+		std::vector<char> valid(count);
+
+		auto const main = mainFile.GetBytes();
+		auto const entries = indexFile.GetBytes().data() + FileHeaderSize;
+		auto const readRecord = [&](int index, int)
+			{
+				auto const entry = entries + std::size_t(index) * IndexEntrySize;
+				auto const offset = std::size_t(ReadBigEndianUint32(entry)) * 2;
+				auto const contentSize = std::size_t(ReadBigEndianUint32(entry + 4)) * 2;
+				if (offset < FileHeaderSize || offset + RecordHeaderSize + contentSize > std::size_t(main.size()))
+				{
+					return;
+				}
+
+				valid[index] = ReadRecordBounds(main.data() + offset + RecordHeaderSize, contentSize, bounds[index]);
+			};
+
+		constexpr auto ChunkSize = 4096;
+		ThreadPool pool{ count < MinParallelRecordCount ? 1 : 0 };
+		pool.ForEachIndex(count, ChunkSize, readRecord);
+
+		auto last = 0;
+		for (auto index = 0; index < count; ++index)
+		{
+			if (valid[index])
+			{
+				bounds[last++] = bounds[index];
+			}
+		}
+
+		bounds.resize(last);
+		return bounds;
+	}
+
 	[[nodiscard]] std::vector<Segment2> ShapeFile::GetSegments() const
 	{
 		std::vector<Segment2> result;
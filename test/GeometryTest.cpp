@@ -7,11 +7,16 @@
 
 #include "GeoToolbox/Profiling.hpp"
 #include "GeoToolbox/SpatialTools.hpp"
+#include "GeoToolbox/TestTools.hpp"
 
 #include <catch2/catch_template_test_macros.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <numeric>
+#include <random>
 #include <unordered_set>
 
 #include "Performance/TestTools.hpp"
@@ -67,6 +72,44 @@ TEST_CASE("Vector")
 	REQUIRE(Convert<Vector3>(Vector3f{ 1.f, 2.f, 0 }) == Vector3{ 1., 2., 0 });
 }
 
+TEST_CASE("PaddedVector")
+{
+	STATIC_REQUIRE(VectorTraits<PaddedVector3f>::Name == "padded3f"sv);
+	STATIC_REQUIRE(sizeof(PaddedVector3f) == 16 && alignof(PaddedVector3f) == 16);
+	STATIC_REQUIRE(sizeof(PaddedVector3) == 32 && alignof(PaddedVector3) == 32);
+	STATIC_REQUIRE(IsVector<PaddedVector3f>);
+
+	PaddedVector3f const x{ DoNotOptimize(1.f), 2, 3 };
+	PaddedVector3f const y{ 4, DoNotOptimize(-2.f), 5 };
+	REQUIRE(x + y == PaddedVector3f{ 5, 0, 8 });
+	REQUIRE(y - x == PaddedVector3f{ 3, -4, 2 });
+	REQUIRE(x * 2 == PaddedVector3f{ 2, 4, 6 });
+	REQUIRE(y / 2 == PaddedVector3f{ 2, -1, 2.5f });
+	REQUIRE(ComponentMultiply(x, y) == PaddedVector3f{ 4, -4, 15 });
+	REQUIRE(Min(x, y) == PaddedVector3f{ 1, -2, 3 });
+	REQUIRE(Max(x, y) == PaddedVector3f{ 4, 2, 5 });
+	REQUIRE(DotProduct(x, y) == 15);
+	REQUIRE(GetDistanceSquared(x, y) == 9 + 16 + 4);
+	REQUIRE(Sum(x) == 6);
+	REQUIRE(VectorTraits<PaddedVector3f>::ToArray(x) == Vector3f{ 1, 2, 3 });
+	REQUIRE(Convert<Vector3f>(x) == Vector3f{ 1, 2, 3 });
+
+	// The box operations match the ones of the unpadded vector
+	Box<PaddedVector3f> box;
+	box.Add(x);
+	box.Add(y);
+	REQUIRE(box == Box<PaddedVector3f>{ { 1, -2, 3 }, { 4, 2, 5 } });
+
+	mt19937 randomGenerator{ 13 };
+	uniform_real_distribution<float> distribution{ -10, 10 };
+	for (auto i = 0; i < 1000; ++i)
+	{
+		Vector3f const point{ distribution(randomGenerator), distribution(randomGenerator), distribution(randomGenerator) };
+		auto const paddedPoint = VectorTraits<PaddedVector3f>::FromArray(point);
+		REQUIRE(GetDistanceSquared(paddedPoint, box) == GetDistanceSquared(point, Box3f{ { 1, -2, 3 }, { 4, 2, 5 } }));
+	}
+}
+
 TEST_CASE("Box")
 {
 	STATIC_REQUIRE(Box2{}.IsEmpty());
@@ -106,11 +149,332 @@ TEST_CASE("Box")
 	REQUIRE(Overlap(box, Box2{ { 0.5, 0.5 }, { 3, 3 } }));
 	REQUIRE_FALSE(Contains(box, Box2{ { 0.5, 0.5 }, { 3, 3 } }));
 
+	// Touching boxes overlap, a gap along any one axis separates them
+	REQUIRE(Overlap(box, Box2{ { 2, 2 }, { 3, 3 } }));
+	REQUIRE_FALSE(Overlap(box, Box2{ { 0.5, 2.5 }, { 1, 3 } }));
+	REQUIRE_FALSE(Overlap(Box2{ { 2.5, 0.5 }, { 3, 1 } }, box));
+	REQUIRE(Intersect(box, Box2{ { 0.5, 2.5 }, { 1, 3 } }).IsEmpty());
+	REQUIRE(Overlap(box, Vector2{ 2, 0 }));
+	REQUIRE_FALSE(Overlap(box, Vector2{ 2, -0.5 }));
+
+	REQUIRE(GetClosestPointOnBox(box, Vector2{ -1, 1 }) == Vector2{ 0, 1 });
+	REQUIRE(GetClosestPointOnBox(box, Vector2{ 3, 5 }) == Vector2{ 2, 2 });
+	REQUIRE(GetDistanceSquared(Vector2{ 1, 1 }, box) == 0);
+	REQUIRE(GetDistanceSquared(Vector2{ -1, 4 }, box) == 5);
+	REQUIRE(GetDistanceSquared(Vector2{ -1, 4 }, box, 1) == 4);
+
 	auto boxf = Box<Vector2f>::Convert( box );
 	REQUIRE( boxf == Box2f{ { 0.f, 0.f }, { 2.f, 2.f } } );
 }
 
+TEMPLATE_TEST_CASE("OverlapMask", "", Vector2, Vector3f)
+{
+	using ScalarType = typename VectorTraits<TestType>::ScalarType;
+	constexpr auto Dimensions = VectorTraits<TestType>::Dimensions;
+
+	mt19937 randomGenerator{ 13 };
+	uniform_real_distribution<ScalarType> distribution{ 0, 10 };
+	auto const randomVector = [&]
+		{
+			TestType v{};
+			for (auto& x : v)
+			{
+				x = distribution(randomGenerator);
+			}
+
+			return v;
+		};
+
+	array<array<ScalarType, OverlapMaskBits>, Dimensions> mins{};
+	array<array<ScalarType, OverlapMaskBits>, Dimensions> maxs{};
+	vector<Box<TestType>> boxes;
+	for (auto i = 0; i < OverlapMaskBits; ++i)
+	{
+		auto const box = Box<TestType>::Bound(randomVector(), randomVector());
+		boxes.push_back(box);
+		for (size_t axis = 0; axis < Dimensions; ++axis)
+		{
+			mins[axis][i] = box.Min()[axis];
+			maxs[axis][i] = box.Max()[axis];
+		}
+	}
+
+	array<ScalarType const*, Dimensions> minPointers{};
+	array<ScalarType const*, Dimensions> maxPointers{};
+	for (size_t axis = 0; axis < Dimensions; ++axis)
+	{
+		minPointers[axis] = mins[axis].data();
+		maxPointers[axis] = maxs[axis].data();
+	}
+
+	for (auto const count : { 0, 1, 3, 7, 8, 13, 32, 63, 64 })
+	{
+		for (auto q = 0; q < 20; ++q)
+		{
+			auto const query = Box<TestType>::FromCenterAndSize(randomVector(), ScalarType(q % 5));
+			uint64_t expected = 0;
+			uint64_t expectedPoints = 0;
+			for (auto i = 0; i < count; ++i)
+			{
+				expected |= uint64_t(Overlap(query, boxes[i])) << i;
+				expectedPoints |= uint64_t(Overlap(query, boxes[i].Min())) << i;
+			}
+
+			REQUIRE(GetOverlapMask(query, minPointers, maxPointers, count) == expected);
+			REQUIRE(GetOverlapMask(query, minPointers, minPointers, count) == expectedPoints);
+			REQUIRE(PopCount(expected) == CountIf(Span{ boxes.data(), count }, [&query](auto const& box) { return Overlap(query, box); }));
+		}
+	}
+
+	REQUIRE(CountTrailingZeros(uint64_t(1) << 63) == 63);
+}
+
+TEMPLATE_TEST_CASE("SegmentDistance", "", Vector2, Vector3f)
+{
+	using ScalarType = typename VectorTraits<TestType>::ScalarType;
+	constexpr auto Dimensions = VectorTraits<TestType>::Dimensions;
+
+	auto const start = Zero<TestType>();
+	auto end = Zero<TestType>();
+	end[0] = 4;
+	Segment<TestType> const segment{ start, end };
+
+	auto point = Zero<TestType>();
+	point[1] = 3;
+	REQUIRE(GetDistanceSquared(point, segment) == ScalarType(9));
+	point[0] = 2;
+	REQUIRE(GetDistanceSquared(point, segment) == ScalarType(9));
+	point[0] = 7;
+	REQUIRE(GetDistanceSquared(point, segment) == ScalarType(18));
+	point[0] = -1;
+	REQUIRE(GetDistanceSquared(point, segment) == ScalarType(10));
+	REQUIRE(GetDistanceSquared(point, Segment<TestType>{ end, end }) == GetDistanceSquared(point, end));
+
+	REQUIRE(SpatialKeyTraits<Segment<TestType>>::GetBox(Segment<TestType>{ end, start }) == Box<TestType>{ start, end });
+	REQUIRE(SpatialKeyTraits<Segment<TestType>>::GetCenter(segment)[0] == ScalarType(2));
+	STATIC_REQUIRE(SpatialKeyIsSegment<Segment<TestType>>);
+
+	mt19937 randomGenerator{ 13 };
+	uniform_real_distribution<ScalarType> distribution{ 0, 10 };
+	auto const randomVector = [&]
+		{
+			TestType v{};
+			for (auto& x : v)
+			{
+				x = distribution(randomGenerator);
+			}
+
+			return v;
+		};
+
+	constexpr auto SegmentCount = 67;
+	array<array<ScalarType, SegmentCount>, Dimensions> starts{};
+	array<array<ScalarType, SegmentCount>, Dimensions> ends{};
+	vector<Segment<TestType>> segments;
+	for (auto i = 0; i < SegmentCount; ++i)
+	{
+		// Every 10th segment is degenerate
+		auto const a = randomVector();
+		segments.push_back({ a, i % 10 == 0 ? a : randomVector() });
+		for (size_t axis = 0; axis < Dimensions; ++axis)
+		{
+			starts[axis][i] = segments.back().first[axis];
+			ends[axis][i] = segments.back().second[axis];
+		}
+	}
+
+	array<ScalarType const*, Dimensions> startPointers{};
+	array<ScalarType const*, Dimensions> endPointers{};
+	for (size_t axis = 0; axis < Dimensions; ++axis)
+	{
+		startPointers[axis] = starts[axis].data();
+		endPointers[axis] = ends[axis].data();
+	}
+
+	for (auto const count : { 0, 1, 3, 7, 8, 13, 64, SegmentCount })
+	{
+		for (auto q = 0; q < 20; ++q)
+		{
+			auto const location = randomVector();
+			array<ScalarType, SegmentCount> distances{};
+			GetSegmentDistancesSquared(VectorTraits<TestType>::ToArray(location), startPointers, endPointers, count, distances.data());
+			for (auto i = 0; i < count; ++i)
+			{
+				auto const expected = GetDistanceSquared(location, segments[i]);
+				REQUIRE(std::abs(distances[i] - expected) <= ScalarType(1e-4) * std::max(expected, ScalarType(1)));
+				REQUIRE(distances[i] >= GetDistanceSquared(location, SpatialKeyTraits<Segment<TestType>>::GetBox(segments[i])) * ScalarType(0.9999));
+			}
+		}
+	}
+}
+
+TEST_CASE("GeodeticDistance")
+{
+	// A quarter of the equator, and across the pole
+	auto const origin = GeodeticLocation::FromDegrees(0, 0);
+	REQUIRE(std::abs(GetGreatCircleDistance(origin, GeodeticLocation::FromDegrees(90, 0)) - Pi / 2) < 1e-12);
+	REQUIRE(std::abs(GetGreatCircleDistance(GeodeticLocation::FromDegrees(0, 89), GeodeticLocation::FromDegrees(180, 89)) - 2 * Pi / 180) < 1e-12);
+
+	// Across the antimeridian the points are near, far apart in the planar coordinates
+	auto const west = GeodeticLocation::FromDegrees(179.5, 10);
+	auto const east = GeodeticLocation::FromDegrees(-179.5, 10);
+	REQUIRE(GetGreatCircleDistance(west, east) * EarthMeanRadius < 110'000);
+
+	auto const unitOrigin = ToUnitSphere<Vector3>(origin);
+	REQUIRE(std::abs(GetDistanceSquared(unitOrigin, Zero<Vector3>()) - 1) < 1e-12);
+	REQUIRE(unitOrigin[0] == 1.0);
+	REQUIRE(std::abs(ToUnitSphere<Vector3>(GeodeticLocation::FromDegrees(30, 90))[2] - 1) < 1e-12);
+
+	// The chord is 2 sin(d / 2), never longer than the arc
+	mt19937 randomGenerator{ 17 };
+	uniform_real_distribution<double> longitudes{ -180, 180 };
+	uniform_real_distribution<double> latitudes{ -90, 90 };
+	for (auto i = 0; i < 100; ++i)
+	{
+		auto const a = GeodeticLocation::FromDegrees(longitudes(randomGenerator), latitudes(randomGenerator));
+		auto const b = GeodeticLocation::FromDegrees(longitudes(randomGenerator), latitudes(randomGenerator));
+		auto const arc = GetGreatCircleDistance(a, b);
+		auto const chord = std::sqrt(GetDistanceSquared(ToUnitSphere<Vector3>(a), ToUnitSphere<Vector3>(b)));
+		REQUIRE(std::abs(chord - 2 * std::sin(arc / 2)) < 1e-9);
+		REQUIRE(chord <= arc + 1e-12);
+	}
+}
+
 TEST_CASE("Feature")
 {
 	[[maybe_unused]] std::unordered_set<Feature<Vector2>> const featureCanBeStoredInAHashContainer;
 }
+
+TEMPLATE_TEST_CASE("ParallelDrawSpatialKeys", "", Vector2, Box2)
+{
+	constexpr auto ImageSize = 64;
+	Box2 const bounds{ Vector2{ 0, 0 }, Vector2{ ImageSize - 1, ImageSize - 1 } };
+
+	SECTION("Density")
+	{
+		// Two overlapping boxes and a point, the y axis goes up in the keys and down in the image
+		vector<Feature<Box2>> const boxes{ { 0, Box2{ Vector2{ 1, 1 }, Vector2{ 10, 5 } } }, { 1, Box2{ Vector2{ 5, 3 }, Vector2{ 20, 30 } } }, { 2, Box2{ Vector2{ 40, 40 }, Vector2{ 40, 40 } } } };
+		Image image{ ImageSize, ImageSize };
+		ParallelDrawSpatialKeys<Box2>(image, boxes, bounds, DrawMode::Density, 1);
+
+		auto const pixel = [&image](int x, int y) { return image.GetData()[size_t(ImageSize - 1 - y) * ImageSize + x]; };
+		REQUIRE(pixel(0, 0) == White);
+		REQUIRE(pixel(2, 2) == GetDensityColor(std::log1p(1.0) / std::log1p(2.0)));
+		REQUIRE(pixel(7, 4) == GetDensityColor(1));
+		REQUIRE(pixel(15, 30) == pixel(2, 2));
+		REQUIRE(pixel(21, 30) == White);
+		REQUIRE(pixel(40, 40) == pixel(2, 2));
+	}
+
+	SECTION("The threads draw the same image")
+	{
+		mt19937 random{ 13 };
+		auto const features = MakeRandomSpatialKeys<TestType>(random, 100'000, Box2{ Vector2{ -10, -10 }, Vector2{ ImageSize + 10, ImageSize + 10 } }, { 0.01, 5.0 });
+		for (auto const mode : { DrawMode::Outline, DrawMode::Density })
+		{
+			Image single{ ImageSize, ImageSize };
+			ParallelDrawSpatialKeys<TestType>(single, features, bounds, mode, 1);
+			Image parallel{ ImageSize, ImageSize };
+			ParallelDrawSpatialKeys<TestType>(parallel, features, bounds, mode, 4);
+			REQUIRE(single.GetData() == parallel.GetData());
+			REQUIRE(std::count(single.GetData().begin(), single.GetData().end(), White) < ImageSize * ImageSize);
+		}
+	}
+
+	SECTION("A box across the tiles")
+	{
+		// Larger than the tiles of 64 pixels
+		constexpr auto LargeImageSize = 200;
+		vector<Feature<Box2>> const boxes{ { 0, Box2{ Vector2{ 10, 20 }, Vector2{ 150, 190 } } } };
+		Box2 const largeBounds{ Vector2{ 0, 0 }, Vector2{ LargeImageSize - 1, LargeImageSize - 1 } };
+		auto const pixel = [](Image const& image, int x, int y) { return image.GetData()[size_t(LargeImageSize - 1 - y) * LargeImageSize + x]; };
+		for (auto const mode : { DrawMode::Outline, DrawMode::Density })
+		{
+			Image image{ LargeImageSize, LargeImageSize };
+			ParallelDrawSpatialKeys<Box2>(image, boxes, largeBounds, mode, 4);
+			auto const color = mode == DrawMode::Outline ? Black : GetDensityColor(1);
+			for (auto const x : { 10, 63, 64, 128, 150 })
+			{
+				REQUIRE(pixel(image, x, 20) == color);
+				REQUIRE(pixel(image, x, 190) == color);
+			}
+
+			REQUIRE(pixel(image, 100, 100) == (mode == DrawMode::Outline ? White : color));
+			REQUIRE(pixel(image, 151, 100) == White);
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("QueryWorkloadMaker", "", Vector2, Box3f)
+{
+	using VectorType = typename SpatialKeyTraits<TestType>::VectorType;
+	using ScalarType = typename SpatialKeyTraits<TestType>::ScalarType;
+	using BoxType = Box<VectorType>;
+	constexpr auto QueryCount = 1000;
+
+	mt19937 random{ 7 };
+	auto const bounds = BoxType::Square(100);
+	auto const features = MakeRandomSpatialKeys<TestType>(random, 10'000, bounds, { ScalarType(0.01), ScalarType(1) });
+	vector<ScalarType> const sizes{ ScalarType(0.25), 1, 2 };
+	auto const makeQueries = [&](int workload)
+		{
+			QueryWorkloadMaker<TestType> maker{ 3, features, bounds, sizes };
+			switch (workload)
+			{
+			case 0: return maker.MakeZipfHotspots(QueryCount);
+			case 1: return maker.MakeRandomWalks(QueryCount);
+			case 2: return maker.MakePanZoomSessions(QueryCount);
+			default: return maker.MakeDataDistributed(QueryCount);
+			}
+		};
+
+	for (auto workload = 0; workload < 4; ++workload)
+	{
+		auto const queries = makeQueries(workload);
+		REQUIRE(queries.size() == QueryCount);
+		REQUIRE(queries == makeQueries(workload));
+		REQUIRE(std::all_of(queries.begin(), queries.end(), [&](BoxType const& query) { return Overlap(bounds.GetScaled(2), query.Center()); }));
+	}
+
+	SECTION("Data-distributed queries are centered on features")
+	{
+		auto const queries = makeQueries(3);
+		REQUIRE(std::all_of(queries.begin(), queries.end(), [&](BoxType const& query)
+			{
+				return std::any_of(features.begin(), features.end(), [&](Feature<TestType> const& feature) { return GetDistanceSquared(SpatialKeyTraits<TestType>::GetCenter(feature.spatialKey), query.Center()) < ScalarType(1e-6); });
+			}));
+	}
+
+	SECTION("Random walks and pan/zoom sessions make small steps and stay within the bounds")
+	{
+		for (auto workload = 1; workload <= 2; ++workload)
+		{
+			auto const queries = makeQueries(workload);
+			auto smallSteps = 0;
+			for (auto i = 1; i < QueryCount; ++i)
+			{
+				REQUIRE(Overlap(bounds, queries[i].Center()));
+				smallSteps += GetDistanceSquared(queries[i - 1].Center(), queries[i].Center()) <= 4 * sizes.back() * sizes.back() ? 1 : 0;
+			}
+
+			// Only the starts of the 16 walks or sessions are far from the previous query
+			REQUIRE(smallSteps >= QueryCount - 1 - 16);
+		}
+	}
+
+	SECTION("Zipf queries concentrate around a few hot spots")
+	{
+		auto const zipf = makeQueries(0);
+		auto const data = makeQueries(3);
+		auto const countNear = [&](vector<BoxType> const& queries, VectorType const& location)
+			{
+				return std::count_if(queries.begin(), queries.end(), [&](BoxType const& query) { return GetDistanceSquared(query.Center(), location) <= 4 * sizes.back() * sizes.back(); });
+			};
+
+		// The most frequent hot spot gets about 1 / H(64) ~ 21% of the queries
+		auto const maxNearZipf = std::accumulate(zipf.begin(), zipf.end(), std::ptrdiff_t(0), [&](std::ptrdiff_t result, BoxType const& query) { return std::max(result, countNear(zipf, query.Center())); });
+		auto const maxNearData = std::accumulate(data.begin(), data.end(), std::ptrdiff_t(0), [&](std::ptrdiff_t result, BoxType const& query) { return std::max(result, countNear(data, query.Center())); });
+		REQUIRE(maxNearZipf > 100);
+		REQUIRE(maxNearZipf > 4 * maxNearData);
+	}
+}
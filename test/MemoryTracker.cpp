@@ -21,7 +21,7 @@ void* TrackedMalloc(size_t size)
 		return result;
 	}
 
-	GeoToolbox::TotalAllocatedSize += size;
+	GeoToolbox::AllocationCounters::Add(size);
 	result[0] = size;
 	return result + 2;
 }
@@ -29,7 +29,7 @@ void* TrackedMalloc(size_t size)
 void TrackedFree(void* block)
 {
 	auto const original = static_cast<size_t*>(block) - 2;
-	GeoToolbox::TotalAllocatedSize -= original[0];
+	GeoToolbox::AllocationCounters::Remove(original[0]);
 	free(original);
 }
 
@@ -41,14 +41,14 @@ void TrackedFree(void* block)
 
 void* operator new(size_t size)
 {
-	GeoToolbox::TotalAllocatedSize += size;
+	GeoToolbox::AllocationCounters::Add(size);
 	return malloc(size);
 }
 
 void operator delete(void* block, size_t size) noexcept
 {
 	free(block);
-	GeoToolbox::TotalAllocatedSize -= size;
+	GeoToolbox::AllocationCounters::Remove(size);
 }
 
 #else
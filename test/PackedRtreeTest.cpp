@@ -0,0 +1,535 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "GeoToolbox/PackedRtree.hpp"
+
+#include <catch2/catch_template_test_macros.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+using namespace GeoToolbox;
+using namespace std;
+
+TEST_CASE("HilbertIndex")
+{
+	// The first order 2D curve visits the quadrants in the order (0, 0), (0, 1), (1, 1), (1, 0)
+	STATIC_REQUIRE(GetHilbertIndex<2>({ 0, 0 }, 1) == 0);
+	STATIC_REQUIRE(GetHilbertIndex<2>({ 0, 1 }, 1) == 1);
+	STATIC_REQUIRE(GetHilbertIndex<2>({ 1, 1 }, 1) == 2);
+	STATIC_REQUIRE(GetHilbertIndex<2>({ 1, 0 }, 1) == 3);
+
+	// Consecutive cells along the curve are neighbours
+	constexpr auto Bits = 4;
+	constexpr auto Side = 1u << Bits;
+	vector<array<uint32_t, 2>> cells(Side * Side);
+	for (auto x = 0u; x < Side; ++x)
+	{
+		for (auto y = 0u; y < Side; ++y)
+		{
+			cells[GetHilbertIndex<2>({ x, y }, Bits)] = { x, y };
+		}
+	}
+
+	for (auto i = 1u; i < cells.size(); ++i)
+	{
+		auto const dx = int(cells[i][0]) - int(cells[i - 1][0]);
+		auto const dy = int(cells[i][1]) - int(cells[i - 1][1]);
+		REQUIRE(abs(dx) + abs(dy) == 1);
+	}
+
+	// The coarse (counting-sorted) and the full order agree on points in distinct cells
+	vector<Vector2> points;
+	for (auto const& cell : cells)
+	{
+		points.push_back({ double(cell[0]), double(cell[1]) });
+	}
+
+	REQUIRE(GetHilbertOrder<Vector2>(points, Bits) == GetHilbertOrder<Vector2>(points));
+}
+
+TEST_CASE("MortonIndex")
+{
+	STATIC_REQUIRE(SpreadBits<2>(0b111) == 0b10101);
+	STATIC_REQUIRE(SpreadBits<3>(0b111) == 0b1001001);
+
+	REQUIRE(GetMortonIndex<2>({ 1, 0 }) == 1);
+	REQUIRE(GetMortonIndex<2>({ 0, 1 }) == 2);
+	REQUIRE(GetMortonIndex<2>({ 3, 1 }) == 0b0111);
+	REQUIRE(GetMortonIndex<3>({ 0, 0, 1 }) == 4);
+
+	// Compare to interleaving bit by bit, for all the bits that fit
+	mt19937 randomGenerator{ 3 };
+	auto const reference = [](auto const& x)
+		{
+			auto const dimensions = x.size();
+			uint64_t result = 0;
+			for (size_t bit = 0; bit * dimensions < 64; ++bit)
+			{
+				for (size_t i = 0; i < dimensions && bit * dimensions + i < 64; ++i)
+				{
+					result |= uint64_t((x[i] >> bit) & 1) << (bit * dimensions + i);
+				}
+			}
+
+			return result;
+		};
+
+	for (auto i = 0; i < 1000; ++i)
+	{
+		array<uint32_t, 2> const x2{ uint32_t(randomGenerator()), uint32_t(randomGenerator()) };
+		REQUIRE(GetMortonIndex(x2) == reference(x2));
+
+		array<uint32_t, 3> const x3{ uint32_t(randomGenerator()) & 0x1FFFFF, uint32_t(randomGenerator()) & 0x1FFFFF, uint32_t(randomGenerator()) & 0x1FFFFF };
+		REQUIRE(GetMortonIndex(x3) == reference(x3));
+
+		array<uint32_t, 4> const x4{ uint32_t(randomGenerator()) & 0xFFFF, uint32_t(randomGenerator()) & 0xFFFF, uint32_t(randomGenerator()) & 0xFFFF, uint32_t(randomGenerator()) & 0xFFFF };
+		REQUIRE(GetMortonIndex(x4) == reference(x4));
+	}
+
+	// The order of the grid points is the row-major order of the cells within each quadrant, recursively
+	vector<Vector2> points;
+	for (auto y = 0; y < 4; ++y)
+	{
+		for (auto x = 0; x < 4; ++x)
+		{
+			points.push_back({ double(x), double(y) });
+		}
+	}
+
+	REQUIRE(GetCurveOrder<Vector2>(points, SpaceFillingCurve::Morton, 2) == vector{ 0, 1, 4, 5, 2, 3, 6, 7, 8, 9, 12, 13, 10, 11, 14, 15 });
+	REQUIRE(GetCurveOrder<Vector2>(points, SpaceFillingCurve::Morton) == GetCurveOrder<Vector2>(points, SpaceFillingCurve::Morton, 2));
+
+	auto const features = MakeRandomSpatialKeys<Box2>(randomGenerator, 100, Box2::Square(100), { 1.0, 5.0 });
+	auto const centers = Transform(features, [](auto const& feature) { return feature.spatialKey.Center(); });
+	REQUIRE(GetSpatialKeysOrder<Box2>(features, SpaceFillingCurve::Hilbert) == GetHilbertOrder<Vector2>(centers));
+}
+
+TEST_CASE("ParallelCurveOrder")
+{
+	// Large enough for several chunks, with duplicate points that must keep their relative order
+	mt19937 randomGenerator{ 5 };
+	auto features = MakeRandomSpatialKeys<Vector3f>(randomGenerator, 100'000, Box3f::Square(100), { 0.0f, 0.0f });
+	for (auto i = 0; i < 1000; ++i)
+	{
+		features[i + 1000].spatialKey = features[i].spatialKey;
+	}
+
+	auto const points = Transform(features, [](auto const& feature) { return feature.spatialKey; });
+	for (auto const threadCount : { 2, 3, 5 })
+	{
+		REQUIRE(ParallelGetCurveOrder<Vector3f>(points, SpaceFillingCurve::Hilbert, threadCount) == GetHilbertOrder<Vector3f>(points));
+		REQUIRE(ParallelGetCurveOrder<Vector3f>(points, SpaceFillingCurve::Morton, threadCount) == GetCurveOrder<Vector3f>(points, SpaceFillingCurve::Morton));
+		REQUIRE(ParallelGetCurveOrder<Vector3f>(points, SpaceFillingCurve::Hilbert, threadCount, 4) == GetHilbertOrder<Vector3f>(points, 4));
+		REQUIRE(ParallelGetSpatialKeysOrder<Vector3f>(features, SpaceFillingCurve::Hilbert, threadCount) == GetSpatialKeysOrder<Vector3f>(features, SpaceFillingCurve::Hilbert));
+
+		// The same tree for any count of threads
+		PackedRtree<Vector3f> const tree{ features };
+		PackedRtree<Vector3f> const parallelTree{ features, threadCount };
+		REQUIRE(parallelTree.GetHeight() == tree.GetHeight());
+		for (auto i = 0; i < tree.GetSize(); i += 97)
+		{
+			REQUIRE(parallelTree.GetId(i) == tree.GetId(i));
+			REQUIRE(parallelTree.GetKey(i) == tree.GetKey(i));
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("Features", "", Vector2, Box2, Vector3f, Box3f)
+{
+	using KeyTraits = SpatialKeyTraits<TestType>;
+	using ScalarType = typename KeyTraits::ScalarType;
+	using BoxType = typename KeyTraits::BoxType;
+
+	mt19937 randomGenerator{ 7 };
+	auto const features = MakeRandomSpatialKeys<TestType>(randomGenerator, 100, BoxType::Square(100), { ScalarType(1), ScalarType(5) });
+	Features<TestType> const columns{ features };
+	REQUIRE(columns.GetSize() == Size(features));
+	REQUIRE(columns.GetIds().size() == Size(features));
+
+	for (auto i = 0; i < columns.GetSize(); ++i)
+	{
+		REQUIRE(columns[i].id == features[i].id);
+		REQUIRE(columns.GetKey(i) == features[i].spatialKey);
+		for (auto axis = 0; axis < KeyTraits::Dimensions; ++axis)
+		{
+			REQUIRE(columns.GetMins(axis)[i] == GetLowBound(features[i].spatialKey, axis));
+			REQUIRE(columns.GetMaxs(axis)[i] == GetHighBound(features[i].spatialKey, axis));
+		}
+	}
+
+	auto const query = BoxType::FromCenterAndSize(KeyTraits::GetCenter(features[0].spatialKey), ScalarType(30));
+	auto const mask = GetOverlapMask(query, columns.GetMinPointers(), columns.GetMaxPointers(), 64);
+	for (auto i = 0; i < 64; ++i)
+	{
+		REQUIRE(((mask >> i) & 1) == (Overlap(query, features[i].spatialKey) ? 1u : 0u));
+	}
+
+	REQUIRE(PackedRtree<TestType>{ columns }.QueryBox(query) == PackedRtree<TestType>{ features }.QueryBox(query));
+}
+
+TEMPLATE_TEST_CASE("PackedRtree", "", Vector2, Box2, Vector3f, Box3f)
+{
+	using KeyTraits = SpatialKeyTraits<TestType>;
+	using ScalarType = typename KeyTraits::ScalarType;
+	using VectorType = typename KeyTraits::VectorType;
+	using BoxType = typename KeyTraits::BoxType;
+
+	mt19937 randomGenerator{ 13 };
+	auto const bounds = BoxType::Square(100);
+
+	REQUIRE(PackedRtree<TestType>{}.QueryBox(bounds) == 0);
+
+	for (auto const size : { 1, 31, 32, 33, 1000, 5000 })
+	{
+		auto const features = MakeRandomSpatialKeys<TestType>(randomGenerator, size, bounds, { ScalarType(1), ScalarType(5) });
+		PackedRtree<TestType> const tree{ features };
+		REQUIRE(tree.GetSize() == size);
+		REQUIRE(tree.QueryBox(bounds) == size);
+
+		uniform_real_distribution<ScalarType> distribution{ ScalarType(-10), ScalarType(110) };
+		for (auto i = 0; i < 20; ++i)
+		{
+			VectorType center{};
+			for (auto& coordinate : center)
+			{
+				coordinate = distribution(randomGenerator);
+			}
+
+			auto const query = BoxType::FromCenterAndSize(center, ScalarType(20));
+			auto const expected = CountIf(features, [&query](auto const& feature) { return Overlap(query, feature.spatialKey); });
+			REQUIRE(tree.QueryBox(query) == expected);
+
+			auto visitedCount = 0;
+			REQUIRE(tree.VisitBoxWhile(query, [&](int entryIndex)
+				{
+					REQUIRE(Overlap(query, tree.GetKey(entryIndex)));
+					return ++visitedCount < 3;
+				}) == (expected < 3));
+			REQUIRE(visitedCount == std::min(expected, 3));
+
+			auto const nearestCount = std::min(size, 10);
+			vector<ScalarType> expectedDistances = Transform(features, [&center](auto const& feature) { return GetDistanceSquared(center, feature.spatialKey); });
+			sort(expectedDistances.begin(), expectedDistances.end());
+			vector<ScalarType> distances;
+			tree.VisitNearest(center, nearestCount, [&](int entryIndex, ScalarType distanceSquared)
+				{
+					REQUIRE(GetDistanceSquared(center, tree.GetKey(entryIndex)) == distanceSquared);
+					distances.push_back(distanceSquared);
+				});
+			REQUIRE(Size(distances) == nearestCount);
+			for (auto j = 0; j < nearestCount; ++j)
+			{
+				REQUIRE(distances[j] == expectedDistances[j]);
+			}
+		}
+
+		vector<BoxType> queries(100);
+		for (auto& query : queries)
+		{
+			VectorType center{};
+			for (auto& coordinate : center)
+			{
+				coordinate = distribution(randomGenerator);
+			}
+
+			query = BoxType::FromCenterAndSize(center, ScalarType(20));
+		}
+
+		vector<int> counts(queries.size());
+		tree.QueryBoxBatch(queries, counts);
+		for (auto i = 0; i < Size(queries); ++i)
+		{
+			REQUIRE(counts[i] == tree.QueryBox(queries[i]));
+		}
+	}
+}
+
+TEST_CASE("PackedRtreeNearestSegment")
+{
+	mt19937 randomGenerator{ 13 };
+	uniform_real_distribution<double> distribution{ 0, 100 };
+	uniform_real_distribution<double> offsetDistribution{ -3, 3 };
+
+	// Short random segments indexed by their bounding boxes, the ids are their indices
+	constexpr auto SegmentCount = 3000;
+	vector<Segment2> segments;
+	vector<Feature<Box2>> features;
+	array<vector<double>, 2> starts;
+	array<vector<double>, 2> ends;
+	for (auto i = 0; i < SegmentCount; ++i)
+	{
+		Vector2 const start{ distribution(randomGenerator), distribution(randomGenerator) };
+		segments.push_back({ start, start + Vector2{ offsetDistribution(randomGenerator), offsetDistribution(randomGenerator) } });
+		features.push_back({ i, SpatialKeyTraits<Segment2>::GetBox(segments.back()) });
+	}
+
+	PackedRtree<Box2> const tree{ features };
+
+	// The segments in the order of the tree entries, for the batched kernel
+	for (auto axis = 0; axis < 2; ++axis)
+	{
+		for (auto entryIndex = 0; entryIndex < SegmentCount; ++entryIndex)
+		{
+			starts[axis].push_back(segments[tree.GetId(entryIndex)].first[axis]);
+			ends[axis].push_back(segments[tree.GetId(entryIndex)].second[axis]);
+		}
+	}
+
+	for (auto q = 0; q < 20; ++q)
+	{
+		Vector2 const location{ distribution(randomGenerator), distribution(randomGenerator) };
+		auto expected = Transform(segments, [&location](Segment2 const& segment) { return GetDistanceSquared(location, segment); });
+		sort(expected.begin(), expected.end());
+
+		constexpr auto NearestCount = 10;
+		vector<double> distances;
+		tree.VisitNearestRefined(location, NearestCount, [&](int first, int count, double* distancesSquared)
+			{
+				GetSegmentDistancesSquared(location, { starts[0].data() + first, starts[1].data() + first }, { ends[0].data() + first, ends[1].data() + first }, count, distancesSquared);
+			},
+			[&](int entryIndex, double distanceSquared)
+			{
+				REQUIRE(std::abs(distanceSquared - GetDistanceSquared(location, segments[tree.GetId(entryIndex)])) < 1e-9);
+				distances.push_back(distanceSquared);
+			});
+
+		REQUIRE(Size(distances) == NearestCount);
+		for (auto i = 0; i < NearestCount; ++i)
+		{
+			REQUIRE(std::abs(distances[i] - expected[i]) < 1e-9);
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("PackedRtreeJoin", "", Vector2, Box2, Vector3f, Box3f)
+{
+	using KeyTraits = SpatialKeyTraits<TestType>;
+	using ScalarType = typename KeyTraits::ScalarType;
+	using BoxType = typename KeyTraits::BoxType;
+
+	mt19937 randomGenerator{ 17 };
+	auto const bounds = BoxType::Square(100);
+
+	// Trees of different heights, the point keys are snapped to a coarse grid to have overlapping pairs
+	for (auto const& [sizeA, sizeB] : { pair{ 1, 1 }, pair{ 33, 1000 }, pair{ 5000, 40 }, pair{ 2000, 3000 } })
+	{
+		auto featuresA = MakeRandomSpatialKeys<TestType>(randomGenerator, sizeA, bounds, { ScalarType(1), ScalarType(5) });
+		auto featuresB = MakeRandomSpatialKeys<TestType>(randomGenerator, sizeB, bounds, { ScalarType(1), ScalarType(5) });
+		if constexpr (SpatialKeyIsPoint<TestType>)
+		{
+			for (auto* features : { &featuresA, &featuresB })
+			{
+				for (auto& feature : *features)
+				{
+					for (auto& coordinate : feature.spatialKey)
+					{
+						coordinate = std::round(coordinate / 10) * 10;
+					}
+				}
+			}
+		}
+
+		PackedRtree<TestType> const treeA{ featuresA };
+		PackedRtree<TestType> const treeB{ featuresB };
+
+		vector<int> counts(featuresA.size());
+		treeA.VisitJoin(treeB, [&](int entryIndex, int otherFirstEntryIndex, uint64_t mask)
+			{
+				for (; mask != 0; mask &= mask - 1)
+				{
+					REQUIRE(Overlap(BoxType(treeA.GetKey(entryIndex)), treeB.GetKey(otherFirstEntryIndex + CountTrailingZeros(mask))));
+					++counts[treeA.GetId(entryIndex)];
+				}
+			});
+
+		for (auto const& feature : featuresA)
+		{
+			auto const expected = CountIf(featuresB, [&feature](auto const& other) { return Overlap(BoxType(feature.spatialKey), other.spatialKey); });
+			REQUIRE(counts[feature.id] == expected);
+		}
+	}
+}
+
+TEMPLATE_TEST_CASE("PackedRtreeImage", "", Vector2, Box2, Vector3f, Box3f)
+{
+	using KeyTraits = SpatialKeyTraits<TestType>;
+	using ScalarType = typename KeyTraits::ScalarType;
+	using VectorType = typename KeyTraits::VectorType;
+	using BoxType = typename KeyTraits::BoxType;
+
+	mt19937 randomGenerator{ 23 };
+	auto const bounds = BoxType::Square(100);
+	auto const filePath = filesystem::temp_directory_path() / "GeoToolbox_PackedRtreeImage.gtpr";
+
+	REQUIRE(PackedRtree<TestType>{}.Save(filePath));
+	REQUIRE(PackedRtree<TestType>::Open(filePath)->QueryBox(bounds) == 0);
+
+	for (auto const size : { 1, 33, 5000 })
+	{
+		auto const features = MakeRandomSpatialKeys<TestType>(randomGenerator, size, bounds, { ScalarType(1), ScalarType(5) });
+		PackedRtree<TestType> const tree{ features };
+		REQUIRE(tree.Save(filePath));
+
+		auto const opened = PackedRtree<TestType>::Open(filePath);
+		REQUIRE(opened != nullptr);
+		REQUIRE(opened->GetSize() == size);
+		REQUIRE(opened->GetHeight() == tree.GetHeight());
+		for (auto i = 0; i < size; ++i)
+		{
+			REQUIRE(opened->GetId(i) == tree.GetId(i));
+			REQUIRE(opened->GetKey(i) == tree.GetKey(i));
+		}
+
+		uniform_real_distribution<ScalarType> distribution{ ScalarType(-10), ScalarType(110) };
+		for (auto i = 0; i < 20; ++i)
+		{
+			VectorType center{};
+			for (auto& coordinate : center)
+			{
+				coordinate = distribution(randomGenerator);
+			}
+
+			auto const query = BoxType::FromCenterAndSize(center, ScalarType(20));
+			REQUIRE(opened->QueryBox(query) == tree.QueryBox(query));
+		}
+
+		// Another key type or node size does not match the image
+		REQUIRE(PackedRtree<Box<Vector<ScalarType, 4>>>::Open(filePath) == nullptr);
+		REQUIRE(PackedRtree<TestType, 16>::Open(filePath) == nullptr);
+	}
+
+	filesystem::remove(filePath);
+	REQUIRE(PackedRtree<TestType>::Open(filePath) == nullptr);
+}
+
+TEMPLATE_TEST_CASE("PackedRtreeBuildFile", "", Vector2, Box2, Vector3f, Box3f)
+{
+	using KeyTraits = SpatialKeyTraits<TestType>;
+	using ScalarType = typename KeyTraits::ScalarType;
+	using BoxType = typename KeyTraits::BoxType;
+
+	// Reads the features in chunks of up to chunkSize, counting the passes
+	struct Source
+	{
+		Span<Feature<TestType> const> features;
+		int chunkSize = 100;
+		int next = 0;
+		int passes = 0;
+
+		bool Rewind()
+		{
+			next = 0;
+			++passes;
+			return true;
+		}
+
+		int Read(Span<Feature<TestType>> chunk)
+		{
+			auto const count = std::min({ int(chunk.size()), chunkSize, int(features.size()) - next });
+			std::copy_n(features.begin() + next, count, chunk.begin());
+			next += count;
+			return count;
+		}
+	};
+
+	mt19937 randomGenerator{ 29 };
+	auto const bounds = BoxType::Square(100);
+	auto const filePath = filesystem::temp_directory_path() / "GeoToolbox_PackedRtreeBuildFile.gtpr";
+
+	// The budget of a few records makes many runs, the large one makes a single run, merged from memory
+	for (auto const memoryBudget : { std::size_t(1000), std::size_t(1) << 24 })
+	{
+		for (auto const size : { 0, 1, 33, 5000 })
+		{
+			auto const features = size > 0 ? MakeRandomSpatialKeys<TestType>(randomGenerator, size, bounds, { ScalarType(1), ScalarType(5) }) : vector<Feature<TestType>>{};
+			PackedRtree<TestType> const tree{ features };
+			Source source{ features };
+			REQUIRE(PackedRtree<TestType>::BuildFile(source, filePath, memoryBudget));
+			REQUIRE(source.passes == 2);
+
+			auto const opened = PackedRtree<TestType>::Open(filePath);
+			REQUIRE(opened != nullptr);
+			REQUIRE(opened->GetSize() == size);
+			REQUIRE(opened->GetHeight() == tree.GetHeight());
+			for (auto i = 0; i < size; ++i)
+			{
+				REQUIRE(opened->GetId(i) == tree.GetId(i));
+				REQUIRE(opened->GetKey(i) == tree.GetKey(i));
+			}
+
+			REQUIRE(opened->QueryBox(bounds) == size);
+			auto const query = BoxType::FromCenterAndSize(bounds.Center(), ScalarType(30));
+			REQUIRE(opened->QueryBox(query) == tree.QueryBox(query));
+		}
+	}
+
+	// The temporary runs are removed
+	REQUIRE(!filesystem::exists(filePath.string() + ".run0"));
+	filesystem::remove(filePath);
+}
+
+TEMPLATE_TEST_CASE("QuantizedPackedRtree", "", Vector2, Box2, Vector3f, Box3f)
+{
+	using KeyTraits = SpatialKeyTraits<TestType>;
+	using ScalarType = typename KeyTraits::ScalarType;
+	using VectorType = typename KeyTraits::VectorType;
+	using BoxType = typename KeyTraits::BoxType;
+
+	mt19937 randomGenerator{ 19 };
+	auto const bounds = BoxType::Square(100);
+
+	REQUIRE(QuantizedPackedRtree<TestType>{}.QueryBox(bounds) == 0);
+
+	for (auto const size : { 1, 32, 33, 1000, 5000 })
+	{
+		auto const features = MakeRandomSpatialKeys<TestType>(randomGenerator, size, bounds, { ScalarType(1), ScalarType(5) });
+		PackedRtree<TestType> const exact{ features };
+		QuantizedPackedRtree<TestType> const tree{ features };
+		QuantizedPackedRtree<TestType, uint8_t> const tree8{ features };
+		REQUIRE(tree.GetSize() == size);
+		REQUIRE(tree.GetHeight() == exact.GetHeight());
+		REQUIRE(tree.GetNodeCount() == exact.GetNodeCount());
+		REQUIRE(tree.QueryBox(bounds) == size);
+		REQUIRE(tree8.QueryBox(bounds) == size);
+
+		// The same leaves in the same order
+		for (auto i = 0; i < size; ++i)
+		{
+			REQUIRE(tree.GetId(i) == exact.GetId(i));
+			REQUIRE(tree.GetKey(i) == exact.GetKey(i));
+		}
+
+		uniform_real_distribution<ScalarType> distribution{ ScalarType(-10), ScalarType(110) };
+		for (auto i = 0; i < 50; ++i)
+		{
+			VectorType center{};
+			for (auto& coordinate : center)
+			{
+				coordinate = distribution(randomGenerator);
+			}
+
+			// Include queries touching the keys exactly, the quantized node boxes must contain them
+			auto const query = i % 2 == 0 ? BoxType::FromCenterAndSize(center, ScalarType(20)) : BoxType(exact.GetKey(i % size));
+			auto const expected = exact.QueryBox(query);
+			REQUIRE(tree.QueryBox(query) == expected);
+			REQUIRE(tree8.QueryBox(query) == expected);
+
+			auto const nearestCount = std::min(size, 10);
+			vector<ScalarType> expectedDistances;
+			exact.VisitNearest(center, nearestCount, [&](int, ScalarType distanceSquared) { expectedDistances.push_back(distanceSquared); });
+			vector<ScalarType> distances;
+			tree8.VisitNearest(center, nearestCount, [&](int entryIndex, ScalarType distanceSquared)
+				{
+					REQUIRE(GetDistanceSquared(center, tree8.GetKey(entryIndex)) == distanceSquared);
+					distances.push_back(distanceSquared);
+				});
+			REQUIRE(distances == expectedDistances);
+		}
+	}
+}
@@ -9,6 +9,7 @@
 
 #include <boost/geometry.hpp>
 #include <boost/geometry/index/rtree.hpp>
+#include <boost/geometry/index/detail/rtree/utilities/view.hpp>
 
 using namespace GeoToolbox;
 using namespace std;
@@ -16,8 +17,130 @@ using namespace std;
 namespace Bgi = boost::geometry::index;
 
 
-template <typename TSpatialKey>
-int BoostRtree<TSpatialKey>::QueryBox(shared_ptr<void> const& indexPtr, BoxType const& queryBox) const
+namespace
+{
+	// Traverses two R-trees together, descending into the pairs of overlapping nodes only, like Tidwall::JoinNodes(). The rtree class does not expose its nodes,
+	// so they are reached with the visitors of the detail namespace, as the utilities of Boost.Geometry do (boost/geometry/index/detail/rtree/utilities)
+	template <class TIndex, class TFunction>
+	class BoostJoin
+	{
+		using View = Bgi::detail::rtree::utilities::view<TIndex>;
+		using MembersHolder = typename View::members_holder;
+		using InternalNode = typename MembersHolder::internal_node;
+		using Leaf = typename MembersHolder::leaf;
+		using NodeBox = typename MembersHolder::box_type;
+
+		// Finds whether a node is internal or a leaf
+		struct Node : MembersHolder::visitor_const
+		{
+			InternalNode const* internal = nullptr;
+			Leaf const* leaf = nullptr;
+
+			void operator()(InternalNode const& node)
+			{
+				internal = &node;
+			}
+
+			void operator()(Leaf const& node)
+			{
+				leaf = &node;
+			}
+		};
+
+		TFunction& function_;
+
+		template <class TNodePointer>
+		[[nodiscard]] static Node GetNode(TNodePointer const& pointer)
+		{
+			Node node;
+			Bgi::detail::rtree::apply_visitor(node, *pointer);
+			return node;
+		}
+
+		[[nodiscard]] static Node GetRoot(TIndex const& index)
+		{
+			Node node;
+			View{ index }.apply_visitor(node);
+			return node;
+		}
+
+		void JoinNodes(Node const& a, NodeBox const& boxA, Node const& b, NodeBox const& boxB)
+		{
+			AddQueryStats_VisitedNodesCount();
+			if (a.internal != nullptr && (b.leaf != nullptr || Bgi::detail::rtree::elements(*a.internal).size() >= Bgi::detail::rtree::elements(*b.internal).size()))
+			{
+				auto const& children = Bgi::detail::rtree::elements(*a.internal);
+				AddQueryStats_BoxOverlapsCount(int(children.size()));
+				for (auto const& child : children)
+				{
+					if (boost::geometry::intersects(child.first, boxB))
+					{
+						JoinNodes(GetNode(child.second), child.first, b, boxB);
+					}
+				}
+
+				return;
+			}
+
+			if (b.internal != nullptr)
+			{
+				auto const& children = Bgi::detail::rtree::elements(*b.internal);
+				AddQueryStats_BoxOverlapsCount(int(children.size()));
+				for (auto const& child : children)
+				{
+					if (boost::geometry::intersects(child.first, boxA))
+					{
+						JoinNodes(a, boxA, GetNode(child.second), child.first);
+					}
+				}
+
+				return;
+			}
+
+			auto const& featuresB = Bgi::detail::rtree::elements(*b.leaf);
+			for (auto const featureA : Bgi::detail::rtree::elements(*a.leaf))
+			{
+				if (!boost::geometry::intersects(featureA->spatialKey, boxB))
+				{
+					continue;
+				}
+
+				AddQueryStats_BoxOverlapsCount(int(featuresB.size()));
+				auto matchCount = 0;
+				for (auto const featureB : featuresB)
+				{
+					matchCount += boost::geometry::intersects(featureA->spatialKey, featureB->spatialKey) ? 1 : 0;
+				}
+
+				if (matchCount > 0)
+				{
+					function_(featureA->id, matchCount);
+				}
+			}
+		}
+
+	public:
+
+		explicit BoostJoin(TFunction& function)
+			: function_{ function }
+		{
+		}
+
+		void operator()(TIndex const& indexA, TIndex const& indexB)
+		{
+			if (indexA.empty() || indexB.empty() || !boost::geometry::intersects(indexA.bounds(), indexB.bounds()))
+			{
+				return;
+			}
+
+			JoinNodes(GetRoot(indexA), indexA.bounds(), GetRoot(indexB), indexB.bounds());
+		}
+	};
+}
+
+
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+int BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryBox(shared_ptr<void> const& indexPtr, BoxType const& queryBox) const
 {
 	auto& index = *static_cast<IndexType const*>(indexPtr.get());
 
@@ -26,8 +149,53 @@ int BoostRtree<TSpatialKey>::QueryBox(shared_ptr<void> const& indexPtr, BoxType
 	return count;
 }
 
-template <typename TSpatialKey>
-double BoostRtree<TSpatialKey>::QueryNearest(shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+bool BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryBoxFeatures(shared_ptr<void> const& indexPtr, BoxType const& queryBox, vector<Feature<TSpatialKey>>& results) const
+{
+	auto& index = *static_cast<IndexType const*>(indexPtr.get());
+
+	index.query(Bgi::intersects(queryBox), OutputIteratorFunction{ [&results](FeaturePtr feature) { results.push_back(*feature); } });
+	return true;
+}
+
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+int BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryBoxVisit(shared_ptr<void> const& indexPtr, BoxType const& queryBox, typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor& visitor) const
+{
+	auto& index = *static_cast<IndexType const*>(indexPtr.get());
+
+	auto count = 0;
+	for (auto feature = index.qbegin(Bgi::intersects(queryBox)); feature != index.qend(); ++feature)
+	{
+		++count;
+		if (!visitor((*feature)->id))
+		{
+			break;
+		}
+	}
+
+	return count;
+}
+
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+int BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryBoxIds(shared_ptr<void> const& indexPtr, BoxType const& queryBox, Span<FeatureId> ids) const
+{
+	auto& index = *static_cast<IndexType const*>(indexPtr.get());
+
+	auto count = 0;
+	index.query(Bgi::intersects(queryBox), OutputIteratorFunction{ [&](FeaturePtr feature)
+		{
+			if (count < Size(ids))
+			{
+				ids[count] = feature->id;
+			}
+
+			++count;
+		} });
+	return count;
+}
+
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+double BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryNearest(shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const
 {
 	using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
 
@@ -56,15 +224,106 @@ double BoostRtree<TSpatialKey>::QueryNearest(shared_ptr<void> const& indexPtr, V
 	return accumulate(nearest.begin(), nearest.end(), 0.0, [](double sum, pair<FeatureId, ScalarType> const& f) { return sum + double(f.second); });
 }
 
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+double BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryNearestRefined(shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount, typename SpatialIndexWrapper<TSpatialKey>::ExactDistances& exactDistances) const
+{
+	using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
+
+	auto& index = *static_cast<IndexType const*>(indexPtr.get());
+	if (index.empty() || nearestCount <= 0)
+	{
+		return 0;
+	}
+
+	// The nearestCount smallest exact distances found so far, in a max-heap
+	vector<ScalarType> nearest;
+	nearest.reserve(nearestCount);
+	for (auto feature = index.qbegin(Bgi::nearest(location, unsigned(index.size()))); feature != index.qend(); ++feature)
+	{
+		if (Size(nearest) == nearestCount && !(GetDistanceSquared(location, (*feature)->spatialKey) < nearest.front()))
+		{
+			break;
+		}
+
+		auto const id = (*feature)->id;
+		ScalarType distanceSquared = 0;
+		exactDistances(location, { &id, 1 }, { &distanceSquared, 1 });
+		if (Size(nearest) < nearestCount)
+		{
+			nearest.push_back(distanceSquared);
+			push_heap(nearest.begin(), nearest.end());
+		}
+		else if (distanceSquared < nearest.front())
+		{
+			pop_heap(nearest.begin(), nearest.end());
+			nearest.back() = distanceSquared;
+			push_heap(nearest.begin(), nearest.end());
+		}
+	}
+
+	return accumulate(nearest.begin(), nearest.end(), 0.0, [](double sum, ScalarType distanceSquared) { return sum + double(distanceSquared); });
+}
+
+template <typename TSpatialKey, int NNodeCapacity, bool IsArena>
+std::int64_t BoostRtree<TSpatialKey, NNodeCapacity, IsArena>::QueryJoin(shared_ptr<void> const& indexPtrA, Span<Feature<TSpatialKey> const> /*featuresA*/, shared_ptr<void> const& indexPtrB, typename SpatialIndexWrapper<TSpatialKey>::JoinCallback& callback) const
+{
+	std::int64_t result = 0;
+	auto reportMatches = [&](FeatureId idA, int matchCount)
+		{
+			callback(idA, matchCount);
+			result += matchCount;
+		};
+	BoostJoin<IndexType, decltype(reportMatches)>{ reportMatches }(*static_cast<IndexType const*>(indexPtrA.get()), *static_cast<IndexType const*>(indexPtrB.get()));
+	return result;
+}
+
 template struct BoostRtree<Vector2>;
 template struct BoostRtree<Vector3f>;
 template struct BoostRtree<Box2>;
 template struct BoostRtree<Box3f>;
+template struct BoostRtree<PaddedVector3f>;
+template struct BoostRtree<Box<PaddedVector3f>>;
+// The geocentric keys of Geodetic.hpp
+template struct BoostRtree<Vector3>;
 #if defined( ENABLE_EIGEN )
 template struct BoostRtree<EVector2>;
 template struct BoostRtree<Box<EVector2>>;
 #endif
 
+// The arena variants, see the "ArenaAllocation" configuration key
+template struct BoostRtree<Vector2, MaxElementsPerNode, true>;
+template struct BoostRtree<Vector3f, MaxElementsPerNode, true>;
+template struct BoostRtree<Box2, MaxElementsPerNode, true>;
+template struct BoostRtree<Box3f, MaxElementsPerNode, true>;
+template struct BoostRtree<PaddedVector3f, MaxElementsPerNode, true>;
+template struct BoostRtree<Box<PaddedVector3f>, MaxElementsPerNode, true>;
+#if defined( ENABLE_EIGEN )
+template struct BoostRtree<EVector2, MaxElementsPerNode, true>;
+template struct BoostRtree<Box<EVector2>, MaxElementsPerNode, true>;
+#endif
+
+#if defined( ENABLE_NODE_CAPACITY_SWEEP )
+// The other capacities of NodeCapacitiesToTest in SpatialIndexTest.cpp
+#define INSTANTIATE_NODE_CAPACITIES(TSpatialKey) \
+	template struct BoostRtree<TSpatialKey, 8>; \
+	template struct BoostRtree<TSpatialKey, 16>; \
+	template struct BoostRtree<TSpatialKey, 64>; \
+	template struct BoostRtree<TSpatialKey, 128>;
+
+INSTANTIATE_NODE_CAPACITIES(Vector2)
+INSTANTIATE_NODE_CAPACITIES(Vector3f)
+INSTANTIATE_NODE_CAPACITIES(Box2)
+INSTANTIATE_NODE_CAPACITIES(Box3f)
+INSTANTIATE_NODE_CAPACITIES(PaddedVector3f)
+INSTANTIATE_NODE_CAPACITIES(Box<PaddedVector3f>)
+#if defined( ENABLE_EIGEN )
+INSTANTIATE_NODE_CAPACITIES(EVector2)
+INSTANTIATE_NODE_CAPACITIES(Box<EVector2>)
+#endif
+
+#undef INSTANTIATE_NODE_CAPACITIES
+#endif
+
 
 #include "catch2/catch_template_test_macros.hpp"
 #include "catch2/benchmark/catch_benchmark.hpp"
@@ -7,11 +7,14 @@
 
 #ifndef ENABLE_BOOST
 
-template <typename TSpatialKey>
+template <typename TSpatialKey, int NNodeCapacity = GeoToolbox::MaxElementsPerNode, bool IsArena = false>
 struct BoostRtree : SpatialIndexWrapper<TSpatialKey>
 {
 };
 
+template <typename TSpatialKey>
+using BoostRtreeArena = BoostRtree<TSpatialKey, GeoToolbox::MaxElementsPerNode, true>;
+
 #else
 
 #include "SpatialIndexWrapper.hpp"
@@ -36,6 +39,10 @@ namespace Bgi = boost::geometry::index;
 BOOST_GEOMETRY_REGISTER_STD_ARRAY_CS(cs::cartesian)
 BOOST_GEOMETRY_REGISTER_BOX(GeoToolbox::Box<GeoToolbox::Vector2>, GeoToolbox::Vector2, Min(), Max())
 BOOST_GEOMETRY_REGISTER_BOX(GeoToolbox::Box<GeoToolbox::Vector3f>, GeoToolbox::Vector3f, Min(), Max())
+// The query boxes of the geocentric keys of Geodetic.hpp
+BOOST_GEOMETRY_REGISTER_BOX(GeoToolbox::Box<GeoToolbox::Vector3>, GeoToolbox::Vector3, Min(), Max())
+BOOST_GEOMETRY_REGISTER_POINT_3D(GeoToolbox::PaddedVector3f, float, cs::cartesian, operator[](0), operator[](1), operator[](2))
+BOOST_GEOMETRY_REGISTER_BOX(GeoToolbox::Box<GeoToolbox::PaddedVector3f>, GeoToolbox::PaddedVector3f, Min(), Max())
 #if defined( ENABLE_EIGEN )
 BOOST_GEOMETRY_REGISTER_POINT_2D(GeoToolbox::EVector2, double, cs::cartesian, operator[](0), operator[](1))
 BOOST_GEOMETRY_REGISTER_BOX(GeoToolbox::Box<GeoToolbox::EVector2>, GeoToolbox::EVector2, Min(), Max())
@@ -54,7 +61,9 @@ struct Bgi::indexable<GeoToolbox::Feature<TSpatialKey> const*>
 };
 
 
-template <typename TSpatialKey>
+// The allocator is a template argument of the Boost R-tree, so the arena variant is a separate index type of its own wrapper, tested only in the arena mode.
+// The baseline keeps the default allocator in both modes
+template <typename TSpatialKey, int NNodeCapacity = GeoToolbox::MaxElementsPerNode, bool IsArena = false>
 struct BoostRtree : SpatialIndexWrapper<TSpatialKey>
 {
 	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
@@ -63,11 +72,33 @@ struct BoostRtree : SpatialIndexWrapper<TSpatialKey>
 
 	using FeaturePtr = GeoToolbox::Feature<TSpatialKey> const*;
 
-	using IndexType = Bgi::rtree<FeaturePtr, Bgi::rstar<GeoToolbox::MaxElementsPerNode>>;
+	using ParametersType = Bgi::rstar<NNodeCapacity>;
+
+	// The arena variant takes the memory from the arena of ArenaIndex
+	using AllocatorType = std::conditional_t<IsArena, std::pmr::polymorphic_allocator<FeaturePtr>, std::allocator<FeaturePtr>>;
+
+	using IndexType = Bgi::rtree<FeaturePtr, ParametersType, Bgi::indexable<FeaturePtr>, Bgi::equal_to<FeaturePtr>, AllocatorType>;
 
 	[[nodiscard]] std::string_view Name() const override
 	{
-		return "Boost " BOOST_LIB_VERSION " R-tree";
+		if constexpr (IsArena)
+		{
+			return UseArenaAllocation() ? "Boost " BOOST_LIB_VERSION " R-tree (arena)" : "";
+		}
+		else
+		{
+			return "Boost " BOOST_LIB_VERSION " R-tree";
+		}
+	}
+
+	[[nodiscard]] int GetNodeCapacity() const override
+	{
+		return NNodeCapacity;
+	}
+
+	[[nodiscard]] bool HasNodeCapacityArgument() const override
+	{
+		return true;
 	}
 
 	[[nodiscard]] bool IsDynamic() const override
@@ -77,13 +108,52 @@ struct BoostRtree : SpatialIndexWrapper<TSpatialKey>
 
 	[[nodiscard]] std::shared_ptr<void> MakeEmptyIndex() const override
 	{
-		return std::make_shared<IndexType>(Bgi::rstar<GeoToolbox::MaxElementsPerNode>{});
+		if constexpr (IsArena)
+		{
+			return ArenaIndex<IndexType>::Make([](std::pmr::memory_resource& resource)
+				{
+					return IndexType{ ParametersType{}, {}, {}, AllocatorType{ &resource } };
+				});
+		}
+		else
+		{
+			return std::make_shared<IndexType>(ParametersType{});
+		}
 	}
 
 	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
 	{
 		auto const data = dataset.GetData();
-		return std::make_shared<IndexType>(GeoToolbox::ValueIterator{ data.data() }, GeoToolbox::ValueIterator{ data.data() + data.size() });
+		auto const first = GeoToolbox::ValueIterator{ data.data() };
+		auto const last = GeoToolbox::ValueIterator{ data.data() + data.size() };
+		if constexpr (IsArena)
+		{
+			return ArenaIndex<IndexType>::Make([first, last](std::pmr::memory_resource& resource)
+				{
+					return IndexType{ first, last, ParametersType{}, {}, {}, AllocatorType{ &resource } };
+				});
+		}
+		else
+		{
+			return std::make_shared<IndexType>(first, last, ParametersType{});
+		}
+	}
+
+	// The copy of the arena variant gets its own arena
+	[[nodiscard]] std::shared_ptr<void> Clone(std::shared_ptr<void> const& indexPtr) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		if constexpr (IsArena)
+		{
+			return ArenaIndex<IndexType>::Make([&index](std::pmr::memory_resource& resource)
+				{
+					return IndexType{ index, AllocatorType{ &resource } };
+				});
+		}
+		else
+		{
+			return std::make_shared<IndexType>(index);
+		}
 	}
 
 	void Insert(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
@@ -102,7 +172,23 @@ struct BoostRtree : SpatialIndexWrapper<TSpatialKey>
 
 	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& box) const override;
 
+	bool QueryBoxFeatures(std::shared_ptr<void> const& indexPtr, BoxType const& box, std::vector<GeoToolbox::Feature<TSpatialKey>>& results) const override;
+
+	// The incremental query that can be stopped allocates its traversal stack on each call, unlike the query into an output iterator used by QueryBoxIds()
+	[[nodiscard]] int QueryBoxVisit(std::shared_ptr<void> const& indexPtr, BoxType const& box, typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor& visitor) const override;
+
+	[[nodiscard]] int QueryBoxIds(std::shared_ptr<void> const& indexPtr, BoxType const& box, GeoToolbox::Span<GeoToolbox::FeatureId> ids) const override;
+
 	[[nodiscard]] double QueryNearest(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override;
+
+	// Refines the features in the order of the incremental nearest query, until the distance to the next key is no less than the nearestCount-th exact distance
+	[[nodiscard]] double QueryNearestRefined(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount, typename SpatialIndexWrapper<TSpatialKey>::ExactDistances& exactDistances) const override;
+
+	// Traverses the two trees together through their nodes
+	[[nodiscard]] std::int64_t QueryJoin(std::shared_ptr<void> const& indexPtrA, GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> featuresA, std::shared_ptr<void> const& indexPtrB, typename SpatialIndexWrapper<TSpatialKey>::JoinCallback& callback) const override;
 };
 
+template <typename TSpatialKey>
+using BoostRtreeArena = BoostRtree<TSpatialKey, GeoToolbox::MaxElementsPerNode, true>;
+
 #endif
@@ -0,0 +1,174 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "SpatialIndexWrapper.hpp"
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+
+// Gives the threads of the mixed read/write scenario access to an index that is not thread-safe by itself.
+// Queries may run concurrently with each other and with the updates, an update is seen by the queries either completely or not at all
+template <typename TSpatialKey>
+class ConcurrencyAdapter
+{
+public:
+
+	using BoxType = typename SpatialIndexWrapper<TSpatialKey>::BoxType;
+	using FeaturePtr = typename SpatialIndexWrapper<TSpatialKey>::FeaturePtr;
+
+
+	virtual ~ConcurrencyAdapter() = default;
+
+	[[nodiscard]] virtual std::string_view Name() const = 0;
+
+	[[nodiscard]] virtual bool Supports(SpatialIndexWrapper<TSpatialKey> const& /*wrapper*/) const
+	{
+		return true;
+	}
+
+	// Takes the index to work on, and returns it back, possibly replaced by an equivalent one
+	virtual void SetIndex(std::shared_ptr<void> index) = 0;
+
+	[[nodiscard]] virtual std::shared_ptr<void> ReleaseIndex() = 0;
+
+	[[nodiscard]] virtual int QueryBox(BoxType const& box) = 0;
+
+	// Erases the feature and inserts it back
+	virtual void Update(FeaturePtr feature) = 0;
+
+protected:
+
+	SpatialIndexWrapper<TSpatialKey> const* wrapper_ = nullptr;
+
+	explicit ConcurrencyAdapter(SpatialIndexWrapper<TSpatialKey> const& wrapper)
+		: wrapper_{ &wrapper }
+	{
+	}
+};
+
+
+// A readers-writer lock around the whole index
+template <typename TSpatialKey>
+class SharedMutexAdapter final : public ConcurrencyAdapter<TSpatialKey>
+{
+	using BaseType = ConcurrencyAdapter<TSpatialKey>;
+
+	std::shared_ptr<void> index_;
+
+	std::shared_mutex mutex_;
+
+public:
+
+	using typename BaseType::BoxType;
+	using typename BaseType::FeaturePtr;
+
+	explicit SharedMutexAdapter(SpatialIndexWrapper<TSpatialKey> const& wrapper)
+		: BaseType{ wrapper }
+	{
+	}
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "SharedMutex";
+	}
+
+	void SetIndex(std::shared_ptr<void> index) override
+	{
+		index_ = std::move(index);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> ReleaseIndex() override
+	{
+		return std::move(index_);
+	}
+
+	[[nodiscard]] int QueryBox(BoxType const& box) override
+	{
+		std::shared_lock const lock{ mutex_ };
+		return this->wrapper_->QueryBox(index_, box);
+	}
+
+	void Update(FeaturePtr feature) override
+	{
+		std::unique_lock const lock{ mutex_ };
+		this->wrapper_->Erase(index_, feature);
+		this->wrapper_->Insert(index_, feature);
+	}
+};
+
+
+// The queries run lock-free on the current snapshot of the index. The writers take turns to clone the snapshot, update the copy and publish it as the new snapshot.
+// The old snapshot is destroyed by the last query that still uses it
+template <typename TSpatialKey>
+class CopyOnWriteAdapter final : public ConcurrencyAdapter<TSpatialKey>
+{
+	using BaseType = ConcurrencyAdapter<TSpatialKey>;
+
+	// Accessed with std::atomic_load/atomic_store
+	std::shared_ptr<void> snapshot_;
+
+	std::mutex writerMutex_;
+
+public:
+
+	using typename BaseType::BoxType;
+	using typename BaseType::FeaturePtr;
+
+	explicit CopyOnWriteAdapter(SpatialIndexWrapper<TSpatialKey> const& wrapper)
+		: BaseType{ wrapper }
+	{
+	}
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "CopyOnWrite";
+	}
+
+	[[nodiscard]] bool Supports(SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		return wrapper.Clone(wrapper.MakeEmptyIndex()) != nullptr;
+	}
+
+	void SetIndex(std::shared_ptr<void> index) override
+	{
+		std::atomic_store(&snapshot_, std::move(index));
+	}
+
+	[[nodiscard]] std::shared_ptr<void> ReleaseIndex() override
+	{
+		return std::atomic_exchange(&snapshot_, std::shared_ptr<void>{});
+	}
+
+	[[nodiscard]] int QueryBox(BoxType const& box) override
+	{
+		auto const snapshot = std::atomic_load(&snapshot_);
+		return this->wrapper_->QueryBox(snapshot, box);
+	}
+
+	void Update(FeaturePtr feature) override
+	{
+		std::lock_guard const lock{ writerMutex_ };
+		auto copy = this->wrapper_->Clone(std::atomic_load(&snapshot_));
+		this->wrapper_->Erase(copy, feature);
+		this->wrapper_->Insert(copy, feature);
+		std::atomic_store(&snapshot_, std::move(copy));
+	}
+};
+
+
+// All adapters, in the order their results are recorded
+template <typename TSpatialKey>
+[[nodiscard]] std::vector<std::unique_ptr<ConcurrencyAdapter<TSpatialKey>>> MakeConcurrencyAdapters(SpatialIndexWrapper<TSpatialKey> const& wrapper)
+{
+	std::vector<std::unique_ptr<ConcurrencyAdapter<TSpatialKey>>> result;
+	result.push_back(std::make_unique<SharedMutexAdapter<TSpatialKey>>(wrapper));
+	result.push_back(std::make_unique<CopyOnWriteAdapter<TSpatialKey>>(wrapper));
+	return result;
+}
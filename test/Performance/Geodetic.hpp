@@ -0,0 +1,126 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Boost.hpp"
+#include "NativePackedRtree.hpp"
+#include "SpatialIndexWrapper.hpp"
+#include "TestTools.hpp"
+
+#include "GeoToolbox/GeometryTools.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Finds the nearest features of a 2D dataset in longitude and latitude degrees by great-circle distance. The centers of the keys are embedded as the points
+// of the unit sphere (GeoToolbox::ToUnitSphere()) in a 3D index of the wrapper, whose nearest search prunes by their chords, and the candidates are refined
+// by their great-circle distances with the haversine formula. Each arc is longer than its chord, so the chords are exact lower bounds, see
+// SpatialIndexWrapper::ExactDistances. The great-circle distance is on the sphere of the mean Earth radius, the distances on the ellipsoid differ from it
+// by up to 0.5%. Supports just Load() and QueryNearestGeodetic(), so the planar scenarios skip it
+template <typename TSpatialKey, template <class> class TWrapper, bool IsPlanar = GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions == 2>
+struct Geodetic : SpatialIndexWrapper<TSpatialKey>
+{
+	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
+
+	using GeocentricKeyType = GeoToolbox::Vector3;
+
+	struct IndexType
+	{
+		// The 3D index refers to the features of its own dataset
+		std::unique_ptr<Dataset<GeocentricKeyType>> dataset;
+		std::shared_ptr<void> index;
+
+		// The locations of the features, indexed by their ids
+		std::vector<GeoToolbox::GeodeticLocation> locations;
+	};
+
+	// The great-circle distances from the location of the query to the features, squared, in radians
+	struct GreatCircleDistances final : SpatialIndexWrapper<GeocentricKeyType>::ExactDistances
+	{
+		IndexType const* index = nullptr;
+		GeoToolbox::GeodeticLocation location;
+
+		void operator()(GeocentricKeyType const& /*location*/, GeoToolbox::Span<GeoToolbox::FeatureId const> ids, GeoToolbox::Span<double> distancesSquared) override
+		{
+			for (auto i = 0; i < GeoToolbox::Size(ids); ++i)
+			{
+				auto const distance = GeoToolbox::GetGreatCircleDistance(location, index->locations[ids[i]]);
+				distancesSquared[i] = distance * distance;
+			}
+		}
+	};
+
+
+	TWrapper<GeocentricKeyType> wrapper;
+
+	// Made on each call, the name of the wrapped index depends on the configuration
+	mutable std::string name;
+
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		name = !wrapper.Name().empty() ? "Geodetic " + std::string(wrapper.Name()) : std::string{};
+		return name;
+	}
+
+	[[nodiscard]] bool SupportsDatasetSize(int size) const override
+	{
+		return wrapper.SupportsDatasetSize(size);
+	}
+
+	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
+	{
+		return wrapper.GetIndexStats(static_cast<IndexType const*>(indexPtr.get())->index);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
+	{
+		auto result = std::make_shared<IndexType>();
+		std::vector<GeoToolbox::Feature<GeocentricKeyType>> data;
+		data.reserve(dataset.GetData().size());
+		for (auto const& feature : dataset.GetData())
+		{
+			auto const center = GeoToolbox::SpatialKeyTraits<TSpatialKey>::GetCenter(feature.spatialKey);
+			auto const location = GeoToolbox::GeodeticLocation::FromDegrees(double(center[0]), double(center[1]));
+			if (feature.id >= GeoToolbox::Size(result->locations))
+			{
+				result->locations.resize(feature.id + 1);
+			}
+
+			result->locations[feature.id] = location;
+			data.push_back({ feature.id, GeoToolbox::ToUnitSphere<GeocentricKeyType>(location) });
+		}
+
+		result->dataset = std::make_unique<Dataset<GeocentricKeyType>>(dataset.GetName(), std::move(data));
+		result->index = wrapper.Load(*result->dataset);
+		return result->index != nullptr ? result : nullptr;
+	}
+
+	[[nodiscard]] double QueryNearestGeodetic(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		GreatCircleDistances distances;
+		distances.index = &index;
+		distances.location = GeoToolbox::GeodeticLocation::FromDegrees(double(location[0]), double(location[1]));
+		auto const result = wrapper.QueryNearestRefined(index.index, GeoToolbox::ToUnitSphere<GeocentricKeyType>(distances.location), nearestCount, distances);
+		return result >= 0 ? result * GeoToolbox::EarthMeanRadius * GeoToolbox::EarthMeanRadius : -1;
+	}
+};
+
+template <typename TSpatialKey, template <class> class TWrapper>
+struct Geodetic<TSpatialKey, TWrapper, false> : SpatialIndexWrapper<TSpatialKey>
+{
+};
+
+template <typename TSpatialKey>
+using GeodeticStdVector = Geodetic<TSpatialKey, StdVector>;
+
+template <typename TSpatialKey>
+using GeodeticBoostRtree = Geodetic<TSpatialKey, BoostRtree>;
+
+template <typename TSpatialKey>
+using GeodeticNativePackedRtree = Geodetic<TSpatialKey, NativePackedRtree>;
@@ -17,7 +17,7 @@ All of these have wrappers here, but just TemplateSTRtree is included in the lis
 
 #ifndef ENABLE_GEOS
 
-template <typename TSpatialKey>
+template <typename TSpatialKey, int NNodeCapacity = GeoToolbox::MaxElementsPerNode>
 struct GeosTemplateStrTree : SpatialIndexWrapper<TSpatialKey>
 {
 };
@@ -62,7 +62,7 @@ geos::geom::Envelope ToEnvelope(GeoToolbox::Box<TVector> const& box)
 	return geos::geom::Envelope{ box.Min()[0], box.Max()[0], box.Min()[1], box.Max()[1] };
 }
 
-template <typename TSpatialKey, bool DimensionsMatch = GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions == 2>
+template <typename TSpatialKey, int NNodeCapacity = GeoToolbox::MaxElementsPerNode, bool DimensionsMatch = GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions == 2>
 struct GeosTemplateStrTree : SpatialIndexWrapper<TSpatialKey>
 {
 	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
@@ -77,6 +77,16 @@ struct GeosTemplateStrTree : SpatialIndexWrapper<TSpatialKey>
 		return "GEOS " GEOS_VERSION " STR-tree";
 	}
 
+	[[nodiscard]] int GetNodeCapacity() const override
+	{
+		return NNodeCapacity;
+	}
+
+	[[nodiscard]] bool HasNodeCapacityArgument() const override
+	{
+		return true;
+	}
+
 	[[nodiscard]] bool IsDynamic() const override
 	{
 		// TemplateSTRtree does have a remove() operation, but maybe I don't know how to use it properly, because the query crashes later. For now use it as static index.
@@ -129,7 +139,7 @@ struct GeosTemplateStrTree : SpatialIndexWrapper<TSpatialKey>
 
 	[[nodiscard]] std::shared_ptr<void> MakeEmptyIndex() const override
 	{
-		return std::make_shared<IndexType>(GeoToolbox::MaxElementsPerNode);
+		return std::make_shared<IndexType>(std::size_t(NNodeCapacity));
 	}
 
 	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
@@ -175,10 +185,23 @@ struct GeosTemplateStrTree : SpatialIndexWrapper<TSpatialKey>
 			});
 		return count;
 	}
+
+	// TemplateSTRtree stops the query when the visitor returns false
+	[[nodiscard]] int QueryBoxVisit(std::shared_ptr<void> const& indexPtr, BoxType const& box, typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor& visitor) const override
+	{
+		auto& index = *const_cast<IndexType*>(static_cast<IndexType const*>(indexPtr.get()));
+		auto count = 0;
+		index.query(ToEnvelope(box), [&](FeaturePtr feature)
+			{
+				++count;
+				return visitor(feature->id);
+			});
+		return count;
+	}
 };
 
-template <typename TSpatialKey>
-struct GeosTemplateStrTree<TSpatialKey, false> : SpatialIndexWrapper<TSpatialKey>
+template <typename TSpatialKey, int NNodeCapacity>
+struct GeosTemplateStrTree<TSpatialKey, NNodeCapacity, false> : SpatialIndexWrapper<TSpatialKey>
 {
 };
 
@@ -0,0 +1,375 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Geos.hpp"
+#include "NanoflannAdapter.hpp"
+#include "NativePackedRtree.hpp"
+#include "SpatialIndexWrapper.hpp"
+#include "TestTools.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Makes a static index dynamic with the logarithmic method of Bentley and Saxe. The inserted features are gathered in a small unindexed buffer,
+// a full buffer is merged with the levels of sizes BufferCapacity * 2^i like a binary counter carries, and the merged features are loaded in the first empty level.
+// Erased features are recorded as tombstones, subtracted from the query results and dropped when their level is rebuilt, all of them are dropped on Rebalance() or
+// when they become too many. The box query sums the counts of the levels and the buffer, minus the tombstones found by the query.
+// The nearest queries of the static indices only return the sum of the distances, so the results of several levels cannot be merged,
+// QueryNearest() is supported only while the index has a single level, without tombstones and buffered features, as it is after Load()
+template <typename TSpatialKey, template <class> class TStaticWrapper>
+struct LogarithmicMethod : SpatialIndexWrapper<TSpatialKey>
+{
+	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
+	using BoxType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::BoxType;
+	using FeaturePtr = typename SpatialIndexWrapper<TSpatialKey>::FeaturePtr;
+
+	static constexpr auto BufferCapacity = 256;
+
+	// Rebuild all levels when the tombstones exceed this fraction of the features, to limit the cost of subtracting them in the queries
+	static constexpr auto MaxTombstonesFraction = 16;
+
+	struct Level
+	{
+		// The static index refers to the features of its own dataset, which is a copy of the merged ones
+		std::unique_ptr<Dataset<TSpatialKey>> dataset;
+		std::shared_ptr<void> index;
+
+		[[nodiscard]] bool IsEmpty() const noexcept
+		{
+			return dataset == nullptr;
+		}
+	};
+
+	struct IndexType
+	{
+		std::vector<Level> levels;
+
+		// The indices of the unordered buffer and of the tombstones for StdVector::QueryBox()
+		std::shared_ptr<void> buffer = std::make_shared<typename StdVector<TSpatialKey>::IndexType>();
+		std::shared_ptr<void> tombstones = std::make_shared<typename StdVector<TSpatialKey>::IndexType>();
+
+		// The level of each tombstone, parallel to tombstones
+		std::vector<int> tombstoneLevels;
+
+		// The level of each feature stored in a level and not erased
+		std::unordered_map<GeoToolbox::FeatureId, int> featureLevels;
+
+		// The position of each feature in the buffer, so that Erase() finds it by id without scanning the buffer
+		std::unordered_map<GeoToolbox::FeatureId, int> bufferPositions;
+
+		[[nodiscard]] std::vector<FeaturePtr>& GetBuffer() const
+		{
+			return *static_cast<std::vector<FeaturePtr>*>(buffer.get());
+		}
+
+		[[nodiscard]] std::vector<FeaturePtr>& GetTombstones() const
+		{
+			return *static_cast<std::vector<FeaturePtr>*>(tombstones.get());
+		}
+
+		[[nodiscard]] int GetSize() const
+		{
+			return int(featureLevels.size() + GetBuffer().size());
+		}
+	};
+
+
+	TStaticWrapper<TSpatialKey> staticWrapper;
+
+	// Queries the buffer and the tombstones
+	StdVector<TSpatialKey> bufferWrapper;
+
+	std::string name = !staticWrapper.Name().empty() ? "Dynamic " + std::string(staticWrapper.Name()) : std::string{};
+
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return name;
+	}
+
+	[[nodiscard]] bool IsDynamic() const override
+	{
+		return true;
+	}
+
+	[[nodiscard]] bool SupportsDatasetSize(int size) const override
+	{
+		return staticWrapper.SupportsDatasetSize(size);
+	}
+
+	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		auto levelCount = 0;
+		for (auto const& level : index.levels)
+		{
+			levelCount += level.IsEmpty() ? 0 : 1;
+		}
+
+		return "Levels: " + std::to_string(levelCount) + " Buffer: " + std::to_string(index.GetBuffer().size()) + " Tombstones: " + std::to_string(index.GetTombstones().size());
+	}
+
+	[[nodiscard]] std::shared_ptr<void> MakeEmptyIndex() const override
+	{
+		return std::make_shared<IndexType>();
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
+	{
+		auto result = std::make_shared<IndexType>();
+		auto const data = dataset.GetData();
+		if (!LoadLevel(*result, GetLevelIndex(dataset.GetSize()), { data.begin(), data.end() }))
+		{
+			return nullptr;
+		}
+
+		return result;
+	}
+
+	void Insert(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		auto& buffer = index.GetBuffer();
+		index.bufferPositions[feature->id] = int(buffer.size());
+		buffer.push_back(feature);
+		if (int(buffer.size()) < BufferCapacity)
+		{
+			return;
+		}
+
+		// Carry the buffer and the full levels below the first empty one into it
+		std::vector<GeoToolbox::Feature<TSpatialKey>> merged;
+		merged.reserve(buffer.size());
+		for (auto const bufferedFeature : buffer)
+		{
+			merged.push_back(*bufferedFeature);
+		}
+
+		buffer.clear();
+		index.bufferPositions.clear();
+		auto levelIndex = 0;
+		for (; levelIndex < int(index.levels.size()) && !index.levels[levelIndex].IsEmpty(); ++levelIndex)
+		{
+			AppendLiveFeatures(index, levelIndex, merged);
+		}
+
+		DropTombstones(index, levelIndex);
+		LoadLevel(index, levelIndex, std::move(merged));
+	}
+
+	bool Erase(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		if (auto const buffered = index.bufferPositions.find(feature->id); buffered != index.bufferPositions.end())
+		{
+			EraseFromBuffer(index, buffered);
+			return true;
+		}
+
+		auto const location = index.featureLevels.find(feature->id);
+		if (location == index.featureLevels.end())
+		{
+			return false;
+		}
+
+		auto const levelIndex = location->second;
+		index.featureLevels.erase(location);
+		index.GetTombstones().push_back(feature);
+		index.tombstoneLevels.push_back(levelIndex);
+
+		if (int(index.GetTombstones().size()) > std::max(BufferCapacity, index.GetSize() / MaxTombstonesFraction))
+		{
+			Compact(index);
+		}
+
+		return true;
+	}
+
+	// Drops all tombstones, by loading the live features of all levels in a single one
+	void Rebalance(std::shared_ptr<void> const& indexPtr) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		if (!index.GetTombstones().empty())
+		{
+			Compact(index);
+		}
+	}
+
+	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& box) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		auto result = bufferWrapper.QueryBox(index.buffer, box);
+		for (auto const& level : index.levels)
+		{
+			if (!level.IsEmpty())
+			{
+				auto const count = staticWrapper.QueryBox(level.index, box);
+				if (count < 0)
+				{
+					return -1;
+				}
+
+				result += count;
+			}
+		}
+
+		if (!index.GetTombstones().empty())
+		{
+			result -= bufferWrapper.QueryBox(index.tombstones, box);
+		}
+
+		return result;
+	}
+
+	[[nodiscard]] double QueryNearest(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		if (!index.GetBuffer().empty() || !index.GetTombstones().empty())
+		{
+			return -1;
+		}
+
+		Level const* single = nullptr;
+		for (auto const& level : index.levels)
+		{
+			if (!level.IsEmpty())
+			{
+				if (single != nullptr)
+				{
+					return -1;
+				}
+
+				single = &level;
+			}
+		}
+
+		return single != nullptr ? staticWrapper.QueryNearest(single->index, location, nearestCount) : -1;
+	}
+
+private:
+
+	// The first level of capacity BufferCapacity * 2^i that can hold size features
+	[[nodiscard]] static int GetLevelIndex(int size)
+	{
+		auto result = 0;
+		for (auto capacity = BufferCapacity; capacity < size; capacity *= 2)
+		{
+			++result;
+		}
+
+		return result;
+	}
+
+	// Moves the last buffered feature to the position of the erased one
+	static void EraseFromBuffer(IndexType& index, typename std::unordered_map<GeoToolbox::FeatureId, int>::iterator buffered)
+	{
+		auto& buffer = index.GetBuffer();
+		auto const position = buffered->second;
+		index.bufferPositions.erase(buffered);
+		if (position != int(buffer.size()) - 1)
+		{
+			buffer[position] = buffer.back();
+			index.bufferPositions[buffer[position]->id] = position;
+		}
+
+		buffer.pop_back();
+	}
+
+	// Appends the features of the level that are not erased and empties the level, its tombstones are kept for DropTombstones()
+	static void AppendLiveFeatures(IndexType& index, int levelIndex, std::vector<GeoToolbox::Feature<TSpatialKey>>& merged)
+	{
+		auto& level = index.levels[levelIndex];
+		for (auto const& feature : level.dataset->GetData())
+		{
+			// A feature erased from this level and inserted again is in the buffer or in another level
+			auto const location = index.featureLevels.find(feature.id);
+			if (location != index.featureLevels.end() && location->second == levelIndex)
+			{
+				merged.push_back(feature);
+			}
+		}
+
+		level = {};
+	}
+
+	// Removes the tombstones of the levels below levelIndex, which are merged into it
+	static void DropTombstones(IndexType& index, int levelIndex)
+	{
+		auto& tombstones = index.GetTombstones();
+		auto kept = 0;
+		for (auto i = 0; i < int(tombstones.size()); ++i)
+		{
+			if (index.tombstoneLevels[i] >= levelIndex)
+			{
+				tombstones[kept] = tombstones[i];
+				index.tombstoneLevels[kept] = index.tombstoneLevels[i];
+				++kept;
+			}
+		}
+
+		tombstones.resize(kept);
+		index.tombstoneLevels.resize(kept);
+	}
+
+	void Compact(IndexType& index) const
+	{
+		std::vector<GeoToolbox::Feature<TSpatialKey>> merged;
+		merged.reserve(index.featureLevels.size());
+		for (auto levelIndex = 0; levelIndex < int(index.levels.size()); ++levelIndex)
+		{
+			if (!index.levels[levelIndex].IsEmpty())
+			{
+				AppendLiveFeatures(index, levelIndex, merged);
+			}
+		}
+
+		index.GetTombstones().clear();
+		index.tombstoneLevels.clear();
+		index.levels.clear();
+		if (!merged.empty())
+		{
+			auto const levelIndex = GetLevelIndex(int(merged.size()));
+			LoadLevel(index, levelIndex, std::move(merged));
+		}
+	}
+
+	bool LoadLevel(IndexType& index, int levelIndex, std::vector<GeoToolbox::Feature<TSpatialKey>> features) const
+	{
+		if (int(index.levels.size()) <= levelIndex)
+		{
+			index.levels.resize(levelIndex + 1);
+		}
+
+		auto& level = index.levels[levelIndex];
+		level.dataset = std::make_unique<Dataset<TSpatialKey>>("Level " + std::to_string(levelIndex), std::move(features));
+		level.index = staticWrapper.Load(*level.dataset);
+		if (level.index == nullptr)
+		{
+			level = {};
+			return false;
+		}
+
+		for (auto const& feature : level.dataset->GetData())
+		{
+			index.featureLevels[feature.id] = levelIndex;
+		}
+
+		return true;
+	}
+};
+
+template <typename TSpatialKey>
+using DynamicNanoflannStaticKdtree = LogarithmicMethod<TSpatialKey, NanoflannStaticKdtree>;
+
+template <typename TSpatialKey>
+using DynamicGeosTemplateStrTree = LogarithmicMethod<TSpatialKey, GeosTemplateStrTree>;
+
+template <typename TSpatialKey>
+using DynamicNativePackedRtree = LogarithmicMethod<TSpatialKey, NativePackedRtree>;
@@ -0,0 +1,298 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "TestTools.hpp"
+#include "GeoToolbox/GeometryTools.hpp"
+#include "GeoToolbox/Profiling.hpp"
+#include "GeoToolbox/SpatialTools.hpp"
+#include "GeoToolbox/StlExtensions.hpp"
+
+#include "catch2/catch_test_macros.hpp"
+
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace GeoToolbox;
+using namespace std;
+
+// Times the primitives that the spatial indices and the test scenarios are built of, each one over a batch of random spatial keys,
+// and records the results in the same format as CompareSpatialIndices, under the "Micro" scenario
+
+namespace
+{
+	using SpatialKeysToBenchmark = TypeList<
+		Vector2, Box2
+#if defined(ENABLE_EIGEN)
+		, EVector2, Box<EVector2>
+		, EVector3, Box<EVector3>
+#endif
+		, Vector3f, Box3f
+		, PaddedVector3f, Box<PaddedVector3f>
+	>;
+
+	constexpr auto MicroScenario = "Micro";
+
+	constexpr auto PrimitivesName = "GeoToolbox";
+
+	constexpr auto DatasetName = "Uniform";
+
+	// Large enough for the batch to take a measurable count of microseconds, small enough to stay mostly in the cache
+	constexpr auto BatchSize = 1 << 16;
+
+	constexpr auto OpNameBoxAdd = "Box::Add";
+	constexpr auto OpNameOverlap = "Overlap";
+	constexpr auto OpNameGetDistanceSquared = "GetDistanceSquared";
+	constexpr auto OpNameQueryIterator = "QueryIterator::operator++";
+	constexpr auto OpNameTransform = "Transform";
+	constexpr auto OpNameParallelCountIf = "ParallelCountIf";
+
+	// The order of the printed results
+	constexpr std::array OperationNames{ OpNameBoxAdd, OpNameOverlap, OpNameGetDistanceSquared, OpNameQueryIterator, OpNameTransform, OpNameParallelCountIf };
+
+
+	template <typename TSpatialKey>
+	class PrimitivesBenchmark
+	{
+		using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+		using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
+		using BoxType = Box<VectorType>;
+
+		static constexpr auto Dimensions = int(SpatialKeyTraits<TSpatialKey>::Dimensions);
+
+		static constexpr auto Extent = ScalarType(10);
+
+
+		Dataset<TSpatialKey> dataset_;
+
+		BoxType queryBox_;
+
+		VectorType location_;
+
+		Timings timings_{ Timings::MsPerSecond };
+
+		unique_ptr<HardwareCounters> hardwareCounters_;
+
+		// The count of primitive operations done by one run of each action, to print the time per operation
+		map<string_view, int64_t> operationCounts_;
+
+		// Accumulates the results of the actions, so that they are not optimized away
+		double sink_ = 0;
+
+	public:
+
+		PrimitivesBenchmark()
+			: dataset_{ DatasetName, ParallelMakeRandomSpatialKeys<TSpatialKey>(13, BatchSize, BoxType::Square(Extent), { ScalarType(1e-7), ScalarType(0.01) }) }
+			, queryBox_{ BoxType::FromCenterAndSize(Flat<VectorType>(Extent / 2), Extent / 4) }
+			, location_{ Flat<VectorType>(Extent / 3) }
+		{
+			SetUpBenchmarkTimings(timings_);
+
+			if (GetConfig().Get<bool>("HardwareCounters"))
+			{
+				hardwareCounters_ = make_unique<HardwareCounters>();
+				timings_.SetHardwareCounters(hardwareCounters_.get());
+			}
+		}
+
+		void Run()
+		{
+			auto const& features = dataset_.GetData();
+
+			// A grid of about BatchSize queries over the dataset bounds, cycling over 3 sizes like the queries of the Load-QueryBox-Destroy scenario
+			auto const samplesPerAxis = int(std::lround(std::pow(double(BatchSize), 1.0 / Dimensions)));
+			QueryIterator const firstQuery{ location_, dataset_.GetBoundingBox(), samplesPerAxis, { Extent / 1024, Extent / 128, Extent / 16 } };
+
+			// The operation counts are the same in each run, count them outside of the timed actions
+			int64_t queryCount = 0;
+			for (auto query = firstQuery; query != QueryIterator<VectorType>{}; ++query)
+			{
+				++queryCount;
+			}
+
+			for (auto const actionName : OperationNames)
+			{
+				operationCounts_[actionName] = Size(features);
+			}
+
+			operationCounts_[OpNameQueryIterator] = queryCount;
+
+			while (timings_.NextIteration())
+			{
+				timings_.Record(OpNameBoxAdd, [&]
+					{
+						BoxType box;
+						for (auto const& feature : features)
+						{
+							box.Add(feature.spatialKey);
+						}
+
+						return Consume(box.Min()[0]);
+					});
+
+				timings_.Record(OpNameOverlap, [&]
+					{
+						auto count = 0;
+						for (auto const& feature : features)
+						{
+							count += Overlap(queryBox_, feature.spatialKey) ? 1 : 0;
+						}
+
+						return Consume(count);
+					});
+
+				timings_.Record(OpNameGetDistanceSquared, [&]
+					{
+						ScalarType sum = 0;
+						for (auto const& feature : features)
+						{
+							sum += GetDistanceSquared(location_, feature.spatialKey);
+						}
+
+						return Consume(sum);
+					});
+
+				timings_.Record(OpNameQueryIterator, [&]
+					{
+						ScalarType sum = 0;
+						for (auto query = firstQuery; query != QueryIterator<VectorType>{}; ++query)
+						{
+							sum += query->Min()[0];
+						}
+
+						return Consume(sum);
+					});
+
+				timings_.Record(OpNameTransform, [&]
+					{
+						auto const centers = Transform(features, [](Feature<TSpatialKey> const& feature) { return SpatialKeyTraits<TSpatialKey>::GetCenter(feature.spatialKey); });
+						return Consume(centers.back()[0]);
+					});
+
+				timings_.Record(OpNameParallelCountIf, [&]
+					{
+						auto const count = ParallelCountIf(features, [this](Feature<TSpatialKey> const& feature) { return Overlap(queryBox_, feature.spatialKey); });
+						return Consume(count);
+					});
+			}
+		}
+
+		void StoreResults(PerfRecord& perfRecord) const
+		{
+			auto const resetResults = GetConfig().Get<bool>("Reset");
+
+			for (auto const actionName : OperationNames)
+			{
+				auto const& action = timings_.GetAllActions().at(actionName);
+				auto const nsPerOperation = action.bestTime * 1000 / double(operationCounts_.at(actionName));
+				ostringstream info;
+				info << std::setprecision(3) << std::fixed << nsPerOperation << " ns/op";
+
+				auto entry = perfRecord.MakeEntry(dataset_, PrimitivesName, MicroScenario, actionName);
+				PerfRecord::Stats stats{ int64_t(action.bestTime), 0, action.failed };
+				auto const& counters = action.hardwareCounters;
+				stats.cycles = counters[HardwareCounters::Cycles];
+				stats.instructions = counters[HardwareCounters::Instructions];
+				stats.l1DataMisses = counters[HardwareCounters::L1DataMisses];
+				stats.lastLevelCacheMisses = counters[HardwareCounters::LastLevelCacheMisses];
+				stats.branchMisses = counters[HardwareCounters::BranchMisses];
+				stats.dataTlbMisses = counters[HardwareCounters::DataTlbMisses];
+				PerfRecord::SetSampleStats(stats, action);
+				stats.info = info.str();
+
+				cout << "\t\t" << actionName << '\t' << stats.info;
+				if (resetResults)
+				{
+					perfRecord.SetEntry(entry, stats);
+				}
+				else
+				{
+					auto const previousStats = perfRecord.FindEntry(entry);
+					auto const verdict = previousStats != nullptr ? PerfRecord::Compare(*previousStats, stats) : PerfRecord::Verdict::Unknown;
+
+					// The change of the best time compared to the previous record of this entry, if there is one
+					pair<int64_t, int64_t> oldAndNewBestTimes{};
+					perfRecord.MergeEntry(entry, stats, &oldAndNewBestTimes);
+					if (oldAndNewBestTimes.first > 0 && oldAndNewBestTimes.second > 0)
+					{
+						auto const changeFactor = double(oldAndNewBestTimes.second) * 100.0 / double(oldAndNewBestTimes.first);
+						cout << '\t' << std::setprecision(1) << std::fixed << (changeFactor >= 100 ? '+' : '-') << std::abs(changeFactor - 100) << '%';
+					}
+
+					if (verdict != PerfRecord::Verdict::Unknown)
+					{
+						cout << '\t' << (verdict == PerfRecord::Verdict::NotSignificant ? "not significant" : verdict == PerfRecord::Verdict::Slower ? "significantly slower" : "significantly faster");
+					}
+				}
+
+				cout << '\n';
+			}
+		}
+
+	private:
+
+		template <typename T>
+		int Consume(T value)
+		{
+			sink_ += double(DoNotOptimize(value));
+			return 0;
+		}
+	};
+
+
+	template <typename TSpatialKey>
+	void RunPrimitives(PerfRecord& perfRecord)
+	{
+		if (!IsSelected("SpatialKey", SpatialKeyTraits<TSpatialKey>::GetName(), 0)
+			|| !IsSelected("Dimensions", std::to_string(SpatialKeyTraits<TSpatialKey>::Dimensions), 0)
+			|| !IsSelected("Vector", SpatialKeyTraits<TSpatialKey>::VectorTraitsType::Name, 0))
+		{
+			return;
+		}
+
+		cout << "\n--- " << SpatialKeyTraits<TSpatialKey>::GetName() << '\n';
+
+		PrimitivesBenchmark<TSpatialKey> benchmark;
+		benchmark.Run();
+		benchmark.StoreResults(perfRecord);
+	}
+}
+
+
+TEST_CASE("MicroBenchmarks", "[.Performance]")
+{
+	if (GetRootPath().empty())
+	{
+		SKIP("Run from a directory under the project root");
+	}
+
+	create_directory(GetOutputPath());
+
+	auto const configFilePath = GetOutputPath() / (GetCatchTestName() + ".cfg");
+	if (is_regular_file(configFilePath))
+	{
+		GetConfig().ReadFile(configFilePath, false);
+	}
+
+	WarnInDebugBuild();
+	SetUpBenchmarkEnvironment();
+
+	PerfRecord perfRecord{ GetCatchTestName() };
+	cout << "RunId: " << perfRecord.GetRunId() << '\n';
+
+	TypeListForEach<SpatialKeysToBenchmark>([&perfRecord]([[maybe_unused]] auto spatialKey)
+		{
+			RunPrimitives<decltype(spatialKey)>(perfRecord);
+		});
+
+	if (GetConfig().Get<bool>("Record"))
+	{
+		perfRecord.Save();
+	}
+}
@@ -34,6 +34,7 @@ struct NanoflannStaticKdtree : SpatialIndexWrapper<TSpatialKey>
 #undef malloc
 #undef free
 
+#include <fstream>
 #include <queue>
 
 #ifdef _MSC_VER
@@ -48,8 +49,11 @@ struct NanoflannStaticKdtreeBase : SpatialIndexWrapper<TSpatialKey>
 		return "nanoflann " MAKE_STRING(NANOFLANN_VERSION) " Align " MAKE_STRING(NANOFLANN_NODE_ALIGNMENT);
 	}
 
-	// Parallel build does run faster, but only in rare cases
-	static constexpr auto MaxThreadCount = 1; // 8;
+	// The other scenarios load on a single thread, the ParallelLoad-Destroy one measures the speedup of the parallel build of nanoflann
+	[[nodiscard]] bool SupportsParallelLoad() const override
+	{
+		return true;
+	}
 
 	template <class TreeType>
 	static std::string GetTreeStats(TreeType const& tree)
@@ -90,6 +94,29 @@ struct NanoflannStaticKdtreeBase : SpatialIndexWrapper<TSpatialKey>
 		stream << " Height: " << maxHeight;
 		return stream.str();
 	}
+
+	// saveIndex() writes the permutation of the points and the nodes, not the points, so the opened tree needs the dataset it was built from
+	template <class TreeType>
+	static bool SaveTree(TreeType const& tree, std::filesystem::path const& filePath)
+	{
+		std::ofstream file{ filePath, std::ios::binary | std::ios::trunc };
+		tree.saveIndex(file);
+		return bool(file);
+	}
+
+	// index is made with the SkipInitialBuildIndex flag, loadIndex() reads the tree into it
+	template <class TIndex>
+	static std::shared_ptr<void> OpenTree(std::shared_ptr<TIndex> index, std::filesystem::path const& filePath)
+	{
+		std::ifstream file{ filePath, std::ios::binary };
+		if (!file)
+		{
+			return nullptr;
+		}
+
+		index->second->loadIndex(file);
+		return file ? index : nullptr;
+	}
 };
 
 template <typename TVector>
@@ -109,6 +136,9 @@ struct NanoflannStaticKdtree final : NanoflannStaticKdtreeBase<TVector>
 	{
 		Dataset<Point> const* dataset = nullptr;
 
+		// The coordinate columns of the dataset, read directly while building the tree
+		std::array<ScalarType const*, Dimensions> coordinates{};
+
 		[[nodiscard]] size_t kdtree_get_point_count() const
 		{
 			return dataset != nullptr ? size_t(dataset->GetSize()) : 0;
@@ -117,8 +147,7 @@ struct NanoflannStaticKdtree final : NanoflannStaticKdtreeBase<TVector>
 		[[nodiscard]] ScalarType kdtree_get_pt(size_t index, size_t const dim) const
 		{
 			DEBUG_ASSERT(dim < Dimensions);
-			auto const& feature = dataset->GetData()[index];
-			return feature.spatialKey[dim];
+			return coordinates[dim][index];
 		}
 
 		template <class BBOX>
@@ -180,15 +209,36 @@ struct NanoflannStaticKdtree final : NanoflannStaticKdtreeBase<TVector>
 		return true;
 	}
 
-	[[nodiscard]] std::shared_ptr<void> Load(Dataset<Point> const& dataset) const override
+	[[nodiscard]] static std::shared_ptr<IndexType> MakeIndex(Dataset<Point> const& dataset, nanoflann::KDTreeSingleIndexAdaptorFlags flags, int threadCount = 1)
 	{
 		auto result = std::make_shared<IndexType>();
 		result->first.dataset = &dataset;
-		auto const params = nanoflann::KDTreeSingleIndexAdaptorParams(GeoToolbox::MaxElementsPerNode, nanoflann::KDTreeSingleIndexAdaptorFlags::None, NanoflannStaticKdtreeBase<TVector>::MaxThreadCount);
+		result->first.coordinates = dataset.GetColumns().GetMinPointers();
+		auto const params = nanoflann::KDTreeSingleIndexAdaptorParams(GeoToolbox::MaxElementsPerNode, flags, unsigned(threadCount));
 		result->second = std::make_unique<TreeType>(int(Dimensions), result->first, params);
 		return result;
 	}
 
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<Point> const& dataset) const override
+	{
+		return MakeIndex(dataset, nanoflann::KDTreeSingleIndexAdaptorFlags::None);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> LoadParallel(Dataset<Point> const& dataset, int threadCount) const override
+	{
+		return MakeIndex(dataset, nanoflann::KDTreeSingleIndexAdaptorFlags::None, threadCount);
+	}
+
+	bool Save(std::shared_ptr<void> const& indexPtr, std::filesystem::path const& filePath) const override
+	{
+		return NanoflannStaticKdtreeBase<TVector>::SaveTree(*static_cast<IndexType const*>(indexPtr.get())->second, filePath);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Open(std::filesystem::path const& filePath, Dataset<Point> const& dataset) const override
+	{
+		return NanoflannStaticKdtreeBase<TVector>::OpenTree(MakeIndex(dataset, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex), filePath);
+	}
+
 	struct QueryBoxResultSet
 	{
 		std::vector<int> indices;
@@ -304,6 +354,9 @@ struct NanoflannStaticKdtree<GeoToolbox::Box<TVector>> final : NanoflannStaticKd
 	{
 		Dataset<BoxType> const* dataset = nullptr;
 
+		// The coordinate columns of the dataset, the low bounds followed by the high bounds, read directly while building the tree
+		std::array<ScalarType const*, Dimensions * 2> coordinates{};
+
 		[[nodiscard]] size_t kdtree_get_point_count() const
 		{
 			return dataset != nullptr ? size_t(dataset->GetSize()) : 0;
@@ -312,8 +365,7 @@ struct NanoflannStaticKdtree<GeoToolbox::Box<TVector>> final : NanoflannStaticKd
 		[[nodiscard]] ScalarType kdtree_get_pt(size_t index, size_t const dim) const
 		{
 			DEBUG_ASSERT(dim < Dimensions * 2);
-			auto const& feature = dataset->GetData()[index];
-			return feature.spatialKey[int(dim) / Dimensions][dim % Dimensions];
+			return coordinates[dim][index];
 		}
 
 		template <class BBOX>
@@ -326,15 +378,42 @@ struct NanoflannStaticKdtree<GeoToolbox::Box<TVector>> final : NanoflannStaticKd
 	using TreeType = nanoflann::KDTreeSingleIndexAdaptor<nanoflann::L2_Simple_Adaptor<ScalarType, Data, ScalarType, int>, Data, Dimensions * 2, int>;
 	using IndexType = std::pair<Data, std::unique_ptr<TreeType>>;
 
-	[[nodiscard]] std::shared_ptr<void> Load(Dataset<BoxType> const& dataset) const override
+	[[nodiscard]] static std::shared_ptr<IndexType> MakeIndex(Dataset<BoxType> const& dataset, nanoflann::KDTreeSingleIndexAdaptorFlags flags, int threadCount = 1)
 	{
 		auto result = std::make_shared<IndexType>();
 		result->first.dataset = &dataset;
-		auto const params = nanoflann::KDTreeSingleIndexAdaptorParams(GeoToolbox::MaxElementsPerNode, nanoflann::KDTreeSingleIndexAdaptorFlags::None, BaseType::MaxThreadCount);
+		auto const& columns = dataset.GetColumns();
+		for (auto axis = 0; axis < int(Dimensions); ++axis)
+		{
+			result->first.coordinates[axis] = columns.GetMins(axis).data();
+			result->first.coordinates[axis + Dimensions] = columns.GetMaxs(axis).data();
+		}
+
+		auto const params = nanoflann::KDTreeSingleIndexAdaptorParams(GeoToolbox::MaxElementsPerNode, flags, unsigned(threadCount));
 		result->second = std::make_unique<TreeType>(int(Dimensions), result->first, params);
 		return result;
 	}
 
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<BoxType> const& dataset) const override
+	{
+		return MakeIndex(dataset, nanoflann::KDTreeSingleIndexAdaptorFlags::None);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> LoadParallel(Dataset<BoxType> const& dataset, int threadCount) const override
+	{
+		return MakeIndex(dataset, nanoflann::KDTreeSingleIndexAdaptorFlags::None, threadCount);
+	}
+
+	bool Save(std::shared_ptr<void> const& indexPtr, std::filesystem::path const& filePath) const override
+	{
+		return BaseType::SaveTree(*static_cast<IndexType const*>(indexPtr.get())->second, filePath);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Open(std::filesystem::path const& filePath, Dataset<BoxType> const& dataset) const override
+	{
+		return BaseType::OpenTree(MakeIndex(dataset, nanoflann::KDTreeSingleIndexAdaptorFlags::SkipInitialBuildIndex), filePath);
+	}
+
 	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
 	{
 		auto& index = *static_cast<IndexType const*>(indexPtr.get());
@@ -0,0 +1,225 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "SpatialIndexWrapper.hpp"
+#include "TestTools.hpp"
+#include "GeoToolbox/PackedRtree.hpp"
+
+// The packed Hilbert R-tree implemented in this library (GeoToolbox/PackedRtree.hpp)
+template <typename TSpatialKey, int NNodeCapacity = GeoToolbox::MaxElementsPerNode>
+struct NativePackedRtree : SpatialIndexWrapper<TSpatialKey>
+{
+	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
+	using BoxType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	using IndexType = GeoToolbox::PackedRtree<TSpatialKey, NNodeCapacity>;
+
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "GeoToolbox Packed R-tree";
+	}
+
+	[[nodiscard]] int GetNodeCapacity() const override
+	{
+		return NNodeCapacity;
+	}
+
+	[[nodiscard]] bool HasNodeCapacityArgument() const override
+	{
+		return true;
+	}
+
+	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
+	{
+		return static_cast<IndexType const*>(indexPtr.get())->GetStats();
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
+	{
+		return std::make_shared<IndexType>(dataset.GetColumns());
+	}
+
+	[[nodiscard]] bool SupportsParallelLoad() const override
+	{
+		return true;
+	}
+
+	[[nodiscard]] std::shared_ptr<void> LoadParallel(Dataset<TSpatialKey> const& dataset, int threadCount) const override
+	{
+		return std::make_shared<IndexType>(dataset.GetColumns(), threadCount);
+	}
+
+	bool Save(std::shared_ptr<void> const& indexPtr, std::filesystem::path const& filePath) const override
+	{
+		return static_cast<IndexType const*>(indexPtr.get())->Save(filePath);
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Open(std::filesystem::path const& filePath, Dataset<TSpatialKey> const& /*dataset*/) const override
+	{
+		return IndexType::Open(filePath);
+	}
+
+	[[nodiscard]] bool SupportsExternalLoad() const override
+	{
+		return true;
+	}
+
+	[[nodiscard]] std::shared_ptr<void> LoadExternal(DatasetStream<TSpatialKey>& stream, std::filesystem::path const& filePath, std::size_t memoryBudget) const override
+	{
+		return IndexType::BuildFile(stream, filePath, memoryBudget) ? IndexType::Open(filePath) : nullptr;
+	}
+
+	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& box) const override
+	{
+		return static_cast<IndexType const*>(indexPtr.get())->QueryBox(box);
+	}
+
+	bool QueryBoxFeatures(std::shared_ptr<void> const& indexPtr, BoxType const& box, std::vector<GeoToolbox::Feature<TSpatialKey>>& results) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		index.VisitBox(box, [&](int entryIndex) { results.push_back({ index.GetId(entryIndex), index.GetKey(entryIndex) }); });
+		return true;
+	}
+
+	[[nodiscard]] int QueryBoxVisit(std::shared_ptr<void> const& indexPtr, BoxType const& box, typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor& visitor) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		auto count = 0;
+		index.VisitBoxWhile(box, [&](int entryIndex)
+			{
+				++count;
+				return visitor(index.GetId(entryIndex));
+			});
+
+		return count;
+	}
+
+	// Writes the ids directly, without the virtual call per feature of the default
+	[[nodiscard]] int QueryBoxIds(std::shared_ptr<void> const& indexPtr, BoxType const& box, GeoToolbox::Span<GeoToolbox::FeatureId> ids) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		auto count = 0;
+		index.VisitBox(box, [&](int entryIndex)
+			{
+				if (count < GeoToolbox::Size(ids))
+				{
+					ids[count] = index.GetId(entryIndex);
+				}
+
+				++count;
+			});
+
+		return count;
+	}
+
+	void QueryBoxBatch(std::shared_ptr<void> const& indexPtr, GeoToolbox::Span<BoxType const> boxes, GeoToolbox::Span<int> counts) const override
+	{
+		static_cast<IndexType const*>(indexPtr.get())->QueryBoxBatch(boxes, counts);
+	}
+
+	[[nodiscard]] std::int64_t QueryJoin(std::shared_ptr<void> const& indexPtrA, GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> /*featuresA*/, std::shared_ptr<void> const& indexPtrB, typename SpatialIndexWrapper<TSpatialKey>::JoinCallback& callback) const override
+	{
+		auto const& indexA = *static_cast<IndexType const*>(indexPtrA.get());
+		std::int64_t result = 0;
+		indexA.VisitJoin(*static_cast<IndexType const*>(indexPtrB.get()), [&](int entryIndex, int, std::uint64_t mask)
+			{
+				auto const count = GeoToolbox::PopCount(mask);
+				callback(indexA.GetId(entryIndex), count);
+				result += count;
+			});
+
+		return result;
+	}
+
+	[[nodiscard]] double QueryNearest(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override
+	{
+		auto distSum = 0.0;
+		static_cast<IndexType const*>(indexPtr.get())->VisitNearest(location, nearestCount, [&distSum](int, auto distanceSquared)
+			{
+				distSum += double(distanceSquared);
+			});
+
+		return distSum;
+	}
+
+	// The entries of each reached leaf are refined together, with their ids gathered from the leaf
+	[[nodiscard]] double QueryNearestRefined(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount, typename SpatialIndexWrapper<TSpatialKey>::ExactDistances& exactDistances) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		auto distSum = 0.0;
+		index.VisitNearestRefined(location, nearestCount, [&](int first, int count, auto* distancesSquared)
+			{
+				std::array<GeoToolbox::FeatureId, IndexType::NodeSize> ids;
+				for (auto i = 0; i < count; ++i)
+				{
+					ids[i] = index.GetId(first + i);
+				}
+
+				exactDistances(location, { ids.data(), count }, { distancesSquared, count });
+			},
+			[&distSum](int, auto distanceSquared)
+			{
+				distSum += double(distanceSquared);
+			});
+
+		return distSum;
+	}
+};
+
+// The compact variant of the packed R-tree, with the internal node boxes quantized to 16 bits relative to their parent (GeoToolbox::QuantizedPackedRtree).
+// Compare its memory delta and the node visits, box overlaps and object tests of its queries to the full-precision one
+template <typename TSpatialKey>
+struct NativeQuantizedPackedRtree : SpatialIndexWrapper<TSpatialKey>
+{
+	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
+	using BoxType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	using IndexType = GeoToolbox::QuantizedPackedRtree<TSpatialKey>;
+
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "GeoToolbox Quantized Packed R-tree";
+	}
+
+	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
+	{
+		return static_cast<IndexType const*>(indexPtr.get())->GetStats();
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
+	{
+		return std::make_shared<IndexType>(dataset.GetColumns());
+	}
+
+	[[nodiscard]] bool SupportsParallelLoad() const override
+	{
+		return true;
+	}
+
+	[[nodiscard]] std::shared_ptr<void> LoadParallel(Dataset<TSpatialKey> const& dataset, int threadCount) const override
+	{
+		return std::make_shared<IndexType>(dataset.GetColumns(), threadCount);
+	}
+
+	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& box) const override
+	{
+		return static_cast<IndexType const*>(indexPtr.get())->QueryBox(box);
+	}
+
+	[[nodiscard]] double QueryNearest(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override
+	{
+		auto distSum = 0.0;
+		static_cast<IndexType const*>(indexPtr.get())->VisitNearest(location, nearestCount, [&distSum](int, auto distanceSquared)
+			{
+				distSum += double(distanceSquared);
+			});
+
+		return distSum;
+	}
+};
@@ -0,0 +1,405 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#pragma once
+
+#include "Boost.hpp"
+#include "NativePackedRtree.hpp"
+#include "SpatialIndexWrapper.hpp"
+#include "TestTools.hpp"
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Caches the box query results of an index in a bounded LRU, for the workloads whose queries repeat or nest in recently answered ones.
+// A query box is expanded to the block of BlockCells cells per axis of a grid aligned to powers of 2, starting at the cell of its low corner,
+// with cells a quarter to a half of its largest side so that the block contains the box. The features found in the block are cached under it,
+// and the following queries whose block on their own grid or on one of the CoarserLevels next coarser grids is cached are answered by filtering its features.
+// The cached entries that overlap an inserted or erased feature are dropped. The features in a block are found with SpatialIndexWrapper::QueryBoxFeatures(),
+// or, for the indices that do not support it, with QueryBoxVisit() and a table of the feature pointers by id, kept only for them. The other queries are
+// passed to the index. The cache is shared by the threads of the parallel scenarios, under a mutex held only to find and update the entries
+template <typename TSpatialKey, template <class> class TWrapper>
+struct QueryCache : SpatialIndexWrapper<TSpatialKey>
+{
+	using ScalarType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::ScalarType;
+	using VectorType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorType;
+	using BoxType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::BoxType;
+	using FeaturePtr = typename SpatialIndexWrapper<TSpatialKey>::FeaturePtr;
+	using FeaturesType = std::vector<GeoToolbox::Feature<TSpatialKey>>;
+
+	static constexpr auto Dimensions = int(GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions);
+
+	// A box no larger than 4 cells starting in the first cell of a block of 5 is contained in it
+	static constexpr auto BlockCells = 5;
+
+	// The coarser grids searched for a cached block that contains the query, the queries up to 2^CoarserLevels times smaller than a cached one may use it
+	static constexpr auto CoarserLevels = 4;
+
+	// The grid level, with cells of size 2^level, and the first cell of a block
+	struct CacheKey
+	{
+		int level = 0;
+		std::array<std::int64_t, Dimensions> cells{};
+
+		[[nodiscard]] friend bool operator==(CacheKey const& a, CacheKey const& b) noexcept
+		{
+			return a.level == b.level && a.cells == b.cells;
+		}
+	};
+
+	struct CacheKeyHash
+	{
+		[[nodiscard]] std::size_t operator()(CacheKey const& key) const noexcept
+		{
+			auto result = std::hash<int>{}(key.level);
+			for (auto const cell : key.cells)
+			{
+				result = result * 31 + std::hash<std::int64_t>{}(cell);
+			}
+
+			return result;
+		}
+	};
+
+	struct Entry
+	{
+		CacheKey key;
+		BoxType box;
+		std::shared_ptr<FeaturesType const> features;
+	};
+
+	struct IndexType
+	{
+		std::shared_ptr<void> index;
+
+		// The count of the cached query boxes, see the "QueryCacheEntries" configuration key
+		int capacity = std::max(1, GetConfig().Get<int>("QueryCacheEntries"));
+
+		std::mutex mutex;
+
+		// The most recently used first
+		std::list<Entry> entries;
+		std::unordered_map<CacheKey, typename std::list<Entry>::iterator, CacheKeyHash> lookup;
+		std::int64_t cachedFeatureCount = 0;
+		std::int64_t cachedFeatureCapacity = 0;
+
+		// Incremented by each insert or erase, the results of a query that overlapped one are not cached
+		std::int64_t generation = 0;
+
+		// Set if the wrapped index does not support QueryBoxFeatures(), its results are then found by their ids
+		bool usesFeatureTable = false;
+		std::vector<FeaturePtr> featuresById;
+
+		std::atomic<std::int64_t> hitCount = 0;
+		std::atomic<std::int64_t> missCount = 0;
+
+		explicit IndexType(std::shared_ptr<void> wrappedIndex)
+			: index{ std::move(wrappedIndex) }
+		{
+		}
+	};
+
+
+	TWrapper<TSpatialKey> wrapper;
+
+	// Made on each call, the name of the wrapped index depends on the configuration
+	mutable std::string name;
+
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		name = !wrapper.Name().empty() ? "Cached " + std::string(wrapper.Name()) : std::string{};
+		return name;
+	}
+
+	[[nodiscard]] bool IsDynamic() const override
+	{
+		return wrapper.IsDynamic();
+	}
+
+	[[nodiscard]] bool SupportsDatasetSize(int size) const override
+	{
+		return wrapper.SupportsDatasetSize(size);
+	}
+
+	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		std::lock_guard lock{ index.mutex };
+		auto const queryCount = index.hitCount + index.missCount;
+		std::ostringstream result;
+		result << std::setprecision(1) << std::fixed
+			<< "Hit rate: " << (queryCount > 0 ? 100.0 * double(index.hitCount) / double(queryCount) : 0.0) << '%'
+			<< " Entries: " << index.entries.size()
+			<< " Cached features: " << index.cachedFeatureCount << " (" << double(GetCacheMemory(index)) / (Kilobyte * Kilobyte) << " MB)";
+		auto const wrappedStats = wrapper.GetIndexStats(index.index);
+		if (!wrappedStats.empty())
+		{
+			result << ' ' << wrappedStats;
+		}
+
+		return result.str();
+	}
+
+	[[nodiscard]] std::shared_ptr<void> MakeEmptyIndex() const override
+	{
+		return Wrap(wrapper.MakeEmptyIndex(), {});
+	}
+
+	[[nodiscard]] std::shared_ptr<void> Load(Dataset<TSpatialKey> const& dataset) const override
+	{
+		return Wrap(wrapper.Load(dataset), dataset.GetData());
+	}
+
+	// The cached entries are dropped after the index changes, the queries in between do not cache their results, see IndexType::generation
+	void Insert(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		wrapper.Insert(index.index, feature);
+		Invalidate(index, feature);
+	}
+
+	bool Erase(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		auto const result = wrapper.Erase(index.index, feature);
+		Invalidate(index, feature);
+		return result;
+	}
+
+	void Rebalance(std::shared_ptr<void> const& indexPtr) const override
+	{
+		wrapper.Rebalance(static_cast<IndexType*>(indexPtr.get())->index);
+	}
+
+	// The copy starts with an empty cache
+	[[nodiscard]] std::shared_ptr<void> Clone(std::shared_ptr<void> const& indexPtr) const override
+	{
+		auto const& index = *static_cast<IndexType const*>(indexPtr.get());
+		auto result = Wrap(wrapper.Clone(index.index), {});
+		if (result != nullptr)
+		{
+			static_cast<IndexType*>(result.get())->featuresById = index.featuresById;
+		}
+
+		return result;
+	}
+
+	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& box) const override
+	{
+		auto& index = *static_cast<IndexType*>(indexPtr.get());
+		auto const sizes = box.Sizes();
+		auto maxSide = sizes[0];
+		for (auto axis = 1; axis < Dimensions; ++axis)
+		{
+			maxSide = std::max(maxSide, sizes[axis]);
+		}
+
+		if (!(maxSide > 0))
+		{
+			return wrapper.QueryBox(index.index, box);
+		}
+
+		auto const level = std::ilogb(maxSide) - 1;
+		std::shared_ptr<FeaturesType const> features;
+		std::int64_t generation = 0;
+		{
+			std::lock_guard lock{ index.mutex };
+			generation = index.generation;
+			for (auto coarser = 0; coarser <= CoarserLevels && features == nullptr; ++coarser)
+			{
+				if (auto const found = index.lookup.find(MakeKey(box, level + coarser)); found != index.lookup.end())
+				{
+					index.entries.splice(index.entries.begin(), index.entries, found->second);
+					features = found->second->features;
+				}
+			}
+		}
+
+		if (features != nullptr)
+		{
+			++index.hitCount;
+		}
+		else
+		{
+			++index.missCount;
+			auto const key = MakeKey(box, level);
+			auto const expandedBox = GetBox(key);
+			auto newFeatures = std::make_shared<FeaturesType>();
+			if (!QueryFeatures(index, expandedBox, *newFeatures))
+			{
+				return -1;
+			}
+
+			features = newFeatures;
+			std::lock_guard lock{ index.mutex };
+			if (index.generation == generation && index.lookup.count(key) == 0)
+			{
+				index.cachedFeatureCount += GeoToolbox::Size(*features);
+				index.cachedFeatureCapacity += std::int64_t(features->capacity());
+				index.entries.push_front({ key, expandedBox, std::move(newFeatures) });
+				index.lookup.emplace(key, index.entries.begin());
+				while (int(index.entries.size()) > index.capacity)
+				{
+					Drop(index, std::prev(index.entries.end()));
+				}
+			}
+		}
+
+		GeoToolbox::AddQueryStats_ObjectTestsCount(GeoToolbox::Size(*features));
+		return int(std::count_if(features->begin(), features->end(), [&box](GeoToolbox::Feature<TSpatialKey> const& feature) { return GeoToolbox::Overlap(box, feature.spatialKey); }));
+	}
+
+	[[nodiscard]] double QueryNearest(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override
+	{
+		return wrapper.QueryNearest(static_cast<IndexType const*>(indexPtr.get())->index, location, nearestCount);
+	}
+
+private:
+
+	// Probes the wrapped index with an empty query to find whether it supports QueryBoxFeatures()
+	[[nodiscard]] std::shared_ptr<void> Wrap(std::shared_ptr<void> wrappedIndex, GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> features) const
+	{
+		if (wrappedIndex == nullptr)
+		{
+			return nullptr;
+		}
+
+		auto result = std::make_shared<IndexType>(std::move(wrappedIndex));
+		FeaturesType probeResults;
+		result->usesFeatureTable = !wrapper.QueryBoxFeatures(result->index, BoxType{ VectorType{}, VectorType{} }, probeResults);
+		if (result->usesFeatureTable)
+		{
+			for (auto const& feature : features)
+			{
+				AddToFeatureTable(*result, &feature);
+			}
+		}
+
+		return result;
+	}
+
+	static void AddToFeatureTable(IndexType& index, FeaturePtr feature)
+	{
+		if (feature->id >= GeoToolbox::Size(index.featuresById))
+		{
+			index.featuresById.resize(feature->id + 1);
+		}
+
+		index.featuresById[feature->id] = feature;
+	}
+
+	// Collects the features of the ids visited by the wrapped index, if it does not support QueryBoxFeatures()
+	[[nodiscard]] bool QueryFeatures(IndexType const& index, BoxType const& box, FeaturesType& results) const
+	{
+		if (!index.usesFeatureTable)
+		{
+			return wrapper.QueryBoxFeatures(index.index, box, results);
+		}
+
+		struct FeatureCollector final : SpatialIndexWrapper<TSpatialKey>::QueryVisitor
+		{
+			IndexType const* index = nullptr;
+			FeaturesType* results = nullptr;
+
+			bool operator()(GeoToolbox::FeatureId id) override
+			{
+				results->push_back(*index->featuresById[id]);
+				return true;
+			}
+		};
+
+		FeatureCollector collector;
+		collector.index = &index;
+		collector.results = &results;
+		return wrapper.QueryBoxVisit(index.index, box, collector) >= 0;
+	}
+
+	// The features and the nodes of the list, the hash table and the shared vectors, and the feature table
+	[[nodiscard]] static std::int64_t GetCacheMemory(IndexType const& index)
+	{
+		// The shared vector is made with its control block of a virtual table pointer and two counts, a list node holds an entry and two links,
+		// a hash table node holds a key, an iterator, a link and the hash code
+		constexpr auto sharedFeaturesSize = std::int64_t(sizeof(FeaturesType) + sizeof(void*) + 2 * sizeof(int));
+		constexpr auto listNodeSize = std::int64_t(sizeof(Entry) + 2 * sizeof(void*));
+		constexpr auto lookupNodeSize = std::int64_t(sizeof(typename decltype(index.lookup)::value_type) + sizeof(void*) + sizeof(std::size_t));
+		auto const entryCount = std::int64_t(index.entries.size());
+		return index.cachedFeatureCapacity * std::int64_t(sizeof(GeoToolbox::Feature<TSpatialKey>))
+			+ entryCount * (sharedFeaturesSize + listNodeSize + lookupNodeSize)
+			+ std::int64_t(index.lookup.bucket_count() * sizeof(void*))
+			+ std::int64_t(index.featuresById.capacity() * sizeof(FeaturePtr));
+	}
+
+	// The block of the grid of 2^level cells that starts at the cell of the low corner of the box
+	[[nodiscard]] static CacheKey MakeKey(BoxType const& box, int level)
+	{
+		CacheKey result{ level };
+		for (auto axis = 0; axis < Dimensions; ++axis)
+		{
+			result.cells[axis] = std::int64_t(std::floor(std::ldexp(double(box.Min()[axis]), -level)));
+		}
+
+		return result;
+	}
+
+	// Rounding the bounds to the nearest scalar keeps them outside of the bounds of the queries of the key, which are scalars too
+	[[nodiscard]] static BoxType GetBox(CacheKey const& key)
+	{
+		VectorType min{};
+		VectorType max{};
+		for (auto axis = 0; axis < Dimensions; ++axis)
+		{
+			min[axis] = ScalarType(std::ldexp(double(key.cells[axis]), key.level));
+			max[axis] = ScalarType(std::ldexp(double(key.cells[axis] + BlockCells), key.level));
+		}
+
+		return BoxType{ min, max };
+	}
+
+	static void Drop(IndexType& index, typename std::list<Entry>::iterator entry)
+	{
+		index.cachedFeatureCount -= GeoToolbox::Size(*entry->features);
+		index.cachedFeatureCapacity -= std::int64_t(entry->features->capacity());
+		index.lookup.erase(entry->key);
+		index.entries.erase(entry);
+	}
+
+	static void Invalidate(IndexType& index, FeaturePtr feature)
+	{
+		std::lock_guard lock{ index.mutex };
+		++index.generation;
+		if (index.usesFeatureTable)
+		{
+			AddToFeatureTable(index, feature);
+		}
+
+		for (auto entry = index.entries.begin(); entry != index.entries.end();)
+		{
+			auto const next = std::next(entry);
+			if (GeoToolbox::Overlap(entry->box, feature->spatialKey))
+			{
+				Drop(index, entry);
+			}
+
+			entry = next;
+		}
+	}
+};
+
+template <typename TSpatialKey>
+using CachedNativePackedRtree = QueryCache<TSpatialKey, NativePackedRtree>;
+
+template <typename TSpatialKey>
+using CachedBoostRtree = QueryCache<TSpatialKey, BoostRtree>;
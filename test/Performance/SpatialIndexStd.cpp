@@ -53,6 +53,10 @@ template struct StdVector<Vector2>;
 template struct StdVector<Vector3f>;
 template struct StdVector<Box2>;
 template struct StdVector<Box3f>;
+template struct StdVector<PaddedVector3f>;
+template struct StdVector<Box<PaddedVector3f>>;
+// The geocentric keys of Geodetic.hpp
+template struct StdVector<Vector3>;
 #if defined( ENABLE_EIGEN )
 template struct StdVector<EVector2>;
 template struct StdVector<Box<EVector2>>;
@@ -7,14 +7,22 @@
 #include "GeoToolbox/GeometryTools.hpp"
 #include "GeoToolbox/Image.hpp"
 #include "GeoToolbox/Iterators.hpp"
+#include "GeoToolbox/MappedFile.hpp"
+#include "GeoToolbox/ObjFile.hpp"
 #include "GeoToolbox/Profiling.hpp"
 #include "GeoToolbox/ShapeFile.hpp"
 #include "GeoToolbox/StlExtensions.hpp"
+#include "GeoToolbox/ThreadPool.hpp"
 
 #include "AlgLib.hpp"
 #include "Boost.hpp"
+#include "ConcurrencyAdapter.hpp"
+#include "Geodetic.hpp"
 #include "Geos.hpp"
+#include "LogarithmicMethod.hpp"
 #include "NanoflannAdapter.hpp"
+#include "NativePackedRtree.hpp"
+#include "QueryCache.hpp"
 // ReSharper disable once CppUnusedIncludeDirective
 #include "SpatialIndexWrapper.hpp"
 #include "TidwallRtree.hpp"
@@ -27,14 +35,24 @@
 #include "catch2/matchers/catch_matchers_floating_point.hpp"
 
 #include <array>
+#include <atomic>
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <sstream>
+#include <thread>
 
 using namespace GeoToolbox;
 using namespace std;
 
 constexpr auto OpNameQueryBox = "Query Range";
 constexpr auto OpNameQueryNearest = "Query Nearest";
+constexpr auto OpNameQueryJoin = "Query Join";
+constexpr auto OpNameQueryBoxIds = "Query Range Ids";
+constexpr auto OpNameQueryBoxLimit = "Query Range Limit";
+constexpr auto OpNameQueryNearestSegment = "Query Nearest Segment";
+constexpr auto OpNameQueryNearestGeodetic = "Query Nearest Geodetic";
 
 using SpatialKeysToTest = TypeList<
 	Vector2, Box2
@@ -42,13 +60,42 @@ using SpatialKeysToTest = TypeList<
 	, EVector2, Box<EVector2>
 #endif
 	, Vector3f, Box3f
+	, PaddedVector3f, Box<PaddedVector3f>
 >;
 
 
+// The other node capacities of the indices with a node capacity template argument, besides the default MaxElementsPerNode, see the "NodeCapacity" configuration key.
+// Each one adds the compilation of these indices, so they are instantiated only with ENABLE_NODE_CAPACITY_SWEEP (the GeoToolbox_NODE_CAPACITY_SWEEP CMake option)
+using NodeCapacitiesToTest = std::integer_sequence<int, 8, 16, 64, 128>;
+
+template <typename TSpatialKey, int NNodeCapacity>
+void AddIndicesOfNodeCapacity(vector<unique_ptr<SpatialIndexWrapper<TSpatialKey>>>& indices)
+{
+	indices.push_back(make_unique<GeosTemplateStrTree<TSpatialKey, NNodeCapacity>>());
+	indices.push_back(make_unique<BoostRtree<TSpatialKey, NNodeCapacity>>());
+
+	// The children of a packed R-tree node are tested into a 64-bit mask
+	if constexpr (NNodeCapacity <= OverlapMaskBits)
+	{
+		indices.push_back(make_unique<NativePackedRtree<TSpatialKey, NNodeCapacity>>());
+	}
+}
+
+template <typename TSpatialKey, int... NNodeCapacity>
+void AddNodeCapacitiesToTest(vector<unique_ptr<SpatialIndexWrapper<TSpatialKey>>>& indices, std::integer_sequence<int, NNodeCapacity...>)
+{
+	(AddIndicesOfNodeCapacity<TSpatialKey, NNodeCapacity>(indices), ...);
+}
+
 template <typename TSpatialKey, template <class> class... TIndex>
 auto MakeIndicesToTest()
 {
-	return array{ static_cast<unique_ptr<SpatialIndexWrapper<TSpatialKey>>>(make_unique<TIndex<TSpatialKey>>())... };
+	vector<unique_ptr<SpatialIndexWrapper<TSpatialKey>>> result;
+	(result.push_back(make_unique<TIndex<TSpatialKey>>()), ...);
+#if defined(ENABLE_NODE_CAPACITY_SWEEP)
+	AddNodeCapacitiesToTest<TSpatialKey>(result, NodeCapacitiesToTest{});
+#endif
+	return result;
 }
 
 template <typename TSpatialKey>
@@ -61,6 +108,17 @@ auto const IndicesToTest = MakeIndicesToTest<TSpatialKey
 	//, GeosVertexSequencePackedRtree	// In rare cases is just a bit faster than TemplateStrTree, (much) slower in 
 	, TidwallRtree
 	, BoostRtree
+	, BoostRtreeArena	// Tested besides BoostRtree in the arena mode only, its allocator is a template argument
+	, NativePackedRtree
+	, NativeQuantizedPackedRtree
+	, DynamicNanoflannStaticKdtree	// The static indices made dynamic by LogarithmicMethod, compare them to the natively dynamic ones in the Insert-Erase-Query scenario
+	, DynamicGeosTemplateStrTree
+	, DynamicNativePackedRtree
+	, CachedNativePackedRtree	// The query cache in front of an index, compare it to the index alone in the load-query scenarios of the hotspot workloads
+	, CachedBoostRtree
+	, GeodeticStdVector	// The 3D indices of the unit sphere points of the lon/lat datasets, compare them to the planar ones in the Load-QueryNearestGeodetic-Destroy scenario
+	, GeodeticBoostRtree
+	, GeodeticNativePackedRtree
 	, AlglibKdtree	// works with double only and needs conversion from float, not implemented yet. Query times are consistently worse than all other indices
 #ifdef ENABLE_PRIVATE
 	, PrivateIndex
@@ -106,7 +164,7 @@ namespace
 		ScalarType extent;
 		Interval<ScalarType> heightRange;
 		Box<VectorType> boundingBox;
-		Catch::SimplePcg32 randomGenerator;
+		std::uint64_t randomSeed;
 		uniform_real_distribution<ScalarType> distributionHeight;
 
 
@@ -114,17 +172,31 @@ namespace
 			: extent{ std::max(extent, ScalarType(1)) }
 			, heightRange{ ScalarType(1e-7), std::max(maxBoxHeight, ScalarType(1e-6)) }
 			, boundingBox{ Box<VectorType>::Square(extent) }
-			, randomGenerator(randomSeed > 0 ? randomSeed : DefaultRandomSeed)
+			, randomSeed(randomSeed > 0 ? randomSeed : DefaultRandomSeed)
 			, distributionHeight{ heightRange.min, heightRange.max }
 		{
 		}
 
+		// The seed of each dataset is derived from the seed of the maker and the name of the dataset, so that the distributions made with the same seed
+		// do not draw the same random numbers. The name is hashed with FNV-1a, which is the same in all standard libraries, unlike std::hash
+		[[nodiscard]] std::uint64_t GetDatasetSeed(std::string_view name) const
+		{
+			auto hash = 0xCBF29CE484222325ull;
+			for (auto const c : name)
+			{
+				hash = (hash ^ std::uint8_t(c)) * 0x100000001B3ull;
+			}
+
+			return CounterRandomGenerator{ randomSeed, hash }();
+		}
+
 		[[nodiscard]] Dataset<TSpatialKey> Make(std::string name, int datasetSize, ScalarType skewPower = 0, ScalarType averageBoxAspect = 1)
 		{
-			auto data = MakeRandomSpatialKeys<TSpatialKey>(randomGenerator, datasetSize, boundingBox, heightRange, skewPower, averageBoxAspect);
-			return Dataset{ std::move(name), data };
+			auto data = ParallelMakeRandomSpatialKeys<TSpatialKey>(GetDatasetSeed(name), datasetSize, boundingBox, heightRange, skewPower, averageBoxAspect);
+			return Dataset{ std::move(name), std::move(data) };
 		}
 
+		// Each feature is made from its own random stream, in parallel, see ParallelForEachRandomIndex()
 		[[nodiscard]] Dataset<TSpatialKey> MakeIslands(int datasetSize, ScalarType islandRadiusFactor = 0)
 		{
 			ASSERT(datasetSize > 0);
@@ -140,40 +212,94 @@ namespace
 
 			vector<Feature<TSpatialKey>> data{ size_t(datasetSize) };
 			array islandCenters = { islandRadius, extent / 2, extent - islandRadius };
-			for (auto i = 0; i < datasetSize; ++i)
-			{
-				auto const island = distributionIslandIndex(randomGenerator);
-				auto const islandCenter = islandCenters[island];
-				auto center = VectorType{ std::clamp(islandCenter + distributionOffset(randomGenerator), zero, extent), std::clamp(islandCenter + distributionOffset(randomGenerator), zero, extent) };
-				if constexpr (SpatialKeyTraits<TSpatialKey>::Dimensions == 3)
+			ParallelForEachRandomIndex(
+				GetDatasetSeed(DatasetName_Islands),
+				datasetSize,
+				[&, distributionIslandIndex, distributionOffset, distributionAspect, distributionHeight = distributionHeight](CounterRandomGenerator& randomGenerator, int i) mutable
 				{
-					center[2] = std::clamp(islandCenter + distributionOffset(randomGenerator), zero, extent);
-				}
+					auto const island = distributionIslandIndex(randomGenerator);
+					auto const islandCenter = islandCenters[island];
+					auto center = VectorType{ std::clamp(islandCenter + distributionOffset(randomGenerator), zero, extent), std::clamp(islandCenter + distributionOffset(randomGenerator), zero, extent) };
+					if constexpr (SpatialKeyTraits<TSpatialKey>::Dimensions == 3)
+					{
+						center[2] = std::clamp(islandCenter + distributionOffset(randomGenerator), zero, extent);
+					}
 
-				if constexpr (SpatialKeyIsPoint<TSpatialKey>)
-				{
-					data[i] = { i, center };
-				}
-				else
-				{
-					data[i] = { i, MakeRandomBox(randomGenerator, center, boundingBox, distributionHeight, distributionAspect) };
-				}
-			}
+					if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+					{
+						data[i] = { i, center };
+					}
+					else
+					{
+						data[i] = { i, MakeRandomBox(randomGenerator, center, boundingBox, distributionHeight, distributionAspect) };
+					}
+				});
 
-			return Dataset{ DatasetName_Islands, data };
+			return Dataset{ DatasetName_Islands, std::move(data) };
 		}
 	};
 }
 
 
+// The datasets loaded from files are cached next to them in the binary format of Dataset::SaveBinary(), one file per spatial key type
 template <typename TSpatialKey>
-shared_ptr<Dataset<TSpatialKey>> LoadShapeFile(std::filesystem::path const& path)
+std::filesystem::path GetBinaryCachePath(std::filesystem::path const& sourcePath)
+{
+	auto result = sourcePath;
+	result += "." + SpatialKeyTraits<TSpatialKey>::GetName() + Dataset<TSpatialKey>::BinaryFileExtension;
+	return result;
+}
+
+// Maps the binary cache of the source file, if it is newer than the source and holds at least as many features as the largest configured dataset size needs
+template <typename TSpatialKey>
+shared_ptr<Dataset<TSpatialKey>> LoadBinaryCache(std::filesystem::path const& sourcePath)
 {
-	if (!IsSelected("Dataset", path.filename().string(), 0))
+	if (!GetConfig().Get<bool>("DatasetCache"))
+	{
+		return {};
+	}
+
+	auto const cachePath = GetBinaryCachePath<TSpatialKey>(sourcePath);
+	error_code error;
+	if (!is_regular_file(cachePath, error) || last_write_time(cachePath, error) < last_write_time(sourcePath, error) || error)
+	{
+		return {};
+	}
+
+	auto sourceSize = 0;
+	auto dataset = Dataset<TSpatialKey>::LoadBinary(cachePath, sourcePath.filename().string(), sourceSize);
+	if (dataset == nullptr || dataset->GetAvailableSize() < std::min(sourceSize, GetDatasetSizeFromOrder(GetDatasetSizeRange().second - 1)))
 	{
 		return {};
 	}
 
+	if (PrintVerboseMessages())
+	{
+		cout << "Mapped " << cachePath.filename().string() << '\n';
+	}
+
+	return dataset;
+}
+
+template <typename TSpatialKey>
+void SaveBinaryCache(std::filesystem::path const& sourcePath, Dataset<TSpatialKey> const& dataset, int sourceSize)
+{
+	if (GetConfig().Get<bool>("DatasetCache") && !dataset.SaveBinary(GetBinaryCachePath<TSpatialKey>(sourcePath), sourceSize) && PrintVerboseMessages())
+	{
+		cout << "Failed to write the binary cache of " << sourcePath.filename().string() << '\n';
+	}
+}
+
+template <typename TSpatialKey>
+shared_ptr<Dataset<TSpatialKey>> LoadShapeFile(std::filesystem::path const& path)
+{
+	// The binary cache is not made for an external dataset, that would load all of it
+	auto const external = GetConfig().Get<bool>("ExternalDataset");
+	if (auto cached = !external ? LoadBinaryCache<TSpatialKey>(path) : nullptr)
+	{
+		return cached;
+	}
+
 	ShapeFile const shapeFile{ path.string() };
 	if (!shapeFile.Supports<TSpatialKey>())
 	{
@@ -196,19 +322,33 @@ shared_ptr<Dataset<TSpatialKey>> LoadShapeFile(std::filesystem::path const& path
 		return {};
 	}
 
+	if (external)
+	{
+		using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+		using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
+
+		typename SpatialKeyTraits<TSpatialKey>::VectorType low{};
+		typename SpatialKeyTraits<TSpatialKey>::VectorType high{};
+		for (auto i = 0; i < int(SpatialKeyTraits<TSpatialKey>::Dimensions); ++i)
+		{
+			low[i] = ScalarType(shapeFile.GetMinBounds()[i]);
+			high[i] = ScalarType(shapeFile.GetMaxBounds()[i]);
+		}
+
+		return Dataset<TSpatialKey>::MakeExternal(path.filename().string(), path, shapeFile.GetObjectCount(), BoxType{ low, high });
+	}
+
 	auto const maxSize = GetDatasetSizeFromOrder(sizeRange.second - 1);
 	auto data = shapeFile.GetKeys<TSpatialKey>(maxSize);
-	return make_shared<Dataset<TSpatialKey>>(path.filename().string(), std::move(data));
+	auto dataset = make_shared<Dataset<TSpatialKey>>(path.filename().string(), std::move(data));
+	dataset->SetFilePath(path);
+	SaveBinaryCache(path, *dataset, shapeFile.GetObjectCount());
+	return dataset;
 }
 
 template <typename TSpatialKey>
 shared_ptr<Dataset<TSpatialKey>> LoadObjFile(std::filesystem::path const& path)
 {
-	if (!IsSelected("Dataset", path.filename().string(), 0))
-	{
-		return {};
-	}
-
 	if constexpr (!SpatialKeyIsPoint<TSpatialKey> || SpatialKeyTraits<TSpatialKey>::Dimensions != 3)
 	{
 		if (PrintVerboseMessages())
@@ -220,33 +360,37 @@ shared_ptr<Dataset<TSpatialKey>> LoadObjFile(std::filesystem::path const& path)
 	}
 	else
 	{
-		vector<TSpatialKey> verts;
-		using ScalarType = typename VectorTraits<TSpatialKey>::ScalarType;
-		ifstream inputFile{ path };
-		string line;
-		while (std::getline(inputFile, line))
+		if (auto cached = LoadBinaryCache<TSpatialKey>(path))
 		{
-			if (StartsWith(line, "v "))
-			{
-				stringstream ls{ line.substr(2) };
-				ScalarType x = 0, y = 0, z = 0;
-				ls >> x >> y >> z;
-				if (ls)
-				{
-					if constexpr (VectorTraits<TSpatialKey>::Dimensions == 2)
-					{
-						verts.push_back({ x, y });
-					}
-					else
-					{
-						verts.push_back({ x, y, z });
-					}
-				}
-			}
+			return cached;
+		}
+
+		auto vertices = ObjFile::ReadVertices<TSpatialKey>(path);
+		if (!vertices)
+		{
+			return {};
 		}
 
-		return make_shared<Dataset<TSpatialKey>>(path.filename().string(), std::move(verts));
+		auto dataset = make_shared<Dataset<TSpatialKey>>(path.filename().string(), std::move(*vertices));
+		dataset->SetFilePath(path);
+		SaveBinaryCache(path, *dataset, dataset->GetAvailableSize());
+		return dataset;
+	}
+}
+
+// A binary cache is loaded through its source file if that exists. Otherwise it can be used on its own, if it was written for the current spatial key type
+template <typename TSpatialKey>
+shared_ptr<Dataset<TSpatialKey>> LoadBinaryFile(std::filesystem::path const& path)
+{
+	auto const sourcePath = std::filesystem::path{ path }.replace_extension().replace_extension();
+	if (path.stem().extension().string() != "." + SpatialKeyTraits<TSpatialKey>::GetName() || exists(sourcePath))
+	{
+		return {};
 	}
+
+	auto const name = sourcePath.filename().string();
+	auto sourceSize = 0;
+	return GetConfig().Get<bool>("ExternalDataset") ? Dataset<TSpatialKey>::OpenBinary(path, name, sourceSize) : Dataset<TSpatialKey>::LoadBinary(path, name, sourceSize);
 }
 
 template <typename TSpatialKey>
@@ -314,6 +458,19 @@ public:
 		return {};
 	}
 
+	// The name of the dataset of a file, which is the name of the source file for a binary cache
+	[[nodiscard]] static string GetDatasetName(std::filesystem::path const& path)
+	{
+		return (path.extension() == Dataset<TSpatialKey>::BinaryFileExtension ? std::filesystem::path{ path }.replace_extension().replace_extension() : path).filename().string();
+	}
+
+	// Loads a file of a supported extension, whether or not the "Dataset" configuration key selects it. Null if the file does not hold a dataset of the spatial key type
+	[[nodiscard]] static shared_ptr<Dataset<TSpatialKey>> LoadFile(std::filesystem::path const& path)
+	{
+		auto const loader = SupportedExtensions.find(path.extension().string());
+		return loader != SupportedExtensions.end() ? loader->second(path) : nullptr;
+	}
+
 private:
 
 	static map<string, shared_ptr<Dataset<TSpatialKey>>(*)(std::filesystem::path const&)> SupportedExtensions;
@@ -338,10 +495,9 @@ private:
 				return;
 			}
 
-			auto loader = SupportedExtensions[directoryPath_.extension().string()];
-			if (loader != nullptr)
+			if (IsSelected("Dataset", GetDatasetName(directoryPath_), 0))
 			{
-				currentSet_ = loader(directoryPath_);
+				currentSet_ = LoadFile(directoryPath_);
 			}
 
 			return;
@@ -366,9 +522,9 @@ private:
 				continue;
 			}
 
-			if (auto loader = SupportedExtensions[directoryIterator_->path().extension().string()])
+			if (IsSelected("Dataset", GetDatasetName(path), 0))
 			{
-				currentSet_ = loader(path);
+				currentSet_ = LoadFile(path);
 			}
 		}
 	}
@@ -379,6 +535,7 @@ map<string, shared_ptr<Dataset<TSpatialKey>>(*)(std::filesystem::path const&)> D
 {
 	{ ".shp", LoadShapeFile },
 	{ ".obj", LoadObjFile },
+	{ Dataset<TSpatialKey>::BinaryFileExtension, LoadBinaryFile },
 };
 
 
@@ -402,46 +559,61 @@ struct DatasetPolygon : Dataset<TSpatialKey>
 		this->onSizeChange_ = OnSizeChange;
 	}
 
-	static void TwoCircles(DatasetPolygon& dataset, int pointCount, int startIndex)
+	static constexpr auto ChunkSize = 16 * 1024;
+
+	// Each point is computed directly from its index, so the chunks are independent
+	static void TwoCircles(DatasetPolygon& dataset, ThreadPool& pool, int pointCount, int startIndex)
 	{
-		auto i = startIndex;
-		if constexpr (KeyTraits::Kind == SpatialKeyKind::Box)
-		{
-			auto const boxSize = ScalarType(2 * Pi * InnerRadius) / ScalarType(pointCount);
-			auto const output = [&dataset, boxSize, &i](VectorType const& point) { dataset.data_[i++] = { i, BoxType::FromCenterAndSize(point, boxSize) }; };
-			MakeCircle<VectorType>(OutputIteratorFunction{ output }, OuterRadius, pointCount / 2);
-			MakeCircle<VectorType>(OutputIteratorFunction{ output }, InnerRadius, pointCount / 2);
-		}
-		else
-		{
-			auto const output = [&dataset, &i](VectorType const& point) { dataset.data_[i++] = { i, point }; };
-			MakeCircle<VectorType>(OutputIteratorFunction{ output }, OuterRadius, pointCount / 2);
-			MakeCircle<VectorType>(OutputIteratorFunction{ output }, InnerRadius, pointCount / 2);
-		}
+		auto const circlePointCount = pointCount / 2;
+		auto const boxSize = ScalarType(2 * Pi * InnerRadius) / ScalarType(pointCount);
+		pool.ForEachIndex(2 * circlePointCount, ChunkSize, [&dataset, circlePointCount, startIndex, boxSize](int k, int)
+			{
+				auto const point = k < circlePointCount
+					? GetCirclePoint<VectorType>(OuterRadius, k, circlePointCount)
+					: GetCirclePoint<VectorType>(InnerRadius, k - circlePointCount, circlePointCount);
+				auto const i = startIndex + k;
+				if constexpr (KeyTraits::Kind == SpatialKeyKind::Box)
+				{
+					dataset.data_[i] = { i, BoxType::FromCenterAndSize(point, boxSize) };
+				}
+				else
+				{
+					dataset.data_[i] = { i, point };
+				}
+			});
 	}
 
 	static void OnSizeChange(Dataset<TSpatialKey>& datasetBase, int newSize)
 	{
 		auto& dataset = static_cast<DatasetPolygon&>(datasetBase);
 		dataset.SetSize_(newSize);
+		ThreadPool pool{ newSize > ChunkSize ? 0 : 1 };
 		if constexpr (SpatialKeyTraits<TSpatialKey>::Dimensions == 2)
 		{
-			TwoCircles(dataset, newSize, 0);
+			TwoCircles(dataset, pool, newSize, 0);
 		}
 		else
 		{
-			TwoCircles(dataset, newSize / 2, 0);
-			for (auto i = newSize / 2; i < newSize; ++i)
-			{
-				dataset.data_[i] = dataset.data_[i - newSize / 2];
-				if constexpr (KeyTraits::Kind == SpatialKeyKind::Point)
-				{
-					dataset.data_[i].spatialKey[2] = OuterRadius;
-				}
-				else
+			auto const half = newSize / 2;
+			TwoCircles(dataset, pool, half, 0);
+			auto const copyUp = [&dataset, half](int i)
 				{
-					dataset.data_[i].spatialKey.Move(VectorType{ 0, 0, OuterRadius });
-				}
+					dataset.data_[i] = dataset.data_[i - half];
+					if constexpr (KeyTraits::Kind == SpatialKeyKind::Point)
+					{
+						dataset.data_[i].spatialKey[2] = OuterRadius;
+					}
+					else
+					{
+						dataset.data_[i].spatialKey.Move(VectorType{ 0, 0, OuterRadius });
+					}
+				};
+
+			// The last point of an odd size copies one of the copies, so it waits for the others
+			pool.ForEachIndex(half, ChunkSize, [&copyUp, half](int k, int) { copyUp(half + k); });
+			if (newSize % 2 != 0)
+			{
+				copyUp(newSize - 1);
 			}
 		}
 	}
@@ -537,7 +709,8 @@ void SaveImage(Dataset<TSpatialKey> const& dataset)
 			return;
 		}
 
-		auto const filename = GetFilename<TSpatialKey>(dataset);
+		auto const mode = GetConfig().Get<string>("ImageMode") == "density" ? DrawMode::Density : DrawMode::Outline;
+		auto const filename = GetFilename<TSpatialKey>(dataset) + (mode == DrawMode::Density ? "-density" : "");
 		auto const filepath = GetOutputPath() / filesystem::path{ filename + ".png" };
 		if (exists(filepath))
 		{
@@ -546,7 +719,7 @@ void SaveImage(Dataset<TSpatialKey> const& dataset)
 
 		static constexpr auto ImageSize = 1024;
 		auto datasetImage = Image{ ImageSize, ImageSize };
-		Draw(datasetImage, dataset);
+		Draw(datasetImage, dataset, mode);
 		datasetImage.Encode(filepath.string());
 	}
 }
@@ -587,52 +760,44 @@ void SaveObj(Dataset<TSpatialKey> const& dataset)
 	using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
 	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
 
-	std::ofstream file(filepath);
-	if (!file)
-	{
-		return;
-	}
-
-	auto writeVertex = [&file](Vector3f const& v)
-		{
-			file << "v  " << v[0] << ' ' << v[1] << ' ' << v[2] << '\n';
-		};
-
-	auto const& keys = dataset.GetKeys();
-	for (auto const& key : keys)
+	// Each key is written as a box with 8 vertices and 6 faces
+	auto const features = dataset.GetData();
+	vector<Vector3f> vertices(features.size() * 8);
+	vector<ObjFile::Quad> quads(features.size() * 6);
+	for (auto keyIndex = 0LL; keyIndex < Size(features); ++keyIndex)
 	{
 		BoxType box;
 		if constexpr (SpatialKeyIsPoint<TSpatialKey>)
 		{
-			box = BoxType::FromCenterAndSize(key, ScalarType(0.01));
+			box = BoxType::FromCenterAndSize(features[keyIndex].spatialKey, ScalarType(0.01));
 		}
 		else
 		{
-			box = key;
+			box = features[keyIndex].spatialKey;
 		}
 
 		auto const& a = Convert<Vector3f>(box.Min());
 		auto const& b = Convert<Vector3f>(box.Max());
-		writeVertex({ a[0], a[1], b[2] });
-		writeVertex(a);
-		writeVertex({ b[0], a[1], a[2] });
-		writeVertex({ b[0], a[1], b[2] });
-		writeVertex({ a[0], b[1], b[2] });
-		writeVertex(b);
-		writeVertex({ b[0], b[1], a[2] });
-		writeVertex({ a[0], b[1], a[2] });
-	}
-
-	file << '\n';
-	for (auto startIndex = 0LL, keyIndex = 0LL; keyIndex < Size(keys); ++keyIndex, startIndex += 8)
-	{
-		file << "f " << startIndex + 1 << ' ' << startIndex + 2 << ' ' << startIndex + 3 << ' ' << startIndex + 4 << '\n';
-		file << "f " << startIndex + 5 << ' ' << startIndex + 6 << ' ' << startIndex + 7 << ' ' << startIndex + 8 << '\n';
-		file << "f " << startIndex + 1 << ' ' << startIndex + 4 << ' ' << startIndex + 6 << ' ' << startIndex + 5 << '\n';
-		file << "f " << startIndex + 4 << ' ' << startIndex + 3 << ' ' << startIndex + 7 << ' ' << startIndex + 6 << '\n';
-		file << "f " << startIndex + 3 << ' ' << startIndex + 2 << ' ' << startIndex + 8 << ' ' << startIndex + 7 << '\n';
-		file << "f " << startIndex + 2 << ' ' << startIndex + 1 << ' ' << startIndex + 5 << ' ' << startIndex + 8 << '\n';
+		auto const v = 8 * keyIndex;
+		vertices[v + 0] = { a[0], a[1], b[2] };
+		vertices[v + 1] = a;
+		vertices[v + 2] = { b[0], a[1], a[2] };
+		vertices[v + 3] = { b[0], a[1], b[2] };
+		vertices[v + 4] = { a[0], b[1], b[2] };
+		vertices[v + 5] = b;
+		vertices[v + 6] = { b[0], b[1], a[2] };
+		vertices[v + 7] = { a[0], b[1], a[2] };
+
+		auto const f = 6 * keyIndex;
+		quads[f + 0] = { v + 0, v + 1, v + 2, v + 3 };
+		quads[f + 1] = { v + 4, v + 5, v + 6, v + 7 };
+		quads[f + 2] = { v + 0, v + 3, v + 5, v + 4 };
+		quads[f + 3] = { v + 3, v + 2, v + 6, v + 5 };
+		quads[f + 4] = { v + 2, v + 1, v + 7, v + 6 };
+		quads[f + 5] = { v + 1, v + 0, v + 4, v + 7 };
 	}
+
+	ObjFile::Write<Vector3f>(filepath, vertices, quads);
 }
 
 
@@ -645,12 +810,88 @@ struct TestContextBase
 	string indexStats;
 
 	bool const resetResults = GetConfig().Get<bool>("Reset");
+
+	// Count the events of the thread running the scenarios, the workers of the parallel scenarios are not included
+	unique_ptr<HardwareCounters> hardwareCounters;
+
+
+	TestContextBase()
+	{
+		SetUpBenchmarkTimings(timings);
+
+		if (!GetConfig().Get<bool>("HardwareCounters"))
+		{
+			return;
+		}
+
+		hardwareCounters = make_unique<HardwareCounters>();
+		timings.SetHardwareCounters(hardwareCounters.get());
+
+		static auto warningPrinted = false;
+		if (!warningPrinted)
+		{
+			warningPrinted = true;
+			for (auto i = 0; i < HardwareCounters::CounterCount; ++i)
+			{
+				if (!hardwareCounters->IsAvailable(HardwareCounters::Counter(i)))
+				{
+					cout << SetColorRed << "WARNING! Hardware counter not available: " << HardwareCounters::Names[i] << '\n' << ResetColor;
+				}
+			}
+		}
+	}
 };
 
 
 static constexpr auto QueriesPerAxis = 21;
 constexpr auto QueryNearestCount = 15;
 
+// The queries of the scenarios are made by QueryIterator, or by one of these generators when selected with the "Workload" configuration key
+constexpr auto GridWorkload = "grid";
+
+template <typename TSpatialKey>
+using QueryWorkloadGenerator = vector<typename SpatialKeyTraits<TSpatialKey>::BoxType>(*)(QueryWorkloadMaker<TSpatialKey>&, int queryCount);
+
+template <typename TSpatialKey>
+map<string, QueryWorkloadGenerator<TSpatialKey>> const QueryWorkloads =
+{
+	{ "zipf", [](QueryWorkloadMaker<TSpatialKey>& maker, int queryCount) { return maker.MakeZipfHotspots(queryCount); } },
+	{ "walk", [](QueryWorkloadMaker<TSpatialKey>& maker, int queryCount) { return maker.MakeRandomWalks(queryCount); } },
+	{ "panzoom", [](QueryWorkloadMaker<TSpatialKey>& maker, int queryCount) { return maker.MakePanZoomSessions(queryCount); } },
+	{ "data", [](QueryWorkloadMaker<TSpatialKey>& maker, int queryCount) { return maker.MakeDataDistributed(queryCount); } },
+};
+
+// The workloads of the "Workload" configuration key, the unknown ones are reported once and skipped
+template <typename TSpatialKey>
+vector<string> GetQueryWorkloads()
+{
+	vector<string> result;
+	auto const workloadList = GetConfig().Get<string>("Workload");
+	for (auto const& value : SplitIterator{ workloadList, ',' }.toArray(true))
+	{
+		auto name = string{ value };
+		if (name == GridWorkload || QueryWorkloads<TSpatialKey>.count(name) > 0)
+		{
+			result.push_back(std::move(name));
+			continue;
+		}
+
+		static auto warningPrinted = false;
+		if (!warningPrinted)
+		{
+			warningPrinted = true;
+			cout << SetColorRed << "WARNING! Unknown Workload: " << value << '\n' << ResetColor;
+		}
+	}
+
+	if (result.empty())
+	{
+		result.emplace_back(GridWorkload);
+	}
+
+	return result;
+}
+
 template <typename TSpatialKey>
 struct TestContext : TestContextBase
 {
@@ -662,146 +903,1778 @@ struct TestContext : TestContextBase
 
 	Dataset<TSpatialKey> const* dataset;
 
+	// Made by the selected workload, see SetWorkload()
+	string workload;
 	vector<BoxType> queries;
 	vector<double> queryResults;
 
+	// The second layer of the Load-Join-Destroy scenario, see GetJoinDataset()
+	shared_ptr<Dataset<TSpatialKey>> joinDataset;
+
+	// The segments of the Load-QueryNearestSegment-Destroy scenario, one column per axis of their starts and of their ends, indexed by the ids of the features
+	// of segmentDataset, which are their bounding boxes. See GetSegmentDataset()
+	array<vector<ScalarType>, Dimensions> segmentStarts;
+	array<vector<ScalarType>, Dimensions> segmentEnds;
+	unique_ptr<Dataset<TSpatialKey>> segmentDataset;
+
 
 	explicit TestContext(Dataset<TSpatialKey> const& dataset, PerfRecord& record)
 		: dataset(&dataset)
 	{
 		perfRecord = &record;
 
+		// Nothing to save of an external dataset, its features are not in memory
 		if constexpr (StartsWith(SpatialKeyTraits<TSpatialKey>::VectorTraitsType::Name, "array") && SpatialKeyTraits<TSpatialKey>::Dimensions == 2)
 		{
-			SaveImage(dataset);
-			SaveObj(dataset);
-			if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+			if (!dataset.IsExternal())
 			{
-				if (StartsWith(dataset.GetName(), "Synthetic"))
+				SaveImage(dataset);
+				SaveObj(dataset);
+				if constexpr (SpatialKeyIsPoint<TSpatialKey>)
 				{
-					SaveShapefile(dataset);
+					if (StartsWith(dataset.GetName(), "Synthetic"))
+					{
+						SaveShapefile(dataset);
+					}
 				}
 			}
 		}
 
-		auto const querySize = 2 * dataset.GetSmallestExtent() / std::max(1, QueriesPerAxis - 1);
+		SetWorkload(GridWorkload);
+		cout << dataset.GetName() << '\t' << dataset.GetSize() << '\n';
+	}
+
+	// Makes the queries of the workload, "grid" or one of QueryWorkloads. The other workloads make as many queries as the grid, of the same sizes
+	void SetWorkload(string const& newWorkload)
+	{
+		static constexpr auto RandomSeed = 37;
+
+		if (newWorkload == workload)
+		{
+			return;
+		}
+
+		workload = newWorkload;
+		queries.clear();
+
+		auto const querySize = 2 * dataset->GetSmallestExtent() / std::max(1, QueriesPerAxis - 1);
 		ASSERT(querySize > 0);
-		QueryIterator firstQuery{ GetLowBound(dataset.GetData().back().spatialKey), dataset.GetBoundingBox(), QueriesPerAxis, { querySize / 16, querySize / 2, querySize } };
+		vector const querySizes{ querySize / 16, querySize / 2, querySize };
+		QueryIterator firstQuery{ GetQuerySample(), dataset->GetBoundingBox(), QueriesPerAxis, querySizes };
 		std::copy(firstQuery, QueryIterator<VectorType>{}, back_inserter(queries));
 		//ASSERT(queryCount == QueriesPerAxis * QueriesPerAxis * 2);
 
-		queryResults.reserve(queries.size());
+		if (workload != GridWorkload)
+		{
+			QueryWorkloadMaker<TSpatialKey> maker{ RandomSeed, dataset->GetData(), dataset->GetBoundingBox(), querySizes };
+			queries = QueryWorkloads<TSpatialKey>.at(workload)(maker, int(queries.size()));
+		}
 
-		cout << dataset.GetName() << '\t' << dataset.GetSize() << '\n';
+		queryResults.reserve(queries.size());
 	}
 
-	static constexpr auto Tolerance = 0.1;
-
-	bool VerifyQueryResults(vector<double>&& results, string_view spatialIndexName, Timings::ActionStats* stats = nullptr)
+	// The low bound of the last feature, where the first query of the grid is centered. From the first feature of an external dataset, read from its file
+	[[nodiscard]] VectorType GetQuerySample() const
 	{
-		if (queryResults.empty())
+		if (!dataset->IsExternal())
 		{
-			queryResults = std::move(results);
+			return GetLowBound(dataset->GetData().back().spatialKey);
 		}
-		else
-		{
-			for (auto i = 0; i < Size(results); ++i)
-			{
-				if (abs(results[i] - queryResults[i]) > Tolerance)
-				{
-					cout << SetColorRed << std::fixed << "\t\t\tFAILED query index " << i << " for spatial index " << spatialIndexName
-						<< ", expected result " << queryResults[i] << ", got " << results[i] << ResetColor << '\n';
-					if (stats != nullptr)
-					{
-						stats->failed = true;
-					}
 
-					return false;
-				}
-			}
+		Feature<TSpatialKey> first{};
+		if (auto const stream = MakeDatasetStream(*dataset); stream != nullptr && stream->Rewind() && stream->Read(Span<Feature<TSpatialKey>>{ &first, 1 }) == 1)
+		{
+			return GetLowBound(first.spatialKey);
 		}
 
-		return true;
+		return dataset->GetBoundingBox().Min();
 	}
 
-	void ResetQueryVerifier()
+	// The scenario name of the results, with the workload as a suffix unless it is the grid
+	[[nodiscard]] string GetScenarioName(string_view scenarioName) const
 	{
-		queryResults.clear();
+		return workload == GridWorkload ? string{ scenarioName } : string{ scenarioName } + '/' + workload;
 	}
 
-	// Returns the change factor compared to the previous best time
-	double StoreResults(string_view testName, string_view spatialIndexName)
+	// Another dataset file of the data directory whose bounds overlap the dataset, the one selected with the "JoinDataset" configuration key if set, so that
+	// two real layers are joined, e.g. parcels and buildings. It has as many features as the dataset, or all of its own if it has fewer.
+	// For the synthetic datasets, or if no file overlaps, random boxes of the same count over the bounding box of the dataset, as large on average as its features.
+	// Made on first use
+	[[nodiscard]] Dataset<TSpatialKey> const& GetJoinDataset()
 	{
-		pair<int64_t, int64_t> accumulatedOldAndNewBestTimes{};
+		static constexpr auto RandomSeed = 31;
 
-		for (auto const& action : timings.GetAllActions())
+		if (joinDataset == nullptr)
 		{
-			auto entry = this->perfRecord->MakeEntry(*dataset, spatialIndexName, testName, action.first);
-			PerfRecord::Stats stats{ int64_t(action.second.bestTime), action.second.memoryDelta/* == std::numeric_limits<int64_t>::max() ? 0 : action.second.memoryDelta*/, action.second.failed };
-			if (auto const queryStats = static_cast<QueryStats*>(action.second.extra.get()))
+			joinDataset = LoadJoinFile();
+			if (joinDataset != nullptr)
 			{
-				stats.queryScalarComparisons = queryStats->ScalarComparisonsCount;
-				stats.queryBoxOverlaps = queryStats->BoxOverlapsCount;
-				stats.queryVisitedNodes = queryStats->VisitedNodesCount;
-				stats.queryObjectTests = queryStats->ObjectTestsCount;
+				joinDataset->SetSize(std::min(dataset->GetSize(), joinDataset->GetAvailableSize()));
+				return *joinDataset;
 			}
 
-			if (resetResults)
+			auto averageSize = 0.0;
+			for (auto const& feature : dataset->GetData())
 			{
-				this->perfRecord->SetEntry(entry, stats);
-			}
-			else
-			{
-				this->perfRecord->MergeEntry(entry, stats, &accumulatedOldAndNewBestTimes);
+				auto const sizes = BoxType(feature.spatialKey).Sizes();
+				auto maxSize = sizes[0];
+				for (auto axis = 1; axis < int(Dimensions); ++axis)
+				{
+					maxSize = std::max(maxSize, sizes[axis]);
+				}
+
+				averageSize += double(maxSize);
 			}
+
+			averageSize /= std::max(1, dataset->GetSize());
+			auto const maxHeight = std::max(ScalarType(2 * averageSize), ScalarType(1e-6));
+			auto data = ParallelMakeRandomSpatialKeys<TSpatialKey>(RandomSeed, std::max(1, dataset->GetSize()), dataset->GetBoundingBox(), { ScalarType(1e-7), maxHeight });
+			joinDataset = make_shared<Dataset<TSpatialKey>>(dataset->GetName() + "_JoinLayer", std::move(data));
 		}
 
-		if (!timings.GetAllActions().empty())
+		return *joinDataset;
+	}
+
+	// See GetJoinDataset(), null if there is no such file
+	[[nodiscard]] shared_ptr<Dataset<TSpatialKey>> LoadJoinFile() const
+	{
+		auto const sourcePath = GetSourceFilePath();
+		if (sourcePath.empty() || !is_directory(GetDataDirectory()))
 		{
-			auto entry = this->perfRecord->MakeEntry(*dataset, spatialIndexName, testName, "Total");
-			PerfRecord::Stats stats{ int64_t(timings.BestIterationTime()) };
-			stats.info = indexStats;
-			if (resetResults)
+			return nullptr;
+		}
+
+		for (auto const& entry : filesystem::directory_iterator{ GetDataDirectory() })
+		{
+			auto const& path = entry.path();
+			auto const name = DatasetFileIterator<TSpatialKey>::GetDatasetName(path);
+			if (!entry.is_regular_file() || name == sourcePath.filename().string() || !IsSelected("JoinDataset", name, -1))
 			{
-				this->perfRecord->SetEntry(entry, stats);
+				continue;
 			}
-			else
+
+			if (auto result = DatasetFileIterator<TSpatialKey>::LoadFile(path); result != nullptr && !result->IsExternal() && !result->IsEmpty()
+				&& Overlap(result->GetBoundingBox(), dataset->GetBoundingBox()))
 			{
-				this->perfRecord->MergeEntry(entry, stats);
+				return result;
 			}
 		}
 
-		return accumulatedOldAndNewBestTimes.second > 0 ? double(accumulatedOldAndNewBestTimes.second) * 100.0 / double(accumulatedOldAndNewBestTimes.first) : -1;
+		return nullptr;
 	}
-};
 
-template <typename TSpatialKey>
-struct TestScenario
-{
-	virtual ~TestScenario() = default;
+	// The segments of the lines or the polygon outlines of a shape file dataset, up to as many as its features, or the diagonals of the boxes of the other datasets.
+	// The returned dataset holds their bounding boxes, see segmentStarts and segmentEnds. Made on first use, for the 2D box keys only
+	[[nodiscard]] Dataset<TSpatialKey> const& GetSegmentDataset()
+	{
+		static_assert(SpatialKeyIsBox<TSpatialKey> && Dimensions == 2);
 
-	[[nodiscard]] virtual std::string_view Name() const = 0;
+		if (segmentDataset != nullptr)
+		{
+			return *segmentDataset;
+		}
+
+		auto const sourcePath = GetSourceFilePath();
+		vector<Segment<VectorType>> segments;
+		if (sourcePath.extension() == ".shp" && is_regular_file(sourcePath))
+		{
+			for (auto const& segment : ShapeFile{ sourcePath.string() }.GetSegments())
+			{
+				if (Size(segments) == dataset->GetSize())
+				{
+					break;
+				}
+
+				segments.push_back({ Convert<VectorType>(segment.first), Convert<VectorType>(segment.second) });
+			}
+		}
+
+		if (segments.empty())
+		{
+			segments = Transform(dataset->GetData(), [](Feature<TSpatialKey> const& feature) { return Segment<VectorType>{ feature.spatialKey.Min(), feature.spatialKey.Max() }; });
+		}
+
+		vector<Feature<TSpatialKey>> data;
+		data.reserve(segments.size());
+		for (auto i = 0; i < Size(segments); ++i)
+		{
+			data.push_back({ i, SpatialKeyTraits<Segment<VectorType>>::GetBox(segments[i]) });
+			for (auto axis = 0; axis < int(Dimensions); ++axis)
+			{
+				segmentStarts[axis].push_back(segments[i].first[axis]);
+				segmentEnds[axis].push_back(segments[i].second[axis]);
+			}
+		}
+
+		segmentDataset = make_unique<Dataset<TSpatialKey>>(dataset->GetName() + "_Segments", std::move(data));
+		return *segmentDataset;
+	}
+
+	// The file the dataset was loaded from, the source of its binary cache, which is named after it. Empty for the datasets made in memory
+	[[nodiscard]] filesystem::path GetSourceFilePath() const
+	{
+		auto result = dataset->GetFilePath();
+		if (result.extension() == Dataset<TSpatialKey>::BinaryFileExtension)
+		{
+			result.replace_extension().replace_extension();
+		}
+
+		return result;
+	}
+
+	static constexpr auto Tolerance = 0.1;
+
+	bool VerifyQueryResults(vector<double>&& results, string_view spatialIndexName, Timings::ActionStats* stats = nullptr)
+	{
+		if (queryResults.empty())
+		{
+			queryResults = std::move(results);
+		}
+		else
+		{
+			for (auto i = 0; i < Size(results); ++i)
+			{
+				if (abs(results[i] - queryResults[i]) > Tolerance)
+				{
+					cout << SetColorRed << std::fixed << "\t\t\tFAILED query index " << i << " for spatial index " << spatialIndexName
+						<< ", expected result " << queryResults[i] << ", got " << results[i] << ResetColor << '\n';
+					if (stats != nullptr)
+					{
+						stats->failed = true;
+					}
+
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void ResetQueryVerifier()
+	{
+		queryResults.clear();
+	}
+
+	// Returns the change factor compared to the previous best time. The verdict lists the actions whose median times changed significantly
+	// from the previous results, it is "not significant" if none did and empty if there are no previous results with enough samples
+	double StoreResults(string_view testName, string_view spatialIndexName, int nodeCapacity, string& verdict)
+	{
+		pair<int64_t, int64_t> accumulatedOldAndNewBestTimes{};
+		vector<string> significantChanges;
+		auto anyCompared = false;
+
+		// The single-threaded run of a parallel scenario is the baseline for the scaling efficiency of the others
+		auto baselineTime = 0.0;
+		for (auto const& action : timings.GetAllActions())
+		{
+			if (auto const extraStats = static_cast<ActionExtraStats*>(action.second.extra.get()); extraStats != nullptr && extraStats->threadCount == 1)
+			{
+				baselineTime = action.second.bestTime;
+			}
+		}
+
+		for (auto const& action : timings.GetAllActions())
+		{
+			auto entry = this->perfRecord->MakeEntry(*dataset, spatialIndexName, testName, action.first, nodeCapacity);
+			PerfRecord::Stats stats{ int64_t(action.second.bestTime), action.second.memoryDelta/* == std::numeric_limits<int64_t>::max() ? 0 : action.second.memoryDelta*/, action.second.failed };
+			stats.peakMemory = action.second.peakMemory;
+			stats.allocationCount = action.second.allocationCount;
+			auto const& counters = action.second.hardwareCounters;
+			stats.cycles = counters[HardwareCounters::Cycles];
+			stats.instructions = counters[HardwareCounters::Instructions];
+			stats.l1DataMisses = counters[HardwareCounters::L1DataMisses];
+			stats.lastLevelCacheMisses = counters[HardwareCounters::LastLevelCacheMisses];
+			stats.branchMisses = counters[HardwareCounters::BranchMisses];
+			stats.dataTlbMisses = counters[HardwareCounters::DataTlbMisses];
+			PerfRecord::SetSampleStats(stats, action.second);
+			if (auto const extraStats = static_cast<ActionExtraStats*>(action.second.extra.get()))
+			{
+				auto const& queryStats = extraStats->queryStats;
+				stats.queryScalarComparisons = queryStats.ScalarComparisonsCount;
+				stats.queryBoxOverlaps = queryStats.BoxOverlapsCount;
+				stats.queryVisitedNodes = queryStats.VisitedNodesCount;
+				stats.queryObjectTests = queryStats.ObjectTestsCount;
+				stats.bytesRead = extraStats->ioBytesRead;
+				stats.bytesWritten = extraStats->ioBytesWritten;
+
+				if (auto const& latencies = extraStats->queryLatencies; latencies != nullptr && !latencies->IsEmpty())
+				{
+					stats.latencyP50 = latencies->GetPercentile(50);
+					stats.latencyP90 = latencies->GetPercentile(90);
+					stats.latencyP99 = latencies->GetPercentile(99);
+					stats.latencyP999 = latencies->GetPercentile(99.9);
+					stats.latencyMax = latencies->Maximum();
+				}
+
+				if (action.second.bestTime > 0)
+				{
+					stats.queriesPerSecond = double(extraStats->queryCount) * double(Timings::UsPerSecond) / action.second.bestTime;
+					stats.updatesPerSecond = double(extraStats->updateCount) * double(Timings::UsPerSecond) / action.second.bestTime;
+					if (extraStats->threadCount > 0 && baselineTime > 0)
+					{
+						stats.scalingEfficiency = baselineTime / action.second.bestTime / extraStats->threadCount;
+					}
+				}
+			}
+
+			if (auto const previousStats = this->perfRecord->FindEntry(entry); previousStats != nullptr && !resetResults)
+			{
+				if (auto const change = PerfRecord::Compare(*previousStats, stats); change != PerfRecord::Verdict::Unknown)
+				{
+					anyCompared = true;
+					if (change != PerfRecord::Verdict::NotSignificant)
+					{
+						ostringstream description;
+						description << action.first << ' ' << std::showpos << std::setprecision(1) << std::fixed << (stats.medianTime / previousStats->medianTime - 1) * 100 << '%';
+						significantChanges.push_back(description.str());
+					}
+				}
+			}
+
+			if (resetResults)
+			{
+				this->perfRecord->SetEntry(entry, stats);
+			}
+			else
+			{
+				this->perfRecord->MergeEntry(entry, stats, &accumulatedOldAndNewBestTimes);
+			}
+		}
+
+		verdict.clear();
+		if (!significantChanges.empty())
+		{
+			sort(significantChanges.begin(), significantChanges.end());
+			verdict = "significant: ";
+			for (auto i = 0; i < Size(significantChanges); ++i)
+			{
+				verdict += (i > 0 ? ", " : "") + significantChanges[i];
+			}
+		}
+		else if (anyCompared)
+		{
+			verdict = "not significant";
+		}
+
+		if (!timings.GetAllActions().empty())
+		{
+			auto entry = this->perfRecord->MakeEntry(*dataset, spatialIndexName, testName, "Total", nodeCapacity);
+			PerfRecord::Stats stats{ int64_t(timings.BestIterationTime()) };
+			stats.info = indexStats;
+			if (resetResults)
+			{
+				this->perfRecord->SetEntry(entry, stats);
+			}
+			else
+			{
+				this->perfRecord->MergeEntry(entry, stats);
+			}
+		}
+
+		return accumulatedOldAndNewBestTimes.second > 0 ? double(accumulatedOldAndNewBestTimes.second) * 100.0 / double(accumulatedOldAndNewBestTimes.first) : -1;
+	}
+};
+
+template <typename TSpatialKey>
+struct TestScenario
+{
+	virtual ~TestScenario() = default;
+
+	[[nodiscard]] virtual std::string_view Name() const = 0;
 
 	// Return -1 if the scenario is not supported, or the number of failures is supported
 	[[nodiscard]] virtual int Run(TestContext<TSpatialKey>&, SpatialIndexWrapper<TSpatialKey> const&) const = 0;
+
+	// Whether the results depend on TestContext::queries, the scenarios that do are run for each of the selected workloads
+	[[nodiscard]] virtual bool UsesQueries() const
+	{
+		return true;
+	}
+
+	// Whether the scenario runs on the datasets whose features are not in memory, see Dataset::IsExternal()
+	[[nodiscard]] virtual bool SupportsExternalDataset() const
+	{
+		return false;
+	}
+};
+
+
+template <typename TSpatialKey>
+struct Test_Load_Query_Destroy : TestScenario<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+	[[nodiscard]] virtual char const* GetOpName() const = 0;
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (RunQuery(wrapper, wrapper.Load(Dataset<TSpatialKey>{}), BoxType{ VectorType{0} }) < 0)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support " << GetOpName() << ")\n";
+			}
+
+			return -1;
+		}
+
+		auto const& dataset = GetQueryDataset(test);
+		if (!wrapper.SupportsDatasetSize(dataset.GetSize()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << dataset.GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		PrepareQueries(test);
+
+		Timings::ActionStats* statsQuery = nullptr;
+
+		auto statsStored = false;
+
+		vector<double> queryResults;
+		queryResults.reserve(test.queries.size());
+
+		// Build the columnar view of the dataset up front, so that adapters that load from it do not pay for the conversion in "Bulk Load"
+		[[maybe_unused]] auto const& columns = dataset.GetColumns();
+
+		auto const latencies = GetConfig().Get<bool>("QueryLatency") ? MakeLatencyHistogram() : nullptr;
+
+		while (test.timings.NextIteration())
+		{
+			auto spatialIndex = test.timings.Record(
+				"Bulk Load",
+				[&]
+				{
+					return wrapper.Load(dataset);
+				});
+
+			if (spatialIndex == nullptr)
+			{
+				return -1;
+			}
+
+			ClearQueryStats();
+
+			test.timings.Record(
+				GetOpName(),
+				[&]
+				{
+					auto queryIndex = 0;
+					for (auto const& query : test.queries)
+					{
+						Stopwatch const queryTimer{ latencies != nullptr };
+						auto const result = RunQuery(wrapper, spatialIndex, query);
+						if (latencies != nullptr)
+						{
+							latencies->Add(queryTimer.ElapsedNanoseconds());
+						}
+
+						if (queryIndex >= Size(queryResults))
+						{
+							queryResults.push_back(result);
+						}
+
+						++queryIndex;
+					}
+				},
+				&statsQuery);
+
+			if (!statsStored)
+			{
+				statsStored = true;
+				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+			}
+
+			statsQuery->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(int(test.queries.size())), int(test.queries.size()), 0, latencies });
+
+			test.timings.Record("Destroy", [&spatialIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					return 0;
+				});
+		}
+
+		if (!FinishQueries(wrapper))
+		{
+			if (statsQuery != nullptr)
+			{
+				statsQuery->failed = true;
+			}
+
+			return 1;
+		}
+
+		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQuery) ? 0 : 1;
+	}
+
+	// The dataset the index is loaded with
+	[[nodiscard]] virtual Dataset<TSpatialKey> const& GetQueryDataset(TestContext<TSpatialKey>& test) const
+	{
+		return *test.dataset;
+	}
+
+	// Set up what the queries need outside of the timings, after the wrapper was found to support them
+	virtual void PrepareQueries(TestContext<TSpatialKey> const& /*test*/) const
+	{
+	}
+
+	// Check what the queries of all iterations found wrong that their results cannot show, return false to fail the run
+	[[nodiscard]] virtual bool FinishQueries(SpatialIndexWrapper<TSpatialKey> const& /*wrapper*/) const
+	{
+		return true;
+	}
+
+	[[nodiscard]] virtual double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const = 0;
+};
+
+template <typename TSpatialKey>
+struct Test_Load_QueryBox_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryRange-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryBox;
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		return wrapper.QueryBox(spatialIndex, query);
+	}
+};
+
+template <typename TSpatialKey>
+struct Test_Load_QueryNearest_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryNearest-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryNearest;
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		return wrapper.QueryNearest(spatialIndex, query.Center(), QueryNearestCount);
+	}
+};
+
+// Finds the segments nearest to the centers of the queries, indexed by their bounding boxes, see TestContext::GetSegmentDataset(). The indices refine the distances
+// to the boxes with the exact distances to the segments, computed by the batched kernel GetSegmentDistancesSquared(). For the 2D box keys only
+template <typename TSpatialKey>
+struct Test_Load_QueryNearestSegment_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+{
+	using ScalarType = typename SpatialKeyTraits<TSpatialKey>::ScalarType;
+	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	static constexpr auto Dimensions = int(SpatialKeyTraits<TSpatialKey>::Dimensions);
+
+	static constexpr auto IsSupported = SpatialKeyIsBox<TSpatialKey> && Dimensions == 2;
+
+	// Gathers the ends of the segments in blocks, one array per axis
+	struct SegmentDistances final : SpatialIndexWrapper<TSpatialKey>::ExactDistances
+	{
+		array<vector<ScalarType>, Dimensions> const* starts = nullptr;
+		array<vector<ScalarType>, Dimensions> const* ends = nullptr;
+
+		void operator()(VectorType const& location, Span<FeatureId const> ids, Span<ScalarType> distancesSquared) override
+		{
+			array<array<ScalarType, OverlapMaskBits>, Dimensions> blockStarts;
+			array<array<ScalarType, OverlapMaskBits>, Dimensions> blockEnds;
+			array<ScalarType const*, Dimensions> startPointers{};
+			array<ScalarType const*, Dimensions> endPointers{};
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				startPointers[axis] = blockStarts[axis].data();
+				endPointers[axis] = blockEnds[axis].data();
+			}
+
+			auto const point = SpatialKeyTraits<TSpatialKey>::VectorTraitsType::ToArray(location);
+			for (auto first = 0; first < Size(ids); first += OverlapMaskBits)
+			{
+				auto const count = int(std::min(std::ptrdiff_t(OverlapMaskBits), Size(ids) - first));
+				for (auto i = 0; i < count; ++i)
+				{
+					for (auto axis = 0; axis < Dimensions; ++axis)
+					{
+						blockStarts[axis][i] = (*starts)[axis][ids[first + i]];
+						blockEnds[axis][i] = (*ends)[axis][ids[first + i]];
+					}
+				}
+
+				GetSegmentDistancesSquared(point, startPointers, endPointers, count, distancesSquared.data() + first);
+			}
+		}
+	};
+
+	mutable SegmentDistances distances;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryNearestSegment-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryNearestSegment;
+	}
+
+	[[nodiscard]] Dataset<TSpatialKey> const& GetQueryDataset(TestContext<TSpatialKey>& test) const override
+	{
+		if constexpr (IsSupported)
+		{
+			return test.GetSegmentDataset();
+		}
+		else
+		{
+			return *test.dataset;
+		}
+	}
+
+	void PrepareQueries(TestContext<TSpatialKey> const& test) const override
+	{
+		distances.starts = &test.segmentStarts;
+		distances.ends = &test.segmentEnds;
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		if constexpr (IsSupported)
+		{
+			return wrapper.QueryNearestRefined(spatialIndex, query.Center(), QueryNearestCount, distances);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+};
+
+// Finds the features nearest to the centers of the queries by great-circle distance, with the Geodetic indices (Geodetic.hpp), for the shape file datasets
+// in longitude and latitude degrees. Compare it to Load-QueryNearest-Destroy on the same datasets for the cost of the geodetic distances
+template <typename TSpatialKey>
+struct Test_Load_QueryNearestGeodetic_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryNearestGeodetic-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryNearestGeodetic;
+	}
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (test.GetSourceFilePath().extension() != ".shp" || !IsInDegrees(test.dataset->GetBoundingBox()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (the dataset is not a shape file in longitude and latitude degrees)\n";
+			}
+
+			return -1;
+		}
+
+		return Test_Load_Query_Destroy<TSpatialKey>::Run(test, wrapper);
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		return wrapper.QueryNearestGeodetic(spatialIndex, query.Center(), QueryNearestCount);
+	}
+
+	[[nodiscard]] static bool IsInDegrees(BoxType const& box)
+	{
+		return SpatialKeyTraits<TSpatialKey>::Dimensions == 2
+			&& box.Min()[0] >= -180 && box.Max()[0] <= 180
+			&& box.Min()[1] >= -90 && box.Max()[1] <= 90;
+	}
+};
+
+// Writes the ids of the found features into a buffer allocated once for the whole dataset, to measure the queries together with the output of their results.
+// The result of a query is the sum of its ids, which does not depend on their order
+template <typename TSpatialKey>
+struct Test_Load_QueryBoxIds_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	mutable vector<FeatureId> ids;
+
+	// The count of the queries that returned more ids than the dataset has features
+	mutable int overflowCount = 0;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryBoxIds-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryBoxIds;
+	}
+
+	void PrepareQueries(TestContext<TSpatialKey> const& test) const override
+	{
+		ids.assign(test.dataset->GetSize(), FeatureId{ 0 });
+		overflowCount = 0;
+	}
+
+	[[nodiscard]] bool FinishQueries(SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (overflowCount > 0)
+		{
+			cout << SetColorRed << "\t\t\tFAILED " << overflowCount << " queries of spatial index " << wrapper.Name() << " returned more ids than the "
+				<< Size(ids) << " features of the dataset" << ResetColor << '\n';
+			return false;
+		}
+
+		return true;
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		auto const count = wrapper.QueryBoxIds(spatialIndex, query, ids);
+		if (count < 0)
+		{
+			return -1;
+		}
+
+		if (count > Size(ids))
+		{
+			// The buffer holds each feature once, so the index returned some of them more than once
+			++overflowCount;
+			return -1;
+		}
+
+		return std::accumulate(ids.begin(), ids.begin() + count, 0.0, [](double sum, FeatureId id) { return sum + double(id); });
+	}
+};
+
+// Stops each query after the first found features, see the "QueryLimit" configuration key, e.g. for hit tests and "any feature here" checks.
+// The result of a query is the count of the visited features
+template <typename TSpatialKey>
+struct Test_Load_QueryBoxLimit_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	struct LimitVisitor final : SpatialIndexWrapper<TSpatialKey>::QueryVisitor
+	{
+		int remaining = 0;
+
+		bool operator()(FeatureId /*id*/) override
+		{
+			return --remaining > 0;
+		}
+	};
+
+	mutable int limit = 1;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryBoxLimit-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryBoxLimit;
+	}
+
+	void PrepareQueries(TestContext<TSpatialKey> const& /*test*/) const override
+	{
+		limit = std::max(1, GetConfig().Get<int>("QueryLimit"));
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		LimitVisitor visitor;
+		visitor.remaining = limit;
+		return wrapper.QueryBoxVisit(spatialIndex, query, visitor);
+	}
+};
+
+static char const* GetParallelOpName(char const* opName, int threadCount)
+{
+	// Timings identifies the actions by the address of their names, so these must stay alive
+	static StringStorage names;
+	return names.GetOrAddString(string(opName) + " x" + to_string(threadCount)).data();
+}
+
+// Runs the queries on several threads against one shared index, once for each of the configured thread counts, to measure the throughput and how it scales
+template <typename TSpatialKey>
+struct Test_Load_ParallelQuery_Destroy : TestScenario<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+	// Small enough to balance the load between the threads, large enough to keep them from contending on the shared query counter
+	static constexpr auto QueriesPerChunk = 4;
+
+	[[nodiscard]] virtual char const* GetOpName() const = 0;
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (RunQuery(wrapper, wrapper.Load(Dataset<TSpatialKey>{}), BoxType{ VectorType{0} }) < 0)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support " << GetOpName() << ")\n";
+			}
+
+			return -1;
+		}
+
+		if (!wrapper.SupportsDatasetSize(test.dataset->GetSize()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << test.dataset->GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		auto const threadCounts = GetThreadCounts();
+		vector<unique_ptr<ThreadPool>> threadPools;
+		vector<char const*> opNames;
+		for (auto const threadCount : threadCounts)
+		{
+			threadPools.push_back(make_unique<ThreadPool>(threadCount));
+			opNames.push_back(GetParallelOpName(GetOpName(), threadCount));
+		}
+
+		auto const queryCount = int(test.queries.size());
+		vector<double> queryResults(queryCount);
+
+		auto statsStored = false;
+
+		[[maybe_unused]] auto const& columns = test.dataset->GetColumns();
+
+		while (test.timings.NextIteration())
+		{
+			auto spatialIndex = test.timings.Record(
+				"Bulk Load",
+				[&]
+				{
+					return wrapper.Load(*test.dataset);
+				});
+
+			if (spatialIndex == nullptr)
+			{
+				return -1;
+			}
+
+			for (auto i = 0; i < Size(threadCounts); ++i)
+			{
+				std::fill(queryResults.begin(), queryResults.end(), -1.0);
+
+				Timings::ActionStats* statsQuery = nullptr;
+				ClearQueryStats();
+				test.timings.Record(
+					opNames[i],
+					[&]
+					{
+						threadPools[i]->ForEachIndex(queryCount, QueriesPerChunk, [&](int queryIndex, int)
+							{
+								queryResults[queryIndex] = RunQuery(wrapper, spatialIndex, test.queries[queryIndex]);
+							});
+					},
+					&statsQuery);
+
+				// The run has completed, so the counters of every worker are final
+				statsQuery->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(queryCount), queryCount, threadCounts[i] });
+
+				if (!test.VerifyQueryResults(vector<double>(queryResults), wrapper.Name(), statsQuery))
+				{
+					return 1;
+				}
+			}
+
+			if (!statsStored)
+			{
+				statsStored = true;
+				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+			}
+
+			test.timings.Record("Destroy", [&spatialIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					return 0;
+				});
+		}
+
+		return 0;
+	}
+
+	[[nodiscard]] virtual double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const = 0;
+};
+
+template <typename TSpatialKey>
+struct Test_Load_ParallelQueryBox_Destroy final : Test_Load_ParallelQuery_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-ParallelQueryBox-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryBox;
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		return wrapper.QueryBox(spatialIndex, query);
+	}
+};
+
+template <typename TSpatialKey>
+struct Test_Load_ParallelQueryNearest_Destroy final : Test_Load_ParallelQuery_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-ParallelQueryNearest-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return OpNameQueryNearest;
+	}
+
+	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	{
+		return wrapper.QueryNearest(spatialIndex, query.Center(), QueryNearestCount);
+	}
+};
+
+// Runs all queries as one batch, to measure what the locality-aware batching of each index buys compared to the single queries of Test_Load_Query_Destroy
+template <typename TSpatialKey>
+struct Test_Load_QueryBatch_Destroy : TestScenario<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+	[[nodiscard]] virtual char const* GetOpName() const = 0;
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		// The support is probed with the first query
+		if (test.queries.empty())
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (no queries)\n";
+			}
+
+			return -1;
+		}
+
+		vector<double> probeResult(1);
+		RunBatch(wrapper, wrapper.Load(Dataset<TSpatialKey>{}), Span{ &test.queries[0], 1 }, probeResult);
+		if (probeResult[0] < 0)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support " << GetOpName() << ")\n";
+			}
+
+			return -1;
+		}
+
+		if (!wrapper.SupportsDatasetSize(test.dataset->GetSize()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << test.dataset->GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		Timings::ActionStats* statsQuery = nullptr;
+
+		auto statsStored = false;
+
+		vector<double> queryResults(test.queries.size());
+
+		[[maybe_unused]] auto const& columns = test.dataset->GetColumns();
+
+		while (test.timings.NextIteration())
+		{
+			auto spatialIndex = test.timings.Record(
+				"Bulk Load",
+				[&]
+				{
+					return wrapper.Load(*test.dataset);
+				});
+
+			if (spatialIndex == nullptr)
+			{
+				return -1;
+			}
+
+			ClearQueryStats();
+
+			test.timings.Record(
+				GetOpName(),
+				[&]
+				{
+					RunBatch(wrapper, spatialIndex, test.queries, queryResults);
+				},
+				&statsQuery);
+
+			if (!statsStored)
+			{
+				statsStored = true;
+				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+			}
+
+			statsQuery->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(int(test.queries.size())), int(test.queries.size()) });
+
+			test.timings.Record("Destroy", [&spatialIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					return 0;
+				});
+		}
+
+		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQuery) ? 0 : 1;
+	}
+
+	// The batch conversions happen inside the timed action, they are part of the batching cost
+	virtual void RunBatch(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, Span<BoxType const> queries, Span<double> results) const = 0;
+};
+
+template <typename TSpatialKey>
+struct Test_Load_QueryBoxBatch_Destroy final : Test_Load_QueryBatch_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryBoxBatch-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return "Query Range Batch";
+	}
+
+	void RunBatch(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, Span<BoxType const> queries, Span<double> results) const override
+	{
+		vector<int> counts(queries.size());
+		wrapper.QueryBoxBatch(spatialIndex, queries, counts);
+		std::copy(counts.begin(), counts.end(), results.begin());
+	}
+};
+
+template <typename TSpatialKey>
+struct Test_Load_QueryNearestBatch_Destroy final : Test_Load_QueryBatch_Destroy<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-QueryNearestBatch-Destroy";
+	}
+
+	[[nodiscard]] char const* GetOpName() const override
+	{
+		return "Query Nearest Batch";
+	}
+
+	void RunBatch(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, Span<BoxType const> queries, Span<double> results) const override
+	{
+		auto const locations = Transform(queries, [](BoxType const& query) { return query.Center(); });
+		wrapper.QueryNearestBatch(spatialIndex, locations, QueryNearestCount, results);
+	}
+};
+
+template <typename TSpatialKey>
+struct Test_Insert_Erase_Query : TestScenario<TSpatialKey>
+{
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Insert-Erase-Query";
+	}
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (!wrapper.IsDynamic())
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support removal)" << '\n';
+			}
+
+			return -1;
+		}
+
+		if (!wrapper.SupportsDatasetSize(test.dataset->GetSize()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << test.dataset->GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		if constexpr (SpatialKeyTraits<TSpatialKey>::Dimensions != 2)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (too slow in 3 dimensions)" << '\n';
+			}
+
+			return -1;
+		}
+		else
+		{
+			return Run_(test, wrapper);
+		}
+	}
+
+	static int Run_(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper)
+	{
+		Timings::ActionStats* statsQueryBox = nullptr;
+
+		auto const& dataset = *test.dataset;
+
+		vector<double> queryResults;
+		queryResults.reserve(test.queries.size());
+
+		auto statsStored = false;
+
+		while (test.timings.NextIteration())
+		{
+			auto spatialIndex = wrapper.MakeEmptyIndex();
+
+			test.timings.Record(
+				"Insert",
+				[&]
+				{
+					for (auto const& feature : dataset.GetData())
+					{
+						wrapper.Insert(spatialIndex, &feature);
+					}
+				});
+
+			if (!wrapper.Erase(spatialIndex, &dataset.GetData()[0]))
+			{
+				cout << "\t\t" << wrapper.Name() << '\t' << "skipped, removing failed\n";
+				return -1;
+			}
+
+			// Remove some elements, both to measure erasing speed and disbalance the index
+			test.timings.Record(
+				"Erase",
+				[&]
+				{
+					auto const dataSetSize = dataset.GetSize();
+					for (auto i = 0; i < dataSetSize; i += 5)
+					{
+						wrapper.Erase(spatialIndex, &dataset.GetData()[i]);
+					}
+				});
+
+			// Return the erased elements back, both to make query results comparable to the other tests and to disbalance the index even more
+			test.timings.Record(
+				"Reinsert",
+				[&]
+				{
+					auto const dataSetSize = dataset.GetSize();
+					for (auto i = 0; i < dataSetSize; i += 5)
+					{
+						wrapper.Insert(spatialIndex, &dataset.GetData()[i]);
+					}
+				});
+
+			// Then give indices that need re-balancing a chance to do it
+			test.timings.Record(
+				"Rebalance",
+				[&]
+				{
+					wrapper.Rebalance(spatialIndex);
+				});
+
+			ClearQueryStats();
+			test.timings.Record(
+				OpNameQueryBox,
+				[&]
+				{
+					auto queryIndex = 0;
+					for (auto const& query : test.queries)
+					{
+						auto const result = wrapper.QueryBox(spatialIndex, query);
+						if (queryIndex >= Size(queryResults))
+						{
+							queryResults.push_back(result);
+						}
+
+						++queryIndex;
+					}
+				}, &statsQueryBox);
+			statsQueryBox->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(int(test.queries.size())), int(test.queries.size()) });
+
+			if (!statsStored)
+			{
+				statsStored = true;
+				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+			}
+		}
+
+		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQueryBox) ? 0 : 1;
+	}
+};
+
+// Writer threads keep erasing and reinserting features while reader threads run the box queries, with the index accessed through each of the concurrency adapters.
+// The writers are paced to make one update per ReadWriteRatio completed queries, they stop when the readers are done. Records the reader and writer throughput and the reader latencies
+template <typename TSpatialKey>
+struct Test_Load_MixedReadWrite_Destroy final : TestScenario<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+
+	static constexpr auto QueriesPerChunk = 4;
+
+	// The queries are run this many times, to give the writers the time for a steady stream of updates
+	static constexpr auto QueryRounds = 4;
+
+	// Spreads the updated features over the dataset, instead of updating its beginning only
+	static constexpr std::int64_t UpdateStride = 7919;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-MixedReadWrite-Destroy";
+	}
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (!wrapper.IsDynamic())
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support removal)" << '\n';
+			}
+
+			return -1;
+		}
+
+		if (!wrapper.SupportsDatasetSize(test.dataset->GetSize()) || test.dataset->GetSize() == 0)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << test.dataset->GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		vector<unique_ptr<ConcurrencyAdapter<TSpatialKey>>> adapters;
+		for (auto& adapter : MakeConcurrencyAdapters(wrapper))
+		{
+			if (IsSelected("Concurrency", adapter->Name()) && adapter->Supports(wrapper))
+			{
+				adapters.push_back(std::move(adapter));
+			}
+		}
+
+		auto const readWriteRatio = std::max(1, GetConfig().Get<int>("ReadWriteRatio"));
+		auto const writerCount = std::max(1, GetConfig().Get<int>("WriterThreads"));
+		auto const readerCounts = GetThreadCounts();
+
+		vector<unique_ptr<ThreadPool>> threadPools;
+		for (auto const readerCount : readerCounts)
+		{
+			threadPools.push_back(make_unique<ThreadPool>(readerCount + writerCount));
+		}
+
+		// One per action, over all iterations
+		vector<char const*> opNames;
+		vector<shared_ptr<LatencyHistogram>> actionLatencies;
+		for (auto const& adapter : adapters)
+		{
+			for (auto const readerCount : readerCounts)
+			{
+				opNames.push_back(GetMixedOpName(adapter->Name(), readerCount, writerCount));
+				actionLatencies.push_back(MakeLatencyHistogram());
+			}
+		}
+
+		auto const data = test.dataset->GetData();
+		auto const queryCount = int(test.queries.size());
+		auto const readCount = QueryRounds * queryCount;
+		vector<double> queryResults(queryCount);
+		vector<LatencyHistogram, MallocAllocator<LatencyHistogram>> threadLatencies(readerCounts.back());
+
+		auto statsStored = false;
+
+		while (test.timings.NextIteration())
+		{
+			auto spatialIndex = test.timings.Record(
+				"Bulk Load",
+				[&]
+				{
+					return wrapper.Load(*test.dataset);
+				});
+
+			if (spatialIndex == nullptr)
+			{
+				return -1;
+			}
+
+			auto actionIndex = 0;
+			for (auto const& adapter : adapters)
+			{
+				for (auto i = 0; i < Size(readerCounts); ++i, ++actionIndex)
+				{
+					auto const readerCount = readerCounts[i];
+					std::fill(queryResults.begin(), queryResults.end(), -1.0);
+					for (auto& latencies : threadLatencies)
+					{
+						latencies.Clear();
+					}
+
+					adapter->SetIndex(std::move(spatialIndex));
+
+					std::atomic<int> nextRead{ 0 };
+					std::atomic<int> readsDone{ 0 };
+					std::atomic<int> readersRunning{ readerCount };
+					std::atomic<int> nextUpdate{ 0 };
+
+					Timings::ActionStats* statsMixed = nullptr;
+					ClearQueryStats();
+					test.timings.Record(
+						opNames[actionIndex],
+						[&]
+						{
+							// The readers come first, so that the hardware counters of the calling thread are those of a reader
+							threadPools[i]->Run([&](int threadIndex)
+								{
+									if (threadIndex < readerCount)
+									{
+										auto& latencies = threadLatencies[threadIndex];
+										for (auto first = nextRead.fetch_add(QueriesPerChunk); first < readCount; first = nextRead.fetch_add(QueriesPerChunk))
+										{
+											auto const last = std::min(first + QueriesPerChunk, readCount);
+											for (auto readIndex = first; readIndex < last; ++readIndex)
+											{
+												Stopwatch const queryTimer;
+												auto const result = adapter->QueryBox(test.queries[readIndex % queryCount]);
+												latencies.Add(queryTimer.ElapsedNanoseconds());
+												if (readIndex < queryCount)
+												{
+													queryResults[readIndex] = result;
+												}
+											}
+
+											readsDone.fetch_add(last - first);
+										}
+
+										readersRunning.fetch_sub(1);
+										return;
+									}
+
+									while (readersRunning.load() > 0)
+									{
+										auto updateIndex = nextUpdate.load();
+										if (updateIndex >= readsDone.load() / readWriteRatio)
+										{
+											std::this_thread::yield();
+										}
+										else if (nextUpdate.compare_exchange_weak(updateIndex, updateIndex + 1))
+										{
+											adapter->Update(&data[std::ptrdiff_t(updateIndex * UpdateStride % Size(data))]);
+										}
+									}
+								});
+						},
+						&statsMixed);
+
+					spatialIndex = adapter->ReleaseIndex();
+
+					auto const& latencies = actionLatencies[actionIndex];
+					for (auto const& threadLatency : threadLatencies)
+					{
+						latencies->Merge(threadLatency);
+					}
+
+					// The update count of the last iteration is taken. The thread count is not set, the single reader run is not a baseline for the scaling efficiency
+					statsMixed->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(readCount), readCount, 0, latencies, nextUpdate.load() });
+
+					// Both adapters make the updates atomic for the readers, and each update restores the same feature, so the results are those of the static index
+					if (!test.VerifyQueryResults(vector<double>(queryResults), wrapper.Name(), statsMixed))
+					{
+						return 1;
+					}
+				}
+			}
+
+			if (!statsStored)
+			{
+				statsStored = true;
+				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+			}
+
+			test.timings.Record("Destroy", [&spatialIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					return 0;
+				});
+		}
+
+		return 0;
+	}
+
+private:
+
+	static char const* GetMixedOpName(std::string_view adapterName, int readerCount, int writerCount)
+	{
+		// Timings identifies the actions by the address of their names, so these must stay alive
+		static StringStorage names;
+		return names.GetOrAddString(string(adapterName) + " x" + to_string(readerCount) + " +" + to_string(writerCount) + "w").data();
+	}
+};
+
+// Bulk-loads the dataset and a second layer over the same area, another dataset file or random boxes (see TestContext::GetJoinDataset()), then joins them,
+// finding the features of the second layer that overlap each feature of the first. The native joins are checked against the default SpatialIndexWrapper::QueryJoin()
+template <typename TSpatialKey>
+struct Test_Load_Join_Destroy final : TestScenario<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+	// The results to compare: the count of the overlapping pairs and the sum of the ids of the first layer, weighted by their matches
+	struct JoinResults final : SpatialIndexWrapper<TSpatialKey>::JoinCallback
+	{
+		std::int64_t matchCount = 0;
+		double weightedIdSum = 0;
+
+		void operator()(FeatureId idA, int count) override
+		{
+			matchCount += count;
+			weightedIdSum += double(idA) * count;
+		}
+	};
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Load-Join-Destroy";
+	}
+
+	[[nodiscard]] bool UsesQueries() const override
+	{
+		return false;
+	}
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if constexpr (SpatialKeyIsPoint<TSpatialKey>)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (point layers have no overlaps to join)" << '\n';
+			}
+
+			return -1;
+		}
+
+		if (wrapper.QueryBox(wrapper.Load(Dataset<TSpatialKey>{}), BoxType{ VectorType{0} }) < 0)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support " << OpNameQueryJoin << ")\n";
+			}
+
+			return -1;
+		}
+
+		if (!wrapper.SupportsDatasetSize(test.dataset->GetSize()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << test.dataset->GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		auto const& joinDataset = test.GetJoinDataset();
+		auto const data = test.dataset->GetData();
+
+		auto resultsChecked = false;
+		Timings::ActionStats* statsJoin = nullptr;
+
+		while (test.timings.NextIteration())
+		{
+			auto spatialIndex = test.timings.Record(
+				"Bulk Load",
+				[&]
+				{
+					return wrapper.Load(*test.dataset);
+				});
+
+			auto joinIndex = test.timings.Record(
+				"Bulk Load Join Layer",
+				[&]
+				{
+					return wrapper.Load(joinDataset);
+				});
+
+			if (spatialIndex == nullptr || joinIndex == nullptr)
+			{
+				return -1;
+			}
+
+			JoinResults results;
+			ClearQueryStats();
+			auto const pairCount = test.timings.Record(
+				OpNameQueryJoin,
+				[&]
+				{
+					return wrapper.QueryJoin(spatialIndex, data, joinIndex, results);
+				},
+				&statsJoin);
+
+			// The join probes the index with each of the features
+			statsJoin->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(int(data.size())), int(data.size()) });
+
+			if (!resultsChecked)
+			{
+				resultsChecked = true;
+				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+
+				JoinResults expected;
+				[[maybe_unused]] auto const expectedPairCount = wrapper.SpatialIndexWrapper<TSpatialKey>::QueryJoin(spatialIndex, data, joinIndex, expected);
+				if (pairCount != results.matchCount || results.matchCount != expected.matchCount || results.weightedIdSum != expected.weightedIdSum)
+				{
+					cout << SetColorRed << std::fixed << "\t\t\tFAILED join for spatial index " << wrapper.Name() << ", expected " << expected.matchCount << " pairs (id sum " << expected.weightedIdSum
+						<< "), got " << pairCount << " (reported " << results.matchCount << ", id sum " << results.weightedIdSum << ")" << ResetColor << '\n';
+					statsJoin->failed = true;
+					return 1;
+				}
+			}
+
+			test.timings.Record("Destroy", [&spatialIndex, &joinIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					[[maybe_unused]] auto toKillToo = std::move(joinIndex);
+					return 0;
+				});
+		}
+
+		return 0;
+	}
+};
+
+// Saves the index once and measures the cold start from the saved file against the bulk load: the time to the first query result and the page faults of each path,
+// and then the queries on the opened index. The cached pages of the file are dropped before each Open (where supported), so the opened index is read from the storage device
+template <typename TSpatialKey>
+struct Test_Open_QueryBox_Close final : TestScenario<TSpatialKey>
+{
+	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
+	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "Open-QueryBox-Close";
+	}
+
+	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
+	{
+		if (wrapper.QueryBox(wrapper.Load(Dataset<TSpatialKey>{}), BoxType{ VectorType{0} }) < 0)
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support " << OpNameQueryBox << ")\n";
+			}
+
+			return -1;
+		}
+
+		if (!wrapper.SupportsDatasetSize(test.dataset->GetSize()))
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support datasets of size " << test.dataset->GetSize() << ")\n";
+			}
+
+			return -1;
+		}
+
+		// The time to the first result is measured with the first query
+		if (test.queries.empty())
+		{
+			if (PrintVerboseMessages())
+			{
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (no queries)\n";
+			}
+
+			return -1;
+		}
+
+		auto const imagePath = GetOutputPath() / filesystem::path{ GetFilename<TSpatialKey>(*test.dataset) + ".index" };
+		vector<double> expectedResults;
+		{
+			auto const loadedIndex = wrapper.Load(*test.dataset);
+			if (loadedIndex == nullptr || !wrapper.Save(loadedIndex, imagePath))
+			{
+				if (PrintVerboseMessages())
+				{
+					cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support Save)\n";
+				}
+
+				return -1;
+			}
+
+			expectedResults = Transform(test.queries, [&](BoxType const& query) { return double(wrapper.QueryBox(loadedIndex, query)); });
+		}
+
+		auto const& firstQuery = test.queries.front();
+		Timings::ActionStats* statsQuery = nullptr;
+		vector<double> queryResults;
+		queryResults.reserve(test.queries.size());
+
+		// Of the first iteration, the following ones may reuse the pages of the previous
+		int64_t loadPageFaults = -1;
+		int64_t openPageFaults = -1;
+
+		while (test.timings.NextIteration())
+		{
+			auto pageFaults = GetPageFaultCount();
+			auto loadedIndex = test.timings.Record(
+				"Bulk Load",
+				[&]
+				{
+					return wrapper.Load(*test.dataset);
+				});
+
+			test.timings.Record("Load First Query", [&] { return wrapper.QueryBox(loadedIndex, firstQuery); });
+			if (loadPageFaults < 0)
+			{
+				loadPageFaults = GetPageFaultCount() - pageFaults;
+			}
+
+			test.timings.Record("Destroy", [&loadedIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(loadedIndex);
+					return 0;
+				});
+
+			MappedFile::DropCachedPages(imagePath);
+
+			pageFaults = GetPageFaultCount();
+			auto spatialIndex = test.timings.Record(
+				"Open",
+				[&]
+				{
+					return wrapper.Open(imagePath, *test.dataset);
+				});
+
+			if (spatialIndex == nullptr)
+			{
+				cout << SetColorRed << "\t\t\tFAILED to open the saved index " << imagePath.generic_string() << " for spatial index " << wrapper.Name() << ResetColor << '\n';
+				filesystem::remove(imagePath);
+				return 1;
+			}
+
+			test.timings.Record("Open First Query", [&] { return wrapper.QueryBox(spatialIndex, firstQuery); });
+			if (openPageFaults < 0)
+			{
+				openPageFaults = GetPageFaultCount() - pageFaults;
+			}
+
+			ClearQueryStats();
+			test.timings.Record(
+				OpNameQueryBox,
+				[&]
+				{
+					queryResults.clear();
+					for (auto const& query : test.queries)
+					{
+						queryResults.push_back(wrapper.QueryBox(spatialIndex, query));
+					}
+
+					return 0;
+				},
+				&statsQuery);
+
+			statsQuery->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(int(test.queries.size())), int(test.queries.size()) });
+
+			test.timings.Record("Close", [&spatialIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					return 0;
+				});
+		}
+
+		filesystem::remove(imagePath);
+
+		test.indexStats = "Page faults: Load " + to_string(loadPageFaults) + " Open " + to_string(openPageFaults);
+
+		// The opened index must answer like the loaded one, and like the other indices
+		if (queryResults != expectedResults)
+		{
+			cout << SetColorRed << "\t\t\tFAILED the opened index of " << wrapper.Name() << " does not return the results of the loaded one" << ResetColor << '\n';
+			statsQuery->failed = true;
+			return 1;
+		}
+
+		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQuery) ? 0 : 1;
+	}
 };
 
-
+// Bulk-loads the dataset on each of the configured build thread counts and reports the speedup of each count against the single-threaded load.
+// The builds of all thread counts are checked to give the same query results. Only the indices that support SpatialIndexWrapper::LoadParallel() are run
 template <typename TSpatialKey>
-struct Test_Load_Query_Destroy : TestScenario<TSpatialKey>
+struct Test_ParallelLoad_Destroy final : TestScenario<TSpatialKey>
 {
 	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
 	using VectorType = typename SpatialKeyTraits<TSpatialKey>::VectorType;
 
-	[[nodiscard]] virtual char const* GetOpName() const = 0;
+	static constexpr auto OpNameBulkLoad = "Bulk Load";
+
+	[[nodiscard]] std::string_view Name() const override
+	{
+		return "ParallelLoad-Destroy";
+	}
+
+	[[nodiscard]] bool UsesQueries() const override
+	{
+		return false;
+	}
 
 	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
 	{
-		if (RunQuery(wrapper, wrapper.Load(Dataset<TSpatialKey>{}), BoxType{ VectorType{0} }) < 0)
+		if (!wrapper.SupportsParallelLoad())
 		{
 			if (PrintVerboseMessages())
 			{
-				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support " << GetOpName() << ")\n";
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support parallel load)\n";
 			}
 
 			return -1;
@@ -817,126 +2690,130 @@ struct Test_Load_Query_Destroy : TestScenario<TSpatialKey>
 			return -1;
 		}
 
-		Timings::ActionStats* statsQuery = nullptr;
-
-		auto statsStored = false;
+		auto const threadCounts = GetBuildThreadCounts();
+		auto const opNames = Transform(threadCounts, [](int threadCount) { return GetParallelOpName(OpNameBulkLoad, threadCount); });
 
-		vector<double> queryResults;
-		queryResults.reserve(test.queries.size());
+		// Without box queries the indices are only checked to build
+		auto const canQuery = wrapper.QueryBox(wrapper.Load(Dataset<TSpatialKey>{}), BoxType{ VectorType{0} }) >= 0;
+		auto verified = false;
 
 		while (test.timings.NextIteration())
 		{
-			auto spatialIndex = test.timings.Record(
-				"Bulk Load",
-				[&]
-				{
-					return wrapper.Load(*test.dataset);
-				});
-
-			if (spatialIndex == nullptr)
+			for (auto i = 0; i < Size(threadCounts); ++i)
 			{
-				return -1;
-			}
+				Timings::ActionStats* statsLoad = nullptr;
+				auto spatialIndex = test.timings.Record(
+					opNames[i],
+					[&]
+					{
+						return wrapper.LoadParallel(*test.dataset, threadCounts[i]);
+					},
+					&statsLoad);
 
-			TheQueryStats.Clear();
+				if (spatialIndex == nullptr)
+				{
+					cout << SetColorRed << "\t\t\tFAILED to load spatial index " << wrapper.Name() << " on " << threadCounts[i] << " threads" << ResetColor << '\n';
+					statsLoad->failed = true;
+					return 1;
+				}
 
-			test.timings.Record(
-				GetOpName(),
-				[&]
+				statsLoad->extra = make_shared<ActionExtraStats>(ActionExtraStats{ {}, 0, threadCounts[i] });
+
+				if (!verified && canQuery)
 				{
-					auto queryIndex = 0;
-					for (auto const& query : test.queries)
+					auto queryResults = Transform(test.queries, [&](BoxType const& query) { return double(wrapper.QueryBox(spatialIndex, query)); });
+					if (!test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsLoad))
 					{
-						auto const result = RunQuery(wrapper, spatialIndex, query);
-						if (queryIndex > Size(queryResults))
-						{
-							queryResults.push_back(result);
-						}
-
-						++queryIndex;
+						return 1;
 					}
-				},
-				&statsQuery);
+				}
 
-			if (!statsStored)
-			{
-				statsStored = true;
-				test.indexStats = wrapper.GetIndexStats(spatialIndex);
+				test.timings.Record("Destroy", [&spatialIndex]
+					{
+						[[maybe_unused]] auto toKill = std::move(spatialIndex);
+						return 0;
+					});
 			}
 
-			statsQuery->extra = make_shared<QueryStats>(TheQueryStats);
-			TheQueryStats.Clear();
+			verified = true;
+		}
 
-			test.timings.Record("Destroy", [&spatialIndex]
-				{
-					[[maybe_unused]] auto toKill = std::move(spatialIndex);
-					return 0;
-				});
+		ostringstream speedups;
+		speedups << "Speedup:" << std::setprecision(2) << std::fixed;
+		auto const& actions = test.timings.GetAllActions();
+		auto const baseline = actions.at(opNames.front()).bestTime;
+		for (auto i = 1; i < Size(threadCounts); ++i)
+		{
+			speedups << " x" << threadCounts[i] << ' ' << baseline / actions.at(opNames[i]).bestTime;
 		}
 
-		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQuery) ? 0 : 1;
+		test.indexStats = speedups.str();
+		return 0;
 	}
-
-	[[nodiscard]] virtual double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const = 0;
 };
 
+// Builds the index from a stream of the dataset read from its file, in the memory budget of the "ExternalMemory" configuration key, spilling the sorted runs to disk
+// when the dataset does not fit in it, and queries the built index file. The bytes read and written by the build are recorded with its time.
+// Only the indices that support SpatialIndexWrapper::LoadExternal() are run. The results are verified against the counts of the features of each query
+// in a pass over the stream, so this runs on the external datasets too ("ExternalDataset" configuration key), whose features are never all in memory
 template <typename TSpatialKey>
-struct Test_Load_QueryBox_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
+struct Test_ExternalLoad_QueryBox_Destroy final : TestScenario<TSpatialKey>
 {
 	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
 
-	[[nodiscard]] std::string_view Name() const override
-	{
-		return "Load-QueryRange-Destroy";
-	}
+	// The features read at once to count the query results, the queries are split between the threads for each chunk
+	static constexpr auto CountChunkSize = 64 * 1024;
 
-	[[nodiscard]] char const* GetOpName() const override
+	[[nodiscard]] std::string_view Name() const override
 	{
-		return OpNameQueryBox;
+		return "ExternalLoad-QueryBox-Destroy";
 	}
 
-	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
+	[[nodiscard]] bool SupportsExternalDataset() const override
 	{
-		return wrapper.QueryBox(spatialIndex, query);
+		return true;
 	}
-};
-
-template <typename TSpatialKey>
-struct Test_Load_QueryNearest_Destroy final : Test_Load_Query_Destroy<TSpatialKey>
-{
-	using BoxType = typename SpatialKeyTraits<TSpatialKey>::BoxType;
 
-	[[nodiscard]] std::string_view Name() const override
+	// The count of the features that overlap each query, as QueryBox() of any index returns it. Returns false if the stream cannot be read
+	[[nodiscard]] static bool CountQueryResults(DatasetStream<TSpatialKey>& stream, Span<BoxType const> queries, vector<double>& counts)
 	{
-		return "Load-QueryNearest-Destroy";
-	}
+		if (!stream.Rewind())
+		{
+			return false;
+		}
 
-	[[nodiscard]] char const* GetOpName() const override
-	{
-		return OpNameQueryNearest;
-	}
+		counts.assign(queries.size(), 0.0);
+		vector<Feature<TSpatialKey>> chunk(CountChunkSize);
+		ThreadPool pool;
+		for (;;)
+		{
+			auto const count = stream.Read(chunk);
+			if (count <= 0)
+			{
+				return count == 0;
+			}
 
-	[[nodiscard]] double RunQuery(SpatialIndexWrapper<TSpatialKey> const& wrapper, std::shared_ptr<void> const& spatialIndex, BoxType const& query) const override
-	{
-		return wrapper.QueryNearest(spatialIndex, query.Center(), QueryNearestCount);
-	}
-};
+			pool.ForEachIndex(Size(queries), 1, [&](int queryIndex, int)
+				{
+					auto const& query = queries[queryIndex];
+					auto found = 0;
+					for (auto i = 0; i < count; ++i)
+					{
+						found += Overlap(query, chunk[i].spatialKey) ? 1 : 0;
+					}
 
-template <typename TSpatialKey>
-struct Test_Insert_Erase_Query : TestScenario<TSpatialKey>
-{
-	[[nodiscard]] std::string_view Name() const override
-	{
-		return "Insert-Erase-Query";
+					counts[queryIndex] += found;
+				});
+		}
 	}
 
 	[[nodiscard]] int Run(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper) const override
 	{
-		if (!wrapper.IsDynamic())
+		if (!wrapper.SupportsExternalLoad())
 		{
 			if (PrintVerboseMessages())
 			{
-				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support removal)" << '\n';
+				cout << "\t\t" << "Skipped " << wrapper.Name() << " (does not support external load)\n";
 			}
 
 			return -1;
@@ -952,119 +2829,130 @@ struct Test_Insert_Erase_Query : TestScenario<TSpatialKey>
 			return -1;
 		}
 
-		if constexpr (SpatialKeyTraits<TSpatialKey>::Dimensions != 2)
+		auto const stream = MakeDatasetStream(*test.dataset);
+		if (stream == nullptr)
 		{
-			if (PrintVerboseMessages())
+			cout << SetColorRed << "\t\t\tFAILED to open the file " << test.dataset->GetFilePath().generic_string() << " of dataset " << test.dataset->GetName() << ResetColor << '\n';
+			return 1;
+		}
+
+		// The counts become the expected results of all the indices of the workload
+		if (test.queryResults.empty())
+		{
+			vector<double> counts;
+			if (!CountQueryResults(*stream, test.queries, counts))
 			{
-				cout << "\t\t" << "Skipped " << wrapper.Name() << " (too slow in 3 dimensions)" << '\n';
+				cout << SetColorRed << "\t\t\tFAILED to read the file " << test.dataset->GetFilePath().generic_string() << " of dataset " << test.dataset->GetName() << ResetColor << '\n';
+				return 1;
 			}
 
-			return -1;
-		}
-		else
-		{
-			return Run_(test, wrapper);
+			test.VerifyQueryResults(std::move(counts), "the streamed dataset");
 		}
-	}
 
-	static int Run_(TestContext<TSpatialKey>& test, SpatialIndexWrapper<TSpatialKey> const& wrapper)
-	{
-		Timings::ActionStats* statsQueryBox = nullptr;
-
-		auto const& dataset = *test.dataset;
+		auto const imagePath = GetOutputPath() / filesystem::path{ GetFilename<TSpatialKey>(*test.dataset) + ".external.index" };
+		auto const memoryBudget = std::size_t(std::max(GetConfig().Get<int>("ExternalMemory"), 1)) * Kilobyte * Kilobyte;
 
+		Timings::ActionStats* statsQuery = nullptr;
 		vector<double> queryResults;
 		queryResults.reserve(test.queries.size());
-
 		auto statsStored = false;
 
 		while (test.timings.NextIteration())
 		{
-			auto spatialIndex = wrapper.MakeEmptyIndex();
-
-			test.timings.Record(
-				"Insert",
+			Timings::ActionStats* statsLoad = nullptr;
+			auto const ioBefore = GetIoByteCounts();
+			auto spatialIndex = test.timings.Record(
+				"External Load",
 				[&]
 				{
-					for (auto const& feature : dataset.GetData())
-					{
-						wrapper.Insert(spatialIndex, &feature);
-					}
-				});
+					return wrapper.LoadExternal(*stream, imagePath, memoryBudget);
+				},
+				&statsLoad);
 
-			if (!wrapper.Erase(spatialIndex, &dataset.GetData()[0]))
+			auto const ioAfter = GetIoByteCounts();
+			if (spatialIndex == nullptr)
 			{
-				cout << "\t\t" << wrapper.Name() << '\t' << "skipped, removing failed\n";
-				return -1;
+				cout << SetColorRed << "\t\t\tFAILED to load spatial index " << wrapper.Name() << " externally" << ResetColor << '\n';
+				statsLoad->failed = true;
+				filesystem::remove(imagePath);
+				return 1;
 			}
 
-			// Remove some elements, both to measure erasing speed and disbalance the index
-			test.timings.Record(
-				"Erase",
-				[&]
-				{
-					auto const dataSetSize = dataset.GetSize();
-					for (auto i = 0; i < dataSetSize; i += 5)
-					{
-						wrapper.Erase(spatialIndex, &dataset.GetData()[i]);
-					}
-				});
-
-			// Return the erased elements back, both to make query results comparable to the other tests and to disbalance the index even more
-			test.timings.Record(
-				"Reinsert",
-				[&]
-				{
-					auto const dataSetSize = dataset.GetSize();
-					for (auto i = 0; i < dataSetSize; i += 5)
-					{
-						wrapper.Insert(spatialIndex, &dataset.GetData()[i]);
-					}
-				});
-
-			// Then give indices that need re-balancing a chance to do it
-			test.timings.Record(
-				"Rebalance",
-				[&]
-				{
-					wrapper.Rebalance(spatialIndex);
-				});
+			statsLoad->extra = make_shared<ActionExtraStats>(ActionExtraStats{ {}, 0, 0, {}, 0, ioAfter.read - ioBefore.read, ioAfter.written - ioBefore.written });
 
-			TheQueryStats.Clear();
+			ClearQueryStats();
 			test.timings.Record(
 				OpNameQueryBox,
 				[&]
 				{
-					auto queryIndex = 0;
+					queryResults.clear();
 					for (auto const& query : test.queries)
 					{
-						auto const result = wrapper.QueryBox(spatialIndex, query);
-						if (queryIndex > Size(queryResults))
-						{
-							queryResults.push_back(result);
-						}
-
-						++queryIndex;
+						queryResults.push_back(wrapper.QueryBox(spatialIndex, query));
 					}
-				}, &statsQueryBox);
-			statsQueryBox->extra = make_shared<QueryStats>(TheQueryStats);
-			TheQueryStats.Clear();
+
+					return 0;
+				},
+				&statsQuery);
+
+			statsQuery->extra = make_shared<ActionExtraStats>(ActionExtraStats{ CollectQueryStats(int(test.queries.size())), int(test.queries.size()) });
 
 			if (!statsStored)
 			{
 				statsStored = true;
 				test.indexStats = wrapper.GetIndexStats(spatialIndex);
 			}
+
+			test.timings.Record("Destroy", [&spatialIndex]
+				{
+					[[maybe_unused]] auto toKill = std::move(spatialIndex);
+					return 0;
+				});
 		}
 
-		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQueryBox) ? 0 : 1;
+		filesystem::remove(imagePath);
+
+		return test.VerifyQueryResults(std::move(queryResults), wrapper.Name(), statsQuery) ? 0 : 1;
 	}
 };
 
+// The node capacity of the results, 0 for the default capacity and for the fixed ones, as in the results of the versions before PerfRecord recorded it,
+// so that the runs of the default capacity are compared with them
+template <typename TSpatialKey>
+int GetRecordedNodeCapacity(SpatialIndexWrapper<TSpatialKey> const& wrapper)
+{
+	return wrapper.HasNodeCapacityArgument() && wrapper.GetNodeCapacity() != MaxElementsPerNode ? wrapper.GetNodeCapacity() : 0;
+}
+
+// The "NodeCapacity" configuration key lists exact values, where the substrings of IsSelected() would select 128 together with 8
+template <typename TSpatialKey>
+bool IsNodeCapacitySelected(SpatialIndexWrapper<TSpatialKey> const& wrapper)
+{
+	if (!wrapper.HasNodeCapacityArgument())
+	{
+		return true;
+	}
+
+	auto const selectedValueList = GetConfig().Get<string>("NodeCapacity");
+	auto const selectedValues = SplitIterator{ selectedValueList, ',' }.toArray(true);
+	auto const nodeCapacity = std::to_string(wrapper.GetNodeCapacity());
+	if (AnyOf(selectedValues, [&nodeCapacity](auto const& v) { return v == nodeCapacity; }))
+	{
+		return true;
+	}
+
+	if (PrintVerboseMessages())
+	{
+		cout << "\t\tSkipped " << wrapper.Name() << " [" << nodeCapacity << "] (NodeCapacity = " << selectedValueList << ")\n";
+	}
+
+	return false;
+}
+
 template <typename TSpatialKey>
 int RunSpatialIndex(TestContext<TSpatialKey>& testContext, TestScenario<TSpatialKey> const& scenario, SpatialIndexWrapper<TSpatialKey> const& wrapper)
 {
-	if (wrapper.Name().empty() || !IsSelected("Index", wrapper.Name(), 2))
+	if (wrapper.Name().empty() || !IsSelected("Index", wrapper.Name(), 2) || !IsNodeCapacitySelected(wrapper))
 	{
 		return 0;
 	}
@@ -1075,9 +2963,14 @@ int RunSpatialIndex(TestContext<TSpatialKey>& testContext, TestScenario<TSpatial
 	auto const failures = scenario.Run(testContext, wrapper);
 	if (failures >= 0)
 	{
-		auto const changeFactor = testContext.StoreResults(scenario.Name(), wrapper.Name());
+		string verdict;
+		auto const changeFactor = testContext.StoreResults(testContext.GetScenarioName(scenario.Name()), wrapper.Name(), GetRecordedNodeCapacity(wrapper), verdict);
 
 		cout << "\t\t" << wrapper.Name();
+		if (wrapper.HasNodeCapacityArgument())
+		{
+			cout << " [" << wrapper.GetNodeCapacity() << ']';
+		}
 		if (changeFactor > 0)
 		{
 			cout << '\t' << std::setprecision(1) << std::fixed;
@@ -1093,6 +2986,11 @@ int RunSpatialIndex(TestContext<TSpatialKey>& testContext, TestScenario<TSpatial
 			cout << '%';
 		}
 
+		if (!verdict.empty())
+		{
+			cout << '\t' << verdict;
+		}
+
 		if (!testContext.indexStats.empty())
 		{
 			cout << '\t' << testContext.indexStats;
@@ -1105,22 +3003,67 @@ int RunSpatialIndex(TestContext<TSpatialKey>& testContext, TestScenario<TSpatial
 	return failuresCount;
 }
 
+// Returns a copy of the dataset in the order selected with the "DatasetOrder" configuration key, or null to use the dataset in its own order.
+// The name of the copy gets the order as a suffix, so that the results of the orders are recorded separately
+template <typename TSpatialKey>
+unique_ptr<Dataset<TSpatialKey>> MakeOrderedDataset(Dataset<TSpatialKey> const& dataset)
+{
+	auto const orderName = GetConfig().Get<string>("DatasetOrder");
+	if (orderName.empty() || orderName == "as-is" || dataset.IsExternal())
+	{
+		return nullptr;
+	}
+
+	auto const data = dataset.GetData();
+	vector<int> order;
+	if (orderName == "random")
+	{
+		order.resize(data.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::shuffle(order.begin(), order.end(), mt19937{ DatasetMaker<TSpatialKey>::DefaultRandomSeed });
+	}
+	else if (orderName == "morton" || orderName == "hilbert")
+	{
+		order = GetSpatialKeysOrder<TSpatialKey>(data, orderName == "morton" ? SpaceFillingCurve::Morton : SpaceFillingCurve::Hilbert);
+	}
+	else
+	{
+		static auto warningPrinted = false;
+		if (!warningPrinted)
+		{
+			warningPrinted = true;
+			cout << SetColorRed << "WARNING! Unknown DatasetOrder: " << orderName << ", using the datasets as they are\n" << ResetColor;
+		}
+
+		return nullptr;
+	}
+
+	return make_unique<Dataset<TSpatialKey>>(dataset.GetName() + "-" + orderName, Transform(order, [&data](int index) { return data[index]; }));
+}
+
 template <typename TSpatialKey>
 int RunScenario(TestContext<TSpatialKey>& testContext, TestScenario<TSpatialKey> const& scenario)
 {
-	if (!IsSelected("Scenario", scenario.Name(), 1))
+	if (!IsSelected("Scenario", scenario.Name(), 1) || (testContext.dataset->IsExternal() && !scenario.SupportsExternalDataset()))
 	{
 		return 0;
 	}
 
-	cout << '\t' << scenario.Name() << '\n';
 	auto failuresCount = 0;
 
-	testContext.ResetQueryVerifier();
-
-	for (auto const& wrapper : IndicesToTest<TSpatialKey>)
+	// The scenarios without queries are run once. The other workloads are made from the features, so the external datasets have only the grid over their bounds
+	auto const workloads = scenario.UsesQueries() && !testContext.dataset->IsExternal() ? GetQueryWorkloads<TSpatialKey>() : vector<string>{ GridWorkload };
+	for (auto const& workload : workloads)
 	{
-		failuresCount += RunSpatialIndex(testContext, scenario, *wrapper);
+		testContext.SetWorkload(workload);
+		cout << '\t' << testContext.GetScenarioName(scenario.Name()) << '\n';
+
+		testContext.ResetQueryVerifier();
+
+		for (auto const& wrapper : IndicesToTest<TSpatialKey>)
+		{
+			failuresCount += RunSpatialIndex(testContext, scenario, *wrapper);
+		}
 	}
 
 	return failuresCount;
@@ -1169,15 +3112,42 @@ int RunSpatialKey(PerfRecord& perfRecord)
 			}
 
 			dataset.SetSize(size);
+			auto const orderedDataset = MakeOrderedDataset(dataset);
 
-			TestContext testContext{ dataset, perfRecord };
+			TestContext testContext{ orderedDataset != nullptr ? *orderedDataset : dataset, perfRecord };
 
 			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryBox_Destroy<SpatialKeyType>{});
 
 			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryNearest_Destroy<SpatialKeyType>{});
 
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryBoxIds_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryBoxLimit_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryNearestSegment_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryNearestGeodetic_Destroy<SpatialKeyType>{});
+
 			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Insert_Erase_Query<SpatialKeyType>{});
 
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryBoxBatch_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_QueryNearestBatch_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_ParallelQueryBox_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_ParallelQueryNearest_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_MixedReadWrite_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Load_Join_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_Open_QueryBox_Close<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_ParallelLoad_Destroy<SpatialKeyType>{});
+
+			totalFailures += RunScenario<SpatialKeyType>(testContext, Test_ExternalLoad_QueryBox_Destroy<SpatialKeyType>{});
+
 			if (GetConfig().Get<bool>("Record"))
 			{
 				testContext.perfRecord->Save();
@@ -1191,6 +3161,7 @@ int RunSpatialKey(PerfRecord& perfRecord)
 int CompareSpatialIndices(PerfRecord& perfRecord)
 {
 	WarnInDebugBuild();
+	SetUpBenchmarkEnvironment();
 
 	if (!GetConfig().Get<bool>("Record"))
 	{
@@ -7,8 +7,13 @@
 
 #include "TestTools.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 #include <memory>
+#include <numeric>
 #include <random>
+#include <vector>
 
 // This class defines the common interface for spatial index wrappers
 template <typename TSpatialKey>
@@ -18,8 +23,43 @@ struct SpatialIndexWrapper
 
 	using BoxType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::BoxType;
 
+	using ScalarType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::ScalarType;
+
 	using FeaturePtr = GeoToolbox::Feature<TSpatialKey> const*;
 
+	// Receives the results of QueryJoin()
+	struct JoinCallback
+	{
+		// matchCount more features of index B overlap the feature idA of index A. The matches of one feature may be reported in several calls
+		virtual void operator()(GeoToolbox::FeatureId idA, int matchCount) = 0;
+
+	protected:
+
+		~JoinCallback() = default;
+	};
+
+	// Receives the results of QueryBoxVisit()
+	struct QueryVisitor
+	{
+		// The feature id overlaps the query box. Return false to stop the query
+		virtual bool operator()(GeoToolbox::FeatureId id) = 0;
+
+	protected:
+
+		~QueryVisitor() = default;
+	};
+
+	// Gives the exact distances of QueryNearestRefined(), to the geometries that the keys of the features bound
+	struct ExactDistances
+	{
+		// Store the squared distances from the location to the geometries of the features ids, which must be no less than the distances to their keys
+		virtual void operator()(VectorType const& location, GeoToolbox::Span<GeoToolbox::FeatureId const> ids, GeoToolbox::Span<ScalarType> distancesSquared) = 0;
+
+	protected:
+
+		~ExactDistances() = default;
+	};
+
 
 	virtual ~SpatialIndexWrapper() = default;
 
@@ -35,6 +75,18 @@ struct SpatialIndexWrapper
 		return false;
 	}
 
+	// The maximum count of children of a node of a tree index, recorded with the results of the index, 0 if not applicable
+	[[nodiscard]] virtual int GetNodeCapacity() const
+	{
+		return 0;
+	}
+
+	// True if the node capacity is a template argument of the wrapper, instantiated for the capacities selectable with the "NodeCapacity" configuration key
+	[[nodiscard]] virtual bool HasNodeCapacityArgument() const
+	{
+		return false;
+	}
+
 	[[nodiscard]] virtual bool SupportsDatasetSize(int /*size*/) const
 	{
 		return true;
@@ -55,6 +107,18 @@ struct SpatialIndexWrapper
 		return {};
 	}
 
+	// Whether LoadParallel() builds the index on more than one thread
+	[[nodiscard]] virtual bool SupportsParallelLoad() const
+	{
+		return false;
+	}
+
+	// Load the index on threadCount threads, the index must give the same query results for any threadCount. Return null if not supported
+	[[nodiscard]] virtual std::shared_ptr<void> LoadParallel(Dataset<TSpatialKey> const& dataset, int threadCount) const
+	{
+		return threadCount == 1 ? Load(dataset) : nullptr;
+	}
+
 	virtual void Insert(std::shared_ptr<void> const& /*spatialIndex*/, FeaturePtr /*feature*/) const
 	{
 	}
@@ -69,18 +133,232 @@ struct SpatialIndexWrapper
 	{
 	}
 
+	// Return a copy of the index that can be modified independently of the original, for the copy-on-write concurrency adapter. Return null if not supported
+	[[nodiscard]] virtual std::shared_ptr<void> Clone(std::shared_ptr<void> const& /*spatialIndex*/) const
+	{
+		return {};
+	}
+
+	// Write the index to a file that Open() can use instead of Load(), to start without rebuilding the index. Return false if not supported
+	virtual bool Save(std::shared_ptr<void> const& /*spatialIndex*/, std::filesystem::path const& /*filePath*/) const
+	{
+		return false;
+	}
+
+	// Open an index written by Save(), ideally mapping the file and querying it in place. The dataset is the one the saved index was loaded from,
+	// for the indices that refer to its features instead of storing them. Return null if not supported or if the file cannot be used
+	[[nodiscard]] virtual std::shared_ptr<void> Open(std::filesystem::path const& /*filePath*/, Dataset<TSpatialKey> const& /*dataset*/) const
+	{
+		return {};
+	}
+
+	// Whether LoadExternal() can build the index from a stream of the features in a bounded memory
+	[[nodiscard]] virtual bool SupportsExternalLoad() const
+	{
+		return false;
+	}
+
+	// Build the index into a file from the features read from the stream, holding at most about memoryBudget bytes of them in memory, and open it like Open().
+	// Return null if not supported or if the build failed
+	[[nodiscard]] virtual std::shared_ptr<void> LoadExternal(DatasetStream<TSpatialKey>& /*stream*/, std::filesystem::path const& /*filePath*/, std::size_t /*memoryBudget*/) const
+	{
+		return {};
+	}
+
 	// Return the count of the features found to intersect the box. Return negative value if this query is not supported
 	[[nodiscard]] virtual int QueryBox(std::shared_ptr<void> const& /*spatialIndex*/, BoxType const& /*box*/) const
 	{
 		return -1;
 	}
 
+	// Append the features found to intersect the box to the results, for the adapters that keep the query results (QueryCache). Return false if not supported
+	virtual bool QueryBoxFeatures(std::shared_ptr<void> const& /*spatialIndex*/, BoxType const& /*box*/, std::vector<GeoToolbox::Feature<TSpatialKey>>& /*results*/) const
+	{
+		return false;
+	}
+
+	// Call the visitor with each feature found to intersect the box, in any order, until it returns false. Do not allocate memory per query.
+	// Return the count of the visited features, or negative value if this query is not supported
+	[[nodiscard]] virtual int QueryBoxVisit(std::shared_ptr<void> const& /*spatialIndex*/, BoxType const& /*box*/, QueryVisitor& /*visitor*/) const
+	{
+		return -1;
+	}
+
+	// Write the ids of the features found to intersect the box to the start of ids, and return their count. If it is greater than ids.size(), the ids did not fit
+	// and the rest of them are dropped. Return negative value if this query is not supported. The default collects the ids with QueryBoxVisit()
+	[[nodiscard]] virtual int QueryBoxIds(std::shared_ptr<void> const& spatialIndex, BoxType const& box, GeoToolbox::Span<GeoToolbox::FeatureId> ids) const
+	{
+		struct IdWriter : QueryVisitor
+		{
+			GeoToolbox::Span<GeoToolbox::FeatureId> ids;
+			int count = 0;
+
+			explicit IdWriter(GeoToolbox::Span<GeoToolbox::FeatureId> output)
+				: ids{ output }
+			{
+			}
+
+			bool operator()(GeoToolbox::FeatureId id) override
+			{
+				if (count < GeoToolbox::Size(ids))
+				{
+					ids[count] = id;
+				}
+
+				++count;
+				return true;
+			}
+		};
+
+		IdWriter writer{ ids };
+		return QueryBoxVisit(spatialIndex, box, writer) >= 0 ? writer.count : -1;
+	}
+
 	// Return the sum of the squared distances to the nearest found features. This is more reliable than the feature ids, as different features may be returned if they are at the same distance.
 	// Return negative value if this query is not supported
 	[[nodiscard]] virtual double QueryNearest(std::shared_ptr<void> const& /*spatialIndex*/, VectorType const& /*location*/, int /*nearestCount*/) const
 	{
 		return -1;
 	}
+
+	// Return the sum of the squared distances to the nearest features, like QueryNearest(), with the distances to the keys refined by exactDistances, e.g. to the segments
+	// the keys bound. The default takes the nearest keys from QueryNearest(): the square root of the sum of their distances is the half size of a box that holds at least
+	// nearestCount keys. The features found in it by QueryBoxVisit() are refined, then those in the box of the nearestCount-th exact distance, if it is larger.
+	// Override this if the index can refine the distances during its nearest search. Return negative value if this query is not supported
+	[[nodiscard]] virtual double QueryNearestRefined(std::shared_ptr<void> const& spatialIndex, VectorType const& location, int nearestCount, ExactDistances& exactDistances) const
+	{
+		auto const keyDistanceSum = QueryNearest(spatialIndex, location, nearestCount);
+		if (keyDistanceSum < 0)
+		{
+			return -1;
+		}
+
+		struct IdCollector : QueryVisitor
+		{
+			std::vector<GeoToolbox::FeatureId> ids;
+
+			bool operator()(GeoToolbox::FeatureId id) override
+			{
+				ids.push_back(id);
+				return true;
+			}
+		};
+
+		IdCollector collector;
+		std::vector<ScalarType> distancesSquared;
+		for (auto radius = ScalarType(std::sqrt(keyDistanceSum));;)
+		{
+			collector.ids.clear();
+			if (QueryBoxVisit(spatialIndex, BoxType::FromCenterAndSize(location, 2 * radius), collector) < 0)
+			{
+				return -1;
+			}
+
+			distancesSquared.resize(collector.ids.size());
+			exactDistances(location, collector.ids, distancesSquared);
+			auto const count = int(std::min(std::ptrdiff_t(nearestCount), GeoToolbox::Size(distancesSquared)));
+			std::partial_sort(distancesSquared.begin(), distancesSquared.begin() + count, distancesSquared.end());
+
+			// The features nearer than the nearestCount-th exact distance overlap its box, as their keys are nearer still
+			auto const nearestRadius = count > 0 ? ScalarType(std::sqrt(distancesSquared[count - 1])) : ScalarType(0);
+			if (nearestRadius <= radius)
+			{
+				return std::accumulate(distancesSquared.begin(), distancesSquared.begin() + count, 0.0, [](double sum, ScalarType distanceSquared) { return sum + double(distanceSquared); });
+			}
+
+			radius = nearestRadius;
+		}
+	}
+
+	// Return the sum of the squared great-circle distances in meters to the nearest features, for 2D keys in longitude and latitude degrees, see Geodetic.hpp.
+	// Return negative value if this query is not supported
+	[[nodiscard]] virtual double QueryNearestGeodetic(std::shared_ptr<void> const& /*spatialIndex*/, VectorType const& /*location*/, int /*nearestCount*/) const
+	{
+		return -1;
+	}
+
+	// Report to the callback the features of index B that overlap each feature of index A, and return the count of all overlapping pairs. Both indices are made by this wrapper,
+	// featuresA are the features index A was loaded with. The default probes index B with QueryBox() for each of featuresA, as the wrappers cannot enumerate their indices.
+	// Override this if the index can join two indices natively, e.g. by traversing both trees together. Return negative value if this query is not supported
+	[[nodiscard]] virtual std::int64_t QueryJoin(std::shared_ptr<void> const& /*spatialIndexA*/, GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> featuresA, std::shared_ptr<void> const& spatialIndexB, JoinCallback& callback) const
+	{
+		std::int64_t result = 0;
+		for (auto const& feature : featuresA)
+		{
+			auto const count = QueryBox(spatialIndexB, BoxType(feature.spatialKey));
+			if (count < 0)
+			{
+				return -1;
+			}
+
+			if (count > 0)
+			{
+				callback(feature.id, count);
+				result += count;
+			}
+		}
+
+		return result;
+	}
+
+	// Store in counts[i] the result of QueryBox() for boxes[i]. The default runs the queries one by one, in the given order.
+	// Override this if the index can do better, e.g. by reordering the batch along a space-filling curve or by sharing the traversal between neighbouring queries
+	virtual void QueryBoxBatch(std::shared_ptr<void> const& spatialIndex, GeoToolbox::Span<BoxType const> boxes, GeoToolbox::Span<int> counts) const
+	{
+		for (auto i = 0; i < int(boxes.size()); ++i)
+		{
+			counts[i] = QueryBox(spatialIndex, boxes[i]);
+		}
+	}
+
+	// Store in distanceSums[i] the result of QueryNearest() for locations[i], see QueryBoxBatch()
+	virtual void QueryNearestBatch(std::shared_ptr<void> const& spatialIndex, GeoToolbox::Span<VectorType const> locations, int nearestCount, GeoToolbox::Span<double> distanceSums) const
+	{
+		for (auto i = 0; i < int(locations.size()); ++i)
+		{
+			distanceSums[i] = QueryNearest(spatialIndex, locations[i], nearestCount);
+		}
+	}
+};
+
+
+// Holds an index together with the arena that all of its memory comes from, for the "ArenaAllocation" mode. The destructor of the index is not run,
+// it would only return the nodes to the arena one by one. Releasing the arena chunks frees everything at once instead
+template <class TIndex>
+class ArenaIndex
+{
+	GeoToolbox::ArenaResource arena_;
+
+	union
+	{
+		TIndex index_;
+	};
+
+public:
+
+	// makeIndex(memory_resource&) returns the index, constructed with an allocator using that resource
+	template <class TMakeIndex>
+	explicit ArenaIndex(TMakeIndex makeIndex)
+		: index_(makeIndex(arena_.GetResource()))
+	{
+	}
+
+	ArenaIndex(ArenaIndex const&) = delete;
+	ArenaIndex(ArenaIndex&&) = delete;
+	ArenaIndex& operator=(ArenaIndex const&) = delete;
+	ArenaIndex& operator=(ArenaIndex&&) = delete;
+
+	~ArenaIndex()
+	{
+	}
+
+	// The returned pointer is to the index, it owns the arena too
+	template <class TMakeIndex>
+	[[nodiscard]] static std::shared_ptr<void> Make(TMakeIndex makeIndex)
+	{
+		auto holder = std::make_shared<ArenaIndex>(std::move(makeIndex));
+		return std::shared_ptr<TIndex>(holder, &holder->index_);
+	}
 };
 
 
@@ -111,15 +389,78 @@ struct StdContainer : SpatialIndexWrapper<TSpatialKey>
 		return std::make_shared<IndexType>();
 	}
 
+	[[nodiscard]] std::shared_ptr<void> Clone(std::shared_ptr<void> const& indexPtr) const override
+	{
+		return std::make_shared<IndexType>(*static_cast<IndexType const*>(indexPtr.get()));
+	}
+
 	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& box) const override
 	{
+		using ScalarType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::ScalarType;
+		static constexpr auto Dimensions = int(GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions);
+		static constexpr auto BlockSize = GeoToolbox::OverlapMaskBits;
+
 		auto& index = *static_cast<IndexType const*>(indexPtr.get());
-		return GeoToolbox::/*Parallel*/CountIf(index, [&box](auto&& feature)
+
+		// Gather the keys in blocks, one array per axis, to test them with the batched overlap kernel
+		std::array<std::array<ScalarType, BlockSize>, Dimensions> mins;
+		std::array<std::array<ScalarType, BlockSize>, Dimensions> maxs;
+		std::array<ScalarType const*, Dimensions> minPointers{};
+		std::array<ScalarType const*, Dimensions> maxPointers{};
+		for (auto axis = 0; axis < Dimensions; ++axis)
+		{
+			minPointers[axis] = mins[axis].data();
+			maxPointers[axis] = GeoToolbox::SpatialKeyIsBox<TSpatialKey> ? maxs[axis].data() : mins[axis].data();
+		}
+
+		auto count = 0;
+		auto blockCount = 0;
+		auto const testBlock = [&]
 			{
-				GeoToolbox::AddQueryStats_ObjectTestsCount();
-				GeoToolbox::AddQueryStats_BoxOverlapsCount();
-				return Overlap(box, feature->spatialKey);
-			});
+				GeoToolbox::AddQueryStats_ObjectTestsCount(blockCount);
+				GeoToolbox::AddQueryStats_BoxOverlapsCount(blockCount);
+				count += GeoToolbox::PopCount(GetOverlapMask(box, minPointers, maxPointers, blockCount));
+				blockCount = 0;
+			};
+
+		for (auto const& feature : index)
+		{
+			for (auto axis = 0; axis < Dimensions; ++axis)
+			{
+				mins[axis][blockCount] = GeoToolbox::GetLowBound(feature->spatialKey, axis);
+				if constexpr (GeoToolbox::SpatialKeyIsBox<TSpatialKey>)
+				{
+					maxs[axis][blockCount] = GeoToolbox::GetHighBound(feature->spatialKey, axis);
+				}
+			}
+
+			if (++blockCount == BlockSize)
+			{
+				testBlock();
+			}
+		}
+
+		testBlock();
+		return count;
+	}
+
+	[[nodiscard]] int QueryBoxVisit(std::shared_ptr<void> const& indexPtr, BoxType const& box, typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor& visitor) const override
+	{
+		auto count = 0;
+		for (auto const& feature : *static_cast<IndexType const*>(indexPtr.get()))
+		{
+			GeoToolbox::AddQueryStats_ObjectTestsCount();
+			if (GeoToolbox::Overlap(box, feature->spatialKey))
+			{
+				++count;
+				if (!visitor(feature->id))
+				{
+					break;
+				}
+			}
+		}
+
+		return count;
 	}
 
 	[[nodiscard]] double QueryNearest(std::shared_ptr<void> const& indexPtr, VectorType const& location, int nearestCount) const override
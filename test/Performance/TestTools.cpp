@@ -6,11 +6,26 @@
 #include "TestTools.hpp"
 
 #include "GeoToolbox/Iterators.hpp"
+#include "GeoToolbox/ObjFile.hpp"
+#include "GeoToolbox/ShapeFile.hpp"
+#include "GeoToolbox/ThreadPool.hpp"
 
 #include "catch2/catch_session.hpp"
 #include "catch2/catch_template_test_macros.hpp"
 
+#if defined( _WIN32 )
+#	define NOMINMAX
+#	define WIN32_LEAN_AND_MEAN
+#	include <Windows.h>
+#elif defined( __linux__ )
+#	include <pthread.h>
+#	include <sched.h>
+#endif
+
 #include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -94,6 +109,165 @@ pair<int, int> GetDatasetSizeRange()
 	: pair{ GetConfig().Get<int>("MinDatasetSize"), GetConfig().Get<int>("MaxDatasetSize") + 1 };
 }
 
+namespace
+{
+	vector<int> GetThreadCountsOfKey(string const& key)
+	{
+		vector<int> result{ 1 };
+		auto const selectedValueList = GetConfig().Get<string>(key);
+		for (auto const& value : SplitIterator{ selectedValueList, ',' }.toArray(true))
+		{
+			auto threadCount = 0;
+			from_chars(value.data(), value.data() + value.size(), threadCount);
+			if (threadCount > 0)
+			{
+				result.push_back(threadCount);
+			}
+		}
+
+		if (result.size() == 1)
+		{
+			result.push_back(ThreadPool::GetHardwareThreadCount());
+		}
+
+		sort(result.begin(), result.end());
+		result.erase(unique(result.begin(), result.end()), result.end());
+		return result;
+	}
+}
+
+vector<int> GetThreadCounts()
+{
+	return GetThreadCountsOfKey("Threads");
+}
+
+vector<int> GetBuildThreadCounts()
+{
+	return GetThreadCountsOfKey("BuildThreads");
+}
+
+namespace
+{
+	bool PinCurrentThread(int cpu)
+	{
+#if defined( _WIN32 )
+		return cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined( __linux__ )
+		if (cpu >= CPU_SETSIZE)
+		{
+			return false;
+		}
+
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+		return false;
+#endif
+	}
+
+	// From the cpufreq files of Linux, there are none on the other systems
+	vector<string> GetFrequencyScalingWarnings()
+	{
+		vector<string> result;
+		filesystem::path const cpuPath{ "/sys/devices/system/cpu" };
+
+		auto scalingCpuCount = 0;
+		string scalingGovernor;
+		for (auto cpu = 0;; ++cpu)
+		{
+			ifstream file{ cpuPath / ("cpu" + to_string(cpu)) / "cpufreq" / "scaling_governor" };
+			string governor;
+			if (!(file >> governor))
+			{
+				break;
+			}
+
+			if (governor != "performance")
+			{
+				++scalingCpuCount;
+				scalingGovernor = governor;
+			}
+		}
+
+		if (scalingCpuCount > 0)
+		{
+			result.push_back(to_string(scalingCpuCount) + " CPUs use the '" + scalingGovernor + "' frequency governor instead of 'performance'");
+		}
+
+		// The boosted clock depends on the temperature and on the load of the other cores, so on what ran before
+		auto value = 0;
+		if (ifstream boost{ cpuPath / "cpufreq" / "boost" }; boost >> value && value != 0)
+		{
+			result.emplace_back("The CPU frequency boost is enabled (" + (cpuPath / "cpufreq" / "boost").generic_string() + ')');
+		}
+
+		if (ifstream noTurbo{ cpuPath / "intel_pstate" / "no_turbo" }; noTurbo >> value && value == 0)
+		{
+			result.emplace_back("Turbo Boost is enabled (" + (cpuPath / "intel_pstate" / "no_turbo").generic_string() + " is 0)");
+		}
+
+		return result;
+	}
+}
+
+bool IsBenchmarkMode()
+{
+	return GetConfig().Get<bool>("Benchmark");
+}
+
+void SetUpBenchmarkEnvironment()
+{
+	static auto done = false;
+	if (done)
+	{
+		return;
+	}
+
+	done = true;
+	if (auto const cpu = GetConfig().Get<int>("PinCpu"); cpu >= 0)
+	{
+		if (PinCurrentThread(cpu))
+		{
+			cout << "Pinned to CPU " << cpu << '\n';
+		}
+		else
+		{
+			cout << SetColorRed << "WARNING! Failed to pin the thread to CPU " << cpu << '\n' << ResetColor;
+		}
+	}
+
+	if (!IsBenchmarkMode())
+	{
+		return;
+	}
+
+	for (auto const& warning : GetFrequencyScalingWarnings())
+	{
+		cout << SetColorRed << "WARNING! " << warning << ", the times will vary more\n" << ResetColor;
+	}
+}
+
+void SetUpBenchmarkTimings(Timings& timings)
+{
+	if (IsBenchmarkMode())
+	{
+		timings.SetWarmupIterations(GetConfig().Get<int>("WarmupIterations"));
+		timings.SetMinimumIterationCount(GetConfig().Get<int>("MinIterations"));
+	}
+}
+
+shared_ptr<LatencyHistogram> MakeLatencyHistogram()
+{
+	return allocate_shared<LatencyHistogram>(MallocAllocator<LatencyHistogram>{});
+}
+
+bool UseArenaAllocation()
+{
+	return GetConfig().Get<bool>("ArenaAllocation");
+}
+
 bool IsSelected(char const* configKey, string_view testValue, int printMessageWithIndent, bool selectedByDefault)
 {
 	auto const selectedValueList = GetConfig().Get<string>(configKey);
@@ -157,29 +331,16 @@ void PerfRecord::Save() const
 		outfile << '\n';
 	}
 
-	for (auto const& line : otherIdLines_)
+	for (auto const& [runId, entry, stats] : otherRunEntries_)
 	{
-		outfile << line << '\n';
+		outfile << runId << Separator;
+		WriteStruct(outfile, entry);
+		outfile << Separator;
+		WriteStruct(outfile, stats);
+		outfile << '\n';
 	}
 }
 
-struct TabDelimiterCtype final : ctype<char>
-{
-	static mask const* make_table()
-	{
-		// make a copy of the "C" locale table
-		static vector<mask> v{ classic_table(), classic_table() + table_size };
-		v['\t'] = space;
-		v[' '] = alnum;
-		return v.data();
-	}
-
-	explicit TabDelimiterCtype(size_t refs = 0)
-		: ctype(make_table(), false, refs)
-	{
-	}
-};
-
 void PerfRecord::Load()
 {
 	ifstream infile{ filepath_.string() };
@@ -207,6 +368,9 @@ void PerfRecord::Load()
 		return;
 	}
 
+	// The columns are read by the names in the header, as the versions differ in the fields of Entry and Stats and in their order.
+	// The first column is the run id, its header is PerfRecordId and the version
+	auto const columnNames = SplitIterator{ line, Separator }.toArray();
 	{
 		line.erase(0, PerfRecordId.size());
 		istringstream ins(line);
@@ -215,29 +379,74 @@ void PerfRecord::Load()
 
 	while (getline(infile, line))
 	{
-		istringstream ins(line);
-		ins.imbue(locale(ins.getloc(), new TabDelimiterCtype));
-		if (version > 0)
+		auto columns = SplitIterator{ line, Separator }.toArray();
+		if (columns.empty())
 		{
-			string runId;
-			ins >> runId;
-			if (runId != runId_)
-			{
-				otherIdLines_.emplace_back(std::move(line));
-				continue;
-			}
+			continue;
+		}
+
+		// The lines of version 0 have no run id
+		if (version == 0)
+		{
+			columns.insert(columns.begin(), runId_);
 		}
 
 		Entry entry;
-		ReadStruct(ins, entry, stringStorage_);
+		ReadStructColumns(columnNames, columns, entry, stringStorage_);
 
 		Stats stats;
-		ReadStruct(ins, stats);
+		ReadStructColumns(columnNames, columns, stats, stringStorage_);
+
+		// The other runs are written back with the columns of this version
+		if (columns[0] != runId_)
+		{
+			otherRunEntries_.emplace_back(std::move(columns[0]), entry, std::move(stats));
+			continue;
+		}
 
 		entries_[entry] = stats;
 	}
 }
 
+PerfRecord::Stats const* PerfRecord::FindEntry(Entry const& entry) const
+{
+	auto const found = entries_.find(entry);
+	return found != entries_.end() ? &found->second : nullptr;
+}
+
+PerfRecord::Verdict PerfRecord::Compare(Stats const& before, Stats const& after)
+{
+	if (before.sampleCount < MinVerdictSampleCount || after.sampleCount < MinVerdictSampleCount || before.medianTime <= 0 || after.medianTime <= 0)
+	{
+		return Verdict::Unknown;
+	}
+
+	// For normally distributed times, the standard deviation is 1.4826 MADs and the standard error of the median is sqrt(pi / 2) times that of the mean
+	auto const standardError = [](Stats const& stats)
+		{
+			return 1.2533 * 1.4826 * stats.medianAbsoluteDeviation / std::sqrt(double(stats.sampleCount));
+		};
+
+	auto const difference = after.medianTime - before.medianTime;
+
+	// The times are measured in whole microseconds, smaller differences are not resolved
+	if (std::abs(difference) < 1
+		|| std::abs(difference) <= MinSignificantChange * before.medianTime
+		|| std::abs(difference) <= SignificanceThreshold * std::hypot(standardError(before), standardError(after)))
+	{
+		return Verdict::NotSignificant;
+	}
+
+	return difference > 0 ? Verdict::Slower : Verdict::Faster;
+}
+
+void PerfRecord::SetSampleStats(Stats& stats, Timings::ActionStats const& action)
+{
+	stats.medianTime = action.GetMedianTime();
+	stats.medianAbsoluteDeviation = action.GetMedianAbsoluteDeviation();
+	stats.sampleCount = int(action.samples.size());
+}
+
 void PerfRecord::MergeEntry(Entry const& entry, Stats const& newStats, std::pair<int64_t, int64_t>* accumulatedOldAndNewBestTimes)
 {
 	auto const previousExisted = entries_.count(entry) > 0;
@@ -289,11 +498,187 @@ Dataset<TSpatialKey>::Dataset(string name, vector<TSpatialKey> const& keys)
 	}
 }
 
+namespace
+{
+	// The header of the binary dataset files, the feature records start at dataOffset.
+	// Increment Version when the layout of the header or of the records changes
+	struct BinaryDatasetHeader
+	{
+		static constexpr std::array<char, 4> Signature{ 'G', 'T', 'D', 'S' };
+		static constexpr std::uint32_t Version = 1;
+		static constexpr auto MaxDimensions = 4;
+
+		std::array<char, 4> signature{};
+		std::uint32_t version = 0;
+		std::uint8_t keyKind = 0;
+		std::uint8_t scalarSize = 0;
+		std::uint8_t dimensions = 0;
+		std::uint8_t idSize = 0;
+		std::uint32_t recordSize = 0;
+		std::int64_t recordCount = 0;
+		std::int64_t sourceCount = 0;
+		std::uint64_t dataOffset = 0;
+		std::array<double, MaxDimensions> boundsMin{};
+		std::array<double, MaxDimensions> boundsMax{};
+
+		template <typename TSpatialKey>
+		[[nodiscard]] static BinaryDatasetHeader Make()
+		{
+			using KeyTraits = SpatialKeyTraits<TSpatialKey>;
+			static_assert(KeyTraits::Dimensions <= MaxDimensions);
+
+			BinaryDatasetHeader header;
+			header.signature = Signature;
+			header.version = Version;
+			header.keyKind = std::uint8_t(KeyTraits::Kind);
+			header.scalarSize = std::uint8_t(sizeof(typename KeyTraits::ScalarType));
+			header.dimensions = std::uint8_t(KeyTraits::Dimensions);
+			header.idSize = std::uint8_t(sizeof(FeatureId));
+			header.recordSize = std::uint32_t(sizeof(Feature<TSpatialKey>));
+			// Page-size multiple keeps the records aligned in the mapping
+			header.dataOffset = 4 * Kilobyte;
+			return header;
+		}
+
+		template <typename TSpatialKey>
+		[[nodiscard]] bool Matches() const
+		{
+			auto const expected = Make<TSpatialKey>();
+			return signature == expected.signature && version == expected.version && keyKind == expected.keyKind && scalarSize == expected.scalarSize
+				&& dimensions == expected.dimensions && idSize == expected.idSize && recordSize == expected.recordSize;
+		}
+
+		template <typename TSpatialKey>
+		[[nodiscard]] typename SpatialKeyTraits<TSpatialKey>::BoxType GetBounds() const
+		{
+			using KeyTraits = SpatialKeyTraits<TSpatialKey>;
+			using ScalarType = typename KeyTraits::ScalarType;
+
+			typename KeyTraits::VectorType low{};
+			typename KeyTraits::VectorType high{};
+			for (auto i = 0; i < int(KeyTraits::Dimensions); ++i)
+			{
+				low[i] = ScalarType(boundsMin[i]);
+				high[i] = ScalarType(boundsMax[i]);
+			}
+
+			return { low, high };
+		}
+	};
+}
+
+template <typename TSpatialKey>
+shared_ptr<Dataset<TSpatialKey>> Dataset<TSpatialKey>::LoadBinary(filesystem::path const& filePath, string name, int& sourceSize)
+{
+	auto mappedFile = make_shared<MappedFile const>(filePath);
+	auto const headers = mappedFile->GetArray<BinaryDatasetHeader>(0, 1);
+	if (headers.empty() || !headers[0].Matches<TSpatialKey>() || headers[0].recordCount > numeric_limits<int>::max())
+	{
+		return {};
+	}
+
+	auto const& header = headers[0];
+	auto const features = mappedFile->GetArray<Feature<TSpatialKey>>(header.dataOffset, header.recordCount);
+	if (Size(features) != header.recordCount)
+	{
+		return {};
+	}
+
+	auto dataset = make_shared<Dataset>();
+	dataset->name_ = std::move(name);
+	dataset->filePath_ = filePath;
+	dataset->mappedFile_ = std::move(mappedFile);
+	dataset->mappedData_ = features;
+	dataset->size_ = int(features.size());
+	if (!features.empty())
+	{
+		dataset->boundingBox_ = header.GetBounds<TSpatialKey>();
+	}
+
+	sourceSize = int(header.sourceCount);
+	return dataset;
+}
+
+template <typename TSpatialKey>
+shared_ptr<Dataset<TSpatialKey>> Dataset<TSpatialKey>::MakeExternal(string name, filesystem::path filePath, int size, BoxType const& bounds)
+{
+	if (size <= 0)
+	{
+		return {};
+	}
+
+	auto dataset = make_shared<Dataset>();
+	dataset->name_ = std::move(name);
+	dataset->filePath_ = std::move(filePath);
+	dataset->externalSize_ = size;
+	dataset->size_ = size;
+	dataset->boundingBox_ = bounds;
+	return dataset;
+}
+
+template <typename TSpatialKey>
+shared_ptr<Dataset<TSpatialKey>> Dataset<TSpatialKey>::OpenBinary(filesystem::path const& filePath, string name, int& sourceSize)
+{
+	BinaryDatasetHeader header;
+	ifstream file{ filePath, ios::binary };
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !header.Matches<TSpatialKey>() || header.recordCount > numeric_limits<int>::max())
+	{
+		return {};
+	}
+
+	sourceSize = int(header.sourceCount);
+	return MakeExternal(std::move(name), filePath, int(header.recordCount), header.GetBounds<TSpatialKey>());
+}
+
+template <typename TSpatialKey>
+bool Dataset<TSpatialKey>::SaveBinary(filesystem::path const& filePath, int sourceSize) const
+{
+	auto const features = GetAllData();
+
+	auto header = BinaryDatasetHeader::Make<TSpatialKey>();
+	header.recordCount = Size(features);
+	header.sourceCount = sourceSize;
+	if (!features.empty())
+	{
+		auto const bounds = Bound(features, GetFeatureBox);
+		for (auto i = 0; i < int(SpatialKeyTraits<TSpatialKey>::Dimensions); ++i)
+		{
+			header.boundsMin[i] = double(bounds.Min()[i]);
+			header.boundsMax[i] = double(bounds.Max()[i]);
+		}
+	}
+
+	// Write to a temporary file and rename it at the end, so that an interrupted write does not leave a truncated file behind
+	auto temporaryPath = filePath;
+	temporaryPath += ".tmp";
+	{
+		ofstream file{ temporaryPath, ios::binary | ios::trunc };
+		vector<char> headerBlock(header.dataOffset);
+		memcpy(headerBlock.data(), &header, sizeof(header));
+		file.write(headerBlock.data(), std::streamsize(headerBlock.size()));
+		file.write(reinterpret_cast<char const*>(features.data()), std::streamsize(features.size() * sizeof(Feature<TSpatialKey>)));
+		if (!file)
+		{
+			file.close();
+			error_code error;
+			filesystem::remove(temporaryPath, error);
+			return false;
+		}
+	}
+
+	error_code error;
+	filesystem::rename(temporaryPath, filePath, error);
+	return !error;
+}
+
 template <typename TSpatialKey>
 void Dataset<TSpatialKey>::SetSize_(int newSize)
 {
 	ASSERT(newSize <= GetAvailableSize());
-	if (!boundingBox_.IsEmpty())
+	columns_.Clear();
+
+	// The bounds of an external dataset are of all features in its file
+	if (!boundingBox_.IsEmpty() && !IsExternal())
 	{
 		if (newSize < size_)
 		{
@@ -301,7 +686,8 @@ void Dataset<TSpatialKey>::SetSize_(int newSize)
 		}
 		else
 		{
-			boundingBox_.Add(Bound(Iterable{ data_.begin() + size_, data_.begin() + newSize }, GetFeatureBox));
+			auto const data = GetAllData();
+			boundingBox_.Add(Bound(Iterable{ data.begin() + size_, data.begin() + newSize }, GetFeatureBox));
 		}
 	}
 
@@ -313,7 +699,7 @@ auto Dataset<TSpatialKey>::GetBoundingBox() const -> BoxType
 {
 	if (boundingBox_.IsEmpty())
 	{
-		boundingBox_ = Bound(MakeIterable(data_.begin(), size_), GetFeatureBox);
+		boundingBox_ = Bound(MakeIterable(GetAllData().begin(), size_), GetFeatureBox);
 	}
 
 	return boundingBox_;
@@ -323,16 +709,225 @@ template <typename TSpatialKey>
 void Dataset<TSpatialKey>::Clear()
 {
 	name_.clear();
+	filePath_.clear();
 	data_.clear();
+	mappedFile_.reset();
+	mappedData_ = {};
+	externalSize_ = 0;
+	size_ = 0;
+	columns_.Clear();
+}
+
+
+namespace
+{
+	// The features stay in memory, for the datasets made in memory or reordered
+	template <typename TSpatialKey>
+	class MemoryDatasetStream final : public DatasetStream<TSpatialKey>
+	{
+		Span<Feature<TSpatialKey> const> features_;
+		std::ptrdiff_t next_ = 0;
+
+	public:
+
+		explicit MemoryDatasetStream(Span<Feature<TSpatialKey> const> features)
+			: DatasetStream<TSpatialKey>{ int(features.size()) }
+			, features_{ features }
+		{
+		}
+
+	protected:
+
+		bool Rewind_() override
+		{
+			next_ = 0;
+			return true;
+		}
+
+		int Read_(Span<Feature<TSpatialKey>> chunk) override
+		{
+			auto const count = std::min(chunk.size(), features_.size() - next_);
+			std::copy_n(features_.begin() + next_, count, chunk.begin());
+			next_ += count;
+			return int(count);
+		}
+	};
+
+	// Reads the records of a file written by Dataset::SaveBinary(), without mapping it
+	template <typename TSpatialKey>
+	class BinaryDatasetStream final : public DatasetStream<TSpatialKey>
+	{
+		ifstream file_;
+		BinaryDatasetHeader header_;
+
+	public:
+
+		BinaryDatasetStream(filesystem::path const& filePath, int size)
+			: DatasetStream<TSpatialKey>{ size }
+			, file_{ filePath, ios::binary }
+		{
+			file_.read(reinterpret_cast<char*>(&header_), sizeof(header_));
+		}
+
+		[[nodiscard]] bool IsOpen() const
+		{
+			return file_.is_open() && header_.Matches<TSpatialKey>();
+		}
+
+	protected:
+
+		bool Rewind_() override
+		{
+			file_.clear();
+			file_.seekg(streamoff(header_.dataOffset));
+			return IsOpen() && bool(file_);
+		}
+
+		int Read_(Span<Feature<TSpatialKey>> chunk) override
+		{
+			file_.read(reinterpret_cast<char*>(chunk.data()), std::streamsize(chunk.size_bytes()));
+			if (file_.bad())
+			{
+				return -1;
+			}
+
+			return int(file_.gcount() / std::streamsize(sizeof(Feature<TSpatialKey>)));
+		}
+	};
+
+	// Reads the records one by one, the ids are their indices without the skipped records, as in the datasets loaded with ShapeFile::GetKeys()
+	template <typename TSpatialKey>
+	class ShapeFileDatasetStream final : public DatasetStream<TSpatialKey>
+	{
+		ShapeFile shapeFile_;
+		vector<TSpatialKey> keys_;
+		int nextRecord_ = 0;
+		FeatureId nextId_ = 0;
+
+	public:
+
+		ShapeFileDatasetStream(filesystem::path const& filePath, int size)
+			: DatasetStream<TSpatialKey>{ size }
+			, shapeFile_{ filePath }
+		{
+		}
+
+		[[nodiscard]] bool IsOpen() const
+		{
+			return shapeFile_.Supports<TSpatialKey>();
+		}
+
+	protected:
+
+		bool Rewind_() override
+		{
+			nextRecord_ = 0;
+			nextId_ = 0;
+			return IsOpen();
+		}
+
+		int Read_(Span<Feature<TSpatialKey>> chunk) override
+		{
+			keys_.resize(chunk.size());
+			auto const count = shapeFile_.ReadKeys<TSpatialKey>(nextRecord_, keys_);
+			for (auto i = 0; i < count; ++i)
+			{
+				chunk[i] = { nextId_++, keys_[i] };
+			}
+
+			return count;
+		}
+	};
+
+	template <typename TSpatialKey>
+	class ObjFileDatasetStream final : public DatasetStream<TSpatialKey>
+	{
+		ObjFile::VertexStream<TSpatialKey> vertices_;
+
+	public:
+
+		ObjFileDatasetStream(filesystem::path const& filePath, int size)
+			: DatasetStream<TSpatialKey>{ size }
+			, vertices_{ filePath }
+		{
+		}
+
+		[[nodiscard]] bool IsOpen() const
+		{
+			return vertices_.IsOpen();
+		}
+
+	protected:
+
+		bool Rewind_() override
+		{
+			return vertices_.Rewind();
+		}
+
+		int Read_(Span<Feature<TSpatialKey>> chunk) override
+		{
+			return vertices_.Read(chunk);
+		}
+	};
+
+	template <class TStream>
+	unique_ptr<TStream> OpenDatasetStream(filesystem::path const& filePath, int size)
+	{
+		auto result = make_unique<TStream>(filePath, size);
+		return result->IsOpen() ? std::move(result) : nullptr;
+	}
+}
+
+template <typename TSpatialKey>
+unique_ptr<DatasetStream<TSpatialKey>> MakeDatasetStream(Dataset<TSpatialKey> const& dataset)
+{
+	auto const& filePath = dataset.GetFilePath();
+	auto const extension = filePath.extension().string();
+	if (extension == Dataset<TSpatialKey>::BinaryFileExtension)
+	{
+		return OpenDatasetStream<BinaryDatasetStream<TSpatialKey>>(filePath, dataset.GetSize());
+	}
+
+	if (extension == ".shp")
+	{
+		return OpenDatasetStream<ShapeFileDatasetStream<TSpatialKey>>(filePath, dataset.GetSize());
+	}
+
+	if constexpr (SpatialKeyIsPoint<TSpatialKey> && SpatialKeyTraits<TSpatialKey>::Dimensions == 3)
+	{
+		if (extension == ".obj")
+		{
+			return OpenDatasetStream<ObjFileDatasetStream<TSpatialKey>>(filePath, dataset.GetSize());
+		}
+	}
+
+	return make_unique<MemoryDatasetStream<TSpatialKey>>(dataset.GetData());
 }
 
 template class Dataset<Vector2>;
 template class Dataset<Vector3f>;
 template class Dataset<Box2>;
 template class Dataset<Box3f>;
+template unique_ptr<DatasetStream<Vector2>> MakeDatasetStream(Dataset<Vector2> const&);
+template unique_ptr<DatasetStream<Vector3f>> MakeDatasetStream(Dataset<Vector3f> const&);
+template unique_ptr<DatasetStream<Box2>> MakeDatasetStream(Dataset<Box2> const&);
+template unique_ptr<DatasetStream<Box3f>> MakeDatasetStream(Dataset<Box3f> const&);
+template class Dataset<PaddedVector3f>;
+template class Dataset<Box<PaddedVector3f>>;
+template unique_ptr<DatasetStream<PaddedVector3f>> MakeDatasetStream(Dataset<PaddedVector3f> const&);
+template unique_ptr<DatasetStream<Box<PaddedVector3f>>> MakeDatasetStream(Dataset<Box<PaddedVector3f>> const&);
+// The geocentric keys of Geodetic.hpp
+template class Dataset<Vector3>;
 #if defined( ENABLE_EIGEN )
 template class Dataset<EVector2>;
 template class Dataset<Box<EVector2>>;
+template unique_ptr<DatasetStream<EVector2>> MakeDatasetStream(Dataset<EVector2> const&);
+template unique_ptr<DatasetStream<Box<EVector2>>> MakeDatasetStream(Dataset<Box<EVector2>> const&);
+// The 3D Eigen keys of MicroBenchmarks.cpp
+template class Dataset<EVector3>;
+template class Dataset<Box<EVector3>>;
+template unique_ptr<DatasetStream<EVector3>> MakeDatasetStream(Dataset<EVector3> const&);
+template unique_ptr<DatasetStream<Box<EVector3>>> MakeDatasetStream(Dataset<Box<EVector3>> const&);
 #endif
 
 
@@ -351,10 +946,32 @@ int main(int argc, char* argv[])
 				{ "DatasetSize", -1, "Fixes the order of the dataset size to use (i.e. 1 means 10 element, 6 means 1 million elements). If not set, all orders from MinDatasetSize to MaxDatasetSize will be used" },
 				{ "MinDatasetSize", 2, "Minimum order of the size of the dataset, tests are executed for all orders from MinDatasetSize to MaxDatasetSize. Default: {def}" },
 				{ "MaxDatasetSize", 6, "Maximum order of the size of the dataset, tests are executed for all orders from MinDatasetSize to MaxDatasetSize. Default: {def}" },
-				{ "Scenario", "", "Comma-separated list of scenarios to run (partial case-insensitive match), one of: Load-QueryBox-Destroy, Load-QueryNearest-Destroy, Insert-Erase-Query" },
+				{ "Scenario", "", "Comma-separated list of scenarios to run (partial case-insensitive match), one of: Load-QueryBox-Destroy, Load-QueryNearest-Destroy, Load-QueryBoxIds-Destroy, Load-QueryBoxLimit-Destroy, Load-QueryNearestSegment-Destroy, Load-QueryNearestGeodetic-Destroy, Insert-Erase-Query, Load-QueryBoxBatch-Destroy, Load-QueryNearestBatch-Destroy, Load-ParallelQueryBox-Destroy, Load-ParallelQueryNearest-Destroy, Load-MixedReadWrite-Destroy, Load-Join-Destroy, Open-QueryBox-Close, ParallelLoad-Destroy, ExternalLoad-QueryBox-Destroy" },
+				{ "Threads", "", "Comma-separated list of thread counts to run the parallel query scenarios with, 1 is always added as the baseline for the scaling efficiency. Default is the count of hardware threads" },
+				{ "BuildThreads", "", "Comma-separated list of thread counts to load the indices with in the ParallelLoad-Destroy scenario, 1 is always added as the baseline for the build speedup. Default is the count of hardware threads" },
 				{ "SpatialKey", "", "Comma-separated list of spatial keys to run the tests for, possible ones are 'point' and 'box'" },
-				{ "Vector", "", "Comma-separated list of vector types to run the tests for (if compiled), like 'array2d' or 'array3f'" },
+				{ "Vector", "", "Comma-separated list of vector types to run the tests for (if compiled), like 'array2d', 'array3f' or 'padded3f'" },
 				{ "Dimensions", "", "Comma-separated list of dimensions to run the tests for" },
+				{ "ArenaAllocation", false, "Indices that accept an allocator (Boost and Tidwall R-trees) take their memory from a monotonic arena, released at once when the index is destroyed. Their names get an '(arena)' suffix, the Boost R-tree is tested with the default allocator too. Default: {def}" },
+				{ "HardwareCounters", false, "Record the hardware counters (cycles, instructions, cache, branch and TLB misses) of each action, with perf_event_open() on Linux (may need a lower /proc/sys/kernel/perf_event_paranoid) or just the cycles on Windows. Default: {def}" },
+				{ "QueryLatency", false, "Time each query of the Load-Query-Destroy scenarios separately and record the p50/p90/p99/p999/max latencies. Adds two clock reads per query to the query time. Default: {def}" },
+				{ "ReadWriteRatio", 10, "Count of queries per index update in the Load-MixedReadWrite-Destroy scenario. Default: {def}" },
+				{ "WriterThreads", 1, "Count of threads updating the index in the Load-MixedReadWrite-Destroy scenario, next to the reader threads given by Threads. Default: {def}" },
+				{ "Concurrency", "", "Comma-separated list of the concurrency adapters to run the Load-MixedReadWrite-Destroy scenario with (partial case-insensitive match), one of: SharedMutex, CopyOnWrite" },
+				{ "DatasetOrder", "as-is", "Order of the features given to the indices, one of: as-is (as generated or as stored in the file), random, morton, hilbert (along the curve over the dataset bounds). Default: {def}" },
+				{ "DatasetCache", true, "Cache the datasets loaded from SHP and OBJ files in a binary file next to each of them, memory-mapped on the following runs. Default: {def}" },
+				{ "Benchmark", false, "Benchmark mode: run WarmupIterations unrecorded iterations and at least MinIterations recorded ones, record the median time and its median absolute deviation of each action, and print whether the medians changed significantly from the stored results. Warns about CPU frequency scaling on Linux. Default: {def}" },
+				{ "WarmupIterations", 2, "Count of the iterations to run before recording the times in benchmark mode. Default: {def}" },
+				{ "MinIterations", 15, "Minimum count of the recorded iterations in benchmark mode. Default: {def}" },
+				{ "PinCpu", -1, "Pin the main thread to this CPU, -1 to leave it to the OS. On Linux the worker threads of the parallel scenarios inherit the pinning, so use it with Threads=1. Default: {def}" },
+				{ "ImageMode", "outline", "How the PNG images of the datasets (StoreDatasetFormat=png) are drawn, one of: outline (the outline of each box), density (the log-scaled count of the keys over each pixel). Default: {def}" },
+				{ "Workload", "grid", "Comma-separated list of the query workloads to run the scenarios with, each one stored as a suffix of the scenario names, of: grid (a regular grid of boxes over the dataset bounds), zipf (Zipf-skewed around hot spots), walk (random-walk trajectories), panzoom (map pan/zoom sessions), data (centered on random features). Default: {def}" },
+				{ "QueryLimit", 1, "Count of the features after which the queries of the Load-QueryBoxLimit-Destroy scenario stop, 1 to stop at the first hit. Default: {def}" },
+				{ "NodeCapacity", std::to_string(GeoToolbox::MaxElementsPerNode), "Comma-separated list of the node capacities to run the Boost, GEOS and native R-trees with (exact match). Besides the default, 8, 16, 64 and 128 (the native R-tree up to 64) are compiled with the GeoToolbox_NODE_CAPACITY_SWEEP CMake option. The Tidwall R-tree has a fixed capacity of 64 and always runs. Default: {def}" },
+				{ "QueryCacheEntries", 1024, "Count of the query boxes whose results are kept by the \"Cached\" indices, the least recently used are dropped. Default: {def}" },
+				{ "ExternalMemory", 256, "Memory budget in megabytes of the external bulk load in the ExternalLoad-QueryBox-Destroy scenario, a smaller budget than the dataset makes it sort in several runs on disk. Default: {def}" },
+				{ "JoinDataset", "", "Comma-separated list of the dataset files to join each dataset file with in the Load-Join-Destroy scenario (partial case-insensitive match), the first one whose bounds overlap the dataset is used. The synthetic datasets and the files without an overlapping one are joined with random boxes. Default: any other file" },
+				{ "ExternalDataset", false, "Open the SHP and binary dataset files without loading their features, reading just the counts and the bounds in their headers, for the datasets larger than the memory. Only the ExternalLoad-QueryBox-Destroy scenario runs on them, with the grid workload over the bounds, verified by counting the features of each query in a pass over the file. Default: {def}" },
 				{ "StoreDatasetFormat", "", "Comma-separated list of formats to store the dataset used for each test, either PNG, SHP or OBJ" },
 			}
 			);
@@ -362,7 +979,7 @@ int main(int argc, char* argv[])
 		if (argc == 1)
 		{
 			std::cout
-				<< "No tests are configured to run by default, please specify the name of a perf.test you'd like to run, like CompareSpatialIndices\n\n"
+				<< "No tests are configured to run by default, please specify the name of a perf.test you'd like to run, like CompareSpatialIndices or MicroBenchmarks\n\n"
 				<< "Configuration keys for CompareSpatialIndices:\n"
 				<< "(either save these to " << (GetOutputPath() / "CompareSpatialIndices.cfg").generic_string() << " or pass them as -key=value on the command line after the Catch arguments and --)\n"
 				<< GetConfig().GenerateDefaultConfigFile();
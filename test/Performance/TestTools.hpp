@@ -7,15 +7,21 @@
 
 #include "GeoToolbox/Config.hpp"
 #include "GeoToolbox/DescribeStruct.hpp"
+#include "GeoToolbox/MappedFile.hpp"
 #include "GeoToolbox/Profiling.hpp"
 #include "GeoToolbox/Span.hpp"
 #include "GeoToolbox/SpatialTools.hpp"
 #include "GeoToolbox/TestTools.hpp"
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 namespace GeoToolbox
 {
@@ -63,9 +69,27 @@ inline void WarnInDebugBuild()
 #endif // !NDEBUG
 }
 
+// The "Benchmark" configuration key: warm up and repeat the actions enough for the medians and their spreads, and give a verdict on the changes from the stored results
+bool IsBenchmarkMode();
+
+// Pins the calling thread to the CPU of the "PinCpu" configuration key and in benchmark mode, warns about the CPU frequency scaling that adds noise to the times. Only on the first call
+void SetUpBenchmarkEnvironment();
+
+// Applies the "WarmupIterations" and "MinIterations" configuration keys in benchmark mode
+void SetUpBenchmarkTimings(GeoToolbox::Timings& timings);
+
 
 std::pair<int, int> GetDatasetSizeRange();
 
+// The sorted thread counts to run the parallel scenarios with, from the "Threads" configuration key. Always starts with 1, the single-threaded baseline
+std::vector<int> GetThreadCounts();
+
+// The sorted thread counts to run the ParallelLoad-Destroy scenario with, from the "BuildThreads" configuration key. Always starts with 1, the baseline of the build speedups
+std::vector<int> GetBuildThreadCounts();
+
+// The "ArenaAllocation" configuration key: the wrappers of indices that accept an allocator take all the index memory from an arena, see ArenaIndex
+bool UseArenaAllocation();
+
 inline int GetDatasetSizeFromOrder(int order)
 {
 	return static_cast<int>(pow(10, order));
@@ -79,6 +103,8 @@ public:
 	using ScalarType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::ScalarType;
 	using BoxType = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::BoxType;
 
+	static constexpr auto BinaryFileExtension = ".gtds";
+
 	Dataset() = default;
 	//~Dataset() = default;
 	//Dataset(Dataset const&) = delete;
@@ -95,14 +121,46 @@ public:
 
 	Dataset(std::string name, std::vector<TSpatialKey> const& keys);
 
+	// Maps a file written by SaveBinary(), the features are used in place, without copying.
+	// Returns null if the file cannot be mapped or was written by another version or for another spatial key type. sourceSize receives the value passed to SaveBinary()
+	[[nodiscard]] static std::shared_ptr<Dataset> LoadBinary(std::filesystem::path const& filePath, std::string name, int& sourceSize);
+
+	// Writes all available features to a binary file: a header with the key kind, scalar type, dimensions and bounds, followed by the packed feature records
+	// in the in-memory layout. sourceSize is the feature count of the source this dataset was loaded from, which may be larger if only part of it was loaded
+	bool SaveBinary(std::filesystem::path const& filePath, int sourceSize) const;
+
+	// A dataset of the first size features of a file, which are not loaded: only the bounds of all features in the file are known. The features are read with
+	// MakeDatasetStream(), for the datasets larger than the memory, and GetData() is empty
+	[[nodiscard]] static std::shared_ptr<Dataset> MakeExternal(std::string name, std::filesystem::path filePath, int size, BoxType const& bounds);
+
+	// Opens a file written by SaveBinary() as an external dataset, reading just its header. Returns null like LoadBinary()
+	[[nodiscard]] static std::shared_ptr<Dataset> OpenBinary(std::filesystem::path const& filePath, std::string name, int& sourceSize);
+
 	[[nodiscard]] std::string const& GetName() const noexcept
 	{
 		return name_;
 	}
 
+	// The file the features were loaded from, in the same order: the binary file they are mapped from or the source file. Empty for the datasets made in memory
+	[[nodiscard]] std::filesystem::path const& GetFilePath() const noexcept
+	{
+		return filePath_;
+	}
+
+	void SetFilePath(std::filesystem::path filePath)
+	{
+		filePath_ = std::move(filePath);
+	}
+
 	[[nodiscard]] bool IsEmpty() const noexcept
 	{
-		return data_.empty();
+		return GetAvailableSize() == 0;
+	}
+
+	// Whether the features stay in the file, see MakeExternal()
+	[[nodiscard]] bool IsExternal() const noexcept
+	{
+		return externalSize_ > 0;
 	}
 
 	[[nodiscard]] int GetSize() const noexcept
@@ -112,7 +170,7 @@ public:
 
 	[[nodiscard]] int GetAvailableSize() const noexcept
 	{
-		return int(data_.size());
+		return IsExternal() ? externalSize_ : int(GetAllData().size());
 	}
 
 	void SetSize(int newSize)
@@ -129,17 +187,37 @@ public:
 
 	[[nodiscard]] GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> GetData() const
 	{
-		return { data_.data(), size_ };
+		return GetAllData().first(size_);
 	}
 
-	[[nodiscard]] std::vector<GeoToolbox::FeatureId> GetIds() const
+	// The same features in columnar form: an id column and per-axis coordinate columns. It is built on first use and kept until the size changes.
+	// Not thread-safe on first use, call it before starting threads that read it.
+	[[nodiscard]] GeoToolbox::Features<TSpatialKey> const& GetColumns() const
 	{
-		return GeoToolbox::Transform(GetData(), [](auto const& feature)
-			{
-				return feature.id;
-			});
+		if (columns_.GetSize() != size_)
+		{
+			columns_.Assign(GetData());
+		}
+
+		return columns_;
 	}
 
+	[[nodiscard]] GeoToolbox::Span<GeoToolbox::FeatureId const> GetIds() const
+	{
+		return GetColumns().GetIds();
+	}
+
+	[[nodiscard]] GeoToolbox::Span<ScalarType const> GetMins(int axis) const
+	{
+		return GetColumns().GetMins(axis);
+	}
+
+	[[nodiscard]] GeoToolbox::Span<ScalarType const> GetMaxs(int axis) const
+	{
+		return GetColumns().GetMaxs(axis);
+	}
+
+	// Interleaved copy of the keys, for consumers that need an array of coordinate tuples
 	[[nodiscard]] std::vector<typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::SpatialKeyArrayType> GetKeys() const
 	{
 		using VectorTraits = typename GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorTraitsType;
@@ -189,38 +267,145 @@ protected:
 
 	void SetSize_(int newSize);
 
+	[[nodiscard]] GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> GetAllData() const noexcept
+	{
+		return mappedFile_ != nullptr ? mappedData_ : GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const>{ data_ };
+	}
+
 
 	std::string name_;
 
+	std::filesystem::path filePath_;
+
 	std::vector<GeoToolbox::Feature<TSpatialKey>> data_{};
 
+	// The features of a dataset loaded with LoadBinary(), data_ is empty then
+	std::shared_ptr<GeoToolbox::MappedFile const> mappedFile_;
+	GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> mappedData_;
+
+	// The count of the features in the file of an external dataset, see MakeExternal(), 0 for the others
+	int externalSize_ = 0;
+
 	int size_ = 0;
 
 	mutable BoxType boundingBox_;
 
+	mutable GeoToolbox::Features<TSpatialKey> columns_;
+
 	void (*onSizeChange_)(Dataset&, int newSize) = nullptr;
 };
 
+// Reads the first features of a dataset in chunks, for the loads that do not need all of them in memory, see GeoToolbox::PackedRtree::BuildFile()
 template <typename TSpatialKey>
-void Draw([[maybe_unused]] GeoToolbox::Image& image, [[maybe_unused]] Dataset<TSpatialKey> const& set)
+class DatasetStream
+{
+	int size_;
+	int position_ = 0;
+
+public:
+
+	explicit DatasetStream(int size)
+		: size_{ size }
+	{
+	}
+
+	DatasetStream(DatasetStream const&) = delete;
+	DatasetStream& operator=(DatasetStream const&) = delete;
+
+	virtual ~DatasetStream() = default;
+
+	// Starts over from the first feature, returns false if the source cannot be read
+	bool Rewind()
+	{
+		position_ = 0;
+		return Rewind_();
+	}
+
+	// Fills the chunk with the next features and returns their count, 0 at the end and negative on error
+	int Read(GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey>> chunk)
+	{
+		auto const count = Read_(chunk.first(std::min(chunk.size(), std::ptrdiff_t(size_ - position_))));
+		position_ += std::max(count, 0);
+		return count;
+	}
+
+protected:
+
+	virtual bool Rewind_() = 0;
+
+	virtual int Read_(GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey>> chunk) = 0;
+};
+
+// Streams the first GetSize() features of the dataset from its file (see Dataset::GetFilePath()) with file reads, or from memory if it has no file.
+// Returns null if the file cannot be opened
+template <typename TSpatialKey>
+std::unique_ptr<DatasetStream<TSpatialKey>> MakeDatasetStream(Dataset<TSpatialKey> const& dataset);
+
+template <typename TSpatialKey>
+void Draw([[maybe_unused]] GeoToolbox::Image& image, [[maybe_unused]] Dataset<TSpatialKey> const& set, [[maybe_unused]] GeoToolbox::DrawMode mode = GeoToolbox::DrawMode::Outline)
 {
 	if constexpr (GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions == 2)
 	{
 		auto const toArray = GeoToolbox::SpatialKeyTraits<TSpatialKey>::VectorTraitsType::ToArray;
 
-		auto keys = set.GetKeys();
 		auto const& origBox = set.GetBoundingBox();
 		auto const box = GeoToolbox::Box2{ toArray(origBox.Min()), toArray(origBox.Max()) };
-		DrawSpatialKeys(image, keys, box);
+		GeoToolbox::ParallelDrawSpatialKeys<TSpatialKey>(image, set.GetData(), box, mode);
 	}
 }
 
 
+// Extra results of a Timings action, stored in Timings::ActionStats::extra
+struct ActionExtraStats
+{
+	GeoToolbox::QueryStats queryStats{};
+
+	// The count of queries run by a query action, used to calculate the throughput
+	int queryCount = 0;
+
+	// The count of threads that ran the queries or the bulk load in parallel, 0 for the single-threaded scenarios
+	int threadCount = 0;
+
+	// The durations of the single queries in nanoseconds, over all iterations, if the "QueryLatency" configuration key is set
+	std::shared_ptr<GeoToolbox::LatencyHistogram const> queryLatencies{};
+
+	// The count of index updates made by the writers of the mixed read/write scenario, used to calculate their throughput
+	int updateCount = 0;
+
+	// The bytes read and written through files by the action, see GeoToolbox::GetIoByteCounts()
+	std::int64_t ioBytesRead = 0;
+	std::int64_t ioBytesWritten = 0;
+};
+
+// The histogram is allocated with MallocAllocator, so that it is not counted as memory used by the index
+std::shared_ptr<GeoToolbox::LatencyHistogram> MakeLatencyHistogram();
+
+
 class PerfRecord
 {
 public:
 
-	static constexpr auto Version = 1;
+	// Version 2 added "Queries/s" and "Scaling", version 3 the hardware counters, version 4 the query latency percentiles, version 5 "Updates/s",
+	// version 6 the median time, its absolute deviation and the count of samples, version 7 "Mem Peak" and "Allocations", version 8 "Read Bytes" and "Written Bytes",
+	// version 9 "Node Capacity" as the last field of Entry, version 10 moved "Read Bytes" and "Written Bytes" after the latencies.
+	// The columns are read by their names, so the files of all versions are read into the current fields
+	static constexpr auto Version = 10;
+
+	// A change is significant if the medians differ by more than this many of their standard errors, estimated from the MADs, and by more than MinSignificantChange
+	static constexpr auto SignificanceThreshold = 3.0;
+
+	static constexpr auto MinSignificantChange = 0.01;
+
+	// Fewer samples give no verdict
+	static constexpr auto MinVerdictSampleCount = 5;
+
+	enum class Verdict
+	{
+		Unknown,
+		NotSignificant,
+		Faster,
+		Slower
+	};
 
 	struct Entry
 	{
@@ -233,6 +418,9 @@ public:
 		std::string_view datasetName;
 		int64_t datasetSize = 0;
 
+		// See SpatialIndexWrapper::GetNodeCapacity(), 0 if the index has no nodes, a fixed count of children or the default MaxElementsPerNode
+		int nodeCapacity = 0;
+
 
 		static constexpr auto DescribeStruct()
 		{
@@ -246,7 +434,8 @@ public:
 				Field{ &Entry::vectorTraits, "Vector Impl" },
 				Field{ &Entry::datasetName, "Dataset Name" },
 				Field{ &Entry::datasetSize, "Dataset Size" },
-				Field{ &Entry::spatialIndexName, "Spatial Index" });
+				Field{ &Entry::spatialIndexName, "Spatial Index" },
+				Field{ &Entry::nodeCapacity, "Node Capacity" });
 		}
 
 		friend bool operator<(Entry const& left, Entry const& right) noexcept
@@ -261,11 +450,47 @@ public:
 		int64_t memoryDelta = 0;// std::numeric_limits<int64_t>::max();
 		bool failed = false;
 
+		// See Timings::ActionStats::peakMemory, the memory to provision for the action is its peak, not the delta that remains after it
+		int64_t peakMemory = 0;
+		int64_t allocationCount = 0;
+
+		// Of the samples of the last run, see Timings::ActionStats::samples. The best time is kept from all runs, the median is the one to compare runs by
+		double medianTime = 0;
+		double medianAbsoluteDeviation = 0;
+		int sampleCount = 0;
+
 		int queryVisitedNodes = 0;
+
+		// Per action, from GeoToolbox::HardwareCounters ("HardwareCounters" configuration key), 0 if not enabled or available
+		int64_t cycles = 0;
+		int64_t instructions = 0;
+		int64_t l1DataMisses = 0;
+		int64_t lastLevelCacheMisses = 0;
+		int64_t branchMisses = 0;
+		int64_t dataTlbMisses = 0;
+
 		GeoToolbox::QueryStats::CounterType queryScalarComparisons = 0;
 		GeoToolbox::QueryStats::CounterType queryBoxOverlaps = 0;
 		GeoToolbox::QueryStats::CounterType queryObjectTests = 0;
 
+		double queriesPerSecond = 0;
+
+		double updatesPerSecond = 0;
+
+		// For the parallel scenarios, the throughput relative to the single-threaded one, divided by the count of threads. 1 means perfect scaling
+		double scalingEfficiency = 0;
+
+		// Percentiles of the single query durations in nanoseconds, see ActionExtraStats::queryLatencies
+		int64_t latencyP50 = 0;
+		int64_t latencyP90 = 0;
+		int64_t latencyP99 = 0;
+		int64_t latencyP999 = 0;
+		int64_t latencyMax = 0;
+
+		// See ActionExtraStats::ioBytesRead, for the actions that stream through files
+		int64_t bytesRead = 0;
+		int64_t bytesWritten = 0;
+
 		std::string info{};  // NOLINT(readability-redundant-member-init)
 
 
@@ -275,12 +500,33 @@ public:
 
 			return std::make_tuple(
 				Field{ &Stats::bestTime, "Time" },
+				Field{ &Stats::medianTime, "Median" },
+				Field{ &Stats::medianAbsoluteDeviation, "MAD" },
+				Field{ &Stats::sampleCount, "Samples" },
 				Field{ &Stats::queryVisitedNodes, "NodeVisits" },
+				Field{ &Stats::cycles, "Cycles" },
+				Field{ &Stats::instructions, "Instructions" },
+				Field{ &Stats::l1DataMisses, "L1D Misses" },
+				Field{ &Stats::lastLevelCacheMisses, "LLC Misses" },
+				Field{ &Stats::branchMisses, "Branch Misses" },
+				Field{ &Stats::dataTlbMisses, "DTLB Misses" },
 				Field{ &Stats::queryObjectTests, "ObjTests" },
 				Field{ &Stats::queryScalarComparisons, "Scalar <>" },
 				Field{ &Stats::queryBoxOverlaps, "Box <>" },
 				Field{ &Stats::memoryDelta, "Mem Delta" },
+				Field{ &Stats::peakMemory, "Mem Peak" },
+				Field{ &Stats::allocationCount, "Allocations" },
 				Field{ &Stats::failed, "Failed" },
+				Field{ &Stats::queriesPerSecond, "Queries/s" },
+				Field{ &Stats::updatesPerSecond, "Updates/s" },
+				Field{ &Stats::scalingEfficiency, "Scaling" },
+				Field{ &Stats::latencyP50, "p50 ns" },
+				Field{ &Stats::latencyP90, "p90 ns" },
+				Field{ &Stats::latencyP99, "p99 ns" },
+				Field{ &Stats::latencyP999, "p999 ns" },
+				Field{ &Stats::latencyMax, "Max ns" },
+				Field{ &Stats::bytesRead, "Read Bytes" },
+				Field{ &Stats::bytesWritten, "Written Bytes" },
 				Field{ &Stats::info, "Info" });
 		}
 
@@ -302,7 +548,9 @@ private:
 	std::string runId_;
 	std::filesystem::path filepath_;
 	std::vector<std::string> prefixLines_;
-	std::vector<std::string> otherIdLines_;
+
+	// The entries of the other run ids in the file, kept to write them back
+	std::vector<std::tuple<std::string, Entry, Stats>> otherRunEntries_;
 
 	std::map<Entry, Stats> entries_;
 
@@ -324,7 +572,7 @@ public:
 	void Load();
 
 	template <typename TSpatialKey>
-	Entry MakeEntry(Dataset<TSpatialKey> const& dataset, std::string_view spatialIndexName, std::string_view scenario, std::string_view operation)
+	Entry MakeEntry(Dataset<TSpatialKey> const& dataset, std::string_view spatialIndexName, std::string_view scenario, std::string_view operation, int nodeCapacity = 0)
 	{
 		return Entry{
 			stringStorage_.GetOrAddString(spatialIndexName),
@@ -334,11 +582,21 @@ public:
 			stringStorage_.GetOrAddString(scenario),
 			stringStorage_.GetOrAddString(operation),
 			stringStorage_.GetOrAddString(dataset.GetName()),
-			dataset.GetSize()
+			dataset.GetSize(),
+			nodeCapacity
 		};
 	}
 
+	// The stored stats of the entry, null if there are none
+	[[nodiscard]] Stats const* FindEntry(Entry const& entry) const;
+
 	void MergeEntry(Entry const& entry, Stats const&, std::pair<int64_t, int64_t>* accumulatedOldAndNewBestTimes = nullptr);
 
 	void SetEntry(Entry const& entry, Stats const&);
+
+	// Compares the median times of two runs of an action, Unknown if either has too few samples
+	[[nodiscard]] static Verdict Compare(Stats const& before, Stats const& after);
+
+	// Sets the median, its deviation and the count of samples from the samples of the action
+	static void SetSampleStats(Stats& stats, GeoToolbox::Timings::ActionStats const& action);
 };
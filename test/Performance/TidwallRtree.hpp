@@ -30,7 +30,7 @@ namespace Tidwall
 
 	using DATATYPE = void*;
 	using NUMTYPE = double;
-	typedef int rc_t;
+	typedef int rc_t;	// atomic_int, of the same layout
 	constexpr auto MAXITEMS = 64;
 	enum kind {
 		LEAF = 1,
@@ -69,6 +69,116 @@ namespace Tidwall
 		bool (*item_clone)(const DATATYPE item, DATATYPE* into, void* udata);
 		void (*item_free)(const DATATYPE item, void* udata);
 	};
+
+	inline bool Intersects(rect const& a, rect const& b) noexcept
+	{
+		for (auto i = 0; i < ENABLE_TIDWALL_RTREE; ++i)
+		{
+			if (a.min[i] > b.max[i] || a.max[i] < b.min[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Traverses two trees together, descending into the pairs of overlapping nodes only, and calls function(dataA, matchCount) for each item of tree A with
+	// matchCount > 0 overlapping items in a leaf of tree B
+	template <class TFunction>
+	void JoinNodes(node const& a, rect const& rectA, node const& b, rect const& rectB, TFunction& function)
+	{
+		GeoToolbox::AddQueryStats_VisitedNodesCount();
+		if (a.kind == BRANCH && (b.kind == LEAF || a.count >= b.count))
+		{
+			GeoToolbox::AddQueryStats_BoxOverlapsCount(a.count);
+			for (auto i = 0; i < a.count; ++i)
+			{
+				if (Intersects(a.rects[i], rectB))
+				{
+					JoinNodes(*a.nodes[i], a.rects[i], b, rectB, function);
+				}
+			}
+
+			return;
+		}
+
+		if (b.kind == BRANCH)
+		{
+			GeoToolbox::AddQueryStats_BoxOverlapsCount(b.count);
+			for (auto j = 0; j < b.count; ++j)
+			{
+				if (Intersects(b.rects[j], rectA))
+				{
+					JoinNodes(a, rectA, *b.nodes[j], b.rects[j], function);
+				}
+			}
+
+			return;
+		}
+
+		GeoToolbox::AddQueryStats_BoxOverlapsCount(a.count);
+		for (auto i = 0; i < a.count; ++i)
+		{
+			if (!Intersects(a.rects[i], rectB))
+			{
+				continue;
+			}
+
+			GeoToolbox::AddQueryStats_ObjectTestsCount(b.count);
+			GeoToolbox::AddQueryStats_BoxOverlapsCount(b.count);
+			auto matchCount = 0;
+			for (auto j = 0; j < b.count; ++j)
+			{
+				matchCount += Intersects(a.rects[i], b.rects[j]) ? 1 : 0;
+			}
+
+			if (matchCount > 0)
+			{
+				function(a.datas[i].data, matchCount);
+			}
+		}
+	}
+
+	// The allocation hooks of the tree have no context parameter, so in the "ArenaAllocation" mode the arena of the tree that is being modified is set for the
+	// current thread by ArenaScope. The arena pointer is kept in the udata field of the tree, which is otherwise only used by the item callbacks (not set here)
+	inline thread_local GeoToolbox::ArenaResource* ActiveArena = nullptr;
+
+	inline void* ArenaMalloc(size_t size)
+	{
+		DEBUG_ASSERT(ActiveArena != nullptr);
+		return ActiveArena->GetResource().allocate(size, alignof(std::max_align_t));
+	}
+
+	// The memory is returned when the whole arena is released
+	inline void ArenaFree(void* /*block*/)
+	{
+	}
+
+	class ArenaScope
+	{
+		GeoToolbox::ArenaResource* previous_ = ActiveArena;
+
+	public:
+
+		explicit ArenaScope(GeoToolbox::ArenaResource* arena) noexcept
+		{
+			ActiveArena = arena;
+		}
+
+		explicit ArenaScope(::rtree* tree) noexcept
+			: ArenaScope{ static_cast<GeoToolbox::ArenaResource*>(reinterpret_cast<rtree*>(tree)->udata) }
+		{
+		}
+
+		ArenaScope(ArenaScope const&) = delete;
+		ArenaScope& operator=(ArenaScope const&) = delete;
+
+		~ArenaScope()
+		{
+			ActiveArena = previous_;
+		}
+	};
 }
 
 struct RtreeDeleter
@@ -79,6 +189,16 @@ struct RtreeDeleter
 	}
 };
 
+// In the arena mode the nodes are not visited on destroy, the deleter owns the arena and releases it with the last tree using it, see ArenaIndex
+struct ArenaRtreeDeleter
+{
+	std::shared_ptr<GeoToolbox::ArenaResource> arena;
+
+	void operator()(rtree* /*tree*/) const
+	{
+	}
+};
+
 template <typename TSpatialKey, bool DimensionsMatch = GeoToolbox::SpatialKeyTraits<TSpatialKey>::Dimensions == ENABLE_TIDWALL_RTREE>
 struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 {
@@ -97,7 +217,13 @@ struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 
 	[[nodiscard]] std::string_view Name() const override
 	{
-		return "Tidwall R-tree";
+		return UseArenaAllocation() ? "Tidwall R-tree (arena)" : "Tidwall R-tree";
+	}
+
+	// Fixed when rtree.c is compiled, so the tree is not instantiated per "NodeCapacity" like the others
+	[[nodiscard]] int GetNodeCapacity() const override
+	{
+		return Tidwall::MAXITEMS;
 	}
 
 	[[nodiscard]] bool IsDynamic() const override
@@ -107,11 +233,37 @@ struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 
 	[[nodiscard]] std::shared_ptr<void> MakeEmptyIndex() const override
 	{
+		if (UseArenaAllocation())
+		{
+			auto arena = std::make_shared<GeoToolbox::ArenaResource>();
+			Tidwall::ArenaScope const scope{ arena.get() };
+			auto const tree = rtree_new_with_allocator(Tidwall::ArenaMalloc, Tidwall::ArenaFree);
+			reinterpret_cast<Tidwall::rtree*>(tree)->udata = arena.get();
+			rtree_opt_relaxed_atomics(tree);
+			return std::shared_ptr<rtree>(tree, ArenaRtreeDeleter{ std::move(arena) });
+		}
+
 		auto result = std::shared_ptr<rtree>(rtree_new_with_allocator(TrackedMalloc, TrackedFree), RtreeDeleter{});
 		rtree_opt_relaxed_atomics(result.get());
 		return result;
 	}
 
+	// rtree_clone() shares the nodes and copies them on write. The shared nodes may be copied and released by different threads, so the tree and its copy
+	// count their references with full atomics.
+	// Not supported in the arena mode, which leaves the tree out of the CopyOnWrite adapter: the copy shares the nodes of the arena of the original,
+	// and the nodes replaced by each update would never be given back while the snapshots keep the arena alive, inflating the peak memory
+	[[nodiscard]] std::shared_ptr<void> Clone(std::shared_ptr<void> const& indexPtr) const override
+	{
+		if (std::get_deleter<ArenaRtreeDeleter>(indexPtr) != nullptr)
+		{
+			return nullptr;
+		}
+
+		auto const index = static_cast<rtree*>(indexPtr.get());
+		reinterpret_cast<Tidwall::rtree*>(index)->relaxed = false;
+		return std::shared_ptr<rtree>(rtree_clone(index), RtreeDeleter{});
+	}
+
 	[[nodiscard]] std::string GetIndexStats(std::shared_ptr<void> const& indexPtr) const override
 	{
 		GeoToolbox::AggregateStats<int> elementsPerNode;
@@ -155,9 +307,29 @@ struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 		return index;
 	}
 
+	// The insertions are sequential, what runs in parallel is their presort along the Hilbert curve, see GeoToolbox::ParallelGetSpatialKeysOrder().
+	// The single-threaded load presorts too, so the speedup is that of the presort only and the better locality of the presorted insertions is common to all thread counts
+	[[nodiscard]] bool SupportsParallelLoad() const override
+	{
+		return true;
+	}
+
+	[[nodiscard]] std::shared_ptr<void> LoadParallel(Dataset<TSpatialKey> const& dataset, int threadCount) const override
+	{
+		auto const& features = dataset.GetData();
+		auto index = MakeEmptyIndex();
+		for (auto const i : GeoToolbox::ParallelGetSpatialKeysOrder<TSpatialKey>(features, GeoToolbox::SpaceFillingCurve::Hilbert, threadCount))
+		{
+			Insert(index, &features[i]);
+		}
+
+		return index;
+	}
+
 	void Insert(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
 	{
 		auto index = static_cast<rtree*>(indexPtr.get());
+		Tidwall::ArenaScope const scope{ index };
 
 		if constexpr (GeoToolbox::SpatialKeyIsPoint<TSpatialKey>)
 		{
@@ -175,6 +347,7 @@ struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 	bool Erase(std::shared_ptr<void> const& indexPtr, FeaturePtr feature) const override
 	{
 		auto index = static_cast<rtree*>(indexPtr.get());
+		Tidwall::ArenaScope const scope{ index };
 
 		if constexpr (GeoToolbox::SpatialKeyIsPoint<TSpatialKey>)
 		{
@@ -197,6 +370,19 @@ struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 		return true;
 	}
 
+	struct VisitState
+	{
+		typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor* visitor = nullptr;
+		int count = 0;
+	};
+
+	static bool VisitMatch(double const* /*min*/, double const* /*max*/, void const* data, void* udata)
+	{
+		auto& state = *static_cast<VisitState*>(udata);
+		++state.count;
+		return (*state.visitor)(static_cast<FeaturePtr>(data)->id);
+	}
+
 	[[nodiscard]] int QueryBox(std::shared_ptr<void> const& indexPtr, BoxType const& queryBox) const override
 	{
 		auto index = static_cast<rtree*>(indexPtr.get());
@@ -206,6 +392,35 @@ struct TidwallRtree : SpatialIndexWrapper<TSpatialKey>
 		rtree_search(index, &queryBoxDouble.Min()[0], &queryBoxDouble.Max()[0], CountMatches, &count);
 		return count;
 	}
+
+	[[nodiscard]] int QueryBoxVisit(std::shared_ptr<void> const& indexPtr, BoxType const& queryBox, typename SpatialIndexWrapper<TSpatialKey>::QueryVisitor& visitor) const override
+	{
+		auto index = static_cast<rtree*>(indexPtr.get());
+
+		VisitState state{ &visitor };
+		auto const queryBoxDouble = BoxTypeDouble::Convert(queryBox);
+		rtree_search(index, &queryBoxDouble.Min()[0], &queryBoxDouble.Max()[0], VisitMatch, &state);
+		return state.count;
+	}
+
+	[[nodiscard]] std::int64_t QueryJoin(std::shared_ptr<void> const& indexPtrA, GeoToolbox::Span<GeoToolbox::Feature<TSpatialKey> const> /*featuresA*/, std::shared_ptr<void> const& indexPtrB, typename SpatialIndexWrapper<TSpatialKey>::JoinCallback& callback) const override
+	{
+		auto const& treeA = *static_cast<Tidwall::rtree const*>(indexPtrA.get());
+		auto const& treeB = *static_cast<Tidwall::rtree const*>(indexPtrB.get());
+		if (treeA.root == nullptr || treeB.root == nullptr || !Tidwall::Intersects(treeA.rect, treeB.rect))
+		{
+			return 0;
+		}
+
+		std::int64_t result = 0;
+		auto reportMatches = [&](void const* data, int matchCount)
+			{
+				callback(static_cast<FeaturePtr>(data)->id, matchCount);
+				result += matchCount;
+			};
+		Tidwall::JoinNodes(*treeA.root, treeA.rect, *treeB.root, treeB.rect, reportMatches);
+		return result;
+	}
 };
 
 template <typename TSpatialKey>
@@ -13,6 +13,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <thread>
 
 using namespace std;
 
@@ -65,6 +66,109 @@ TEST_CASE("Timing")
 		RELEASE_ONLY(REQUIRE(timings.TotalRunningTime() >= timings.MinimumRunningTime()));
 		REQUIRE(timings.GetAllActions().size() == 2);
 	}
+
+	SECTION("Warmup and samples")
+	{
+		Timings sampledTimings{ 1, 0, 100 };
+		sampledTimings.SetWarmupIterations(3);
+		sampledTimings.SetMinimumIterationCount(20);
+
+		auto runs = 0;
+		while (sampledTimings.NextIteration())
+		{
+			sampledTimings.Record("count", [&runs] { return ++runs; });
+		}
+
+		auto const& action = sampledTimings.GetAllActions().begin()->second;
+		RELEASE_ONLY(REQUIRE(Size(action.samples) >= 20));
+		REQUIRE(runs == Size(action.samples) + 3);
+		REQUIRE(action.iterationCount == Size(action.samples));
+		REQUIRE(action.GetMedianTime() >= action.bestTime);
+	}
+
+#if TRACK_ALLOCATED_MEMORY
+	SECTION("Peak memory and allocations")
+	{
+		constexpr auto BufferSize = 1 << 20;
+		auto const allocateBuffer = []
+			{
+				vector<char> buffer(BufferSize);
+				return DoNotOptimize(buffer[BufferSize / 2]);
+			};
+
+		while (timings.NextIteration())
+		{
+			timings.Record("transient", allocateBuffer);
+
+			// The buffer is counted by the thread that allocates it
+			timings.Record("transient on another thread", [&allocateBuffer]
+				{
+					thread worker{ allocateBuffer };
+					worker.join();
+				});
+		}
+
+		for (auto const& action : timings.GetAllActions())
+		{
+			REQUIRE(action.second.memoryDelta == 0);
+			REQUIRE(action.second.peakMemory >= BufferSize);
+			REQUIRE(action.second.allocationCount >= 1);
+		}
+	}
+#endif
+}
+
+TEST_CASE("MedianAbsoluteDeviation")
+{
+	using namespace GeoToolbox;
+
+	REQUIRE(GetMedian(vector<double>{}) == 0);
+	REQUIRE(GetMedian(vector<double>{ 3, 1, 2 }) == 2);
+	REQUIRE(GetMedian(vector<double>{ 4, 1, 3, 2 }) == 2.5);
+
+	// The outlier moves neither the median nor the deviation
+	vector<double> const values{ 10, 11, 9, 10, 12, 8, 1000 };
+	REQUIRE(GetMedian(values) == 10);
+	REQUIRE(GetMedianAbsoluteDeviation(values) == 1);
+}
+
+TEST_CASE("LatencyHistogram")
+{
+	using namespace GeoToolbox;
+
+	LatencyHistogram histogram;
+	REQUIRE(histogram.GetPercentile(50) == 0);
+
+	// Small values have a bucket each
+	for (auto i = 1; i <= 50; ++i)
+	{
+		histogram.Add(i);
+	}
+
+	REQUIRE(histogram.GetPercentile(50) == 25);
+	REQUIRE(histogram.GetPercentile(100) == 50);
+
+	histogram.Clear();
+	for (auto i = 1; i <= 100'000; ++i)
+	{
+		histogram.Add(i);
+	}
+
+	REQUIRE(histogram.Count() == 100'000);
+	REQUIRE(histogram.Maximum() == 100'000);
+	for (auto const percentile : { 50.0, 90.0, 99.0, 99.9 })
+	{
+		auto const exact = percentile * 1000;
+		auto const reported = double(histogram.GetPercentile(percentile));
+		REQUIRE(reported >= exact);
+		REQUIRE(reported <= exact * (1 + 1.0 / (1 << LatencyHistogram::SubBucketBits)));
+	}
+
+	LatencyHistogram other;
+	other.Add(int64_t(1) << 50);
+	histogram.Merge(other);
+	REQUIRE(histogram.Count() == 100'001);
+	REQUIRE(histogram.GetPercentile(100) == int64_t(1) << 50);
 }
 
 struct X
@@ -138,6 +242,14 @@ TEST_CASE("DescribeStruct")
 	CopyStruct(x, x2);
 	REQUIRE(x2.i == x.i);
 	REQUIRE(x2.s == x.s);
+
+	// The columns of another version of the struct, reordered, with an unknown one and without "Float"
+	StringStorage storage;
+	X2 x2read = { 0, "", -3 };
+	ReadStructColumns({ "String", "Unknown", "Int" }, { "qwe", "7", "19" }, x2read, storage);
+	REQUIRE(x2read.i == 19);
+	REQUIRE(x2read.s == "qwe");
+	REQUIRE(x2read.f == -3);
 }
 
 
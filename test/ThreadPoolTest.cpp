@@ -0,0 +1,99 @@
+// Copyright 2024-2026 Ivan Kolev
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+#include "GeoToolbox/SpatialTools.hpp"
+#include "GeoToolbox/ThreadPool.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace GeoToolbox;
+using namespace std;
+
+TEST_CASE("ThreadPool")
+{
+	for (auto const threadCount : { 1, 2, 5 })
+	{
+		ThreadPool pool{ threadCount };
+		REQUIRE(pool.GetThreadCount() == threadCount);
+
+		// Each thread runs exactly once per run, and the pool can be reused
+		for (auto run = 0; run < 3; ++run)
+		{
+			vector<int> calls(threadCount);
+			pool.Run([&calls](int threadIndex) { ++calls[threadIndex]; });
+			REQUIRE(all_of(calls.begin(), calls.end(), [](int count) { return count == 1; }));
+		}
+
+		vector<int> visits(1001);
+		pool.ForEachIndex(int(visits.size()), 16, [&visits](int index, int) { ++visits[index]; });
+		REQUIRE(accumulate(visits.begin(), visits.end(), 0) == int(visits.size()));
+		REQUIRE(find(visits.begin(), visits.end(), 0) == visits.end());
+
+		REQUIRE_THROWS_AS(pool.Run([](int threadIndex) { if (threadIndex == 0) throw runtime_error("test"); }), runtime_error);
+	}
+
+	REQUIRE(ThreadPool{}.GetThreadCount() == ThreadPool::GetHardwareThreadCount());
+}
+
+TEST_CASE("QueryStats")
+{
+	constexpr auto ThreadCount = 4;
+	constexpr auto CallsPerThread = 10'000;
+
+	ThreadPool pool{ ThreadCount };
+	ClearQueryStats();
+	pool.Run([](int)
+		{
+			for (auto i = 0; i < CallsPerThread; ++i)
+			{
+				AddQueryStats_ScalarComparisonsCount();
+				AddQueryStats_VisitedNodesCount();
+				AddQueryStats_ObjectTestsCount(2);
+			}
+		});
+
+	auto const stats = CollectQueryStats();
+	REQUIRE(stats.ScalarComparisonsCount == ThreadCount * CallsPerThread);
+	REQUIRE(stats.VisitedNodesCount == ThreadCount * CallsPerThread);
+	REQUIRE(stats.ObjectTestsCount == 2 * ThreadCount * CallsPerThread);
+	REQUIRE(stats.BoxOverlapsCount == 0);
+
+	// The averages of DebugPrint() are over the given count of queries
+	REQUIRE(CollectQueryStats(CallsPerThread).QueryCount == CallsPerThread);
+
+	// The counts of threads that have exited are kept until cleared
+	std::thread{ [] { AddQueryStats_BoxOverlapsCount(); } }.join();
+	REQUIRE(CollectQueryStats().BoxOverlapsCount == 1);
+
+	ClearQueryStats();
+	REQUIRE(CollectQueryStats().IsEmpty());
+}
+
+TEST_CASE("ParallelMakeRandomSpatialKeys")
+{
+	// More than one chunk, so that the threads share the work
+	constexpr auto DatasetSize = 40'000;
+
+	auto const make = [](int threadCount)
+		{
+			return ParallelMakeRandomSpatialKeys<Box2>(13, DatasetSize, Box2::Square(100), { 0.1, 1.0 }, 2, 3, 4, threadCount);
+		};
+
+	auto const reference = make(1);
+	REQUIRE(int(reference.size()) == DatasetSize);
+	for (auto const threadCount : { 2, 5 })
+	{
+		auto const features = make(threadCount);
+		REQUIRE(equal(features.begin(), features.end(), reference.begin(), reference.end(), [](auto const& a, auto const& b) { return a.id == b.id && a.spatialKey == b.spatialKey; }));
+	}
+
+	REQUIRE(CounterRandomGenerator{ 13, 1 }() != CounterRandomGenerator{ 13, 2 }());
+	REQUIRE(CounterRandomGenerator{ 13, 1 }() != CounterRandomGenerator{ 14, 1 }());
+}